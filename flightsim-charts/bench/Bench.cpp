@@ -0,0 +1,378 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include "Bench.h"
+#include "Recorder.h"
+
+const int MaxResults = 256;
+const int TimedRuns = 3;
+
+struct BenchResult {
+    char name[64];
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+// Variables
+std::atomic<long long> _allocations(0);
+int _minMillis = 200;
+double _threshold = 25;
+BenchResult _baseline[MaxResults];
+int _baselineCount = 0;
+BenchResult _result[MaxResults];
+int _resultCount = 0;
+int _checks = 0;
+int _failures = 0;
+char* _recording = NULL;
+long long _recordingSize = 0;
+
+
+/// Allocations are counted by wrapping malloc, calloc and realloc at link
+/// time (see CMakeLists.txt) and by replacing the global operator new.
+/// Only calls made from the bench and the modules it is linked with are
+/// counted, not ones made inside the C and C++ runtimes.
+
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* ptr, size_t size);
+
+    void* __wrap_malloc(size_t size)
+    {
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_malloc(size);
+    }
+
+    void* __wrap_calloc(size_t count, size_t size)
+    {
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_calloc(count, size);
+    }
+
+    void* __wrap_realloc(void* ptr, size_t size)
+    {
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        return __real_realloc(ptr, size);
+    }
+}
+
+void* operator new(size_t size)
+{
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = __real_malloc(size ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+/// <summary>
+/// Time (in ns) is the minimum run time for each benchmark and
+/// threshold is the percentage slower than its baseline that fails it.
+/// </summary>
+void benchInit(int minMillis, double threshold)
+{
+    _minMillis = minMillis;
+    _threshold = threshold;
+}
+
+long long benchAllocations()
+{
+    return _allocations.load(std::memory_order_relaxed);
+}
+
+int benchFailures()
+{
+    return _failures;
+}
+
+/// <summary>
+/// Baseline lines are: name ns_per_op allocs_per_op
+/// Lines starting with # are comments.
+/// </summary>
+bool benchLoadBaseline(const char* filename)
+{
+    FILE* inf = fopen(filename, "r");
+    if (inf == NULL) {
+        printf("Failed to open baseline %s\n", filename);
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), inf) && _baselineCount < MaxResults) {
+        if (*line == '#' || *line == '\n') {
+            continue;
+        }
+
+        BenchResult* base = &_baseline[_baselineCount];
+        if (sscanf(line, "%63s %lf %lf", base->name, &base->nsPerOp, &base->allocsPerOp) == 3) {
+            _baselineCount++;
+        }
+        else {
+            printf("Bad baseline line ignored: %s", line);
+        }
+    }
+
+    fclose(inf);
+    return true;
+}
+
+bool benchSaveBaseline(const char* filename)
+{
+    FILE* outf = fopen(filename, "w");
+    if (outf == NULL) {
+        printf("Failed to create baseline %s\n", filename);
+        return false;
+    }
+
+    fprintf(outf, "# name ns_per_op allocs_per_op\n");
+    for (int i = 0; i < _resultCount; i++) {
+        fprintf(outf, "%s %.2f %.4f\n", _result[i].name, _result[i].nsPerOp, _result[i].allocsPerOp);
+    }
+
+    fclose(outf);
+    printf("Saved baseline %s\n", filename);
+    return true;
+}
+
+/// <summary>
+/// Load a session recorded by the app so its data can be used
+/// as input to the benchmarks.
+/// </summary>
+bool benchLoadRecording(const char* filename)
+{
+    FILE* inf = fopen(filename, "rb");
+    if (inf == NULL) {
+        printf("Failed to open recording %s\n", filename);
+        return false;
+    }
+
+    fseek(inf, 0, SEEK_END);
+    long size = ftell(inf);
+    fseek(inf, 0, SEEK_SET);
+
+    _recording = (char*)malloc(size > 0 ? size : 1);
+    if (_recording == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    _recordingSize = fread(_recording, 1, size, inf);
+    fclose(inf);
+
+    unsigned int version;
+    if (_recordingSize < (long long)(sizeof(RecordMagic) + sizeof(version)) || memcmp(_recording, RecordMagic, sizeof(RecordMagic)) != 0) {
+        printf("Not a recording: %s\n", filename);
+        _recordingSize = 0;
+        return false;
+    }
+
+    memcpy(&version, _recording + sizeof(RecordMagic), sizeof(version));
+    if (version != RecordVersion) {
+        printf("Recording %s is version %u, expected %d\n", filename, version, RecordVersion);
+        _recordingSize = 0;
+        return false;
+    }
+
+    printf("Using recording %s\n", filename);
+    return true;
+}
+
+/// <summary>
+/// Returns all the data recorded for a stream joined together, or NULL
+/// if there is no recording. The feed stream comes out exactly as it was
+/// received from the fr24 server. Caller must free the data.
+/// </summary>
+const char* benchRecording(int stream, int* size)
+{
+    if (_recordingSize == 0) {
+        return NULL;
+    }
+
+    long long total = 0;
+    long long pos = sizeof(RecordMagic) + sizeof(unsigned int);
+    while (pos + (long long)sizeof(RecordHeader) <= _recordingSize) {
+        RecordHeader header;
+        memcpy(&header, _recording + pos, sizeof(header));
+        if (pos + (long long)sizeof(header) + header.size > _recordingSize) {
+            break;
+        }
+        if ((int)header.stream == stream) {
+            total += header.size;
+        }
+        pos += sizeof(header) + header.size;
+    }
+
+    char* data = (char*)malloc(total > 0 ? total : 1);
+    if (data == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    *size = 0;
+    pos = sizeof(RecordMagic) + sizeof(unsigned int);
+    while (*size < total) {
+        RecordHeader header;
+        memcpy(&header, _recording + pos, sizeof(header));
+        if ((int)header.stream == stream) {
+            memcpy(data + *size, _recording + pos + sizeof(header), header.size);
+            *size += header.size;
+        }
+        pos += sizeof(header) + header.size;
+    }
+
+    return data;
+}
+
+/// <summary>
+/// Returns the time taken in ns to call the function the given number
+/// of times and sets allocs to the number of allocations it made.
+/// </summary>
+double timeCalls(void (*fn)(), long long calls, long long* allocs)
+{
+    long long startAllocs = benchAllocations();
+    auto start = std::chrono::steady_clock::now();
+
+    for (long long i = 0; i < calls; i++) {
+        fn();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    *allocs = benchAllocations() - startAllocs;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+BenchResult* findBaseline(const char* name)
+{
+    for (int i = 0; i < _baselineCount; i++) {
+        if (strcmp(_baseline[i].name, name) == 0) {
+            return &_baseline[i];
+        }
+    }
+
+    return NULL;
+}
+
+/// <summary>
+/// Time the function, which must do opsPerCall operations each time it
+/// is called. It is called once before timing so anything that is only
+/// allocated the first time isn't counted. Returns the time per operation.
+/// Results that are kept can be saved as a baseline.
+/// </summary>
+double timeOps(const char* name, int opsPerCall, void (*fn)(), bool keep)
+{
+    fn();
+
+    // Find how many calls take at least the minimum time
+    long long calls = 1;
+    long long allocs;
+    double best;
+    while ((best = timeCalls(fn, calls, &allocs)) < _minMillis * 1e6 && calls < (1LL << 40)) {
+        calls *= 2;
+    }
+
+    for (int run = 1; run < TimedRuns; run++) {
+        double elapsed = timeCalls(fn, calls, &allocs);
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    double ops = (double)calls * opsPerCall;
+    double nsPerOp = best / ops;
+    double allocsPerOp = allocs / ops;
+    printf("%-36s %12.2f ns/op %10.4f allocs/op", name, nsPerOp, allocsPerOp);
+
+    if (!keep) {
+        printf("\n");
+        return nsPerOp;
+    }
+
+    if (_resultCount < MaxResults) {
+        BenchResult* result = &_result[_resultCount++];
+        snprintf(result->name, sizeof(result->name), "%s", name);
+        result->nsPerOp = nsPerOp;
+        result->allocsPerOp = allocsPerOp;
+    }
+
+    BenchResult* base = findBaseline(name);
+    if (base == NULL) {
+        printf("\n");
+        return nsPerOp;
+    }
+
+    double change = (nsPerOp / base->nsPerOp - 1) * 100;
+    printf("  %+6.0f%%", change);
+
+    // Allocation counts don't depend on the machine so any increase is a regression
+    if (change > _threshold || allocsPerOp > base->allocsPerOp + 0.00005) {
+        printf("  REGRESSION (baseline %.2f ns/op %.4f allocs/op)", base->nsPerOp, base->allocsPerOp);
+        _failures++;
+    }
+    printf("\n");
+    return nsPerOp;
+}
+
+double benchRun(const char* name, int opsPerCall, void (*fn)())
+{
+    return timeOps(name, opsPerCall, fn, true);
+}
+
+/// <summary>
+/// Like benchRun but never compared with a baseline, for timings that
+/// depend on more than the code, e.g. the network stack.
+/// </summary>
+double benchMeasure(const char* name, int opsPerCall, void (*fn)())
+{
+    return timeOps(name, opsPerCall, fn, false);
+}
+
+/// <summary>
+/// Report a measurement that is only for information, e.g. throughput.
+/// </summary>
+void benchReport(const char* name, double value, const char* units)
+{
+    printf("%-36s %12.2f %s\n", name, value, units);
+}
+
+/// <summary>
+/// Returns ok. A check that isn't ok is reported and fails the run.
+/// </summary>
+bool benchCheck(bool ok, const char* format, ...)
+{
+    _checks++;
+    if (ok) {
+        return true;
+    }
+
+    va_list args;
+    va_start(args, format);
+    printf("CHECK FAILED: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+
+    _failures++;
+    return false;
+}
+
+int benchChecks()
+{
+    return _checks;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Platform.h"
+
+/// Headless benchmarks and checks for the pure modules, built with
+/// FSC_HEADLESS so they run on a Linux build box.
+///
+/// A benchmark runs its function until enough time has passed to time it
+/// and reports the time and the number of allocations per operation. If
+/// a baseline has been loaded a benchmark fails when it is more than the
+/// threshold percentage slower than its baseline or makes more
+/// allocations. Checks are correctness tests that run alongside the
+/// benchmarks and fail the run if they don't hold.
+///
+/// Recorded data comes from a session recorded by the app (see Recorder.h).
+
+void benchInit(int minMillis, double threshold);
+bool benchLoadBaseline(const char* filename);
+bool benchSaveBaseline(const char* filename);
+bool benchLoadRecording(const char* filename);
+const char* benchRecording(int stream, int* size);
+double benchRun(const char* name, int opsPerCall, void (*fn)());
+double benchMeasure(const char* name, int opsPerCall, void (*fn)());
+void benchReport(const char* name, double value, const char* units);
+bool benchCheck(bool ok, const char* format, ...);
+long long benchAllocations();
+int benchChecks();
+int benchFailures();
+
+// Synthetic data
+int benchMakeFeedText(char* data, int size, int lines);
+const char* benchRecordedFeedText(int* size, int* lines);
+void benchCalibrateChart(double lat0, double lon0, double lat1, double lon1);
+
+// Suites
+void benchCoords();
+void benchAiIndex();
+void benchFeedParser();
+void benchFeedBinary();
+void benchFeedQueue();
+void benchServerWait();
+void benchSharedFrames();
+void benchSpatialGrid();
+void benchStaticGrids();
+void benchLayerLod();
+void benchChartTiles();
+void benchLabelAtlas();
+void benchIconClass();
+void benchRecorder();
+void benchFrame();
+void benchKeepAlive();
+void benchDelta();
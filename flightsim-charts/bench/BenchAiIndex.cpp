@@ -0,0 +1,262 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "flightsim-charts.h"
+#include "AiIndex.h"
+
+const int CallsignPool = 6000;      // More than Max_AI_Aircraft so some lookups miss
+
+// Variables
+char _callsigns[CallsignPool][16];
+AI_Aircraft _benchAircraft[Max_AI_Aircraft];
+int _benchAircraftCount = 0;
+AiIndexSlot _benchSlots[Ai_Aircraft_Index_Size];
+AiIndex _benchIndex = { _benchSlots, Ai_Aircraft_Index_Size, 0 };
+int _payload[Max_AI_Aircraft];      // Callsign of each line in the payload
+int _found;
+AI_Aircraft _fullAircraft[Max_AI_Aircraft];
+bool _stale[Max_AI_Aircraft];
+
+
+void makeCallsigns()
+{
+    static const char* airlines[] = { "BAW", "EZY", "RYR", "DLH", "AFR", "KLM", "UAE", "AAL" };
+
+    srand(2);
+    for (int i = 0; i < CallsignPool; i++) {
+        sprintf(_callsigns[i], "%s%d", airlines[i % 8], 100 + i);
+    }
+}
+
+/// <summary>
+/// Fill the table and index with the first Max_AI_Aircraft callsigns
+/// </summary>
+void fillAircraft()
+{
+    aiIndexClear(&_benchIndex);
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        strcpy(_benchAircraft[i].callsign, _callsigns[i]);
+        aiIndexSet(&_benchIndex, _callsigns[i], i);
+    }
+    _benchAircraftCount = Max_AI_Aircraft;
+}
+
+/// <summary>
+/// Each payload line is a random callsign from the pool (1 in 6 are
+/// not in the table, like new aircraft arriving).
+/// </summary>
+void makePayload()
+{
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        _payload[i] = rand() % CallsignPool;
+    }
+}
+
+/// <summary>
+/// How processData found aircraft before the index
+/// </summary>
+int linearFind(const char* callsign)
+{
+    for (int i = 0; i < _benchAircraftCount; i++) {
+        if (strcmp(_benchAircraft[i].callsign, callsign) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void benchIndexLookup()
+{
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        if (aiIndexFind(&_benchIndex, _callsigns[_payload[i]]) != -1) {
+            _found++;
+        }
+    }
+}
+
+void benchLinearLookup()
+{
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        if (linearFind(_callsigns[_payload[i]]) != -1) {
+            _found++;
+        }
+    }
+}
+
+/// <summary>
+/// Random adds, moves and removes, checking every lookup against a
+/// linear scan of the table. Removes shift entries back so this also
+/// checks that nothing becomes unreachable.
+/// </summary>
+void checkIndexMatchesScan()
+{
+    aiIndexClear(&_benchIndex);
+    _benchAircraftCount = 0;
+
+    for (int op = 0; op < 200000; op++) {
+        const char* callsign = _callsigns[rand() % CallsignPool];
+        int expected = linearFind(callsign);
+        int found = aiIndexFind(&_benchIndex, callsign);
+        if (found != expected) {
+            benchCheck(false, "index found %s at %d, scan found it at %d", callsign, found, expected);
+            return;
+        }
+
+        if (expected == -1) {
+            if (_benchAircraftCount < Max_AI_Aircraft) {
+                strcpy(_benchAircraft[_benchAircraftCount].callsign, callsign);
+                aiIndexSet(&_benchIndex, callsign, _benchAircraftCount);
+                _benchAircraftCount++;
+            }
+        }
+        else if (rand() % 3 == 0) {
+            // Swap remove, so the last aircraft moves
+            aiIndexRemove(&_benchIndex, callsign);
+            _benchAircraftCount--;
+            if (expected < _benchAircraftCount) {
+                _benchAircraft[expected] = _benchAircraft[_benchAircraftCount];
+                aiIndexSet(&_benchIndex, _benchAircraft[expected].callsign, expected);
+            }
+        }
+    }
+
+    benchCheck(_benchIndex.count == _benchAircraftCount, "index has %d entries, table has %d", _benchIndex.count, _benchAircraftCount);
+}
+
+void checkKeys()
+{
+    AiKey key;
+    benchCheck(!aiMakeKey("", &key), "empty callsign made a key");
+    benchCheck(!aiMakeKey("ABCDEFGHIJKLMNOP", &key), "16 char callsign made a key");
+    benchCheck(aiMakeKey("ABCDEFGHIJKLMNO", &key), "15 char callsign didn't make a key");
+    benchCheck(aiIndexFind(&_benchIndex, "") == -1, "empty callsign found");
+}
+
+/// <summary>
+/// Put back the full table before each removal
+/// </summary>
+void refillAircraft()
+{
+    memcpy(_benchAircraft, _fullAircraft, sizeof(_benchAircraft));
+    _benchAircraftCount = Max_AI_Aircraft;
+    aiIndexClear(&_benchIndex);
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        aiIndexSet(&_benchIndex, _benchAircraft[i].callsign, i);
+    }
+}
+
+/// <summary>
+/// Mark the stale aircraft like removeStale does
+/// </summary>
+void markStale(bool force)
+{
+    for (int i = 0; i < _benchAircraftCount; i++) {
+        if (force || _stale[i]) {
+            _benchAircraft[i].lastUpdated = 0;
+        }
+    }
+}
+
+void benchRefill()
+{
+    refillAircraft();
+}
+
+void benchForcedClear()
+{
+    refillAircraft();
+    markStale(true);
+    _benchAircraftCount = aiCompact(_benchAircraft, _benchAircraftCount, &_benchIndex);
+}
+
+void benchPartialClear()
+{
+    refillAircraft();
+    markStale(false);
+    _benchAircraftCount = aiCompact(_benchAircraft, _benchAircraftCount, &_benchIndex);
+}
+
+/// <summary>
+/// How removeStale removed aircraft before, moving the whole tail of
+/// the table down for each one
+/// </summary>
+void benchPartialClearMemmove()
+{
+    refillAircraft();
+    for (int i = 0, from = 0; from < Max_AI_Aircraft; from++) {
+        if (_stale[from]) {
+            aiIndexRemove(&_benchIndex, _benchAircraft[i].callsign);
+            _benchAircraftCount--;
+            memmove(&_benchAircraft[i], &_benchAircraft[i + 1], sizeof(AI_Aircraft) * (_benchAircraftCount - i));
+            for (int j = i; j < _benchAircraftCount; j++) {
+                aiIndexSet(&_benchIndex, _benchAircraft[j].callsign, j);
+            }
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+/// <summary>
+/// Survivors must keep their order and the index must find every
+/// survivor at its new slot and none of the removed aircraft.
+/// </summary>
+void checkCompact(const char* name, bool force)
+{
+    refillAircraft();
+    markStale(force);
+    _benchAircraftCount = aiCompact(_benchAircraft, _benchAircraftCount, &_benchIndex);
+
+    int expected = 0;
+    int mismatches = 0;
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        const char* callsign = _fullAircraft[i].callsign;
+        int found = aiIndexFind(&_benchIndex, callsign);
+        if (force || _stale[i]) {
+            if (found != -1) {
+                mismatches++;
+            }
+        }
+        else {
+            if (found != expected || strcmp(_benchAircraft[expected].callsign, callsign) != 0) {
+                mismatches++;
+            }
+            expected++;
+        }
+    }
+
+    benchCheck(_benchAircraftCount == expected, "%s kept %d aircraft, expected %d", name, _benchAircraftCount, expected);
+    benchCheck(mismatches == 0, "%s left %d aircraft in the wrong place", name, mismatches);
+    benchCheck(_benchIndex.count == expected, "%s index has %d entries, expected %d", name, _benchIndex.count, expected);
+}
+
+void benchAiIndex()
+{
+    makeCallsigns();
+    checkIndexMatchesScan();
+    checkKeys();
+
+    // Lookups for a synthetic 5000 line payload against a full table
+    fillAircraft();
+    makePayload();
+    benchRun("ai.lookup.index", Max_AI_Aircraft, benchIndexLookup);
+    benchRun("ai.lookup.linear", Max_AI_Aircraft, benchLinearLookup);
+
+    // Removing 1 in 10 aircraft or all of them from a full table
+    for (int i = 0; i < Max_AI_Aircraft; i++) {
+        _fullAircraft[i] = _benchAircraft[i];
+        _fullAircraft[i].lastUpdated = 1;
+        _stale[i] = rand() % 10 == 0;
+    }
+    checkCompact("partial clear", false);
+    checkCompact("forced clear", true);
+
+    // Each of these includes refilling the table
+    benchRun("ai.removeStale.refill", Max_AI_Aircraft, benchRefill);
+    benchRun("ai.removeStale.forced", Max_AI_Aircraft, benchForcedClear);
+    benchRun("ai.removeStale.partial", Max_AI_Aircraft, benchPartialClear);
+    benchRun("ai.removeStale.partial.memmove", Max_AI_Aircraft, benchPartialClearMemmove);
+}
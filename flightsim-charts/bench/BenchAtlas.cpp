@@ -0,0 +1,224 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "AtlasPacker.h"
+
+const int NatsObstacles = 40000;    // About as many as the full NATS obstacle file
+const int AtlasLabels = NatsObstacles * 2;
+const int VisibleObstacles = 2000;
+const int LabelHeight = 10;         // See createTagBitmap
+
+/// Obstacle types in the NATS file, most common first
+const int ObstacleTypes = 10;
+const char* ObstacleType[ObstacleTypes] = {
+    "WIND TURBINE", "BUILDING", "MAST", "CRANE", "CHIMNEY", "PYLON", "TOWER", "SPIRE", "LIGHTING TOWER", "COOLING TOWER"
+};
+
+struct PlacedLabel {
+    int page;
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Variables
+int _labelWidth[AtlasLabels];
+PlacedLabel _placed[AtlasLabels];
+LabelAtlas _benchAtlas;
+
+
+/// <summary>
+/// Width of the tag createTagBitmap makes for the text
+/// </summary>
+int tagWidth(const char* text)
+{
+    return 4 + (int)strlen(text) * 8;
+}
+
+/// <summary>
+/// A name and an elevation tag for each obstacle, in the order
+/// loadObstacles creates them
+/// </summary>
+void makeObstacleLabels()
+{
+    char elevation[16];
+    for (int i = 0; i < NatsObstacles; i++) {
+        int type = rand() % (ObstacleTypes * 2);
+        if (type >= ObstacleTypes) {
+            type = 0;
+        }
+        _labelWidth[i * 2] = tagWidth(ObstacleType[type]);
+
+        int feet = 50 + (rand() % 100) * (rand() % 100) / 8;
+        sprintf(elevation, "%d ft", feet);
+        _labelWidth[i * 2 + 1] = tagWidth(elevation);
+    }
+}
+
+void atlasFree(LabelAtlas* atlas)
+{
+    for (int i = 0; i < atlas->pageCount; i++) {
+        free(atlas->page[i]);
+    }
+    atlas->pageCount = 0;
+}
+
+/// <summary>
+/// Returns the number of labels that didn't fit and would get a bitmap
+/// of their own
+/// </summary>
+int packLabels(LabelAtlas* atlas, int count)
+{
+    int unplaced = 0;
+    for (int i = 0; i < count; i++) {
+        PlacedLabel* label = &_placed[i];
+        label->width = _labelWidth[i];
+        label->height = LabelHeight;
+        if (!atlasPlace(atlas, label->width, label->height, &label->page, &label->x, &label->y)) {
+            label->page = -1;
+            unplaced++;
+        }
+    }
+
+    return unplaced;
+}
+
+/// <summary>
+/// Every label must be inside its page and no two labels may share a pixel
+/// </summary>
+void checkPlacement(int count, int pageCount)
+{
+    unsigned char* used = (unsigned char*)malloc(AtlasPageSize * AtlasPageSize);
+    if (used == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    int outside = 0;
+    int overlaps = 0;
+    for (int page = 0; page < pageCount; page++) {
+        memset(used, 0, AtlasPageSize * AtlasPageSize);
+
+        for (int i = 0; i < count; i++) {
+            const PlacedLabel* label = &_placed[i];
+            if (label->page != page) {
+                continue;
+            }
+
+            if (label->x < 0 || label->y < 0 || label->x + label->width > AtlasPageSize || label->y + label->height > AtlasPageSize) {
+                outside++;
+                continue;
+            }
+
+            for (int y = label->y; y < label->y + label->height; y++) {
+                for (int x = label->x; x < label->x + label->width; x++) {
+                    if (used[y * AtlasPageSize + x]++ != 0) {
+                        overlaps++;
+                    }
+                }
+            }
+        }
+    }
+
+    free(used);
+
+    benchCheck(outside == 0, "%d labels were placed outside their page", outside);
+    benchCheck(overlaps == 0, "%d label pixels overlapped", overlaps);
+}
+
+/// <summary>
+/// Labels too big for a page, or that come after the atlas is full, must
+/// be refused so they get their own bitmap
+/// </summary>
+void checkAtlasFull()
+{
+    LabelAtlas atlas;
+    atlas.pageCount = 0;
+
+    int pageNum;
+    int x;
+    int y;
+    benchCheck(!atlasPlace(&atlas, AtlasPageSize + 1, LabelHeight, &pageNum, &x, &y)
+        && !atlasPlace(&atlas, 10, AtlasPageSize + 1, &pageNum, &x, &y) && atlas.pageCount == 0, "label bigger than a page was placed");
+
+    int placed = 0;
+    while (placed <= MaxAtlasPages && atlasPlace(&atlas, AtlasPageSize, AtlasPageSize, &pageNum, &x, &y)) {
+        placed++;
+    }
+    benchCheck(placed == MaxAtlasPages && atlas.pageCount == MaxAtlasPages && !atlasPlace(&atlas, 1, 1, &pageNum, &x, &y),
+        "full atlas took %d page sized labels, has %d pages", placed, atlas.pageCount);
+
+    atlasFree(&atlas);
+}
+
+/// <summary>
+/// Loading the full obstacle file with names shown must fit in the atlas,
+/// otherwise the rest of the labels fall back to a bitmap each
+/// </summary>
+void checkObstacles()
+{
+    LabelAtlas atlas;
+    atlas.pageCount = 0;
+
+    int unplaced = packLabels(&atlas, AtlasLabels);
+    checkPlacement(AtlasLabels, atlas.pageCount);
+    benchCheck(unplaced == 0, "%d of %d obstacle labels didn't fit in %d atlas pages", unplaced, AtlasLabels, MaxAtlasPages);
+
+    double labelPixels = 0;
+    for (int i = 0; i < AtlasLabels; i++) {
+        if (_placed[i].page != -1) {
+            labelPixels += (double)_labelWidth[i] * LabelHeight;
+        }
+    }
+
+    benchReport("atlas.nats pages", atlas.pageCount, "pages");
+    benchReport("atlas.nats video memory", atlas.pageCount * AtlasPageSize * 4.0 * AtlasPageSize / (1024 * 1024), "MB");
+    benchReport("atlas.nats fill", 100 * labelPixels / ((double)atlas.pageCount * AtlasPageSize * AtlasPageSize), "%");
+
+    // Labels drawn with bitmap drawing held are batched until the page
+    // changes. Before the atlas every label was its own bitmap. Visible
+    // obstacles come from the grid in index order.
+    int batches = 0;
+    int lastPage = -1;
+    int visible = 0;
+    for (int num = 0; num < NatsObstacles; num++) {
+        if (rand() % NatsObstacles >= VisibleObstacles) {
+            continue;
+        }
+        visible++;
+        for (int tag = 0; tag < 2; tag++) {
+            int page = _placed[num * 2 + tag].page;
+            if (page != lastPage || page == -1) {
+                batches++;
+            }
+            lastPage = page;
+        }
+    }
+    benchReport("atlas.frame batches", batches, "batches");
+    benchReport("atlas.frame batches before", visible * 2, "batches");
+
+    atlasFree(&atlas);
+}
+
+/// <summary>
+/// Place every label of the full obstacle file as loading it does
+/// </summary>
+void benchAtlasLoad()
+{
+    packLabels(&_benchAtlas, AtlasLabels);
+    atlasFree(&_benchAtlas);
+}
+
+void benchLabelAtlas()
+{
+    srand(20);
+    makeObstacleLabels();
+
+    checkAtlasFull();
+    checkObstacles();
+
+    _benchAtlas.pageCount = 0;
+    benchRun("atlas.load.nats", AtlasLabels, benchAtlasLoad);
+}
@@ -0,0 +1,296 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Bench.h"
+#include "FeedParser.h"
+#include "FeedBinary.h"
+
+const int BinaryLines = 5000;
+const int TrailPoints = sizeof(AI_Trail::loc) / sizeof(Locn);
+const double LocTolerance = 0.5e-7 + 1e-12;
+
+/// The raw fields of an aircraft, as sent in either format
+struct RawAircraft {
+    const char* callsign;
+    const char* airline;
+    const char* model;
+    const char* lat;
+    const char* lon;
+};
+
+// Variables
+char _binaryText[BinaryLines * 128];
+int _binaryTextSize;
+char _binaryData[FeedHeaderSize + BinaryLines * FeedAircraftSize];
+int _binaryDataSize;
+AI_Trail _trailIn;
+AI_Trail _trailOut;
+char _trailText[TrailPoints * 32 + 1024];
+int _trailTextSize;
+char _trailData[FeedMaxTrailSize];
+int _trailDataSize;
+int _decoded;
+
+
+bool sameAircraft(const AI_Aircraft* a, const AI_Aircraft* b)
+{
+    return strcmp(a->callsign, b->callsign) == 0 && strcmp(a->airline, b->airline) == 0 && strcmp(a->model, b->model) == 0
+        && fabs(a->loc.lat - b->loc.lat) <= LocTolerance && fabs(a->loc.lon - b->loc.lon) <= LocTolerance
+        && fabs(a->heading - b->heading) <= 0.005 && fabs(a->alt - b->alt) <= 0.5 && fabs(a->speed - b->speed) <= 0.5;
+}
+
+/// <summary>
+/// Encode the synthetic text payload as a binary payload. Every aircraft
+/// must decode to what the text parser gave.
+/// </summary>
+void checkAircraftRoundTrip()
+{
+    FeedHeader header = { true, true, 1234567 };
+    _binaryDataSize = encodeFeedHeader(_binaryData, &header);
+
+    int count = 0;
+    const char* data = _binaryText;
+    const char* end = &_binaryText[_binaryTextSize];
+    AI_Aircraft* parsed = (AI_Aircraft*)malloc(sizeof(AI_Aircraft) * BinaryLines);
+    if (parsed == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    while (data < end) {
+        const char* endLine = findFeedLineEnd(data, end);
+        if (parseAircraftLine(data, endLine, &parsed[count])) {
+            _binaryDataSize += encodeFeedAircraft(&_binaryData[_binaryDataSize], &parsed[count]);
+            count++;
+        }
+        data = endLine + 1;
+    }
+
+    FeedHeader decodedHeader;
+    data = _binaryData;
+    end = &_binaryData[_binaryDataSize];
+    int len = decodeFeedHeader(data, end, &decodedHeader);
+    benchCheck(len == FeedHeaderSize && decodedHeader.isDelta && decodedHeader.isFull && decodedHeader.seq == 1234567, "header didn't round trip");
+    data += len;
+
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) {
+        int type;
+        int t;
+        AI_Aircraft ai;
+        len = decodeFeedRecord(data, end, &type, &ai, NULL, &t);
+        if (len != FeedAircraftSize || type != FEED_AIRCRAFT || !sameAircraft(&ai, &parsed[i])) {
+            if (mismatches++ == 0) {
+                printf("%s decoded as %s,%s,%s,%f,%f\n", parsed[i].callsign, ai.callsign, ai.airline, ai.model, ai.loc.lat, ai.loc.lon);
+            }
+        }
+        data += FeedAircraftSize;
+    }
+
+    benchCheck(mismatches == 0, "%d of %d aircraft didn't round trip", mismatches, count);
+    free(parsed);
+}
+
+/// <summary>
+/// A trail of the maximum length with 7 decimal places
+/// </summary>
+void makeTrail()
+{
+    memset(&_trailIn, 0, sizeof(AI_Trail));
+    strcpy(_trailIn.callsign, "BAW123");
+    strcpy(_trailIn.airline, "British Airways");
+    strcpy(_trailIn.modelType, "Airbus A320");
+    memset(_trailIn.image, 'i', sizeof(_trailIn.image) - 1);
+    strcpy(_trailIn.fromAirport, "London Heathrow");
+    strcpy(_trailIn.toAirport, "Paris Charles de Gaulle");
+
+    srand(7);
+    _trailTextSize = sprintf(_trailText, "!2!%s!%s!%s!%s!%s!%s", _trailIn.callsign, _trailIn.airline, _trailIn.modelType,
+        _trailIn.image, _trailIn.fromAirport, _trailIn.toAirport);
+    for (int i = 0; i < TrailPoints; i++) {
+        _trailIn.loc[i].lat = (rand() % 1800000000 - 900000000) / 1e7;
+        _trailIn.loc[i].lon = (rand() % 2000000000 - 1000000000) / 1e7 * 1.8;
+        _trailIn.loc[i].lon = floor(_trailIn.loc[i].lon * 1e7 + 0.5) / 1e7;
+        _trailTextSize += sprintf(&_trailText[_trailTextSize], "!%.7f!%.7f", _trailIn.loc[i].lat, _trailIn.loc[i].lon);
+    }
+    _trailIn.count = TrailPoints;
+
+    _trailDataSize = encodeFeedTrail(_trailData, 1, &_trailIn);
+}
+
+bool sameTrail(const AI_Trail* a, const AI_Trail* b)
+{
+    if (strcmp(a->callsign, b->callsign) != 0 || strcmp(a->airline, b->airline) != 0 || strcmp(a->modelType, b->modelType) != 0
+        || strcmp(a->image, b->image) != 0 || strcmp(a->fromAirport, b->fromAirport) != 0 || strcmp(a->toAirport, b->toAirport) != 0
+        || a->count != b->count) {
+        return false;
+    }
+
+    for (int i = 0; i < a->count; i++) {
+        if (fabs(a->loc[i].lat - b->loc[i].lat) > LocTolerance || fabs(a->loc[i].lon - b->loc[i].lon) > LocTolerance) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// The trail must decode the same from both formats. A record that
+/// hasn't all arrived must ask for more data without using anything.
+/// </summary>
+void checkTrailRoundTrip()
+{
+    int type;
+    int t = -1;
+    AI_Aircraft ai;
+    memset(&_trailOut, 0, sizeof(AI_Trail));
+    int len = decodeFeedRecord(_trailData, &_trailData[_trailDataSize], &type, &ai, &_trailOut, &t);
+    benchCheck(len == _trailDataSize && type == FEED_TRAIL && t == 1 && sameTrail(&_trailIn, &_trailOut), "binary trail didn't round trip");
+
+    memset(&_trailOut, 0, sizeof(AI_Trail));
+    t = parseTrailLine(_trailText, &_trailText[_trailTextSize], &_trailOut);
+    benchCheck(t == 1 && sameTrail(&_trailIn, &_trailOut), "text trail doesn't match binary trail");
+
+    int partials = 0;
+    for (int size = 0; size < _trailDataSize; size += 1 + size / 16) {
+        _trailOut.count = -1;
+        if (decodeFeedRecord(_trailData, &_trailData[size], &type, &ai, &_trailOut, &t) != 0 || _trailOut.count != -1) {
+            partials++;
+        }
+    }
+    benchCheck(partials == 0, "%d partial trails weren't left for more data", partials);
+
+    char buf[FeedAircraftSize];
+    AI_Aircraft in;
+    memset(&in, 0, sizeof(in));
+    strcpy(in.callsign, "BAW1");
+    int size = encodeFeedAircraft(buf, &in);
+    partials = 0;
+    for (int i = 0; i < size; i++) {
+        if (decodeFeedRecord(buf, &buf[i], &type, &ai, NULL, &t) != 0) {
+            partials++;
+        }
+    }
+    benchCheck(partials == 0, "%d partial aircraft weren't left for more data", partials);
+
+    size = encodeFeedRemove(buf, "BAW1");
+    len = decodeFeedRecord(buf, &buf[size], &type, &ai, NULL, &t);
+    benchCheck(len == FeedRemoveSize && type == FEED_REMOVE && strcmp(ai.callsign, "BAW1") == 0, "remove didn't round trip");
+
+    buf[0] = 99;
+    benchCheck(decodeFeedRecord(buf, &buf[size], &type, &ai, NULL, &t) == -1, "unknown record type wasn't bad");
+}
+
+/// <summary>
+/// Decode an aircraft sent in each format from the same raw fields.
+/// Both must accept or reject it and agree on what they accept.
+/// </summary>
+void checkAgreement(const RawAircraft* raw)
+{
+    char line[256];
+    int len = sprintf(line, "%s,%s,%s,%s,%s,90,3000,200", raw->callsign, raw->airline, raw->model, raw->lat, raw->lon);
+    AI_Aircraft text;
+    memset(&text, 0, sizeof(text));
+    bool textOk = parseAircraftLine(line, &line[len], &text);
+
+    // Build the record by hand so fields can be longer than AI_Aircraft allows
+    unsigned char buf[FeedAircraftSize];
+    AI_Aircraft in;
+    memset(&in, 0, sizeof(in));
+    in.loc.lat = *raw->lat ? atof(raw->lat) : NAN;
+    in.loc.lon = *raw->lon ? atof(raw->lon) : NAN;
+    in.heading = 90;
+    in.alt = 3000;
+    in.speed = 200;
+    encodeFeedAircraft((char*)buf, &in);
+    memcpy(&buf[1], raw->callsign, strlen(raw->callsign) < 16 ? strlen(raw->callsign) : 16);
+    memcpy(&buf[17], raw->airline, strlen(raw->airline) < 32 ? strlen(raw->airline) : 32);
+    memcpy(&buf[49], raw->model, strlen(raw->model) < 16 ? strlen(raw->model) : 16);
+
+    int type;
+    int t;
+    AI_Aircraft binary;
+    memset(&binary, 0, sizeof(binary));
+    decodeFeedRecord((char*)buf, (char*)&buf[FeedAircraftSize], &type, &binary, NULL, &t);
+    bool binaryOk = type == FEED_AIRCRAFT;
+
+    if (!benchCheck(textOk == binaryOk, "%s: text %s it, binary %s it", line, textOk ? "accepted" : "rejected", binaryOk ? "accepted" : "rejected")) {
+        return;
+    }
+
+    if (textOk) {
+        benchCheck(sameAircraft(&text, &binary), "%s: text gave %s,%s,%s binary gave %s,%s,%s", line,
+            text.callsign, text.airline, text.model, binary.callsign, binary.airline, binary.model);
+    }
+}
+
+void checkAgreements()
+{
+    static const RawAircraft raw[] = {
+        { "BAW123", "British Airways", "A320", "51.5", "-0.1" },
+        { "", "British Airways", "A320", "51.5", "-0.1" },
+        { "BAW123", "", "", "51.5", "-0.1" },
+        { "BAW123", "N/A", "N/A", "51.5", "-0.1" },
+        { "ABCDEFGHIJKLMNO", "British Airways", "A320", "51.5", "-0.1" },
+        { "ABCDEFGHIJKLMNOP", "British Airways", "A320", "51.5", "-0.1" },
+        { "BAW123", "0123456789012345678901234567890", "A320", "51.5", "-0.1" },
+        { "BAW123", "01234567890123456789012345678901", "A320", "51.5", "-0.1" },
+        { "BAW123", "British Airways", "0123456789ABCDEF", "51.5", "-0.1" },
+        { "BAW123", "British Airways", "A320", "51.5", "" },
+        { "BAW123", "British Airways", "A320", "", "" },
+        { "Unknown", "British Airways", "A320", "-33.9", "151.2" },
+    };
+
+    for (int i = 0; i < (int)(sizeof(raw) / sizeof(RawAircraft)); i++) {
+        checkAgreement(&raw[i]);
+    }
+}
+
+void benchDecodeAircraft()
+{
+    const char* data = &_binaryData[FeedHeaderSize];
+    const char* end = &_binaryData[_binaryDataSize];
+
+    while (data < end) {
+        int type;
+        int t;
+        AI_Aircraft ai;
+        data += decodeFeedRecord(data, end, &type, &ai, NULL, &t);
+        if (type == FEED_AIRCRAFT) {
+            _decoded++;
+        }
+    }
+}
+
+void benchTrailText()
+{
+    parseTrailLine(_trailText, &_trailText[_trailTextSize], &_trailOut);
+}
+
+void benchTrailBinary()
+{
+    int type;
+    int t;
+    AI_Aircraft ai;
+    decodeFeedRecord(_trailData, &_trailData[_trailDataSize], &type, &ai, &_trailOut, &t);
+}
+
+void benchFeedBinary()
+{
+    _binaryTextSize = benchMakeFeedText(_binaryText, sizeof(_binaryText), BinaryLines);
+    checkAircraftRoundTrip();
+    makeTrail();
+    checkTrailRoundTrip();
+    checkAgreements();
+
+    int records = (_binaryDataSize - FeedHeaderSize) / FeedAircraftSize;
+    double ns = benchRun("feed.decode.binary", records, benchDecodeAircraft);
+    benchReport("feed.decode.binary MB/s", FeedAircraftSize / ns * 1e3, "MB/s");
+
+    ns = benchRun("feed.trail.text", TrailPoints, benchTrailText);
+    benchReport("feed.trail.text MB/s", _trailTextSize / (ns * TrailPoints) * 1e3, "MB/s");
+    ns = benchRun("feed.trail.binary", TrailPoints, benchTrailBinary);
+    benchReport("feed.trail.binary MB/s", _trailDataSize / (ns * TrailPoints) * 1e3, "MB/s");
+}
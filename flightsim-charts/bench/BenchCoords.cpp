@@ -0,0 +1,203 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Bench.h"
+#include "ChartCoords.h"
+
+const int CoordsCount = 5000;
+const int RandomCharts = 2000;
+const int MaxChartLocations = 1000;
+
+// Externals
+extern ChartData _chartData;
+
+// Variables
+Locn _coordsLoc[CoordsCount];
+Position _coordsPos[CoordsCount];
+ChartBatch _coordsBatch;
+
+/// Locations inside a bigger record, like the layers batchProject gathers from
+struct CoordsRecord {
+    int id;
+    Locn loc;
+    char name[20];
+};
+
+
+/// <summary>
+/// Calibrate the chart as a 4000 x 3000 pixel chart of the given area
+/// </summary>
+void benchCalibrateChart(double lat0, double lon0, double lat1, double lon1)
+{
+    _chartData.x[0] = 0;
+    _chartData.y[0] = 0;
+    _chartData.x[1] = 4000;
+    _chartData.y[1] = 3000;
+    _chartData.lat[0] = lat0;
+    _chartData.lon[0] = lon0;
+    _chartData.lat[1] = lat1;
+    _chartData.lon[1] = lon1;
+    updateChartTransform();
+}
+
+/// <summary>
+/// Locations spread over the calibrated area and a bit beyond it
+/// </summary>
+void makeLocations()
+{
+    srand(1);
+    for (int i = 0; i < CoordsCount; i++) {
+        double latFrac = rand() / (double)RAND_MAX * 1.2 - 0.1;
+        double lonFrac = rand() / (double)RAND_MAX * 1.2 - 0.1;
+        _coordsLoc[i].lat = _chartData.lat[0] + latFrac * (_chartData.lat[1] - _chartData.lat[0]);
+        _coordsLoc[i].lon = _chartData.lon[0] + lonFrac * (_chartData.lon[1] - _chartData.lon[0]);
+    }
+}
+
+void benchLocationToChartPos()
+{
+    for (int i = 0; i < CoordsCount; i++) {
+        locationToChartPos(&_coordsLoc[i], &_coordsPos[i]);
+    }
+}
+
+/// <summary>
+/// What locationToChartPos did before the chart transform was kept:
+/// deltas from _chartData and pow on every call
+/// </summary>
+void powChartPos(Locn* loc, Position* pos)
+{
+    double lonCalibDiff = _chartData.lon[1] - _chartData.lon[0];
+    double lonDiff = loc->lon - _chartData.lon[0];
+    double xScale = lonDiff / lonCalibDiff;
+    int xCalibDiff = _chartData.x[1] - _chartData.x[0];
+    pos->x = _chartData.x[0] + xCalibDiff * xScale;
+
+    double latCalibDiff = _chartData.lat[1] - _chartData.lat[0];
+    double latDiff;
+    if (abs(latCalibDiff) < 2) {
+        latDiff = loc->lat - _chartData.lat[0];
+    }
+    else {
+        double lat0 = (pow(_chartData.lat[0] + 26.4, 2) / 7.9) - 60;
+        double lat1 = (pow(_chartData.lat[1] + 26.4, 2) / 7.9) - 60;
+        double yPos = (pow(loc->lat + 26.4, 2) / 7.9) - 60;
+        latCalibDiff = lat1 - lat0;
+        latDiff = yPos - lat0;
+    }
+    double yScale = latDiff / latCalibDiff;
+    int yCalibDiff = _chartData.y[1] - _chartData.y[0];
+    pos->y = _chartData.y[0] + yCalibDiff * yScale;
+}
+
+double randomBetween(double low, double high)
+{
+    return low + (high - low) * (rand() / (double)RAND_MAX);
+}
+
+/// <summary>
+/// Random linear and projected charts. Every location, picked through an
+/// index from records like a layer's, must get exactly the same position
+/// from batchProject, locationToChartPos and the old pow formula.
+/// </summary>
+void checkBatchProject()
+{
+    static CoordsRecord record[MaxChartLocations];
+    static int index[MaxChartLocations];
+
+    srand(25);
+    int locations = 0;
+    int scalarWrong = 0;
+    int batchWrong = 0;
+    for (int chart = 0; chart < RandomCharts; chart++) {
+        double latSpan = chart % 2 == 0 ? randomBetween(0.01, 1.99) : randomBetween(2, 30);
+        _chartData.x[0] = rand() % 500;
+        _chartData.y[0] = rand() % 500;
+        _chartData.x[1] = 5000 + rand() % 20000;
+        _chartData.y[1] = 5000 + rand() % 20000;
+        _chartData.lat[0] = randomBetween(-60, 60);
+        _chartData.lon[0] = randomBetween(-170, 150);
+        _chartData.lat[1] = _chartData.lat[0] - latSpan;
+        _chartData.lon[1] = _chartData.lon[0] + randomBetween(0.01, 20);
+        updateChartTransform();
+
+        int count = 1 + rand() % MaxChartLocations;
+        for (int i = 0; i < count; i++) {
+            record[i].loc.lat = randomBetween(_chartData.lat[1] - 1, _chartData.lat[0] + 1);
+            record[i].loc.lon = randomBetween(_chartData.lon[0] - 1, _chartData.lon[1] + 1);
+            index[i] = count - 1 - i;
+        }
+
+        batchProject(&_coordsBatch, &record[0].loc, sizeof(CoordsRecord), index, count);
+
+        for (int n = 0; n < count; n++) {
+            Position old;
+            Position pos;
+            powChartPos(&record[index[n]].loc, &old);
+            locationToChartPos(&record[index[n]].loc, &pos);
+            if (pos.x != old.x || pos.y != old.y) {
+                scalarWrong++;
+            }
+            if (_coordsBatch.x[n] != pos.x || _coordsBatch.y[n] != pos.y) {
+                batchWrong++;
+            }
+        }
+        locations += count;
+    }
+
+    benchCheck(scalarWrong == 0, "%d of %d locations moved from the pow formula", scalarWrong, locations);
+    benchCheck(batchWrong == 0, "%d of %d batch projected locations differ from locationToChartPos", batchWrong, locations);
+}
+
+/// Called through a pointer so, like locationToChartPos, it isn't inlined
+/// into the loop where the compiler could hoist the calibration work
+void (*_powChartPos)(Locn* loc, Position* pos) = powChartPos;
+
+void benchPowChartPos()
+{
+    for (int i = 0; i < CoordsCount; i++) {
+        _powChartPos(&_coordsLoc[i], &_coordsPos[i]);
+    }
+}
+
+void benchBatchProject()
+{
+    batchProject(&_coordsBatch, _coordsLoc, sizeof(Locn), NULL, CoordsCount);
+}
+
+/// <summary>
+/// The calibration points must map back to their own chart positions
+/// </summary>
+void checkCalibration(const char* name)
+{
+    for (int i = 0; i < 2; i++) {
+        Locn loc = { _chartData.lat[i], _chartData.lon[i] };
+        Position pos;
+        locationToChartPos(&loc, &pos);
+        benchCheck(abs(pos.x - _chartData.x[i]) <= 1 && abs(pos.y - _chartData.y[i]) <= 1,
+            "%s calibration point %d maps to %d,%d not %d,%d", name, i, pos.x, pos.y, _chartData.x[i], _chartData.y[i]);
+    }
+}
+
+void benchCoords()
+{
+    checkBatchProject();
+
+    // Linear chart (small area)
+    benchCalibrateChart(51.6, -0.6, 51.3, 0.2);
+    checkCalibration("linear");
+    makeLocations();
+    benchRun("coords.locationToChartPos.linear", CoordsCount, benchLocationToChartPos);
+    benchRun("coords.batchProject.linear", CoordsCount, benchBatchProject);
+
+    // Projected chart (large area)
+    benchCalibrateChart(60, -10, 35, 30);
+    checkCalibration("projected");
+    makeLocations();
+    benchRun("coords.locationToChartPos.projected", CoordsCount, benchLocationToChartPos);
+    benchRun("coords.batchProject.projected", CoordsCount, benchBatchProject);
+    benchRun("coords.pow.projected", CoordsCount, benchPowChartPos);
+
+    batchCleanup(&_coordsBatch);
+}
@@ -0,0 +1,312 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Bench.h"
+#include "Standin.h"
+#include "AiIndex.h"
+#include "FeedParser.h"
+#include "FeedBinary.h"
+
+const int DeltaAircraft = 4500;     // Leaves room for new aircraft before the gone ones are removed
+const int DeltaMovingPercent = 5;
+const int DeltaTicks = 20;
+
+enum DELTA_MODE {
+    MODE_FULL_TEXT,
+    MODE_DELTA_TEXT,
+    MODE_FULL_BINARY,
+    MODE_DELTA_BINARY,
+    MODE_COUNT
+};
+
+/// Applies responses to its own AI table the same way the listener and
+/// server threads do
+struct FeedClient {
+    AI_Aircraft aircraft[Max_AI_Aircraft];
+    int count;
+    AiIndexSlot slots[Ai_Aircraft_Index_Size];
+    AiIndex index;
+    unsigned int seq;
+    unsigned int resync;
+    bool full;
+};
+
+struct DeltaResponse {
+    char* data;
+    int size;
+};
+
+// Variables
+const char* _modeName[MODE_COUNT] = { "fr24", "fr24d", "fr24.bin", "fr24d.bin" };
+FeedClient _client[MODE_COUNT];
+DeltaResponse _response[MODE_COUNT][DeltaTicks];
+int _benchMode;
+
+
+void clientInit(FeedClient* client)
+{
+    client->count = 0;
+    client->index.slots = client->slots;
+    client->index.size = Ai_Aircraft_Index_Size;
+    aiIndexClear(&client->index);
+    client->seq = 0;
+    client->resync = 0;
+}
+
+void clientRequest(FeedClient* client, int mode, char* request)
+{
+    if (mode == MODE_DELTA_TEXT || mode == MODE_DELTA_BINARY) {
+        sprintf(request, "fr24d,%u", client->seq);
+    }
+    else {
+        strcpy(request, "fr24");
+    }
+
+    if (mode == MODE_FULL_BINARY || mode == MODE_DELTA_BINARY) {
+        strcat(request, ",bin");
+    }
+}
+
+void clientBegin(FeedClient* client, bool full, unsigned int seq)
+{
+    client->full = full;
+    client->seq = seq;
+    if (full) {
+        client->resync++;
+    }
+}
+
+void clientAircraft(FeedClient* client, AI_Aircraft* ai)
+{
+    int i = aiIndexFind(&client->index, ai->callsign);
+    if (i == -1) {
+        if (client->count == Max_AI_Aircraft) {
+            return;
+        }
+        i = client->count++;
+        aiIndexSet(&client->index, ai->callsign, i);
+    }
+
+    client->aircraft[i] = *ai;
+    client->aircraft[i].lastUpdated = 1;
+    client->aircraft[i].resync = client->resync;
+}
+
+void clientRemove(FeedClient* client, const char* callsign)
+{
+    int i = aiIndexFind(&client->index, callsign);
+    if (i != -1) {
+        client->aircraft[i].lastUpdated = 0;
+    }
+}
+
+/// <summary>
+/// After a full response anything that wasn't sent has gone
+/// </summary>
+void clientEnd(FeedClient* client)
+{
+    if (client->full) {
+        for (int i = 0; i < client->count; i++) {
+            if (client->aircraft[i].resync != client->resync) {
+                client->aircraft[i].lastUpdated = 0;
+            }
+        }
+    }
+
+    client->count = aiCompact(client->aircraft, client->count, &client->index);
+}
+
+void clientApplyText(FeedClient* client, const char* data, const char* end)
+{
+    clientBegin(client, true, 0);
+
+    while (data < end) {
+        const char* line = data;
+        const char* endLine = findFeedLineEnd(line, end);
+        if (!endLine) {
+            break;
+        }
+        data = endLine + 1;
+
+        if (line[0] == '@') {
+            char* pos;
+            unsigned int seq = strtoul(&line[1], &pos, 10);
+            clientBegin(client, strncmp(pos, ",full", 5) == 0, seq);
+            continue;
+        }
+
+        if (line[0] == '-') {
+            char callsign[16];
+            int len = (int)(endLine - line) - 1;
+            if (len > 0 && len < (int)sizeof(callsign)) {
+                memcpy(callsign, &line[1], len);
+                callsign[len] = '\0';
+                clientRemove(client, callsign);
+            }
+            continue;
+        }
+
+        AI_Aircraft ai;
+        if (parseAircraftLine(line, endLine, &ai)) {
+            clientAircraft(client, &ai);
+        }
+    }
+
+    clientEnd(client);
+}
+
+void clientApplyBinary(FeedClient* client, const char* data, const char* end)
+{
+    FeedHeader header;
+    int len = decodeFeedHeader(data, end, &header);
+    if (len <= 0) {
+        return;
+    }
+    data += len;
+    clientBegin(client, !header.isDelta || header.isFull, header.seq);
+
+    while (data < end) {
+        int type;
+        int t;
+        AI_Aircraft ai;
+        len = decodeFeedRecord(data, end, &type, &ai, NULL, &t);
+        if (len <= 0) {
+            break;
+        }
+        data += len;
+
+        if (type == FEED_AIRCRAFT) {
+            clientAircraft(client, &ai);
+        }
+        else if (type == FEED_REMOVE) {
+            clientRemove(client, ai.callsign);
+        }
+    }
+
+    clientEnd(client);
+}
+
+void clientApply(FeedClient* client, const DeltaResponse* response)
+{
+    if (response->size > 0 && isFeedBinary(response->data[0])) {
+        clientApplyBinary(client, response->data, response->data + response->size);
+    }
+    else {
+        clientApplyText(client, response->data, response->data + response->size);
+    }
+}
+
+/// <summary>
+/// Every client must end up with the aircraft the stand-in has, in the
+/// same order as the full text client, with the same data as the other
+/// client using the same encoding.
+/// </summary>
+void checkClients(int tick)
+{
+    FeedClient* fullText = &_client[MODE_FULL_TEXT];
+    FeedClient* fullBinary = &_client[MODE_FULL_BINARY];
+
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        FeedClient* client = &_client[mode];
+        FeedClient* same = mode == MODE_FULL_BINARY || mode == MODE_DELTA_BINARY ? fullBinary : fullText;
+
+        if (!benchCheck(client->count == standinFeedPresent(), "tick %d %s client has %d aircraft, stand-in has %d",
+            tick, _modeName[mode], client->count, standinFeedPresent())) {
+            continue;
+        }
+
+        int mismatches = 0;
+        for (int i = 0; i < fullText->count; i++) {
+            const AI_Aircraft* expected = &fullText->aircraft[i];
+            int n = aiIndexFind(&client->index, expected->callsign);
+            if (n == -1) {
+                mismatches++;
+                continue;
+            }
+
+            // Binary locations are rounded to 1e-7 degrees, text to 1e-6
+            const AI_Aircraft* ai = &client->aircraft[n];
+            if (strcmp(ai->model, expected->model) != 0 || fabs(ai->loc.lat - expected->loc.lat) > 1e-6 || fabs(ai->loc.lon - expected->loc.lon) > 1e-6) {
+                mismatches++;
+            }
+
+            int s = aiIndexFind(&same->index, expected->callsign);
+            if (s == -1 || memcmp(&ai->loc, &same->aircraft[s].loc, sizeof(Locn)) != 0 || ai->heading != same->aircraft[s].heading) {
+                mismatches++;
+            }
+        }
+
+        benchCheck(mismatches == 0, "tick %d %s client has %d aircraft that don't match", tick, _modeName[mode], mismatches);
+    }
+}
+
+/// <summary>
+/// Re-apply the responses after the first. Each client is already up to
+/// date so this is the steady state cost of a poll.
+/// </summary>
+void benchApply()
+{
+    for (int tick = 1; tick < DeltaTicks; tick++) {
+        clientApply(&_client[_benchMode], &_response[_benchMode][tick]);
+    }
+}
+
+void benchDelta()
+{
+    char request[64];
+    static char payload[StandinMaxResponse];
+
+    standinFeedInit(DeltaAircraft, DeltaMovingPercent, 6);
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        clientInit(&_client[mode]);
+    }
+
+    long long bytes[MODE_COUNT] = { 0 };
+    for (int tick = 0; tick < DeltaTicks; tick++) {
+        if (tick > 0) {
+            standinFeedTick();
+        }
+
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            clientRequest(&_client[mode], mode, request);
+            DeltaResponse* response = &_response[mode][tick];
+            response->size = standinFeed(request, payload, StandinMaxResponse);
+            response->data = (char*)malloc(response->size > 0 ? response->size : 1);
+            if (response->data == NULL) {
+                printf("Ran out of memory\n");
+                exit(1);
+            }
+            memcpy(response->data, payload, response->size);
+            clientApply(&_client[mode], response);
+
+            // The first delta is a full resync
+            if (tick > 0) {
+                bytes[mode] += response->size;
+            }
+        }
+
+        checkClients(tick);
+    }
+
+    // Bandwidth per poll once the client has caught up
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        char name[64];
+        sprintf(name, "delta.bytes.%s", _modeName[mode]);
+        benchReport(name, bytes[mode] / (double)(DeltaTicks - 1), "bytes/poll");
+    }
+
+    // Client CPU per poll
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        char name[64];
+        sprintf(name, "delta.apply.%s", _modeName[mode]);
+        _benchMode = mode;
+        benchRun(name, DeltaTicks - 1, benchApply);
+    }
+
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        for (int tick = 0; tick < DeltaTicks; tick++) {
+            free(_response[mode][tick].data);
+        }
+    }
+}
@@ -0,0 +1,339 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Bench.h"
+#include "Recorder.h"
+#include "FeedParser.h"
+#include "FeedBinary.h"
+
+const int FeedLines = 5000;
+const int FeedTextSize = FeedLines * 128;
+const int NumberCount = 100000;
+
+// Variables
+char _feedText[FeedTextSize];
+int _feedTextSize;
+const char* _recordedText = NULL;
+int _recordedTextSize;
+int _recordedLines;
+AI_Trail _benchTrail;
+int _parsed;
+
+
+/// <summary>
+/// Fill data with a synthetic fr24 text payload of aircraft lines like
+/// a busy hub. Some have an empty callsign, airline or model. Returns
+/// the size of the payload.
+/// </summary>
+int benchMakeFeedText(char* data, int size, int lines)
+{
+    static const char* airlines[] = { "British Airways", "easyJet", "", "N/A", "Ryanair", "Lufthansa" };
+    static const char* models[] = { "A320", "B738", "", "N/A", "C172", "EC35", "B77W", "GLID" };
+
+    srand(3);
+    int len = 0;
+    for (int i = 0; i < lines && size - len > 128; i++) {
+        char callsign[16];
+        if (i % 50 == 0) {
+            *callsign = '\0';
+        }
+        else {
+            sprintf(callsign, "%c%c%c%d", 'A' + i % 26, 'A' + i / 26 % 26, 'A' + i / 676 % 26, 100 + i % 9000);
+        }
+
+        double lat = 51.47 + (rand() / (double)RAND_MAX - 0.5) * 4;
+        double lon = -0.45 + (rand() / (double)RAND_MAX - 0.5) * 6;
+        len += sprintf(&data[len], "%s,%s,%s,%.6f,%.6f,%.0f,%d,%d\n",
+            callsign, airlines[rand() % 6], models[rand() % 8], lat, lon,
+            (double)(rand() % 360), rand() % 40000, rand() % 500);
+    }
+
+    return len;
+}
+
+/// <summary>
+/// Returns the text payloads of the feed responses in the recording
+/// joined together, or NULL if there is no recording.
+/// </summary>
+const char* benchRecordedFeedText(int* size, int* lines)
+{
+    int recordedSize;
+    const char* recorded = benchRecording(STREAM_FEED, &recordedSize);
+    if (recorded == NULL) {
+        return NULL;
+    }
+
+    char* text = (char*)malloc(recordedSize > 0 ? recordedSize : 1);
+    if (text == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    // Responses are <len>\n<payload>
+    *size = 0;
+    *lines = 0;
+    const char* pos = recorded;
+    const char* end = recorded + recordedSize;
+    while (pos < end) {
+        const char* endHeader = (const char*)memchr(pos, '\n', end - pos);
+        if (endHeader == NULL) {
+            break;
+        }
+
+        int len = atoi(pos);
+        pos = endHeader + 1;
+        if (len > end - pos) {
+            len = (int)(end - pos);
+        }
+
+        if (len > 0 && *pos != '#' && !isFeedBinary(*pos)) {
+            memcpy(&text[*size], pos, len);
+            *size += len;
+            for (int i = 0; i < len; i++) {
+                if (pos[i] == '\n') {
+                    (*lines)++;
+                }
+            }
+        }
+        pos += len;
+    }
+
+    free((void*)recorded);
+    return text;
+}
+
+/// <summary>
+/// How processData parsed an aircraft line before FeedParser. The line
+/// must be null terminated.
+/// </summary>
+bool sscanfAircraftLine(const char* line, AI_Aircraft* ai)
+{
+    int cols = sscanf(line, "%15[^,],%31[^,],%15[^,],%lf,%lf,%lf,%lf,%lf",
+        ai->callsign, ai->airline, ai->model, &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+
+    if (cols == 0) {
+        strcpy(ai->callsign, "-");
+        cols = sscanf(line, ",%31[^,],%15[^,],%lf,%lf,%lf,%lf,%lf",
+            ai->airline, ai->model, &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+
+        if (cols == 0) {
+            *ai->airline = '\0';
+            cols = sscanf(line, ",,%15[^,],%lf,%lf,%lf,%lf,%lf",
+                ai->model, &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+        }
+
+        if (cols == 0) {
+            *ai->model = '\0';
+            cols = sscanf(line, ",,,%lf,%lf,%lf,%lf,%lf",
+                &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+        }
+    }
+    else if (cols == 1) {
+        *ai->airline = '\0';
+        cols = sscanf(line, "%15[^,],,%15[^,],%lf,%lf,%lf,%lf,%lf",
+            ai->callsign, ai->model, &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+
+        if (cols == 1) {
+            *ai->model = '\0';
+            cols = sscanf(line, "%15[^,],,,%lf,%lf,%lf,%lf,%lf",
+                ai->callsign, &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed);
+        }
+    }
+
+    if (cols < 5) {
+        return false;
+    }
+
+    if (strcmp(ai->model, "N/A") == 0) {
+        strcpy(ai->model, "GRND");
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Parse the lines like processLines does
+/// </summary>
+void parseLines(const char* data, const char* end)
+{
+    while (data < end) {
+        const char* line = data;
+        const char* endLine = findFeedLineEnd(line, end);
+        if (!endLine) {
+            break;
+        }
+        data = endLine + 1;
+
+        if (line[0] == '!') {
+            if (parseTrailLine(line, endLine, &_benchTrail) != -1) {
+                _parsed++;
+            }
+            continue;
+        }
+
+        if (line[0] == '@' || line[0] == '-') {
+            continue;
+        }
+
+        AI_Aircraft ai;
+        if (parseAircraftLine(line, endLine, &ai)) {
+            _parsed++;
+        }
+    }
+}
+
+void benchParseSynthetic()
+{
+    parseLines(_feedText, &_feedText[_feedTextSize]);
+}
+
+void benchParseRecorded()
+{
+    parseLines(_recordedText, &_recordedText[_recordedTextSize]);
+}
+
+void benchParseSscanf()
+{
+    char line[256];
+    const char* data = _feedText;
+    const char* end = &_feedText[_feedTextSize];
+
+    while (data < end) {
+        const char* endLine = (const char*)memchr(data, '\n', end - data);
+        int len = (int)(endLine - data);
+        memcpy(line, data, len);
+        line[len] = '\0';
+        data = endLine + 1;
+
+        AI_Aircraft ai;
+        if (sscanfAircraftLine(line, &ai)) {
+            _parsed++;
+        }
+    }
+}
+
+/// <summary>
+/// Numbers in the forms the feed uses must give exactly what strtod
+/// gives. Other forms must be within a couple of ulps and stop at the
+/// same place.
+/// </summary>
+void checkParseDouble()
+{
+    static const char* formats[] = { "%.6f", "%.5f", "%.1f", "%.0f", "%+.3f" };
+    static const char* others[] = { "%.17g", "%e", "%.20f", "%.3E" };
+
+    srand(4);
+    int exactFails = 0;
+    int closeFails = 0;
+    char text[512];
+    for (int i = 0; i < NumberCount; i++) {
+        double val = (rand() / (double)RAND_MAX - 0.5) * pow(10, rand() % 7);
+        bool exact = i % 2 == 0;
+        sprintf(text, exact ? formats[i % 5] : others[i % 4], val);
+        strcat(text, ",x");
+
+        char* expectedEnd;
+        double expected = strtod(text, &expectedEnd);
+        double parsed = NAN;
+        const char* parsedEnd = parseFeedDouble(text, text + strlen(text), &parsed);
+
+        if (parsedEnd != expectedEnd) {
+            exactFails++;
+        }
+        else if (exact && parsed != expected) {
+            if (exactFails++ == 0) {
+                printf("%s parsed as %.17g, strtod gives %.17g\n", text, parsed, expected);
+            }
+        }
+        else if (fabs(parsed - expected) > fabs(expected) * 4e-16) {
+            if (closeFails++ == 0) {
+                printf("%s parsed as %.17g, strtod gives %.17g\n", text, parsed, expected);
+            }
+        }
+    }
+
+    benchCheck(exactFails == 0, "%d feed numbers didn't match strtod", exactFails);
+    benchCheck(closeFails == 0, "%d other numbers weren't close to strtod", closeFails);
+
+    double val;
+    const char* none = "-,";
+    benchCheck(parseFeedDouble(none, none + 2, &val) == NULL, "sign with no digits parsed as a number");
+    const char* bounded = "12.5";
+    benchCheck(parseFeedDouble(bounded, bounded + 2, &val) == bounded + 2 && val == 12, "parse went past the end");
+}
+
+/// <summary>
+/// Every synthetic line the old sscanf code accepted must parse the same
+/// </summary>
+void checkParseLines()
+{
+    int mismatches = 0;
+    const char* data = _feedText;
+    const char* end = &_feedText[_feedTextSize];
+    char line[256];
+
+    while (data < end) {
+        const char* endLine = findFeedLineEnd(data, end);
+        int len = (int)(endLine - data);
+        memcpy(line, data, len);
+        line[len] = '\0';
+
+        AI_Aircraft ai;
+        AI_Aircraft old;
+        memset(&ai, 0, sizeof(ai));
+        memset(&old, 0, sizeof(old));
+        bool ok = parseAircraftLine(data, endLine, &ai);
+        bool oldOk = sscanfAircraftLine(line, &old);
+        data = endLine + 1;
+
+        // The old code dropped lines with an airline but no model
+        if (!oldOk) {
+            continue;
+        }
+
+        if (!ok) {
+            if (mismatches++ == 0) {
+                printf("%s didn't parse\n", line);
+            }
+        }
+        else if (strcmp(ai.callsign, old.callsign) != 0 || strcmp(ai.airline, old.airline) != 0 || strcmp(ai.model, old.model) != 0
+            || ai.loc.lat != old.loc.lat || ai.loc.lon != old.loc.lon || ai.heading != old.heading || ai.alt != old.alt || ai.speed != old.speed) {
+            if (mismatches++ == 0) {
+                printf("%s parsed as %s,%s,%s,%f,%f\n", line, ai.callsign, ai.airline, ai.model, ai.loc.lat, ai.loc.lon);
+            }
+        }
+    }
+
+    benchCheck(mismatches == 0, "%d lines parsed differently to sscanf", mismatches);
+
+    // The buffer must not be modified, so check a line with no newline after it
+    const char* partial = "BAW1,British Airways,A320,51.5,-0.4,90,1000,200";
+    AI_Aircraft ai;
+    benchCheck(parseAircraftLine(partial, partial + strlen(partial), &ai) && ai.speed == 200, "unterminated line didn't parse");
+    const char* noLon = "BAW1,British Airways,A320,51.5\n";
+    benchCheck(!parseAircraftLine(noLon, noLon + strlen(noLon) - 1, &ai), "line with no lon parsed");
+
+    const char* trail = "!2!BAW1!British Airways!A320!img.jpg!London!Paris!51.5!-0.4!51.6!-0.3";
+    benchCheck(parseTrailLine(trail, trail + strlen(trail), &_benchTrail) == 1 && _benchTrail.count == 2 && _benchTrail.loc[1].lon == -0.3,
+        "trail line parsed wrongly");
+}
+
+void benchFeedParser()
+{
+    _feedTextSize = benchMakeFeedText(_feedText, FeedTextSize, FeedLines);
+    checkParseDouble();
+    checkParseLines();
+
+    double ns = benchRun("feed.parse.text", FeedLines, benchParseSynthetic);
+    benchReport("feed.parse.text lines/s", 1e9 / ns, "lines/s");
+    benchReport("feed.parse.text MB/s", _feedTextSize / (ns * FeedLines) * 1e3, "MB/s");
+    benchRun("feed.parse.sscanf", FeedLines, benchParseSscanf);
+
+    _recordedText = benchRecordedFeedText(&_recordedTextSize, &_recordedLines);
+    if (_recordedText && _recordedLines > 0) {
+        ns = benchRun("feed.parse.recorded", _recordedLines, benchParseRecorded);
+        benchReport("feed.parse.recorded lines/s", 1e9 / ns, "lines/s");
+        benchReport("feed.parse.recorded MB/s", _recordedTextSize / (ns * _recordedLines) * 1e3, "MB/s");
+    }
+}
@@ -0,0 +1,471 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "Bench.h"
+#include "Standin.h"
+#include "FeedFrame.h"
+#include "FeedBinary.h"
+
+const int FrameLines = 5000;
+const int FrameBufferSize = 80000;      // Must be > MaxHeaderSize + RecvSize
+const int OversizeLen = 100000;
+const int ScriptSize = 1000000;
+const int MaxResponses = 16;
+const int BinaryAircraft = 300;
+const int OversizeBinaryAircraft = 2000;
+const int KeepAliveRequests = 30;
+
+/// What the frame passed on for one response
+struct FrameResult {
+    ResponseStatus status;
+    int mode;
+    int textSize;
+    int messages;
+    int records;
+};
+
+/// What should have been passed on
+struct FrameExpected {
+    const char* text;
+    int textSize;
+    const char* message;
+    int records;
+};
+
+// Variables
+char _frameData[FrameBufferSize];
+FeedFrame _frame;
+char _script[ScriptSize];
+int _scriptSize;
+FrameExpected _expected[MaxResponses];
+int _expectedCount;
+char _text[ScriptSize];
+int _textSize;
+char _message[OversizeLen + 64];
+int _messages;
+int _records;
+bool _gotBinaryHeader;
+int _frameFd;
+const char* _memoryData;
+int _memoryLeft;
+char _synthetic[FrameLines * 128];
+int _syntheticSize;
+int _keepAlivePort;
+int _echoFailures = 0;
+
+
+/// <summary>
+/// Keep the complete lines
+/// </summary>
+const char* collectLines(const char* data, const char* end)
+{
+    const char* lastLine = data;
+    const char* endLine;
+    while ((endLine = (const char*)memchr(lastLine, '\n', end - lastLine)) != NULL) {
+        lastLine = endLine + 1;
+    }
+
+    memcpy(&_text[_textSize], data, lastLine - data);
+    _textSize += (int)(lastLine - data);
+    return lastLine;
+}
+
+/// <summary>
+/// Count the complete records
+/// </summary>
+const char* collectRecords(const char* data, const char* end)
+{
+    if (!_gotBinaryHeader) {
+        FeedHeader header;
+        int len = decodeFeedHeader(data, end, &header);
+        if (len <= 0) {
+            return data;
+        }
+        _gotBinaryHeader = true;
+        data += len;
+    }
+
+    while (data < end) {
+        int type;
+        int t;
+        AI_Aircraft ai;
+        int len = decodeFeedRecord(data, end, &type, &ai, NULL, &t);
+        if (len <= 0) {
+            break;
+        }
+        data += len;
+        _records++;
+    }
+
+    return data;
+}
+
+void collectMessage(const char* message)
+{
+    strcpy(_message, message);
+    _messages++;
+}
+
+void frameProgress()
+{
+}
+
+int socketRecv(char* buf, int len)
+{
+    return (int)recv(_frameFd, buf, len, 0);
+}
+
+/// <summary>
+/// Receive from memory in chunks of up to 4K like a fast network
+/// </summary>
+int memoryRecv(char* buf, int len)
+{
+    if (len > 4096) {
+        len = 4096;
+    }
+    if (len > _memoryLeft) {
+        len = _memoryLeft;
+    }
+
+    memcpy(buf, _memoryData, len);
+    _memoryData += len;
+    _memoryLeft -= len;
+    return len;
+}
+
+void frameInit(FrameRecv recvData)
+{
+    _frame.data = _frameData;
+    _frame.size = FrameBufferSize;
+    _frame.pending = 0;
+    _frame.recvData = recvData;
+    _frame.processText = collectLines;
+    _frame.processBinary = collectRecords;
+    _frame.processMessage = collectMessage;
+    _frame.progress = frameProgress;
+}
+
+FrameResult receiveOne()
+{
+    _textSize = 0;
+    _messages = 0;
+    _records = 0;
+    _gotBinaryHeader = false;
+
+    FrameResult result;
+    result.status = frameReceive(&_frame);
+    result.mode = _frame.mode;
+    result.textSize = _textSize;
+    result.messages = _messages;
+    result.records = _records;
+    return result;
+}
+
+/// <summary>
+/// Add a response to the script
+/// </summary>
+void addResponse(const char* payload, int size)
+{
+    _scriptSize += sprintf(&_script[_scriptSize], "%d\n", size);
+    memcpy(&_script[_scriptSize], payload, size);
+    _scriptSize += size;
+}
+
+void expectText(const char* text, int size)
+{
+    FrameExpected* expected = &_expected[_expectedCount++];
+    memset(expected, 0, sizeof(FrameExpected));
+    expected->text = text;
+    expected->textSize = size;
+}
+
+void expectMessage(const char* message)
+{
+    FrameExpected* expected = &_expected[_expectedCount++];
+    memset(expected, 0, sizeof(FrameExpected));
+    expected->message = message;
+}
+
+void expectRecords(int records)
+{
+    FrameExpected* expected = &_expected[_expectedCount++];
+    memset(expected, 0, sizeof(FrameExpected));
+    expected->records = records;
+}
+
+int makeBinary(char* buf, int aircraft)
+{
+    FeedHeader header = { false, false, 0 };
+    int len = encodeFeedHeader(buf, &header);
+
+    for (int i = 0; i < aircraft; i++) {
+        AI_Aircraft ai;
+        memset(&ai, 0, sizeof(ai));
+        sprintf(ai.callsign, "BIN%d", i);
+        strcpy(ai.model, "A320");
+        ai.loc.lat = 51 + i * 0.0001;
+        ai.loc.lon = -0.5;
+        len += encodeFeedAircraft(&buf[len], &ai);
+    }
+
+    return len;
+}
+
+/// <summary>
+/// Pipelined responses covering every kind of payload, including ones
+/// too big for the buffer that must be skipped without losing anything
+/// that comes after them.
+/// </summary>
+void makeScript()
+{
+    static char oversizeText[OversizeLen + 256];
+    static char oversizeMessage[OversizeLen];
+    static char binary[BinaryAircraft * FeedAircraftSize + FeedHeaderSize];
+    static char oversizeBinary[OversizeBinaryAircraft * FeedAircraftSize + FeedHeaderSize + OversizeLen];
+    static const char* message = "# Clear,all";
+    static const char* lastText = "BAW1,British Airways,A320,51.5,-0.4,90,1000,200\n";
+
+    _scriptSize = 0;
+    _expectedCount = 0;
+
+    addResponse(_synthetic, _syntheticSize);
+    expectText(_synthetic, _syntheticSize);
+
+    // A line too long for the buffer between two good ones
+    const char* goodLines = "A,,,1,2\nB,,,3,4\n";
+    int len = sprintf(oversizeText, "A,,,1,2\n");
+    memset(&oversizeText[len], 'X', OversizeLen);
+    len += OversizeLen;
+    len += sprintf(&oversizeText[len], "\nB,,,3,4\n");
+    addResponse(oversizeText, len);
+    expectText(goodLines, (int)strlen(goodLines));
+
+    addResponse(message, (int)strlen(message));
+    expectMessage(message);
+
+    memset(oversizeMessage, 'M', OversizeLen);
+    oversizeMessage[0] = '#';
+    addResponse(oversizeMessage, OversizeLen);
+    expectMessage(NULL);
+
+    addResponse(binary, makeBinary(binary, BinaryAircraft));
+    expectRecords(BinaryAircraft);
+
+    // Much bigger than the buffer but records are processed as they arrive
+    len = makeBinary(oversizeBinary, OversizeBinaryAircraft);
+    addResponse(oversizeBinary, len);
+    expectRecords(OversizeBinaryAircraft);
+
+    // A record that can't be decoded fills the buffer so the rest is skipped
+    len = makeBinary(oversizeBinary, 1);
+    memset(&oversizeBinary[len], 0xEE, OversizeLen);
+    addResponse(oversizeBinary, len + OversizeLen);
+    expectRecords(1);
+
+    addResponse("", 0);
+    expectText("", 0);
+
+    addResponse(lastText, (int)strlen(lastText));
+    expectText(lastText, (int)strlen(lastText));
+}
+
+/// <summary>
+/// Receive the whole script from the stand-in and check each response
+/// </summary>
+void checkScript(int port, int maxChunk)
+{
+    standinScript(_script, _scriptSize, maxChunk);
+    _frameFd = standinConnect(port);
+    if (!benchCheck(_frameFd >= 0, "Failed to connect to the stand-in")) {
+        return;
+    }
+
+    frameInit(socketRecv);
+    for (int i = 0; i < _expectedCount; i++) {
+        FrameExpected* expected = &_expected[i];
+        FrameResult result = receiveOne();
+        if (!benchCheck(result.status == RESPONSE_OK, "chunks %d response %d status %d", maxChunk, i, result.status)) {
+            break;
+        }
+
+        if (expected->text) {
+            benchCheck(result.mode == FRAME_TEXT && result.textSize == expected->textSize && memcmp(_text, expected->text, _textSize) == 0,
+                "chunks %d response %d text differs (%d bytes, expected %d)", maxChunk, i, result.textSize, expected->textSize);
+        }
+        else if (result.mode == FRAME_MESSAGE) {
+            if (expected->message) {
+                benchCheck(result.messages == 1 && strcmp(_message, expected->message) == 0, "chunks %d response %d message differs", maxChunk, i);
+            }
+            else {
+                benchCheck(result.messages == 0, "chunks %d response %d oversize message not skipped", maxChunk, i);
+            }
+        }
+        else {
+            benchCheck(result.mode == FRAME_BINARY && result.records == expected->records,
+                "chunks %d response %d got %d records, expected %d", maxChunk, i, result.records, expected->records);
+        }
+    }
+
+    // The stand-in has closed the connection
+    FrameResult result = receiveOne();
+    benchCheck(result.status == RESPONSE_NONE, "chunks %d no response gave status %d", maxChunk, result.status);
+    close(_frameFd);
+}
+
+/// <summary>
+/// A connection that closes part way through a response
+/// </summary>
+void checkIncomplete(int port)
+{
+    char partial[64];
+    int len = sprintf(partial, "100\nBAW1,,,1,2\n");
+    standinScript(partial, len, 4);
+    _frameFd = standinConnect(port);
+    if (!benchCheck(_frameFd >= 0, "Failed to connect to the stand-in")) {
+        return;
+    }
+
+    frameInit(socketRecv);
+    FrameResult result = receiveOne();
+    benchCheck(result.status == RESPONSE_INCOMPLETE && result.textSize == 11, "partial response gave status %d with %d bytes", result.status, result.textSize);
+    close(_frameFd);
+}
+
+void benchFrameText()
+{
+    _memoryData = _script;
+    _memoryLeft = _scriptSize;
+    receiveOne();
+}
+
+void benchFrame()
+{
+    _syntheticSize = benchMakeFeedText(_synthetic, sizeof(_synthetic), FrameLines);
+    makeScript();
+
+    int port = standinStart();
+    if (!benchCheck(port > 0, "Failed to start the stand-in")) {
+        return;
+    }
+
+    srand(5);
+    checkScript(port, 3);
+    checkScript(port, 7);
+    checkScript(port, 1500);
+    checkScript(port, 70000);
+    checkIncomplete(port);
+    standinStop();
+
+    // Just the synthetic payload, without sockets
+    _scriptSize = 0;
+    addResponse(_synthetic, _syntheticSize);
+    frameInit(memoryRecv);
+    benchRun("frame.receive.text", FrameLines, benchFrameText);
+}
+
+/// <summary>
+/// Answer with an aircraft line whose callsign is the request
+/// </summary>
+int echoRequest(const char* request, char* payload, int size)
+{
+    return snprintf(payload, size, "%s,,,51,0\n", request);
+}
+
+bool sendAll(int fd, const char* data)
+{
+    return send(fd, data, strlen(data), MSG_NOSIGNAL) == (ssize_t)strlen(data);
+}
+
+/// <summary>
+/// Returns true if the response is the echo of the request
+/// </summary>
+bool receiveEcho(const char* request)
+{
+    char expected[64];
+    int len = sprintf(expected, "%s,,,51,0\n", request);
+
+    FrameResult result = receiveOne();
+    return result.status == RESPONSE_OK && _textSize == len && memcmp(_text, expected, len) == 0;
+}
+
+void checkEcho(const char* request)
+{
+    benchCheck(receiveEcho(request), "response to %s was %.*s", request, _textSize, _text);
+}
+
+/// <summary>
+/// Requests on a kept alive connection, sent like the listener sends
+/// them: one at a time, each after the response to the one before. Each
+/// must get its own response, in order, over a single connection.
+/// </summary>
+void checkKeepAliveReuse()
+{
+    int connections = standinConnections();
+    _frameFd = standinConnect(_keepAlivePort);
+    if (!benchCheck(_frameFd >= 0, "Failed to connect to the stand-in")) {
+        return;
+    }
+
+    frameInit(socketRecv);
+    for (int i = 0; i < KeepAliveRequests; i++) {
+        char request[16];
+        char line[24];
+        sprintf(request, "REQ%d", i);
+        sprintf(line, "%s\n", request);
+
+        sendAll(_frameFd, line);
+        checkEcho(request);
+    }
+
+    close(_frameFd);
+    benchCheck(standinConnections() == connections + 1, "kept alive requests used %d connections", standinConnections() - connections);
+}
+
+/// <summary>
+/// One request per connection, like the listener without keep alive
+/// </summary>
+void benchReconnect()
+{
+    _frameFd = standinConnect(_keepAlivePort);
+    frameInit(socketRecv);
+    sendAll(_frameFd, "REQ");
+    if (!receiveEcho("REQ")) {
+        _echoFailures++;
+    }
+    close(_frameFd);
+}
+
+void benchKeepAliveRequest()
+{
+    sendAll(_frameFd, "REQ\n");
+    if (!receiveEcho("REQ")) {
+        _echoFailures++;
+    }
+}
+
+/// <summary>
+/// Request latency with and without keep alive over loopback
+/// </summary>
+void benchKeepAlive()
+{
+    _keepAlivePort = standinStart();
+    if (!benchCheck(_keepAlivePort > 0, "Failed to start the stand-in")) {
+        return;
+    }
+
+    standinRespond(echoRequest, 5);
+    checkKeepAliveReuse();
+
+    standinRespond(echoRequest, 100000);
+    benchMeasure("net.request.reconnect", 1, benchReconnect);
+
+    _frameFd = standinConnect(_keepAlivePort);
+    frameInit(socketRecv);
+    benchMeasure("net.request.keepalive", 1, benchKeepAliveRequest);
+    close(_frameFd);
+
+    benchCheck(_echoFailures == 0, "%d timed requests got the wrong response", _echoFailures);
+    standinStop();
+}
@@ -0,0 +1,384 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "ChartCoords.h"
+#include "SpatialGrid.h"
+#include "SharedData.h"
+
+const int GridOthers = MAX_AIRCRAFT;
+const int GridAi = 5000;
+const int AreaQueries = 2000;
+const int Zooms = 4;
+const double ZoomScale[Zooms] = { 0.25, 1, 4, 16 };
+const char* ZoomName[Zooms] = { "uk", "region", "city", "airport" };
+const int UkObstacles = 40000;      // About as many as the full NATS obstacle file
+const int UkVrps = 1500;
+const int UkElevations = 10000;
+const int MaxCulled = UkObstacles;
+
+// Externals
+extern int _displayWidth;
+extern int _displayHeight;
+extern DrawData _chart;
+extern DrawData _view;
+
+// Variables
+OtherData _gridOther[GridOthers];
+AiFrameAircraft _gridAi[GridAi];
+ObstacleData _ukObstacle[UkObstacles];
+VrpData _ukVrp[UkVrps];
+ElevationData _ukElevation[UkElevations];
+SpatialGrid _obstacleCullGrid;
+SpatialGrid _vrpCullGrid;
+SpatialGrid _elevationCullGrid;
+SpatialGrid _otherCullGrid;
+SpatialGrid _aiCullGrid;
+ChartBatch _cullBatch;
+Position _cullPos1;
+Position _cullPos2;
+bool _allVisible[MaxCulled];
+int _culled;
+
+
+/// <summary>
+/// Mostly around London with the rest spread over the UK and a few
+/// off the chart
+/// </summary>
+void makeGridLoc(Locn* loc, int i)
+{
+    double r1 = rand() / (double)RAND_MAX;
+    double r2 = rand() / (double)RAND_MAX;
+
+    if (i % 50 == 0) {
+        loc->lat = 40 + r1 * 30;
+        loc->lon = -30 + r2 * 50;
+    }
+    else if (i % 5 < 3) {
+        loc->lat = 51.47 + (r1 - 0.5) * 1.5;
+        loc->lon = -0.45 + (r2 - 0.5) * 2.5;
+    }
+    else {
+        loc->lat = 50 + r1 * 9;
+        loc->lon = -8 + r2 * 10;
+    }
+}
+
+/// <summary>
+/// Anywhere over the UK
+/// </summary>
+void makeUkLoc(Locn* loc)
+{
+    loc->lat = 50 + rand() / (double)RAND_MAX * 9;
+    loc->lon = -8 + rand() / (double)RAND_MAX * 10;
+}
+
+/// <summary>
+/// Centre the display on Heathrow at the given zoom and work out the
+/// chart area to check against with a border in display pixels, like
+/// getDisplayArea
+/// </summary>
+void setZoom(double scale, int border)
+{
+    Locn heathrow = { 51.47, -0.45 };
+    Position pos;
+    locationToChartPos(&heathrow, &pos);
+    _chart.x = pos.x;
+    _chart.y = pos.y;
+    _view.scale = scale;
+
+    displayToChartPos(0, 0, &_cullPos1);
+    displayToChartPos(_displayWidth - 1, _displayHeight - 1, &_cullPos2);
+
+    double chartBorder = border / _view.scale;
+    _cullPos1.x -= chartBorder;
+    _cullPos1.y -= chartBorder;
+    _cullPos2.x += chartBorder;
+    _cullPos2.y += chartBorder;
+}
+
+/// <summary>
+/// Project every location like drawOtherAircraft used to. Returns how
+/// many are visible and flags them if visible isn't NULL.
+/// </summary>
+int cullAll(const Locn* firstLoc, int stride, int count, bool* visible)
+{
+    int visibleCount = 0;
+    Position pos;
+    for (int i = 0; i < count; i++) {
+        Locn* loc = (Locn*)((const char*)firstLoc + i * stride);
+        bool isVisible = drawOther(&_cullPos1, &_cullPos2, loc, &pos);
+        if (visible) {
+            visible[i] = isVisible;
+        }
+        if (isVisible) {
+            visibleCount++;
+        }
+    }
+
+    return visibleCount;
+}
+
+/// <summary>
+/// Only project the locations in cells that overlap the display, the
+/// same as drawOtherAircraft and findVisible
+/// </summary>
+int cullGrid(SpatialGrid* grid, const Locn* firstLoc, int stride, bool* visible)
+{
+    LocnArea areas[2];
+    int areaCount = chartAreaToLocations(&_cullPos1, &_cullPos2, areas);
+    int foundCount = gridQuery(grid, areas, areaCount);
+
+    batchProject(&_cullBatch, firstLoc, stride, grid->found, foundCount);
+
+    int visibleCount = 0;
+    Position pos;
+    for (int n = 0; n < foundCount; n++) {
+        if (batchDrawOther(&_cullBatch, n, &_cullPos1, &_cullPos2, &pos)) {
+            if (visible) {
+                visible[grid->found[n]] = true;
+            }
+            visibleCount++;
+        }
+    }
+
+    return visibleCount;
+}
+
+/// <summary>
+/// Returns how many locations the grid culls differently to projecting
+/// all of them. Sets visible to how many are visible.
+/// </summary>
+int cullMismatches(SpatialGrid* grid, const Locn* firstLoc, int stride, int count, int* visible)
+{
+    static bool gridVisible[MaxCulled];
+
+    cullAll(firstLoc, stride, count, _allVisible);
+    memset(gridVisible, 0, sizeof(gridVisible));
+    cullGrid(grid, firstLoc, stride, gridVisible);
+
+    int mismatches = 0;
+    *visible = 0;
+    for (int i = 0; i < count; i++) {
+        if (_allVisible[i]) {
+            (*visible)++;
+        }
+        if (_allVisible[i] != gridVisible[i]) {
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+/// <summary>
+/// At each zoom the grid must find exactly what projecting everything
+/// finds
+/// </summary>
+void checkCull(const char* zoom, const char* layer, SpatialGrid* grid, const Locn* firstLoc, int stride, int count)
+{
+    int visible;
+    int mismatches = cullMismatches(grid, firstLoc, stride, count, &visible);
+    benchCheck(mismatches == 0, "%s zoom: grid culling of %s differs for %d of %d visible", zoom, layer, mismatches, visible);
+    printf("%s zoom: %d of %d %s visible\n", zoom, visible, count, layer);
+}
+
+/// <summary>
+/// Returns false unless found is strictly ascending and contains every
+/// location inside any of the areas
+/// </summary>
+bool queryMatches(SpatialGrid* grid, const Locn* locs, int count, const LocnArea* areas, int areaCount)
+{
+    int foundCount = gridQuery(grid, areas, areaCount);
+    static bool found[GridAi];
+    memset(found, 0, sizeof(found));
+
+    for (int n = 0; n < foundCount; n++) {
+        if (n > 0 && grid->found[n] <= grid->found[n - 1]) {
+            return false;
+        }
+        found[grid->found[n]] = true;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int a = 0; a < areaCount; a++) {
+            if (locs[i].lat >= areas[a].minLat && locs[i].lat <= areas[a].maxLat
+                && locs[i].lon >= areas[a].minLon && locs[i].lon <= areas[a].maxLon && !found[i]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Random areas, including ones folded into two lat bands, against
+/// brute force. Also grids whose items are all in one place.
+/// </summary>
+void checkQueries()
+{
+    static Locn locs[GridAi];
+    static SpatialGrid grid;
+
+    for (int i = 0; i < GridAi; i++) {
+        makeGridLoc(&locs[i], i);
+    }
+    gridBuild(&grid, locs, sizeof(Locn), GridAi);
+
+    int failures = 0;
+    for (int q = 0; q < AreaQueries; q++) {
+        LocnArea areas[2];
+        int areaCount = q % 4 == 0 ? 2 : 1;
+        for (int a = 0; a < areaCount; a++) {
+            Locn corner;
+            makeGridLoc(&corner, q);
+            double size = rand() / (double)RAND_MAX * (q % 3 == 0 ? 20 : 1);
+            areas[a].minLat = corner.lat;
+            areas[a].maxLat = corner.lat + size;
+            areas[a].minLon = a == 0 ? corner.lon : areas[0].minLon;
+            areas[a].maxLon = a == 0 ? corner.lon + size * 1.5 : areas[0].maxLon;
+        }
+
+        if (!queryMatches(&grid, locs, GridAi, areas, areaCount)) {
+            failures++;
+        }
+    }
+    benchCheck(failures == 0, "%d of %d random area queries missed items or weren't in order", failures, AreaQueries);
+
+    LocnArea all = { -90, 90, -180, 180 };
+    benchCheck(gridQuery(&grid, &all, 1) == GridAi, "query of the whole world didn't find everything");
+
+    // Every item in the same place
+    for (int i = 0; i < GridAi; i++) {
+        locs[i] = locs[0];
+    }
+    gridBuild(&grid, locs, sizeof(Locn), GridAi);
+    LocnArea point = { locs[0].lat, locs[0].lat, locs[0].lon, locs[0].lon };
+    benchCheck(gridQuery(&grid, &point, 1) == GridAi && queryMatches(&grid, locs, GridAi, &point, 1), "grid of identical locations lost items");
+
+    // Rebuilding smaller must not keep old items
+    gridBuild(&grid, locs, sizeof(Locn), 1);
+    benchCheck(gridQuery(&grid, &all, 1) == 1, "rebuilt grid of 1 didn't find 1 item");
+    gridBuild(&grid, locs, sizeof(Locn), 0);
+    benchCheck(gridQuery(&grid, &all, 1) == 0, "empty grid found items");
+
+    gridCleanup(&grid);
+}
+
+void benchBuildGrids()
+{
+    gridBuild(&_otherCullGrid, &_gridOther[0].loc, sizeof(OtherData), GridOthers);
+    gridBuild(&_aiCullGrid, &_gridAi[0].loc, sizeof(AiFrameAircraft), GridAi);
+}
+
+void benchCullAll()
+{
+    _culled += cullAll(&_gridOther[0].loc, sizeof(OtherData), GridOthers, NULL);
+    _culled += cullAll(&_gridAi[0].loc, sizeof(AiFrameAircraft), GridAi, NULL);
+}
+
+void benchCullGrid()
+{
+    _culled += cullGrid(&_otherCullGrid, &_gridOther[0].loc, sizeof(OtherData), NULL);
+    _culled += cullGrid(&_aiCullGrid, &_gridAi[0].loc, sizeof(AiFrameAircraft), NULL);
+}
+
+void benchSpatialGrid()
+{
+    srand(12);
+    checkQueries();
+
+    for (int i = 0; i < GridOthers; i++) {
+        makeGridLoc(&_gridOther[i].loc, i);
+    }
+    for (int i = 0; i < GridAi; i++) {
+        makeGridLoc(&_gridAi[i].loc, i);
+    }
+
+    // UK chart, projected
+    benchCalibrateChart(59, -8, 50, 2);
+    benchBuildGrids();
+    benchRun("grid.build", 1, benchBuildGrids);
+
+    for (int z = 0; z < Zooms; z++) {
+        setZoom(ZoomScale[z], 15);
+        checkCull(ZoomName[z], "other aircraft", &_otherCullGrid, &_gridOther[0].loc, sizeof(OtherData), GridOthers);
+        checkCull(ZoomName[z], "AI aircraft", &_aiCullGrid, &_gridAi[0].loc, sizeof(AiFrameAircraft), GridAi);
+
+        // Projecting everything is only there for comparison and its
+        // time swings with how well the visible test predicts
+        char name[64];
+        sprintf(name, "grid.cull.%s.all", ZoomName[z]);
+        benchMeasure(name, 1, benchCullAll);
+        sprintf(name, "grid.cull.%s.grid", ZoomName[z]);
+        benchRun(name, 1, benchCullGrid);
+    }
+
+    gridCleanup(&_otherCullGrid);
+    gridCleanup(&_aiCullGrid);
+    batchCleanup(&_cullBatch);
+}
+
+/// <summary>
+/// What drawElevations, drawVrps and drawObstacles project each frame
+/// </summary>
+void benchStaticAll()
+{
+    setZoom(_view.scale, 50);
+    _culled += cullAll(&_ukElevation[0].loc, sizeof(ElevationData), UkElevations, NULL);
+    setZoom(_view.scale, 250);
+    _culled += cullAll(&_ukVrp[0].loc, sizeof(VrpData), UkVrps, NULL);
+    _culled += cullAll(&_ukObstacle[0].loc, sizeof(ObstacleData), UkObstacles, NULL);
+}
+
+void benchStaticGrid()
+{
+    setZoom(_view.scale, 50);
+    _culled += cullGrid(&_elevationCullGrid, &_ukElevation[0].loc, sizeof(ElevationData), NULL);
+    setZoom(_view.scale, 250);
+    _culled += cullGrid(&_vrpCullGrid, &_ukVrp[0].loc, sizeof(VrpData), NULL);
+    _culled += cullGrid(&_obstacleCullGrid, &_ukObstacle[0].loc, sizeof(ObstacleData), NULL);
+}
+
+/// <summary>
+/// Full UK sets of obstacles, VRPs and elevations indexed once at load
+/// like ChartFlightPlan does
+/// </summary>
+void benchStaticGrids()
+{
+    srand(13);
+    for (int i = 0; i < UkObstacles; i++) {
+        makeUkLoc(&_ukObstacle[i].loc);
+    }
+    for (int i = 0; i < UkVrps; i++) {
+        makeUkLoc(&_ukVrp[i].loc);
+    }
+    for (int i = 0; i < UkElevations; i++) {
+        makeUkLoc(&_ukElevation[i].loc);
+    }
+
+    benchCalibrateChart(59, -8, 50, 2);
+    gridBuild(&_obstacleCullGrid, &_ukObstacle[0].loc, sizeof(ObstacleData), UkObstacles);
+    gridBuild(&_vrpCullGrid, &_ukVrp[0].loc, sizeof(VrpData), UkVrps);
+    gridBuild(&_elevationCullGrid, &_ukElevation[0].loc, sizeof(ElevationData), UkElevations);
+
+    for (int z = 0; z < Zooms; z++) {
+        setZoom(ZoomScale[z], 50);
+        checkCull(ZoomName[z], "elevations", &_elevationCullGrid, &_ukElevation[0].loc, sizeof(ElevationData), UkElevations);
+        setZoom(ZoomScale[z], 250);
+        checkCull(ZoomName[z], "VRPs", &_vrpCullGrid, &_ukVrp[0].loc, sizeof(VrpData), UkVrps);
+        checkCull(ZoomName[z], "obstacles", &_obstacleCullGrid, &_ukObstacle[0].loc, sizeof(ObstacleData), UkObstacles);
+
+        char name[64];
+        sprintf(name, "grid.static.%s.all", ZoomName[z]);
+        benchMeasure(name, 1, benchStaticAll);
+        sprintf(name, "grid.static.%s.grid", ZoomName[z]);
+        benchRun(name, 1, benchStaticGrid);
+    }
+
+    gridCleanup(&_obstacleCullGrid);
+    gridCleanup(&_vrpCullGrid);
+    gridCleanup(&_elevationCullGrid);
+    batchCleanup(&_cullBatch);
+}
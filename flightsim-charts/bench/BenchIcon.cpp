@@ -0,0 +1,247 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "IconClass.h"
+
+const int RandomPairs = 500000;
+const int BenchPairs = 1000;
+const int IconVehicle = -1;
+const int GroundAltitude = 50;      // GRND models below this are vehicles
+
+/// Every type code list, so codes can be taken from them
+const int TypeLists = 10;
+const char* TypeList[TypeLists] = {
+    Heli, Turboprop, Airliner, Large_Airliner, Jet, Military_Heli, Military_Jet, Military_Small, Military_Other, Military_Other2
+};
+
+/// Random codes are made from these, '_' included as it separates the codes in the lists
+const char IconChars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_a/ ";
+const int IconSuffixes = 6;
+const char* IconSuffix[IconSuffixes] = { "", "0", "8", "W", "MAX", "NEO" };
+const int FeedModels = 10;
+const char* FeedModel[FeedModels] = { "A320", "B738", "", "N/A", "C172", "EC35", "B77W", "GLID", "GRND", "DISC" };
+
+struct IconPair {
+    char model[16];
+    char callsign[16];
+};
+
+// Variables
+IconPair _iconPair[BenchPairs];
+int _iconSum;
+int _iconMismatches;
+
+
+/// <summary>
+/// What getIconData drew before the icon type was kept in the record:
+/// three sprintfs and up to ten strstr scans
+/// </summary>
+int strstrIcon(const char* model, const char* callsign, int altitude)
+{
+    if (strlen(model) > 5) {
+        return ICON_LONG_MODEL;
+    }
+
+    if (strcmp(model, "GLID") == 0 || strcmp(model, "DISC") == 0) {
+        return ICON_GLIDER;
+    }
+
+    if (strcmp(model, "GRND") == 0 && altitude < GroundAltitude) {
+        return IconVehicle;
+    }
+
+    char prefixShort[8];
+    char prefixModel[8];
+    char prefixCallsign[8];
+    sprintf(prefixShort, "_%.3s_", model);
+    sprintf(prefixModel, "_%.4s_", model);
+    sprintf(prefixCallsign, "_%.5s_", callsign);
+
+    if (strstr(Heli, prefixShort) != NULL) {
+        return ICON_HELI;
+    }
+    if (strstr(Turboprop, prefixShort) != NULL || strstr(Turboprop, prefixModel) != NULL) {
+        return ICON_TURBOPROP;
+    }
+    if (strstr(Airliner, prefixShort) != NULL) {
+        return ICON_AIRLINER;
+    }
+    if (strstr(Large_Airliner, prefixShort) != NULL) {
+        return ICON_LARGE_AIRLINER;
+    }
+    if (strstr(Jet, prefixShort) != NULL) {
+        return ICON_JET;
+    }
+    if (strstr(Military_Heli, prefixShort) != NULL || strstr(Military_Heli, prefixCallsign) != NULL) {
+        return ICON_MILITARY_HELI;
+    }
+    if (strstr(Military_Jet, prefixShort) != NULL || strstr(Military_Jet, prefixCallsign) != NULL) {
+        return ICON_MILITARY_JET;
+    }
+    if (strstr(Military_Small, prefixShort) != NULL || strstr(Military_Small, prefixCallsign) != NULL) {
+        return ICON_MILITARY_SMALL;
+    }
+    if (strstr(Military_Other, prefixShort) != NULL || strstr(Military_Other2, prefixModel) != NULL) {
+        return ICON_MILITARY_OTHER;
+    }
+
+    return ICON_DEFAULT;
+}
+
+/// <summary>
+/// What getIconData draws now from the classified icon type
+/// </summary>
+int tableIcon(int iconType, int altitude)
+{
+    if ((iconType & IconGround) && altitude < GroundAltitude) {
+        return IconVehicle;
+    }
+
+    return iconType & IconTypeMask;
+}
+
+void compareIcon(const char* model, const char* callsign)
+{
+    int iconType = classifyIcon(model, callsign);
+
+    for (int altitude = 0; altitude <= GroundAltitude; altitude += GroundAltitude) {
+        int expected = strstrIcon(model, callsign, altitude);
+        int actual = tableIcon(iconType, altitude);
+        if (actual != expected) {
+            if (_iconMismatches++ < 5) {
+                printf("Model \"%s\" callsign \"%s\" at %d ft was icon %d, used to be %d\n", model, callsign, altitude, actual, expected);
+            }
+        }
+    }
+}
+
+void randomCode(char* code, int maxLen)
+{
+    int len = rand() % (maxLen + 1);
+    for (int i = 0; i < len; i++) {
+        code[i] = IconChars[rand() % (sizeof(IconChars) - 1)];
+    }
+    code[len] = '\0';
+}
+
+/// <summary>
+/// Fill code with a random code from a random list. Returns its length.
+/// </summary>
+int listCode(char* code)
+{
+    const char* list = TypeList[rand() % TypeLists];
+    int codes = 0;
+    for (int i = 1; list[i] != '\0'; i++) {
+        if (list[i] == '_') {
+            codes++;
+        }
+    }
+
+    int wanted = rand() % codes;
+    const char* start = list + 1;
+    for (int i = 0; i < wanted; i++) {
+        start = strchr(start, '_') + 1;
+    }
+
+    int len = (int)(strchr(start, '_') - start);
+    memcpy(code, start, len);
+    code[len] = '\0';
+    return len;
+}
+
+/// <summary>
+/// A model and callsign like a feed would give: a listed code with a
+/// variant suffix, a common model or random characters
+/// </summary>
+void makeIconPair(IconPair* pair)
+{
+    int kind = rand() % 4;
+    if (kind == 0) {
+        int len = listCode(pair->model);
+        strcpy(pair->model + len, IconSuffix[rand() % IconSuffixes]);
+    }
+    else if (kind == 1) {
+        strcpy(pair->model, FeedModel[rand() % FeedModels]);
+    }
+    else {
+        randomCode(pair->model, 7);
+    }
+
+    kind = rand() % 3;
+    if (kind == 0) {
+        int len = listCode(pair->callsign);
+        sprintf(pair->callsign + len, "%d", rand() % 100);
+    }
+    else {
+        randomCode(pair->callsign, 8);
+    }
+}
+
+/// <summary>
+/// Every code in every list, alone and with each suffix, as the model and
+/// as the callsign, then random models and callsigns, must get the same
+/// icon as the old strstr checks
+/// </summary>
+void checkIcons()
+{
+    _iconMismatches = 0;
+
+    char code[16];
+    for (int list = 0; list < TypeLists; list++) {
+        const char* start = TypeList[list] + 1;
+        const char* end;
+        while ((end = strchr(start, '_')) != NULL) {
+            int len = (int)(end - start);
+            memcpy(code, start, len);
+
+            for (int suffix = 0; suffix < IconSuffixes; suffix++) {
+                strcpy(code + len, IconSuffix[suffix]);
+                compareIcon(code, "");
+                compareIcon("", code);
+                compareIcon("C172", code);
+                compareIcon(code, code);
+            }
+            start = end + 1;
+        }
+    }
+
+    for (int i = 0; i < FeedModels; i++) {
+        compareIcon(FeedModel[i], "");
+    }
+
+    IconPair pair;
+    for (int i = 0; i < RandomPairs; i++) {
+        makeIconPair(&pair);
+        compareIcon(pair.model, pair.callsign);
+    }
+
+    benchCheck(_iconMismatches == 0, "%d aircraft got a different icon from the type table than from strstr", _iconMismatches);
+}
+
+void benchClassifyTable()
+{
+    for (int i = 0; i < BenchPairs; i++) {
+        _iconSum += classifyIcon(_iconPair[i].model, _iconPair[i].callsign);
+    }
+}
+
+void benchClassifyStrstr()
+{
+    for (int i = 0; i < BenchPairs; i++) {
+        _iconSum += strstrIcon(_iconPair[i].model, _iconPair[i].callsign, 1000);
+    }
+}
+
+void benchIconClass()
+{
+    srand(21);
+    checkIcons();
+
+    for (int i = 0; i < BenchPairs; i++) {
+        makeIconPair(&_iconPair[i]);
+    }
+
+    benchRun("icon.classify.table", BenchPairs, benchClassifyTable);
+    benchRun("icon.classify.strstr", BenchPairs, benchClassifyStrstr);
+}
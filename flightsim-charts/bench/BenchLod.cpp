@@ -0,0 +1,249 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "Bench.h"
+#include "LayerLod.h"
+
+const int LodObstacles = 40000;     // About as many as the full NATS obstacle file
+const int MinObstaclePixels = 40;   // See drawObstacles
+const int LevelSweeps = 2000;
+
+struct LodCell {
+    long long cell;
+    int rank;
+    int item;
+};
+
+// Variables
+ObstacleData _lodObstacle[LodObstacles];
+LodCell _lodCell[LodObstacles];
+int _lodBest[LodObstacles];
+LayerLod _lod;
+LayerLod _benchLod;
+
+
+/// <summary>
+/// Obstacles mostly in clusters like wind farms and cities, the rest
+/// spread over the UK. Heights repeat so some cells have a tie.
+/// </summary>
+void makeLodObstacles()
+{
+    double clusterLat = 0;
+    double clusterLon = 0;
+    for (int i = 0; i < LodObstacles; i++) {
+        ObstacleData* obstacle = &_lodObstacle[i];
+        if (i % 100 == 0) {
+            clusterLat = 50 + rand() / (double)RAND_MAX * 9;
+            clusterLon = -8 + rand() / (double)RAND_MAX * 10;
+        }
+
+        if (i % 4 == 0) {
+            obstacle->loc.lat = 50 + rand() / (double)RAND_MAX * 9;
+            obstacle->loc.lon = -8 + rand() / (double)RAND_MAX * 10;
+        }
+        else {
+            obstacle->loc.lat = clusterLat + (rand() / (double)RAND_MAX - 0.5) * 0.05;
+            obstacle->loc.lon = clusterLon + (rand() / (double)RAND_MAX - 0.5) * 0.08;
+        }
+        obstacle->elevationFt = 100 + (rand() % 60) * 10;
+    }
+}
+
+bool lodCellBefore(const LodCell& a, const LodCell& b)
+{
+    if (a.cell != b.cell) {
+        return a.cell < b.cell;
+    }
+    if (a.rank != b.rank) {
+        return a.rank > b.rank;
+    }
+
+    return a.item < b.item;
+}
+
+/// <summary>
+/// Work out from every obstacle, rather than the level below, which one
+/// each cell of a level should keep: the tallest, the first if there is
+/// a tie or the layer isn't ranked. Returns the number of cells with an
+/// obstacle in.
+/// </summary>
+int tallestPerCell(double cellSize, bool ranked)
+{
+    for (int i = 0; i < LodObstacles; i++) {
+        _lodCell[i].cell = (long long)floor(_lodObstacle[i].loc.lat / cellSize) * 0x100000000LL
+            + (long long)floor(_lodObstacle[i].loc.lon / cellSize);
+        _lodCell[i].rank = ranked ? _lodObstacle[i].elevationFt : 0;
+        _lodCell[i].item = i;
+    }
+    std::sort(_lodCell, _lodCell + LodObstacles, lodCellBefore);
+
+    int cells = 0;
+    for (int i = 0; i < LodObstacles; i++) {
+        if (i == 0 || _lodCell[i].cell != _lodCell[i - 1].cell) {
+            _lodBest[cells++] = _lodCell[i].item;
+        }
+    }
+    std::sort(_lodBest, _lodBest + cells);
+
+    return cells;
+}
+
+/// <summary>
+/// Every level must keep exactly the tallest obstacle of each of its
+/// cells, be in table order, be a subset of the level below and have a
+/// grid that finds all of it. Unranked, like VRPs, it must keep the
+/// first in each cell.
+/// </summary>
+void checkLevels(bool ranked)
+{
+    const char* layer = ranked ? "obstacles" : "unranked";
+    lodBuild(&_lod, &_lodObstacle[0].loc, ranked ? &_lodObstacle[0].elevationFt : NULL, sizeof(ObstacleData), LodObstacles);
+
+    LocnArea world = { -90, 90, -180, 180 };
+    double cellSize = LodCellSize;
+    int wrongTallest = 0;
+    int notSubset = 0;
+    int wrongLoc = 0;
+    int notFound = 0;
+    for (int l = 0; l < LodLevels; l++) {
+        LodLevel* level = &_lod.level[l];
+
+        int cells = tallestPerCell(cellSize, ranked);
+        if (level->count != cells) {
+            wrongTallest++;
+        }
+        else {
+            for (int i = 0; i < cells; i++) {
+                if (level->item[i] != _lodBest[i]) {
+                    wrongTallest++;
+                    break;
+                }
+            }
+        }
+
+        // Both are in ascending order so the level below is walked once
+        const LodLevel* below = l > 0 ? &_lod.level[l - 1] : NULL;
+        int j = 0;
+        for (int i = 0; i < level->count; i++) {
+            int item = level->item[i];
+            if (i > 0 && item <= level->item[i - 1]) {
+                notSubset++;
+            }
+            if (below) {
+                while (j < below->count && below->item[j] < item) {
+                    j++;
+                }
+                if (j == below->count || below->item[j] != item) {
+                    notSubset++;
+                }
+            }
+            if (level->loc[i].lat != _lodObstacle[item].loc.lat || level->loc[i].lon != _lodObstacle[item].loc.lon) {
+                wrongLoc++;
+            }
+        }
+
+        if (gridQuery(&level->grid, &world, 1) != level->count) {
+            notFound++;
+        }
+
+        if (ranked) {
+            char name[64];
+            sprintf(name, "lod.level%d obstacles", l);
+            benchReport(name, level->count, "obstacles");
+        }
+        cellSize *= 2;
+    }
+
+    benchCheck(wrongTallest == 0, "%s: %d levels didn't keep the right item in each cell", layer, wrongTallest);
+    benchCheck(notSubset == 0, "%s: %d level items weren't in order or in the level below", layer, notSubset);
+    benchCheck(wrongLoc == 0, "%s: %d level locations didn't match their item", layer, wrongLoc);
+    benchCheck(notFound == 0, "%s: %d level grids didn't find all their items", layer, notFound);
+    lodCleanup(&_lod);
+}
+
+/// <summary>
+/// An empty layer has nothing at any level
+/// </summary>
+void checkEmptyLayer()
+{
+    lodBuild(&_lod, &_lodObstacle[0].loc, &_lodObstacle[0].elevationFt, sizeof(ObstacleData), LodObstacles);
+    lodBuild(&_lod, &_lodObstacle[0].loc, NULL, sizeof(ObstacleData), 0);
+    benchCheck(_lod.level[0].count == 0 && _lod.level[LodLevels - 1].count == 0, "empty layer has items");
+    lodCleanup(&_lod);
+}
+
+/// <summary>
+/// Level lodChooseLevel should give: -1 if the smallest cells are at
+/// least twice minPixels, otherwise the first level with cells at least
+/// minPixels across, or the last level if none are
+/// </summary>
+int expectedLevel(double pixelsPerDegree, int minPixels)
+{
+    if (LodCellSize * pixelsPerDegree >= minPixels * 2) {
+        return -1;
+    }
+
+    for (int l = 0; l < LodLevels; l++) {
+        if (LodCellSize * (1 << l) * pixelsPerDegree >= minPixels) {
+            return l;
+        }
+    }
+
+    return LodLevels - 1;
+}
+
+/// <summary>
+/// The level must change exactly where the cells cross minPixels,
+/// including either side of every boundary and the -1 boundary
+/// </summary>
+void checkChooseLevel()
+{
+    int wrong = 0;
+
+    // Sweep from far zoomed out to far zoomed in
+    for (int i = 0; i <= LevelSweeps; i++) {
+        double pixelsPerDegree = pow(10.0, -1 + 7.0 * i / LevelSweeps);
+        if (lodChooseLevel(pixelsPerDegree, MinObstaclePixels) != expectedLevel(pixelsPerDegree, MinObstaclePixels)) {
+            wrong++;
+        }
+    }
+
+    // Just either side of each boundary
+    for (int l = -1; l < LodLevels; l++) {
+        double boundary = MinObstaclePixels / (LodCellSize * (l == -1 ? 0.5 : 1 << l));
+        if (lodChooseLevel(boundary * 1.000001, MinObstaclePixels) != l) {
+            wrong++;
+        }
+        if (l < LodLevels - 1 && lodChooseLevel(boundary * 0.999999, MinObstaclePixels) != l + 1) {
+            wrong++;
+        }
+    }
+
+    benchCheck(wrong == 0, "lodChooseLevel picked the wrong level %d times", wrong);
+    benchCheck(lodChooseLevel(1e9, MinObstaclePixels) == -1 && lodChooseLevel(0, MinObstaclePixels) == LodLevels - 1,
+        "lodChooseLevel at the zoom limits gave %d and %d", lodChooseLevel(1e9, MinObstaclePixels), lodChooseLevel(0, MinObstaclePixels));
+}
+
+/// <summary>
+/// Build the levels for the full obstacle file as loading it does
+/// </summary>
+void benchLodBuild()
+{
+    lodBuild(&_benchLod, &_lodObstacle[0].loc, &_lodObstacle[0].elevationFt, sizeof(ObstacleData), LodObstacles);
+}
+
+void benchLayerLod()
+{
+    srand(14);
+    makeLodObstacles();
+
+    checkLevels(true);
+    checkLevels(false);
+    checkEmptyLayer();
+    checkChooseLevel();
+
+    benchRun("lod.build.nats", LodObstacles, benchLodBuild);
+    lodCleanup(&_benchLod);
+}
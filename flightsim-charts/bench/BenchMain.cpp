@@ -0,0 +1,86 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+
+/// Usage: fsc-bench [--baseline file] [--save file] [--threshold percent]
+///                  [--min-ms millis] [--recording file]
+///
+/// The threshold can also be set with FSC_BENCH_THRESHOLD.
+/// Exits with 1 if any check fails or any benchmark regresses.
+
+int main(int argc, char** argv)
+{
+    const char* baselineFile = NULL;
+    const char* saveFile = NULL;
+    const char* recordingFile = NULL;
+    int minMillis = 200;
+    double threshold = 25;
+
+    char* env = getenv("FSC_BENCH_THRESHOLD");
+    if (env) {
+        threshold = atof(env);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselineFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save") == 0 && hasValue) {
+            saveFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            threshold = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-ms") == 0 && hasValue) {
+            minMillis = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--recording") == 0 && hasValue) {
+            recordingFile = argv[++i];
+        }
+        else {
+            printf("Usage: %s [--baseline file] [--save file] [--threshold percent] [--min-ms millis] [--recording file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    benchInit(minMillis, threshold);
+
+    if (baselineFile && !benchLoadBaseline(baselineFile)) {
+        return 2;
+    }
+
+    if (recordingFile && !benchLoadRecording(recordingFile)) {
+        return 2;
+    }
+
+    if (baselineFile) {
+        printf("Baseline %s, threshold %.0f%%\n", baselineFile, threshold);
+    }
+
+    benchCoords();
+    benchAiIndex();
+    benchFeedParser();
+    benchFeedBinary();
+    benchFrame();
+    benchKeepAlive();
+    benchDelta();
+    benchFeedQueue();
+    benchServerWait();
+    benchSharedFrames();
+    benchSpatialGrid();
+    benchStaticGrids();
+    benchLayerLod();
+    benchChartTiles();
+    benchLabelAtlas();
+    benchIconClass();
+    benchRecorder();
+
+    if (saveFile) {
+        benchSaveBaseline(saveFile);
+    }
+
+    printf("%d checks, %d failures\n", benchChecks(), benchFailures());
+    return benchFailures() > 0 ? 1 : 0;
+}
@@ -0,0 +1,387 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Bench.h"
+#include "Standin.h"
+#include "FeedFrame.h"
+#include "FeedParser.h"
+#include "FeedQueue.h"
+
+const int StressUpdates = 1000000;
+const int StressTrailEvery = 1000;
+const int QueueBatch = 1000;
+const int SlowMillis = 250;         // How long the slow stand-in takes to respond
+const int SlowAircraft = 2000;
+const int LoopMillis = 2000;        // How long the server loop runs for
+const int InlineEveryMillis = 500;
+const int QueueBufferSize = 80000;
+
+/// Server loop iteration times in ms
+const int LatencyBuckets = 8;
+const int LatencyLimit[LatencyBuckets] = { 2, 5, 10, 20, 50, 100, 250, MAXINT };
+
+struct LatencyHistogram {
+    int count[LatencyBuckets];
+    int total;
+    double max;
+    int applied;
+    int responses;
+};
+
+// Variables
+int _stressBadOrder;
+int _stressBadTrails;
+FeedUpdate _batchUpdate;
+char _queueData[QueueBufferSize];
+FeedFrame _queueFrame;
+int _queueFd;
+int _queuePort;
+std::atomic<bool> _queueStop;
+
+
+/// <summary>
+/// Listener side of the stress test. Every update has its sequence
+/// number in it and every so often a trail is handed over too.
+/// </summary>
+void stressProducer()
+{
+    FeedUpdate update;
+    memset(&update, 0, sizeof(update));
+
+    for (int seq = 0; seq < StressUpdates; seq++) {
+        update.type = UPDATE_AIRCRAFT;
+        update.trailNum = seq;
+        update.ai.alt = seq;
+        sprintf(update.ai.callsign, "S%d", seq);
+
+        if (seq % StressTrailEvery == 0) {
+            AI_Trail* trail;
+            while ((trail = feedTrailAcquire(&update.staging)) == NULL) {
+                std::this_thread::yield();
+            }
+
+            sprintf(trail->callsign, "T%d", seq);
+            trail->count = seq % 100 + 1;
+            for (int i = 0; i < trail->count; i++) {
+                trail->loc[i].lat = seq;
+                trail->loc[i].lon = i;
+            }
+            update.type = UPDATE_TRAIL;
+        }
+
+        while (!feedQueuePush(&update)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/// <summary>
+/// Server side of the stress test. Updates must arrive in order, fully
+/// written, and each trail must be complete when it is handed over.
+/// </summary>
+void stressConsumer()
+{
+    FeedUpdate update;
+    char callsign[16];
+
+    for (int seq = 0; seq < StressUpdates; ) {
+        if (!feedQueuePop(&update)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        sprintf(callsign, "S%d", seq);
+        if (update.trailNum != seq || update.ai.alt != seq || strcmp(update.ai.callsign, callsign) != 0) {
+            if (_stressBadOrder++ == 0) {
+                printf("Expected update %d, got %d %s\n", seq, update.trailNum, update.ai.callsign);
+            }
+        }
+
+        if (update.type == UPDATE_TRAIL) {
+            AI_Trail* trail = feedTrail(update.staging);
+            sprintf(callsign, "T%d", seq);
+            bool ok = strcmp(trail->callsign, callsign) == 0 && trail->count == seq % 100 + 1;
+            for (int i = 0; ok && i < trail->count; i++) {
+                ok = trail->loc[i].lat == seq && trail->loc[i].lon == i;
+            }
+            if (!ok) {
+                _stressBadTrails++;
+            }
+            feedTrailRelease(update.staging);
+        }
+
+        seq++;
+    }
+}
+
+void checkStress()
+{
+    _stressBadOrder = 0;
+    _stressBadTrails = 0;
+
+    std::thread producer(stressProducer);
+    stressConsumer();
+    producer.join();
+
+    FeedUpdate update;
+    benchCheck(_stressBadOrder == 0, "%d of %d queued updates were out of order or torn", _stressBadOrder, StressUpdates);
+    benchCheck(_stressBadTrails == 0, "%d staging trails were torn", _stressBadTrails);
+    benchCheck(!feedQueuePop(&update), "queue wasn't empty after the stress test");
+
+    // Every staging trail must have been released
+    int staging[FeedTrailStaging];
+    int acquired = 0;
+    while (acquired < FeedTrailStaging + 1 && feedTrailAcquire(&staging[acquired]) != NULL) {
+        acquired++;
+    }
+    benchCheck(acquired == FeedTrailStaging, "%d staging trails were free, expected %d", acquired, FeedTrailStaging);
+    for (int i = 0; i < acquired; i++) {
+        feedTrailRelease(staging[i]);
+    }
+}
+
+/// <summary>
+/// A full queue must refuse updates rather than overwrite them
+/// </summary>
+void checkFull()
+{
+    FeedUpdate update;
+    memset(&update, 0, sizeof(update));
+
+    int pushed = 0;
+    update.trailNum = pushed;
+    while (pushed <= FeedQueueSize && feedQueuePush(&update)) {
+        update.trailNum = ++pushed;
+    }
+    benchCheck(pushed == FeedQueueSize, "queue took %d updates, size is %d", pushed, FeedQueueSize);
+
+    int popped = 0;
+    int bad = 0;
+    while (feedQueuePop(&update)) {
+        if (update.trailNum != popped++) {
+            bad++;
+        }
+    }
+    benchCheck(popped == pushed && bad == 0, "full queue gave back %d updates, %d out of order", popped, bad);
+}
+
+void benchPushPop()
+{
+    for (int i = 0; i < QueueBatch; i++) {
+        feedQueuePush(&_batchUpdate);
+    }
+
+    FeedUpdate update;
+    while (feedQueuePop(&update)) {
+    }
+}
+
+int slowFeed(const char* request, char* payload, int size)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(SlowMillis));
+    return standinFeed(request, payload, size);
+}
+
+int queueRecv(char* buf, int len)
+{
+    return (int)recv(_queueFd, buf, len, 0);
+}
+
+/// <summary>
+/// Queue an update for each aircraft like processLines does
+/// </summary>
+const char* queueLines(const char* data, const char* end)
+{
+    FeedUpdate update;
+    update.type = UPDATE_AIRCRAFT;
+
+    while (data < end) {
+        const char* endLine = (const char*)memchr(data, '\n', end - data);
+        if (endLine == NULL) {
+            break;
+        }
+
+        if (parseAircraftLine(data, endLine, &update.ai)) {
+            while (!feedQueuePush(&update)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        data = endLine + 1;
+    }
+
+    return data;
+}
+
+const char* queueNoRecords(const char*, const char* end)
+{
+    return end;
+}
+
+void queueNoMessage(const char*)
+{
+}
+
+void queueNoProgress()
+{
+}
+
+/// <summary>
+/// One request to the slow stand-in, the way the listener makes it
+/// </summary>
+void listenerRequest()
+{
+    _queueFd = standinConnect(_queuePort);
+    if (_queueFd < 0) {
+        return;
+    }
+
+    send(_queueFd, "fr24", 4, 0);
+
+    _queueFrame.data = _queueData;
+    _queueFrame.size = QueueBufferSize;
+    _queueFrame.pending = 0;
+    _queueFrame.recvData = queueRecv;
+    _queueFrame.processText = queueLines;
+    _queueFrame.processBinary = queueNoRecords;
+    _queueFrame.processMessage = queueNoMessage;
+    _queueFrame.progress = queueNoProgress;
+
+    if (frameReceive(&_queueFrame) == RESPONSE_OK) {
+        FeedUpdate update;
+        update.type = UPDATE_END;
+        while (!feedQueuePush(&update)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    close(_queueFd);
+}
+
+void listenerLoop()
+{
+    while (!_queueStop) {
+        listenerRequest();
+    }
+}
+
+/// <summary>
+/// The server loop: wait for SimConnect, then apply whatever the listener
+/// has queued. Records how long each time round the loop takes. If not
+/// threaded the loop makes the listener requests itself like it used to.
+/// </summary>
+void serverLoop(bool threaded, LatencyHistogram* histogram)
+{
+    memset(histogram, 0, sizeof(LatencyHistogram));
+
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    auto nextRequest = start;
+    while (last - start < std::chrono::milliseconds(LoopMillis)) {
+        // Stands in for SimConnect_CallDispatch with nothing to do
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if (!threaded && last >= nextRequest) {
+            listenerRequest();
+            nextRequest = last + std::chrono::milliseconds(InlineEveryMillis);
+        }
+
+        FeedUpdate update;
+        while (feedQueuePop(&update)) {
+            if (update.type == UPDATE_END) {
+                histogram->responses++;
+            }
+            else {
+                histogram->applied++;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count() / 1000.0;
+        last = now;
+
+        int bucket = 0;
+        while (ms >= LatencyLimit[bucket]) {
+            bucket++;
+        }
+        histogram->count[bucket]++;
+        histogram->total++;
+        if (ms > histogram->max) {
+            histogram->max = ms;
+        }
+    }
+}
+
+void reportHistogram(const char* mode, const LatencyHistogram* histogram)
+{
+    char name[64];
+    int lower = 0;
+    for (int i = 0; i < LatencyBuckets; i++) {
+        if (LatencyLimit[i] == MAXINT) {
+            sprintf(name, "queue.latency.%s >=%dms", mode, lower);
+        }
+        else {
+            sprintf(name, "queue.latency.%s %d-%dms", mode, lower, LatencyLimit[i]);
+        }
+        benchReport(name, histogram->count[i], "loops");
+        lower = LatencyLimit[i];
+    }
+
+    sprintf(name, "queue.latency.%s max", mode);
+    benchReport(name, histogram->max, "ms");
+}
+
+/// <summary>
+/// While the listener waits on a slow server the server loop must keep
+/// going round. Run the same way as before the listener had its own
+/// thread for comparison.
+/// </summary>
+void checkLatency()
+{
+    _queuePort = standinStart();
+    if (!benchCheck(_queuePort > 0, "Failed to start the stand-in")) {
+        return;
+    }
+
+    standinFeedInit(SlowAircraft, 5, 8);
+    standinRespond(slowFeed, 1500);
+
+    LatencyHistogram threaded;
+    _queueStop = false;
+    std::thread listener(listenerLoop);
+    serverLoop(true, &threaded);
+    _queueStop = true;
+    listener.join();
+
+    LatencyHistogram inlined;
+    serverLoop(false, &inlined);
+    standinStop();
+
+    FeedUpdate update;
+    while (feedQueuePop(&update)) {
+    }
+
+    reportHistogram("threaded", &threaded);
+    reportHistogram("inline", &inlined);
+
+    benchCheck(threaded.responses > 0 && threaded.applied >= threaded.responses * SlowAircraft,
+        "threaded listener applied %d aircraft from %d responses", threaded.applied, threaded.responses);
+    benchCheck(threaded.max < SlowMillis / 2, "server loop took %.1f ms with the listener on its own thread", threaded.max);
+    benchCheck(inlined.max >= SlowMillis, "inline listener only held up the server loop for %.1f ms", inlined.max);
+}
+
+void benchFeedQueue()
+{
+    checkFull();
+    checkStress();
+
+    memset(&_batchUpdate, 0, sizeof(_batchUpdate));
+    _batchUpdate.type = UPDATE_AIRCRAFT;
+    benchRun("queue.pushPop", QueueBatch, benchPushPop);
+
+    checkLatency();
+}
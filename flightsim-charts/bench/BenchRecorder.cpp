@@ -0,0 +1,383 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include "Bench.h"
+#include "Recorder.h"
+#include "FeedFrame.h"
+#include "FeedParser.h"
+
+const char RecordingFile[] = "fsc-bench-recording.tmp";
+const char TruncatedFile[] = "fsc-bench-truncated.tmp";
+const int DispatchMessages = 2000;
+const int MaxDispatchSize = 600;
+const int FeedResponses = 60;
+const int MaxResponseSize = 40000;
+const int MaxFeedChunk = 3000;
+const int ReplayRecv = 777;         // Smaller than most records so they are returned in pieces
+const int TimedMessages = 10;
+const int TimedGapMillis = 15;
+const double MaxLateMillis = 15;
+const int ReplayLines = 2000;
+const int ReplayResponses = 100;
+const int ReplayBufferSize = 80000;
+
+// Variables
+char* _expectedFeed;
+int _expectedFeedSize;
+int _replayLines;
+char _replayBuffer[ReplayBufferSize];
+
+
+unsigned char dispatchByte(int message, int i)
+{
+    return (unsigned char)(message * 31 + i);
+}
+
+/// <summary>
+/// Listener side of the round trip. Each response is received in random
+/// sized chunks and ended like receiveResponse does.
+/// </summary>
+void recordResponses()
+{
+    int pos = 0;
+    for (int r = 0; r < FeedResponses; r++) {
+        int size = 1 + rand() % MaxResponseSize;
+        for (int i = 0; i < size; i++) {
+            _expectedFeed[pos + i] = (char)(r * 7 + i);
+        }
+
+        int sent = 0;
+        while (sent < size) {
+            int chunk = 1 + rand() % MaxFeedChunk;
+            if (chunk > size - sent) {
+                chunk = size - sent;
+            }
+            recordFeed(_expectedFeed + pos + sent, chunk);
+            sent += chunk;
+            std::this_thread::yield();
+        }
+        recordFeedEnd();
+        pos += size;
+    }
+
+    _expectedFeedSize = pos;
+}
+
+/// <summary>
+/// Returns the number of records for the stream in a recording file or
+/// -1 if it can't be read
+/// </summary>
+int countRecords(const char* filename, int stream)
+{
+    FILE* inf = fopen(filename, "rb");
+    if (inf == NULL) {
+        return -1;
+    }
+
+    int count = 0;
+    RecordHeader header;
+    fseek(inf, sizeof(RecordMagic) + sizeof(unsigned int), SEEK_SET);
+    while (fread(&header, sizeof(header), 1, inf) == 1) {
+        if ((int)header.stream == stream) {
+            count++;
+        }
+        fseek(inf, header.size, SEEK_CUR);
+    }
+
+    fclose(inf);
+    return count;
+}
+
+/// <summary>
+/// Record SimConnect messages on one thread while feed responses are
+/// recorded on another, then replay it. Every message and every feed
+/// byte must come back unchanged and in order, and each response must
+/// be a single record.
+/// </summary>
+void checkRoundTrip()
+{
+    _expectedFeed = (char*)malloc(FeedResponses * MaxResponseSize);
+    if (_expectedFeed == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    if (!benchCheck(recordStart(RecordingFile), "couldn't start recording")) {
+        return;
+    }
+
+    std::thread listener(recordResponses);
+
+    unsigned char message[MaxDispatchSize];
+    for (int m = 0; m < DispatchMessages; m++) {
+        int size = m % MaxDispatchSize;
+        for (int i = 0; i < size; i++) {
+            message[i] = dispatchByte(m, i);
+        }
+        recordData(STREAM_DISPATCH, message, size);
+        if (m % 10 == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    listener.join();
+    recorderCleanup();
+
+    benchCheck(countRecords(RecordingFile, STREAM_FEED) == FeedResponses, "%d feed records for %d responses",
+        countRecords(RecordingFile, STREAM_FEED), FeedResponses);
+
+    if (!benchCheck(replayStart(RecordingFile, true), "couldn't replay the recording")) {
+        return;
+    }
+
+    int messages = 0;
+    int badMessages = 0;
+    int size;
+    int waitMillis;
+    const char* data;
+    while ((data = replayDispatch(&size, &waitMillis)) != NULL) {
+        bool ok = size == messages % MaxDispatchSize;
+        for (int i = 0; ok && i < size; i++) {
+            ok = (unsigned char)data[i] == dispatchByte(messages, i);
+        }
+        if (!ok) {
+            badMessages++;
+        }
+        messages++;
+    }
+    benchCheck(messages == DispatchMessages && badMessages == 0 && waitMillis == -1,
+        "replayed %d of %d SimConnect messages, %d were wrong", messages, DispatchMessages, badMessages);
+
+    char* feed = (char*)malloc(_expectedFeedSize + ReplayRecv);
+    if (feed == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    int feedSize = 0;
+    int bytes;
+    while (feedSize <= _expectedFeedSize && (bytes = replayFeed(feed + feedSize, ReplayRecv)) > 0) {
+        feedSize += bytes;
+    }
+    benchCheck(feedSize == _expectedFeedSize && memcmp(feed, _expectedFeed, feedSize) == 0,
+        "replayed %d of %d feed bytes or they were different", feedSize, _expectedFeedSize);
+
+    free(feed);
+    free(_expectedFeed);
+    recorderCleanup();
+}
+
+bool writeFile(const char* filename, const void* data, int size)
+{
+    FILE* outf = fopen(filename, "wb");
+    if (outf == NULL) {
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, size, outf) == (size_t)size;
+    return fclose(outf) == 0 && ok;
+}
+
+/// <summary>
+/// A recording cut short must replay up to its last whole record and
+/// anything that isn't a recording must be refused
+/// </summary>
+void checkTruncated()
+{
+    recordStart(RecordingFile);
+    char message[100];
+    for (int m = 0; m < 3; m++) {
+        memset(message, m, sizeof(message));
+        recordData(STREAM_DISPATCH, message, sizeof(message));
+    }
+    recorderCleanup();
+
+    FILE* inf = fopen(RecordingFile, "rb");
+    char file[1000];
+    int fileSize = inf ? (int)fread(file, 1, sizeof(file), inf) : 0;
+    if (inf) {
+        fclose(inf);
+    }
+
+    int size;
+    int waitMillis;
+    int wrong = 0;
+    for (int cut = 1; cut < (int)(sizeof(RecordHeader) + sizeof(message)); cut += 7) {
+        writeFile(TruncatedFile, file, fileSize - cut);
+        if (!replayStart(TruncatedFile, true)) {
+            wrong++;
+            continue;
+        }
+
+        int messages = 0;
+        while (replayDispatch(&size, &waitMillis) != NULL) {
+            messages++;
+        }
+        if (messages != 2) {
+            wrong++;
+        }
+        recorderCleanup();
+    }
+    benchCheck(wrong == 0, "%d truncated recordings didn't replay their whole records", wrong);
+
+    writeFile(TruncatedFile, file, sizeof(RecordMagic) + 2);
+    bool refused = !replayStart(TruncatedFile, true);
+    file[0] = 'X';
+    writeFile(TruncatedFile, file, fileSize);
+    refused = refused && !replayStart(TruncatedFile, true);
+    file[0] = RecordMagic[0];
+    file[sizeof(RecordMagic)]++;
+    writeFile(TruncatedFile, file, fileSize);
+    refused = refused && !replayStart(TruncatedFile, true);
+    benchCheck(refused, "a short file, wrong magic or wrong version was replayed");
+
+    recorderCleanup();
+    remove(TruncatedFile);
+}
+
+/// <summary>
+/// Without fast, messages must be replayed at the time they were
+/// recorded: never early and only a little late
+/// </summary>
+void checkRealTime()
+{
+    recordStart(RecordingFile);
+    for (int m = 0; m < TimedMessages; m++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(TimedGapMillis));
+        recordData(STREAM_DISPATCH, &m, sizeof(m));
+    }
+    recorderCleanup();
+
+    if (!benchCheck(replayStart(RecordingFile, false), "couldn't replay the timed recording")) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    int messages = 0;
+    int early = 0;
+    double maxLate = 0;
+    int size;
+    int waitMillis;
+    while (true) {
+        const char* data = replayDispatch(&size, &waitMillis);
+        if (data == NULL) {
+            if (waitMillis == -1) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMillis));
+            continue;
+        }
+
+        double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+        double due = ((const RecordHeader*)data - 1)->micros / 1000.0;
+        if (elapsed < due - 1) {
+            early++;
+        }
+        if (elapsed - due > maxLate) {
+            maxLate = elapsed - due;
+        }
+        messages++;
+    }
+    recorderCleanup();
+
+    benchCheck(messages == TimedMessages && early == 0, "replayed %d of %d timed messages, %d early", messages, TimedMessages, early);
+    benchCheck(maxLate < MaxLateMillis, "timed message replayed %.1f ms late", maxLate);
+}
+
+const char* replayLines(const char* data, const char* end)
+{
+    AI_Aircraft ai;
+
+    while (data < end) {
+        const char* endLine = (const char*)memchr(data, '\n', end - data);
+        if (endLine == NULL) {
+            break;
+        }
+
+        if (parseAircraftLine(data, endLine, &ai)) {
+            _replayLines++;
+        }
+        data = endLine + 1;
+    }
+
+    return data;
+}
+
+const char* replayNoRecords(const char*, const char* end)
+{
+    return end;
+}
+
+void replayNoMessage(const char*)
+{
+}
+
+void replayNoProgress()
+{
+}
+
+/// <summary>
+/// Record a session of synthetic feed responses and replay it as fast as
+/// possible through the same framing and parsing the listener uses
+/// </summary>
+void reportReplay()
+{
+    int textSize = ReplayLines * 200;
+    char* text = (char*)malloc(textSize);
+    if (text == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+    textSize = benchMakeFeedText(text, textSize, ReplayLines);
+
+    recordStart(RecordingFile);
+    char header[32];
+    for (int r = 0; r < ReplayResponses; r++) {
+        int headerSize = sprintf(header, "%d\n", textSize);
+        recordFeed(header, headerSize);
+        for (int sent = 0; sent < textSize; sent += RecvSize) {
+            recordFeed(text + sent, textSize - sent < RecvSize ? textSize - sent : RecvSize);
+        }
+        recordFeedEnd();
+    }
+    recorderCleanup();
+    free(text);
+
+    auto start = std::chrono::steady_clock::now();
+    replayStart(RecordingFile, true);
+
+    FeedFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.data = _replayBuffer;
+    frame.size = ReplayBufferSize;
+    frame.recvData = replayFeed;
+    frame.processText = replayLines;
+    frame.processBinary = replayNoRecords;
+    frame.processMessage = replayNoMessage;
+    frame.progress = replayNoProgress;
+
+    _replayLines = 0;
+    int responses = 0;
+    while (frameReceive(&frame) == RESPONSE_OK) {
+        responses++;
+    }
+    recorderCleanup();
+
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+    benchCheck(responses == ReplayResponses && _replayLines == ReplayLines * ReplayResponses,
+        "replayed %d of %d responses with %d aircraft", responses, ReplayResponses, _replayLines);
+    benchReport("recorder.replay.feed lines/s", _replayLines / seconds, "lines/s");
+    benchReport("recorder.replay.feed responses/s", responses / seconds, "responses/s");
+}
+
+void benchRecorder()
+{
+    srand(24);
+    checkRoundTrip();
+    checkTruncated();
+    checkRealTime();
+    reportReplay();
+    remove(RecordingFile);
+}
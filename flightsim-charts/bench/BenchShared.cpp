@@ -0,0 +1,318 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include "Bench.h"
+#include "SharedData.h"
+
+const int FramesPublished = 20000;
+const int YieldEvery = 97;          // Records between yields so the threads interleave mid-frame
+const int AiFrameMax = 500;
+const int OwnPublished = 2000000;
+
+/// What the reader saw
+struct FrameStats {
+    int reads;
+    int fresh;
+    int torn;
+    int backwards;
+    int changed;
+};
+
+// Variables
+std::atomic<bool> _publishing;
+OtherFrame _copyFrom;
+OtherFrame _copyTo;
+LocData _ownRead;
+WindData _windRead;
+
+
+void fillOther(OtherData* other, int seq, int i)
+{
+    other->loc.lat = seq;
+    other->loc.lon = -seq;
+    other->heading = i;
+    other->alt = seq;
+    other->speed = seq;
+    other->wingSpan = seq;
+    sprintf(other->callsign, "O%d", seq);
+    sprintf(other->model, "M%d", i);
+}
+
+/// <summary>
+/// Returns the frame's sequence number or -1 if it is torn. The sequence
+/// number is written to every record so any mix of frames shows up.
+/// </summary>
+int checkOther(const OtherFrame* frame)
+{
+    if (frame->count == 0) {
+        return 0;
+    }
+
+    int seq = (int)frame->aircraft[0].alt;
+    if (frame->count != seq % MAX_AIRCRAFT + 1) {
+        return -1;
+    }
+
+    char callsign[32];
+    sprintf(callsign, "O%d", seq);
+    for (int i = 0; i < frame->count; i++) {
+        const OtherData* other = &frame->aircraft[i];
+        if (other->loc.lat != seq || other->loc.lon != -seq || other->heading != i || other->alt != seq
+            || other->speed != seq || other->wingSpan != seq || strcmp(other->callsign, callsign) != 0) {
+            return -1;
+        }
+
+        if (i % YieldEvery == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    return seq;
+}
+
+void otherPublisher()
+{
+    for (int seq = 1; seq <= FramesPublished; seq++) {
+        OtherFrame* frame = otherFrameWrite();
+        frame->count = seq % MAX_AIRCRAFT + 1;
+        for (int i = 0; i < frame->count; i++) {
+            fillOther(&frame->aircraft[i], seq, i);
+            if (i % YieldEvery == 0) {
+                std::this_thread::yield();
+            }
+        }
+        otherFramePublish();
+    }
+
+    _publishing = false;
+}
+
+void fillAi(AiFrameAircraft* ai, int seq, int i)
+{
+    ai->loc.lat = seq;
+    ai->loc.lon = i;
+    ai->heading = seq;
+    ai->alt = seq;
+    ai->speed = seq;
+    ai->iconType = seq;
+    sprintf(ai->callsign, "A%d", seq);
+    sprintf(ai->tagText, "%d", seq);
+}
+
+int checkAi(const AiFrame* frame)
+{
+    if (frame->count == 0) {
+        return 0;
+    }
+
+    int seq = (int)frame->aircraft[0].alt;
+    if (frame->count != seq % AiFrameMax + 1) {
+        return -1;
+    }
+
+    char callsign[16];
+    sprintf(callsign, "A%d", seq);
+    for (int i = 0; i < frame->count; i++) {
+        const AiFrameAircraft* ai = &frame->aircraft[i];
+        if (ai->loc.lat != seq || ai->loc.lon != i || ai->heading != seq || ai->alt != seq || ai->speed != seq
+            || ai->iconType != seq || strcmp(ai->callsign, callsign) != 0) {
+            return -1;
+        }
+
+        if (i % YieldEvery == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    return seq;
+}
+
+void aiPublisher()
+{
+    for (int seq = 1; seq <= FramesPublished; seq++) {
+        AiFrame* frame = aiFrameWrite();
+        frame->count = seq % AiFrameMax + 1;
+        for (int i = 0; i < frame->count; i++) {
+            fillAi(&frame->aircraft[i], seq, i);
+            if (i % YieldEvery == 0) {
+                std::this_thread::yield();
+            }
+        }
+        aiFramePublish();
+    }
+
+    _publishing = false;
+}
+
+/// <summary>
+/// Read frames like the render thread while the publisher runs. Every
+/// frame must be whole, never older than the last one read, and must not
+/// change while it is held.
+/// </summary>
+template <class Frame>
+FrameStats readFrames(void (*publisher)(), Frame* (*frameRead)(), int (*checkFrame)(const Frame*))
+{
+    FrameStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    _publishing = true;
+    std::thread thread(publisher);
+
+    int last = 0;
+    bool done = false;
+    while (!done) {
+        // Read once more after the publisher has finished
+        done = !_publishing;
+
+        Frame* frame = frameRead();
+        int seq = checkFrame(frame);
+        stats.reads++;
+
+        if (seq == -1) {
+            stats.torn++;
+            continue;
+        }
+        if (seq < last) {
+            stats.backwards++;
+        }
+        if (seq > last) {
+            stats.fresh++;
+        }
+        last = seq;
+
+        // Give the publisher a chance to write into the frame being held
+        std::this_thread::yield();
+        if (checkFrame(frame) != seq) {
+            stats.changed++;
+        }
+    }
+
+    thread.join();
+
+    if (last != FramesPublished) {
+        stats.backwards++;
+    }
+
+    return stats;
+}
+
+void reportFrames(const char* name, const FrameStats* stats)
+{
+    benchCheck(stats->torn == 0, "%s: %d of %d frames read were torn", name, stats->torn, stats->reads);
+    benchCheck(stats->changed == 0, "%s: %d frames changed while being read", name, stats->changed);
+    benchCheck(stats->backwards == 0, "%s: an older frame was read or the last frame was missed", name);
+    printf("%s: %d reads, %d new frames of %d published\n", name, stats->reads, stats->fresh, FramesPublished);
+}
+
+void benchPublishRead()
+{
+    otherFrameWrite()->count = 1;
+    otherFramePublish();
+    otherFrameRead();
+}
+
+/// <summary>
+/// How the server and render threads used to hand over the frame
+/// </summary>
+void benchFrameCopy()
+{
+    memcpy(&_copyTo, &_copyFrom, sizeof(OtherFrame));
+}
+
+void ownPublisher()
+{
+    LocData aircraft;
+    WindData wind;
+    memset(&aircraft, 0, sizeof(aircraft));
+
+    for (int seq = 1; seq <= OwnPublished; seq++) {
+        aircraft.loc.lat = seq;
+        aircraft.loc.lon = -seq;
+        aircraft.heading = seq;
+        aircraft.alt = seq;
+        aircraft.speed = seq;
+        aircraft.verticalSpeed = seq;
+        sprintf(aircraft.callsign, "OWN%d", seq);
+        wind.direction = seq;
+        wind.speed = -seq;
+        ownStatePublish(&aircraft, &wind);
+    }
+
+    _publishing = false;
+}
+
+/// <summary>
+/// Read own aircraft like the render thread does each frame while the
+/// server publishes as fast as it can. Every read must be from a single
+/// publish and never older than the last one.
+/// </summary>
+void checkOwnState()
+{
+    LocData start;
+    WindData startWind;
+    memset(&start, 0, sizeof(start));
+    memset(&startWind, 0, sizeof(startWind));
+    ownStatePublish(&start, &startWind);
+
+    _publishing = true;
+    std::thread thread(ownPublisher);
+
+    int reads = 0;
+    int torn = 0;
+    int backwards = 0;
+    double last = 0;
+    bool done = false;
+    while (!done) {
+        done = !_publishing;
+
+        LocData aircraft;
+        WindData wind;
+        ownStateRead(&aircraft, &wind);
+        reads++;
+
+        double seq = aircraft.loc.lat;
+        char callsign[32];
+        sprintf(callsign, "OWN%.0f", seq);
+        if (aircraft.loc.lon != -seq || aircraft.heading != seq || aircraft.alt != seq || aircraft.speed != seq
+            || aircraft.verticalSpeed != seq || wind.direction != seq || wind.speed != -seq || (seq != 0 && strcmp(aircraft.callsign, callsign) != 0)) {
+            torn++;
+        }
+        else if (seq < last) {
+            backwards++;
+        }
+        last = seq;
+    }
+
+    thread.join();
+
+    benchCheck(torn == 0, "%d of %d own aircraft reads were torn", torn, reads);
+    benchCheck(backwards == 0 && last == OwnPublished, "own aircraft went backwards %d times, last read was %.0f", backwards, last);
+    printf("own state: %d reads of %d published\n", reads, OwnPublished);
+}
+
+void benchOwnRead()
+{
+    ownStateRead(&_ownRead, &_windRead);
+}
+
+void benchOwnPublish()
+{
+    ownStatePublish(&_ownRead, &_windRead);
+}
+
+void benchSharedFrames()
+{
+    FrameStats stats = readFrames(otherPublisher, otherFrameRead, checkOther);
+    reportFrames("other frames", &stats);
+    stats = readFrames(aiPublisher, aiFrameRead, checkAi);
+    reportFrames("ai frames", &stats);
+
+    benchRun("shared.other.publishRead", 1, benchPublishRead);
+    benchRun("shared.other.copy", 1, benchFrameCopy);
+
+    checkOwnState();
+    benchRun("shared.own.read", 1, benchOwnRead);
+    benchRun("shared.own.publish", 1, benchOwnPublish);
+}
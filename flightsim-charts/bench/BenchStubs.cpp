@@ -0,0 +1,17 @@
+#include "Platform.h"
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include "flightsim-charts.h"
+
+/// The globals the pure modules share with the app, which are
+/// defined by modules that can't be built headless.
+
+double DegreesToRadians = M_PI / 180.0;
+bool _quit = false;
+int _displayWidth = 1920;
+int _displayHeight = 1080;
+DrawData _chart;
+DrawData _view;
+LocData _aircraftData;
+MouseData _mouseData;
+ChartData _chartData;
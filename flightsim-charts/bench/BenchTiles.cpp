@@ -0,0 +1,556 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Bench.h"
+#include "TilePyramid.h"
+
+const int BigChart = 20000;         // 20k x 20k chart the tiles were added for
+const int DisplayWidth = 1920;
+const int DisplayHeight = 1080;
+const int RangeViews = 20000;
+const int PanFrames = 3000;
+const int HalveSide = 4096;
+const int PitchPadding = 12;        // Locked bitmaps can have a pitch wider than the pixels
+const double MegaByte = 1024.0 * 1024.0;
+const ULONGLONG ChartFileSize = 123456789;
+const ULONGLONG ChartFileTime = 132000000000000000ULL;
+
+// Variables
+unsigned char* _halveFrom;
+unsigned char* _halveTo;
+unsigned char* _cacheImage;
+ULONGLONG _cacheImageSize;
+
+
+/// <summary>
+/// Each level must be half the one before rounded up with the right
+/// number of tiles, and only the last may fit in one tile.
+/// </summary>
+bool pyramidOk(int width, int height)
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(width, height, level);
+    if (levels < 1 || levels > MaxTileLevels || level[0].width != width || level[0].height != height) {
+        return false;
+    }
+
+    for (int i = 0; i < levels; i++) {
+        if (i > 0 && (level[i].width != (level[i - 1].width + 1) / 2 || level[i].height != (level[i - 1].height + 1) / 2)) {
+            return false;
+        }
+        if (level[i].tilesX * TileSize < level[i].width || (level[i].tilesX - 1) * TileSize >= level[i].width
+            || level[i].tilesY * TileSize < level[i].height || (level[i].tilesY - 1) * TileSize >= level[i].height) {
+            return false;
+        }
+
+        bool fits = level[i].tilesX == 1 && level[i].tilesY == 1;
+        if (fits != (i == levels - 1) && levels != MaxTileLevels) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void checkPyramid()
+{
+    const int Sizes = 8;
+    const int size[Sizes][2] = {
+        { BigChart, BigChart }, { 1, 1 }, { TileSize, TileSize }, { TileSize + 1, 1 },
+        { BigChart, 3 }, { 7, 40001 }, { 1000000, 1000000 }, { 1 << 30, 1 }
+    };
+
+    int bad = 0;
+    for (int i = 0; i < Sizes; i++) {
+        if (!pyramidOk(size[i][0], size[i][1])) {
+            if (bad++ == 0) {
+                printf("Bad pyramid for %dx%d\n", size[i][0], size[i][1]);
+            }
+        }
+    }
+    benchCheck(bad == 0, "%d of %d tile pyramids were wrong", bad, Sizes);
+}
+
+/// <summary>
+/// Zooming all the way in and out of the big chart the level drawn must
+/// have between one and two pixels per display pixel, unless zoomed in
+/// past level 0 or out past the last level, and the tiles covering the
+/// display must always fit in the tile cache.
+/// </summary>
+void checkLevels()
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(BigChart, BigChart, level);
+
+    int bad = 0;
+    int tooMany = 0;
+    int maxTiles = 0;
+    for (double viewWidth = 200; viewWidth < BigChart * 4; viewWidth *= 1.01) {
+        int levelNum = tileChooseLevel(viewWidth, DisplayWidth, levels);
+        double levelPixels = viewWidth / DisplayWidth / (1 << levelNum);
+
+        bool ok = levelNum >= 0 && levelNum < levels;
+        if (ok && levelNum > 0) {
+            ok = levelPixels >= 1 - 1e-9;
+        }
+        if (ok && levelNum < levels - 1) {
+            ok = levelPixels <= 2 + 1e-9;
+        }
+        if (!ok && bad++ == 0) {
+            printf("View %.0f wide drawn from level %d with %.2f pixels per display pixel\n", viewWidth, levelNum, levelPixels);
+        }
+
+        // Worst case is a view that straddles tile boundaries
+        double viewHeight = viewWidth * DisplayHeight / DisplayWidth;
+        double offset = TileSize * (1 << levelNum) - 1;
+        int tx1, ty1, tx2, ty2;
+        tileRange(level[levelNum].tilesX, level[levelNum].tilesY, levelNum, offset, offset, viewWidth, viewHeight, &tx1, &ty1, &tx2, &ty2);
+
+        int tiles = (tx2 - tx1 + 1) * (ty2 - ty1 + 1);
+        if (tiles > maxTiles) {
+            maxTiles = tiles;
+        }
+        if (tiles > MaxCachedTiles) {
+            tooMany++;
+        }
+    }
+
+    benchCheck(bad == 0, "%d zooms were drawn from the wrong level", bad);
+    benchCheck(tooMany == 0, "%d zooms needed more than %d tiles", tooMany, MaxCachedTiles);
+    benchReport("tiles.perFrame max", maxTiles, "tiles");
+}
+
+/// <summary>
+/// The tile range must be exactly the tiles that overlap the view,
+/// including views partly or wholly off the chart.
+/// </summary>
+void checkRange()
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(BigChart, BigChart * 3 / 4, level);
+
+    int bad = 0;
+    for (int i = 0; i < RangeViews; i++) {
+        int levelNum = rand() % levels;
+        double viewWidth = 100 + rand() / (double)RAND_MAX * BigChart * 2;
+        double viewHeight = viewWidth * DisplayHeight / DisplayWidth;
+        double viewX = -viewWidth * 1.5 + rand() / (double)RAND_MAX * (BigChart + viewWidth * 2);
+        double viewY = -viewHeight * 1.5 + rand() / (double)RAND_MAX * (BigChart + viewHeight * 2);
+
+        int tx1, ty1, tx2, ty2;
+        tileRange(level[levelNum].tilesX, level[levelNum].tilesY, levelNum, viewX, viewY, viewWidth, viewHeight, &tx1, &ty1, &tx2, &ty2);
+
+        double tileSide = (double)TileSize * (1 << levelNum);
+        for (int ty = 0; ty < level[levelNum].tilesY; ty++) {
+            for (int tx = 0; tx < level[levelNum].tilesX; tx++) {
+                bool overlaps = tx * tileSide <= viewX + viewWidth && (tx + 1) * tileSide > viewX
+                    && ty * tileSide <= viewY + viewHeight && (ty + 1) * tileSide > viewY;
+                bool inRange = tx >= tx1 && tx <= tx2 && ty >= ty1 && ty <= ty2;
+                if (overlaps != inRange) {
+                    bad++;
+                }
+            }
+        }
+    }
+    benchCheck(bad == 0, "%d tiles were wrongly in or out of the range drawn", bad);
+}
+
+/// <summary>
+/// Pan and zoom around the big chart keeping the tile cache the way
+/// tilesDraw does. A free slot must be used while there is one, after
+/// that the least recently used tile is evicted and never one that has
+/// already been drawn this frame.
+/// </summary>
+void checkEviction()
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(BigChart, BigChart, level);
+
+    int* cacheSlot[MaxTileLevels];
+    for (int i = 0; i < levels; i++) {
+        cacheSlot[i] = (int*)malloc(level[i].tilesX * level[i].tilesY * sizeof(int));
+        if (cacheSlot[i] == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+        for (int tile = 0; tile < level[i].tilesX * level[i].tilesY; tile++) {
+            cacheSlot[i][tile] = -1;
+        }
+    }
+
+    CachedTile cache[MaxCachedTiles];
+    memset(cache, 0, sizeof(cache));
+
+    // Stands in for the video bitmap
+    ALLEGRO_BITMAP* uploaded = (ALLEGRO_BITMAP*)cache;
+
+    int hits = 0;
+    int uploads = 0;
+    int notFree = 0;
+    int notLeastRecent = 0;
+    int drawnEvicted = 0;
+    for (unsigned int frame = 1; frame <= PanFrames; frame++) {
+        double viewWidth = 4000 * pow(2, 2.5 * sin(frame / 150.0));
+        double viewHeight = viewWidth * DisplayHeight / DisplayWidth;
+        double viewX = BigChart / 2 + BigChart * 0.4 * sin(frame / 400.0) - viewWidth / 2;
+        double viewY = BigChart / 2 + BigChart * 0.4 * cos(frame / 300.0) - viewHeight / 2;
+
+        int levelNum = tileChooseLevel(viewWidth, DisplayWidth, levels);
+        int tx1, ty1, tx2, ty2;
+        tileRange(level[levelNum].tilesX, level[levelNum].tilesY, levelNum, viewX, viewY, viewWidth, viewHeight, &tx1, &ty1, &tx2, &ty2);
+
+        for (int ty = ty1; ty <= ty2; ty++) {
+            for (int tx = tx1; tx <= tx2; tx++) {
+                int tile = ty * level[levelNum].tilesX + tx;
+                int slot = cacheSlot[levelNum][tile];
+                if (slot != -1) {
+                    cache[slot].lastUsed = frame;
+                    hits++;
+                    continue;
+                }
+
+                bool anyFree = false;
+                unsigned int leastRecent = frame;
+                for (int i = 0; i < MaxCachedTiles; i++) {
+                    if (cache[i].bmp == NULL) {
+                        anyFree = true;
+                    }
+                    else if (cache[i].lastUsed < leastRecent) {
+                        leastRecent = cache[i].lastUsed;
+                    }
+                }
+
+                slot = tileEvictSlot(cache);
+                CachedTile* cached = &cache[slot];
+                if (anyFree && cached->bmp != NULL) {
+                    notFree++;
+                }
+                if (!anyFree && cached->lastUsed != leastRecent) {
+                    notLeastRecent++;
+                }
+                if (cached->bmp != NULL && cached->lastUsed == frame) {
+                    drawnEvicted++;
+                }
+
+                if (cached->bmp != NULL) {
+                    cacheSlot[cached->level][cached->tile] = -1;
+                }
+                cached->bmp = uploaded;
+                cached->level = levelNum;
+                cached->tile = tile;
+                cached->lastUsed = frame;
+                cacheSlot[levelNum][tile] = slot;
+                uploads++;
+            }
+        }
+    }
+
+    for (int i = 0; i < levels; i++) {
+        free(cacheSlot[i]);
+    }
+
+    benchCheck(notFree == 0, "%d tiles evicted while there were free cache slots", notFree);
+    benchCheck(notLeastRecent == 0, "%d evicted tiles weren't the least recently used", notLeastRecent);
+    benchCheck(drawnEvicted == 0, "%d tiles evicted in the frame they were drawn", drawnEvicted);
+    benchReport("tiles.pan hit rate", 100.0 * hits / (hits + uploads), "%");
+    benchReport("tiles.pan uploads", (double)uploads / PanFrames, "per frame");
+}
+
+/// <summary>
+/// Halving must average each 2x2 block, repeating the last row or
+/// column when the size is odd, and leave the padding alone.
+/// </summary>
+void checkHalve()
+{
+    const int Sizes = 6;
+    const int size[Sizes][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 8, 1 }, { 513, 257 }, { 1000, 3 } };
+
+    int bad = 0;
+    for (int i = 0; i < Sizes; i++) {
+        int srcWidth = size[i][0];
+        int srcHeight = size[i][1];
+        int width = (srcWidth + 1) / 2;
+        int height = (srcHeight + 1) / 2;
+        int fromPitch = srcWidth * 4 + PitchPadding;
+        int toPitch = width * 4 + PitchPadding;
+
+        unsigned char* from = (unsigned char*)malloc(fromPitch * srcHeight);
+        unsigned char* to = (unsigned char*)malloc(toPitch * height);
+        if (from == NULL || to == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+
+        for (int b = 0; b < fromPitch * srcHeight; b++) {
+            from[b] = rand() & 0xff;
+        }
+        memset(to, 0xa5, toPitch * height);
+
+        halvePixels(from, fromPitch, srcWidth, srcHeight, to, toPitch);
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width * 4 + PitchPadding; x++) {
+                int expected = 0xa5;
+                if (x < width * 4) {
+                    int px = x / 4;
+                    int c = x % 4;
+                    int sum = 0;
+                    for (int dy = 0; dy < 2; dy++) {
+                        for (int dx = 0; dx < 2; dx++) {
+                            int sx = px * 2 + dx < srcWidth ? px * 2 + dx : srcWidth - 1;
+                            int sy = y * 2 + dy < srcHeight ? y * 2 + dy : srcHeight - 1;
+                            sum += from[sy * fromPitch + sx * 4 + c];
+                        }
+                    }
+                    expected = (sum + 2) / 4;
+                }
+
+                if (to[y * toPitch + x] != expected) {
+                    bad++;
+                }
+            }
+        }
+
+        free(from);
+        free(to);
+    }
+    benchCheck(bad == 0, "%d bytes were wrong after halving", bad);
+}
+
+/// <summary>
+/// What a 20k x 20k chart costs as one bitmap compared with the pyramid
+/// and the video tiles it is drawn from
+/// </summary>
+void reportMemory()
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(BigChart, BigChart, level);
+
+    double pyramidBytes = 0;
+    for (int i = 0; i < levels; i++) {
+        pyramidBytes += (double)level[i].width * level[i].height * 4;
+    }
+
+    benchReport("tiles.memory.20k levels", levels, "levels");
+    benchReport("tiles.memory.20k single bitmap", (double)BigChart * BigChart * 4 / MegaByte, "MB");
+    benchReport("tiles.memory.20k decoded pyramid", pyramidBytes / MegaByte, "MB");
+    benchReport("tiles.memory.20k video tiles max", (double)MaxCachedTiles * TileSize * TileSize * 4 / MegaByte, "MB");
+}
+
+/// <summary>
+/// Lay out the start of a tile cache file the way writeTileCache does, up
+/// to the end of the index. The PNG data isn't needed to open it.
+/// </summary>
+unsigned char* makeCacheImage(int width, int height, ULONGLONG* size)
+{
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(width, height, level);
+
+    int totalTiles = 0;
+    for (int i = 0; i < levels; i++) {
+        totalTiles += level[i].tilesX * level[i].tilesY;
+    }
+
+    ULONGLONG indexPos = sizeof(TileCacheHeader) + levels * sizeof(TileCacheLevel);
+    *size = indexPos + totalTiles * sizeof(TileCacheEntry);
+    unsigned char* data = (unsigned char*)malloc(*size);
+    if (data == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    tileCacheHeaderInit((TileCacheHeader*)data, ChartFileSize, ChartFileTime, width, height, levels);
+    memcpy(data + sizeof(TileCacheHeader), level, levels * sizeof(TileCacheLevel));
+
+    TileCacheEntry* index = (TileCacheEntry*)(data + indexPos);
+    ULONGLONG offset = *size;
+    for (int i = 0; i < totalTiles; i++) {
+        index[i].offset = offset;
+        index[i].size = 1000 + i;
+        index[i].reserved = 0;
+        offset += index[i].size;
+    }
+
+    return data;
+}
+
+bool cacheRejected(unsigned char* data, ULONGLONG size)
+{
+    return tileCacheIndex(data, size, ChartFileSize, ChartFileTime) == NULL;
+}
+
+/// <summary>
+/// A tile cache file must only be used if it is for the same chart and
+/// its header, level table and index are whole and consistent. Anything
+/// else means decoding the chart again rather than reading past the end
+/// of the mapping.
+/// </summary>
+void checkTileCache()
+{
+    ULONGLONG size;
+    unsigned char* data = makeCacheImage(3000, 2000, &size);
+    TileCacheHeader* header = (TileCacheHeader*)data;
+    TileCacheLevel* level = (TileCacheLevel*)(data + sizeof(TileCacheHeader));
+    ULONGLONG indexPos = sizeof(TileCacheHeader) + header->levels * sizeof(TileCacheLevel);
+
+    const TileCacheEntry* index = tileCacheIndex(data, size, ChartFileSize, ChartFileTime);
+    benchCheck(index == (const TileCacheEntry*)(data + indexPos), "tile cache file written for the chart wasn't accepted");
+    benchCheck(tileCacheIndex(data, size, ChartFileSize + 1, ChartFileTime) == NULL
+        && tileCacheIndex(data, size, ChartFileSize, ChartFileTime - 1) == NULL, "tile cache file for a changed chart was accepted");
+
+    int truncated = 0;
+    for (ULONGLONG length = 0; length < size; length++) {
+        if (!cacheRejected(data, length)) {
+            truncated++;
+        }
+    }
+    benchCheck(truncated == 0, "%d truncated tile cache files were accepted", truncated);
+
+    // Each corruption is undone before the next
+    int corrupt = 0;
+    header->magic[3]++;
+    corrupt += !cacheRejected(data, size);
+    header->magic[3]--;
+    header->version++;
+    corrupt += !cacheRejected(data, size);
+    header->version--;
+
+    int levels = header->levels;
+    header->levels = 0;
+    corrupt += !cacheRejected(data, size);
+    header->levels = MaxTileLevels + 1;
+    corrupt += !cacheRejected(data, size);
+    header->levels = levels + 1;
+    corrupt += !cacheRejected(data, size);
+    header->levels = levels;
+
+    header->width++;
+    corrupt += !cacheRejected(data, size);
+    header->width--;
+
+    for (int i = 0; i < levels; i++) {
+        TileCacheLevel saved = level[i];
+        level[i].width = 0;
+        corrupt += !cacheRejected(data, size);
+        level[i] = saved;
+        level[i].tilesX++;
+        corrupt += !cacheRejected(data, size);
+        level[i] = saved;
+        level[i].tilesY--;
+        corrupt += !cacheRejected(data, size);
+        level[i] = saved;
+
+        // A huge level mustn't overflow the index size
+        level[i].width = MAXINT;
+        level[i].tilesX = (int)(((long long)MAXINT + TileSize - 1) / TileSize);
+        corrupt += !cacheRejected(data, size);
+        level[i] = saved;
+    }
+    benchCheck(corrupt == 0, "%d corrupt tile cache files were accepted", corrupt);
+    benchCheck(!cacheRejected(data, size), "tile cache file wasn't accepted after undoing the corruption");
+
+    free(data);
+
+    // More levels than ChartTiles has room for, even though they are consistent
+    int tooMany = MaxTileLevels + 1;
+    size = sizeof(TileCacheHeader) + tooMany * (sizeof(TileCacheLevel) + sizeof(TileCacheEntry));
+    data = (unsigned char*)calloc(1, size);
+    if (data == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+    tileCacheHeaderInit((TileCacheHeader*)data, ChartFileSize, ChartFileTime, 1, 1, tooMany);
+    level = (TileCacheLevel*)(data + sizeof(TileCacheHeader));
+    for (int i = 0; i < tooMany; i++) {
+        tileLevelSize(&level[i], 1, 1);
+    }
+    benchCheck(cacheRejected(data, size), "tile cache file with %d levels was accepted", tooMany);
+    free(data);
+
+    char* cacheFile = tileCacheFile("C:\\Charts\\uk.2024\\south.png");
+    benchCheck(strcmp(cacheFile, "C:\\Charts\\uk.2024\\south.tiles") == 0, "tile cache file for south.png was %s", cacheFile);
+    cacheFile = tileCacheFile("C:\\Charts\\uk.2024\\south");
+    benchCheck(strcmp(cacheFile, "C:\\Charts\\uk.2024\\south.tiles") == 0, "tile cache file for south was %s", cacheFile);
+}
+
+/// <summary>
+/// Everything opening a chart from its tile cache does apart from mapping
+/// the file: check it and set up the levels
+/// </summary>
+void benchCacheOpen()
+{
+    const TileCacheEntry* index = tileCacheIndex(_cacheImage, _cacheImageSize, ChartFileSize, ChartFileTime);
+    const TileCacheHeader* header = (const TileCacheHeader*)_cacheImage;
+    const TileCacheLevel* level = (const TileCacheLevel*)(_cacheImage + sizeof(TileCacheHeader));
+    if (index == NULL) {
+        return;
+    }
+
+    int* cacheSlot[MaxTileLevels];
+    for (int i = 0; i < header->levels; i++) {
+        int tileCount = level[i].tilesX * level[i].tilesY;
+        cacheSlot[i] = (int*)malloc(tileCount * sizeof(int));
+        if (cacheSlot[i] == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+        for (int tile = 0; tile < tileCount; tile++) {
+            cacheSlot[i][tile] = -1;
+        }
+    }
+
+    for (int i = 0; i < header->levels; i++) {
+        free(cacheSlot[i]);
+    }
+}
+
+void benchHalve()
+{
+    halvePixels(_halveFrom, HalveSide * 4, HalveSide, HalveSide, _halveTo, HalveSide * 2);
+}
+
+void benchChartTiles()
+{
+    srand(15);
+    checkPyramid();
+    checkLevels();
+    checkRange();
+    checkEviction();
+    checkHalve();
+    checkTileCache();
+    reportMemory();
+
+    _halveFrom = (unsigned char*)malloc((size_t)HalveSide * HalveSide * 4);
+    _halveTo = (unsigned char*)malloc((size_t)HalveSide * HalveSide);
+    if (_halveFrom == NULL || _halveTo == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < HalveSide * HalveSide * 4; i++) {
+        _halveFrom[i] = (unsigned char)(i * 7 + (i >> 12));
+    }
+
+    double ns = benchRun("tiles.halve.4096", 1, benchHalve);
+    benchReport("tiles.halve MB/s", HalveSide * 4.0 * HalveSide / ns * 1e3, "MB/s");
+
+    // Every level but the last is halved to build the 20k pyramid
+    TileCacheLevel level[MaxTileLevels];
+    int levels = tilePyramid(BigChart, BigChart, level);
+    double halvedPixels = 0;
+    for (int i = 0; i < levels - 1; i++) {
+        halvedPixels += (double)level[i].width * level[i].height;
+    }
+    double buildMillis = ns * halvedPixels / ((double)HalveSide * HalveSide) / 1e6;
+
+    free(_halveFrom);
+    free(_halveTo);
+
+    _cacheImage = makeCacheImage(BigChart, BigChart, &_cacheImageSize);
+    ns = benchRun("tiles.cache.open.20k", 1, benchCacheOpen);
+    free(_cacheImage);
+
+    // Cold is a lower bound as it leaves out decoding the chart and writing the cache
+    benchReport("tiles.startup.20k cold", buildMillis, "ms");
+    benchReport("tiles.startup.20k warm", ns / 1e3, "us");
+}
@@ -0,0 +1,381 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "Bench.h"
+#include "ServerWait.h"
+#include "ServerSchedule.h"
+
+const int WakeRounds = 300;
+const int PollRounds = 20;
+const int PollMillis = 50;          // What the server loop used to sleep for
+const int IdleMillis = 200;
+const ULONGLONG StartMillis = 123456;
+const ULONGLONG SessionMillis = 120000;
+const int FailedConnects = 3;
+const ULONGLONG DisconnectMillis = 70000;
+const int MaxResponseMillis = 120;
+const int MaxFeedGapMillis = 700;
+const int MaxRequests = 10000;
+
+enum FAKE_SOURCE {
+    SOURCE_SIMCONNECT,
+    SOURCE_FEED,
+    SOURCE_NOTIFY,
+    SOURCES
+};
+
+/// What the fake server loop saw, by the fake clock
+struct FakeSession {
+    int connects;
+    ULONGLONG connectAt[FailedConnects + 2];
+    ULONGLONG connectedAt;
+    ULONGLONG disconnectedAt;
+    int requests;
+    ULONGLONG requestAt[MaxRequests];
+    ULONGLONG answeredAt[MaxRequests];
+    int badWaits;
+    int maxWait;
+};
+
+// Variables
+std::atomic<long long> _signalledAt;
+std::atomic<bool> _woken;
+std::atomic<bool> _polledFlag;
+const char* _sourceName[SOURCES] = { "simconnect", "feed", "notify" };
+FakeSession _session;
+
+
+long long nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double millisSince(long long micros)
+{
+    return (nowMicros() - micros) / 1000.0;
+}
+
+/// <summary>
+/// Signal like SimConnect, the listener or the UI would
+/// </summary>
+void fakeSignal(int source)
+{
+    switch (source) {
+    case SOURCE_SIMCONNECT:
+        serverSignal(serverSimConnectEvent());
+        break;
+    case SOURCE_FEED:
+        serverFeedReady();
+        break;
+    case SOURCE_NOTIFY:
+        serverNotify();
+        break;
+    }
+}
+
+/// <summary>
+/// Signals one source after a short random delay and waits for the
+/// server loop to notice before signalling again
+/// </summary>
+void fakeSource(int source, int rounds)
+{
+    for (int i = 0; i < rounds; i++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(rand() % 3000));
+        _woken = false;
+        _signalledAt = nowMicros();
+        fakeSignal(source);
+        while (!_woken) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/// <summary>
+/// Each source must wake the server loop. How long it takes is only
+/// reported as it depends on how busy the machine is.
+/// </summary>
+void reportWakeLatency(int source)
+{
+    serverWaitInit();
+    std::thread thread(fakeSource, source, WakeRounds);
+
+    double total = 0;
+    double max = 0;
+    int missed = 0;
+    for (int i = 0; i < WakeRounds; i++) {
+        if (!serverWait(-1)) {
+            missed++;
+        }
+        double ms = millisSince(_signalledAt);
+        total += ms;
+        if (ms > max) {
+            max = ms;
+        }
+        _woken = true;
+    }
+    thread.join();
+
+    benchCheck(missed == 0, "%d %s signals didn't wake the server loop", missed, _sourceName[source]);
+
+    char name[64];
+    sprintf(name, "wait.wake.%s mean", _sourceName[source]);
+    benchReport(name, total / WakeRounds, "ms");
+    sprintf(name, "wait.wake.%s max", _sourceName[source]);
+    benchReport(name, max, "ms");
+}
+
+void pollSource()
+{
+    for (int i = 0; i < PollRounds; i++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(rand() % 3000));
+        _woken = false;
+        _signalledAt = nowMicros();
+        _polledFlag = true;
+        while (!_woken) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/// <summary>
+/// The same with the old fixed sleep for comparison
+/// </summary>
+void reportPollLatency()
+{
+    std::thread thread(pollSource);
+
+    double total = 0;
+    for (int i = 0; i < PollRounds; ) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(PollMillis));
+        if (_polledFlag) {
+            _polledFlag = false;
+            total += millisSince(_signalledAt);
+            _woken = true;
+            i++;
+        }
+    }
+    thread.join();
+
+    benchReport("wait.wake.poll50 mean", total / PollRounds, "ms");
+}
+
+/// <summary>
+/// With nothing happening the server loop must sleep until its timeout,
+/// or until signalled if there is no timeout
+/// </summary>
+void checkIdle()
+{
+    serverWaitInit();
+
+    long long start = nowMicros();
+    bool woken = serverWait(IdleMillis);
+    benchReport("wait.idle.200", millisSince(start), "ms");
+    benchCheck(!woken, "idle wait was woken with nothing signalled");
+
+    std::thread quit([] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(IdleMillis));
+        serverNotify();
+    });
+    woken = serverWait(-1);
+    quit.join();
+    benchCheck(woken, "wait forever returned without being notified");
+}
+
+/// <summary>
+/// A signal before the wait must not be lost, each wait consumes one
+/// signalled event and signalling the same event twice only wakes once
+/// </summary>
+void checkAutoReset()
+{
+    serverWaitInit();
+
+    serverFeedReady();
+    serverFeedReady();
+    serverNotify();
+    serverSignal(serverSimConnectEvent());
+
+    int woken = 0;
+    while (woken <= SOURCES && serverWait(0)) {
+        woken++;
+    }
+    benchCheck(woken == SOURCES, "%d signalled events woke the wait %d times", SOURCES, woken);
+
+    serverWaitCleanup();
+}
+
+/// <summary>
+/// Drive the schedule the way server() does with a fake clock, fake
+/// SimConnect and feed wakeups at random times. SimConnect refuses the
+/// first connections, answers each all aircraft request after a random
+/// delay and drops the connection once. Returns when the session ends.
+/// </summary>
+void runFakeSession(bool noConnect)
+{
+    memset(&_session, 0, sizeof(_session));
+    ServerSchedule schedule;
+    scheduleInit(&schedule);
+
+    ULONGLONG now = StartMillis;
+    ULONGLONG end = StartMillis + SessionMillis;
+    ULONGLONG nextFeed = now + rand() % MaxFeedGapMillis;
+    ULONGLONG disconnectAt = now + DisconnectMillis;
+    bool connected = false;
+    bool pending = false;
+    bool dropped = false;
+
+    while (now < end) {
+        // Dispatch
+        if (connected) {
+            if (!dropped && now >= disconnectAt) {
+                dropped = true;
+                connected = false;
+                pending = false;
+                _session.disconnectedAt = now;
+                scheduleDisconnected(&schedule, now);
+            }
+            else if (pending && now >= _session.answeredAt[_session.requests - 1]) {
+                pending = false;
+            }
+        }
+
+        int waitMillis;
+        int action = scheduleNext(&schedule, now, connected, noConnect, pending, &waitMillis);
+        if (action == ACTION_CONNECT) {
+            if (_session.connects < FailedConnects + 2) {
+                _session.connectAt[_session.connects] = now;
+            }
+            _session.connects++;
+            connected = _session.connects > FailedConnects;
+            if (connected && _session.connectedAt == 0) {
+                _session.connectedAt = now;
+            }
+            waitMillis = scheduleDone(&schedule, now, action, connected);
+        }
+        else if (action == ACTION_ALL_AIRCRAFT) {
+            if (_session.requests < MaxRequests) {
+                _session.requestAt[_session.requests] = now;
+                _session.answeredAt[_session.requests] = now + rand() % MaxResponseMillis;
+                _session.requests++;
+                pending = true;
+            }
+            waitMillis = scheduleDone(&schedule, now, action, pending);
+        }
+
+        if (waitMillis < -1 || (waitMillis == -1 && !noConnect) || (connected && waitMillis > ConnectedMillis)) {
+            _session.badWaits++;
+        }
+        if (waitMillis > _session.maxWait) {
+            _session.maxWait = waitMillis;
+        }
+
+        // Wait until the timeout or the next thing that signals
+        ULONGLONG wake = waitMillis < 0 ? end : now + waitMillis;
+        if (nextFeed < wake) {
+            wake = nextFeed;
+        }
+        if (connected && pending && _session.answeredAt[_session.requests - 1] < wake) {
+            wake = _session.answeredAt[_session.requests - 1];
+        }
+        if (connected && !dropped && disconnectAt < wake) {
+            wake = disconnectAt;
+        }
+
+        if (wake > now) {
+            now = wake;
+        }
+        if (now >= nextFeed) {
+            nextFeed = now + 1 + rand() % MaxFeedGapMillis;
+        }
+    }
+}
+
+/// <summary>
+/// Connection attempts are RetryMillis apart however often the loop is
+/// woken, and the first one after a disconnect is RetryMillis later
+/// </summary>
+void checkConnectSchedule()
+{
+    runFakeSession(false);
+
+    int wrong = 0;
+    if (_session.connects < FailedConnects + 2 || _session.connectAt[0] != StartMillis) {
+        wrong++;
+    }
+    for (int i = 1; i <= FailedConnects && i < _session.connects; i++) {
+        if (_session.connectAt[i] != _session.connectAt[i - 1] + RetryMillis) {
+            wrong++;
+        }
+    }
+    benchCheck(wrong == 0, "connection attempts weren't every %d ms", RetryMillis);
+
+    benchCheck(_session.disconnectedAt != 0 && _session.connects == FailedConnects + 2
+        && _session.connectAt[FailedConnects + 1] == _session.disconnectedAt + RetryMillis,
+        "reconnected %d ms after being disconnected", (int)(_session.connectAt[FailedConnects + 1] - _session.disconnectedAt));
+    benchCheck(_session.badWaits == 0, "%d waits were negative or longer than %d ms while connected", _session.badWaits, ConnectedMillis);
+}
+
+/// <summary>
+/// All aircraft are requested straight after connecting, then again as
+/// soon as each request is answered but never within AllAircraftMillis
+/// of the last one and never while one is pending. Disconnected, there
+/// are no requests.
+/// </summary>
+void checkAllAircraftSchedule()
+{
+    int wrong = 0;
+    int early = 0;
+    int late = 0;
+    bool reconnected = false;
+    if (_session.requests == 0 || _session.requestAt[0] != _session.connectedAt) {
+        wrong++;
+    }
+
+    for (int i = 1; i < _session.requests; i++) {
+        ULONGLONG at = _session.requestAt[i];
+        if (at >= _session.disconnectedAt && !reconnected) {
+            reconnected = true;
+            if (at != _session.connectAt[FailedConnects + 1]) {
+                wrong++;
+            }
+            continue;
+        }
+
+        ULONGLONG due = _session.requestAt[i - 1] + AllAircraftMillis;
+        if (_session.answeredAt[i - 1] > due) {
+            due = _session.answeredAt[i - 1];
+        }
+        if (at < due) {
+            early++;
+        }
+        else if (at > due) {
+            late++;
+        }
+    }
+
+    benchCheck(wrong == 0, "all aircraft weren't requested as soon as connected");
+    benchCheck(early == 0 && late == 0, "%d of %d all aircraft requests early and %d late", early, _session.requests, late);
+    benchReport("wait.schedule.requests", _session.requests, "requests");
+
+    runFakeSession(true);
+    benchCheck(_session.connects == 0 && _session.requests == 0 && _session.badWaits == 0,
+        "with no connect there were %d connection attempts and %d requests", _session.connects, _session.requests);
+}
+
+void benchServerWait()
+{
+    srand(9);
+    checkAutoReset();
+    checkIdle();
+    checkConnectSchedule();
+    checkAllAircraftSchedule();
+
+    for (int source = 0; source < SOURCES; source++) {
+        reportWakeLatency(source);
+    }
+    reportPollLatency();
+
+    serverWaitCleanup();
+}
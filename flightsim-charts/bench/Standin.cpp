@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <thread>
+#include "Standin.h"
+
+const int StandinHeaderRoom = 32;
+
+// Variables
+int _standinFd = -1;
+std::thread _standinThread;
+bool _standinStopping = false;
+const char* _standinScript = NULL;
+int _standinScriptSize = 0;
+StandinHandler _standinHandler = NULL;
+int _standinMaxChunk = 1;
+int _standinConnections = 0;
+char _standinResponse[StandinHeaderRoom + StandinMaxResponse];
+
+
+/// <summary>
+/// Send all the data in chunks of 1 to maxChunk bytes. Each chunk is
+/// a separate send with Nagle off so they tend to arrive separately.
+/// </summary>
+bool sendChunked(int fd, const char* data, int size, int maxChunk)
+{
+    int sent = 0;
+    while (sent < size) {
+        int chunk = 1 + rand() % maxChunk;
+        if (chunk > size - sent) {
+            chunk = size - sent;
+        }
+
+        int bytes = (int)send(fd, &data[sent], chunk, MSG_NOSIGNAL);
+        if (bytes <= 0) {
+            return false;
+        }
+        sent += bytes;
+    }
+
+    return true;
+}
+
+bool respond(int fd, const char* request)
+{
+    // Leave room in front of the payload for the header so they are sent together
+    char* payload = &_standinResponse[StandinHeaderRoom];
+    int size = _standinHandler(request, payload, StandinMaxResponse);
+
+    char header[StandinHeaderRoom];
+    int headerLen = sprintf(header, "%d\n", size);
+    char* response = payload - headerLen;
+    memcpy(response, header, headerLen);
+    return sendChunked(fd, response, headerLen + size, _standinMaxChunk);
+}
+
+/// <summary>
+/// Answer requests until the client closes the connection
+/// </summary>
+void serveRequests(int fd)
+{
+    char requests[1024];
+    int filled = 0;
+
+    while (true) {
+        int bytes = (int)recv(fd, &requests[filled], sizeof(requests) - 1 - filled, 0);
+        if (bytes <= 0) {
+            return;
+        }
+        filled += bytes;
+        requests[filled] = '\0';
+
+        char* request = requests;
+        char* endRequest;
+        if (strchr(request, '\n') == NULL) {
+            // Not kept alive
+            if (!respond(fd, request)) {
+                return;
+            }
+            filled = 0;
+            continue;
+        }
+
+        while ((endRequest = strchr(request, '\n')) != NULL) {
+            *endRequest = '\0';
+            if (!respond(fd, request)) {
+                return;
+            }
+            request = endRequest + 1;
+        }
+
+        filled -= (int)(request - requests);
+        memmove(requests, request, filled);
+    }
+}
+
+void standinServe()
+{
+    while (!_standinStopping) {
+        int fd = accept(_standinFd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        _standinConnections++;
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        if (_standinHandler) {
+            serveRequests(fd);
+        }
+        else {
+            sendChunked(fd, _standinScript, _standinScriptSize, _standinMaxChunk);
+        }
+        close(fd);
+    }
+}
+
+/// <summary>
+/// Start listening. Port 0 listens on an ephemeral port on 127.0.0.1,
+/// otherwise on all addresses so the app can connect from another
+/// machine. Returns the port or -1.
+/// </summary>
+int standinStart(int port)
+{
+    _standinFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_standinFd < 0) {
+        printf("Stand-in failed to create TCP socket\n");
+        return -1;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(port == 0 ? INADDR_LOOPBACK : INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    int enable = 1;
+    setsockopt(_standinFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    socklen_t len = sizeof(addr);
+    if (bind(_standinFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(_standinFd, 4) != 0
+        || getsockname(_standinFd, (sockaddr*)&addr, &len) != 0) {
+        printf("Stand-in failed to listen\n");
+        close(_standinFd);
+        return -1;
+    }
+
+    _standinStopping = false;
+    _standinThread = std::thread(standinServe);
+    return ntohs(addr.sin_port);
+}
+
+void standinStop()
+{
+    _standinStopping = true;
+    shutdown(_standinFd, SHUT_RDWR);
+    _standinThread.join();
+    close(_standinFd);
+    _standinFd = -1;
+}
+
+/// <summary>
+/// The data to send to the next connection. It is not copied.
+/// </summary>
+void standinScript(const char* data, int size, int maxChunk)
+{
+    _standinScript = data;
+    _standinScriptSize = size;
+    _standinHandler = NULL;
+    _standinMaxChunk = maxChunk;
+}
+
+/// <summary>
+/// Answer the requests on the following connections with the handler
+/// </summary>
+void standinRespond(StandinHandler handler, int maxChunk)
+{
+    _standinHandler = handler;
+    _standinMaxChunk = maxChunk;
+}
+
+int standinConnections()
+{
+    return _standinConnections;
+}
+
+/// <summary>
+/// Connect to the stand-in. Returns the socket or -1.
+/// </summary>
+int standinConnect(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Same receive timeout as the listener
+    timeval timeout = { 15, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
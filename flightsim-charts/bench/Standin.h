@@ -0,0 +1,33 @@
+#pragma once
+
+/// Local stand-in for the fr24 server. Listens on 127.0.0.1 and either
+/// sends the next connection a scripted byte stream (any number of
+/// pipelined <len>\n<payload> responses) or answers requests like the
+/// real server. Data is sent in random sized chunks so the receiving
+/// code sees headers, lines and records split at every possible place.
+///
+/// Requests are answered in the order they arrive. A kept alive
+/// connection ends each request with a newline and can send several at
+/// once. Otherwise the request is whatever arrives in one go.
+///
+/// standinFeed is the reference fr24 feed (see StandinFeed.cpp). fsc-standin
+/// runs it on its own so the app can be pointed at it.
+
+const int StandinMaxResponse = 2000000;
+
+/// Fills payload with the response to the request and returns its size
+typedef int (*StandinHandler)(const char* request, char* payload, int size);
+
+int standinStart(int port = 0);
+void standinStop();
+void standinScript(const char* data, int size, int maxChunk);
+void standinRespond(StandinHandler handler, int maxChunk);
+int standinConnect(int port);
+int standinConnections();
+
+// Reference feed
+void standinFeedInit(int aircraft, int movingPercent, int seed);
+void standinFeedTick();
+unsigned int standinFeedSeq();
+int standinFeedPresent();
+int standinFeed(const char* request, char* payload, int size);
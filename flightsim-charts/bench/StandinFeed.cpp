@@ -0,0 +1,207 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include "Standin.h"
+#include "FeedBinary.h"
+
+/// Reference implementation of the fr24 feed for the stand-in server.
+/// Simulates traffic that mostly stays put: each tick a percentage of the
+/// aircraft move and a tenth as many leave and are replaced by new ones.
+///
+/// Requests:
+///   fr24[,bin]         Every aircraft
+///   fr24d,seq[,bin]    Aircraft changed since seq and removes for the
+///                      ones that have gone, or every aircraft as a full
+///                      resync if seq is 0 or too old
+/// Anything else (watch, home, wayp) gets an empty response.
+
+const int MaxStandinAircraft = Max_AI_Aircraft * 2;
+const unsigned int StandinHistory = 100;    // Ticks of removes that are kept
+
+struct StandinAircraft {
+    AI_Aircraft ai;
+    unsigned int addedSeq;
+    unsigned int changedSeq;
+    unsigned int goneSeq;       // 0 if still here
+};
+
+// Variables
+std::mutex _feedMutex;
+StandinAircraft _feedAircraft[MaxStandinAircraft];
+int _feedCount = 0;
+int _feedPresent = 0;
+int _feedMovingPercent;
+unsigned int _feedSeq;
+unsigned int _feedOldestSeq;
+int _feedNextCallsign;
+
+
+void addFeedAircraft()
+{
+    static const char* airlines[] = { "British Airways", "easyJet", "Ryanair", "Lufthansa", "KLM", "N/A" };
+    static const char* models[] = { "A320", "B738", "A21N", "E190", "B77W", "C172", "EC35" };
+
+    if (_feedCount == MaxStandinAircraft) {
+        return;
+    }
+
+    StandinAircraft* aircraft = &_feedAircraft[_feedCount++];
+    memset(aircraft, 0, sizeof(StandinAircraft));
+    AI_Aircraft* ai = &aircraft->ai;
+
+    int n = _feedNextCallsign++;
+    sprintf(ai->callsign, "%c%c%c%d", 'A' + n % 26, 'A' + n / 26 % 26, 'A' + n / 676 % 26, 100 + n % 9000);
+    strcpy(ai->airline, airlines[rand() % 6]);
+    strcpy(ai->model, models[rand() % 7]);
+    ai->loc.lat = 51.47 + (rand() / (double)RAND_MAX - 0.5) * 4;
+    ai->loc.lon = -0.45 + (rand() / (double)RAND_MAX - 0.5) * 6;
+    ai->heading = rand() % 360;
+    ai->alt = rand() % 40000;
+    ai->speed = rand() % 500;
+
+    aircraft->addedSeq = _feedSeq;
+    aircraft->changedSeq = _feedSeq;
+    _feedPresent++;
+}
+
+/// <summary>
+/// Forget aircraft that went before the oldest sequence number
+/// that can still get a delta.
+/// </summary>
+void dropGoneAircraft()
+{
+    if (_feedSeq <= StandinHistory) {
+        return;
+    }
+
+    _feedOldestSeq = _feedSeq - StandinHistory;
+    int keep = 0;
+    for (int i = 0; i < _feedCount; i++) {
+        if (_feedAircraft[i].goneSeq == 0 || _feedAircraft[i].goneSeq > _feedOldestSeq) {
+            _feedAircraft[keep++] = _feedAircraft[i];
+        }
+    }
+    _feedCount = keep;
+}
+
+void standinFeedInit(int aircraft, int movingPercent, int seed)
+{
+    std::lock_guard<std::mutex> lock(_feedMutex);
+
+    srand(seed);
+    _feedCount = 0;
+    _feedPresent = 0;
+    _feedMovingPercent = movingPercent;
+    _feedSeq = 1;
+    _feedOldestSeq = 1;
+    _feedNextCallsign = 0;
+
+    for (int i = 0; i < aircraft; i++) {
+        addFeedAircraft();
+    }
+}
+
+void standinFeedTick()
+{
+    std::lock_guard<std::mutex> lock(_feedMutex);
+
+    _feedSeq++;
+    int leaving = 0;
+    for (int i = 0; i < _feedCount; i++) {
+        StandinAircraft* aircraft = &_feedAircraft[i];
+        if (aircraft->goneSeq != 0) {
+            continue;
+        }
+
+        int chance = rand() % 1000;
+        if (chance < _feedMovingPercent) {
+            aircraft->goneSeq = _feedSeq;
+            _feedPresent--;
+            leaving++;
+        }
+        else if (chance < _feedMovingPercent * 10) {
+            aircraft->ai.loc.lat += (rand() % 200 - 100) * 0.00001;
+            aircraft->ai.loc.lon += (rand() % 200 - 100) * 0.00001;
+            aircraft->ai.heading = rand() % 360;
+            aircraft->changedSeq = _feedSeq;
+        }
+    }
+
+    dropGoneAircraft();
+    for (int i = 0; i < leaving; i++) {
+        addFeedAircraft();
+    }
+}
+
+unsigned int standinFeedSeq()
+{
+    std::lock_guard<std::mutex> lock(_feedMutex);
+    return _feedSeq;
+}
+
+int standinFeedPresent()
+{
+    std::lock_guard<std::mutex> lock(_feedMutex);
+    return _feedPresent;
+}
+
+int writeAircraftLine(char* payload, const AI_Aircraft* ai)
+{
+    return sprintf(payload, "%s,%s,%s,%.6f,%.6f,%.0f,%.0f,%.0f\n",
+        ai->callsign, ai->airline, ai->model, ai->loc.lat, ai->loc.lon, ai->heading, ai->alt, ai->speed);
+}
+
+/// <summary>
+/// The response to a request. Usable as a StandinHandler.
+/// </summary>
+int standinFeed(const char* request, char* payload, int size)
+{
+    std::lock_guard<std::mutex> lock(_feedMutex);
+
+    bool isDelta = strncmp(request, "fr24d,", 6) == 0;
+    if (!isDelta && strncmp(request, "fr24", 4) != 0) {
+        return 0;
+    }
+
+    bool binary = strstr(request, ",bin") != NULL;
+    unsigned int since = isDelta ? strtoul(&request[6], NULL, 10) : 0;
+    bool full = since == 0 || since < _feedOldestSeq || since > _feedSeq;
+
+    // Worst case size of a record
+    const int maxRecord = 128;
+    int len = 0;
+
+    if (binary) {
+        FeedHeader header = { isDelta, isDelta && full, _feedSeq };
+        len += encodeFeedHeader(payload, &header);
+    }
+    else if (isDelta) {
+        len += sprintf(payload, full ? "@%u,full\n" : "@%u\n", _feedSeq);
+    }
+
+    for (int i = 0; i < _feedCount && len < size - maxRecord; i++) {
+        StandinAircraft* aircraft = &_feedAircraft[i];
+        if (aircraft->goneSeq != 0) {
+            // Only tell the client about aircraft it knows about
+            if (!full && aircraft->goneSeq > since && aircraft->addedSeq <= since) {
+                if (binary) {
+                    len += encodeFeedRemove(&payload[len], aircraft->ai.callsign);
+                }
+                else {
+                    len += sprintf(&payload[len], "-%s\n", aircraft->ai.callsign);
+                }
+            }
+        }
+        else if (full || aircraft->changedSeq > since) {
+            if (binary) {
+                len += encodeFeedAircraft(&payload[len], &aircraft->ai);
+            }
+            else {
+                len += writeAircraftLine(&payload[len], &aircraft->ai);
+            }
+        }
+    }
+
+    return len;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Standin.h"
+
+/// Usage: fsc-standin [--port port] [--aircraft count] [--moving percent]
+///                    [--tick-ms millis] [--chunk bytes]
+///
+/// Runs the reference fr24 feed until killed. Point the app's listener
+/// at this machine to use it in place of the real server.
+
+int main(int argc, char** argv)
+{
+    int port = 52025;
+    int aircraft = 2000;
+    int moving = 5;
+    int tickMillis = 3000;
+    int maxChunk = 65536;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--port") == 0 && hasValue) {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--aircraft") == 0 && hasValue) {
+            aircraft = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--moving") == 0 && hasValue) {
+            moving = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--tick-ms") == 0 && hasValue) {
+            tickMillis = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && hasValue) {
+            maxChunk = atoi(argv[++i]);
+        }
+        else {
+            printf("Usage: %s [--port port] [--aircraft count] [--moving percent] [--tick-ms millis] [--chunk bytes]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    standinFeedInit(aircraft, moving, 1);
+    standinRespond(standinFeed, maxChunk > 0 ? maxChunk : 1);
+    if (standinStart(port) < 0) {
+        return 1;
+    }
+
+    printf("Stand-in fr24 server on port %d with %d aircraft\n", port, aircraft);
+    while (true) {
+        usleep(tickMillis * 1000);
+        standinFeedTick();
+        printf("Seq %u, %d aircraft, %d connections\n", standinFeedSeq(), standinFeedPresent(), standinConnections());
+    }
+}
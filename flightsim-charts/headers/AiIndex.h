@@ -0,0 +1,32 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Callsign to slot index for the AI aircraft and fixed object tables.
+/// Uses open addressing with linear probing. Callsigns are interned into
+/// fixed width, zero padded keys so a probe is a single memcmp.
+
+const int AiKeySize = 16;
+const int Ai_Aircraft_Index_Size = 8192;    // Must be a power of 2 and > Max_AI_Aircraft
+const int Ai_Fixed_Index_Size = 1024;       // Must be a power of 2 and > Max_AI_Fixed
+
+struct AiKey {
+    char text[AiKeySize];
+};
+
+struct AiIndexSlot {
+    AiKey key;          // Empty slot if key.text[0] is '\0'
+    int slot;
+};
+
+struct AiIndex {
+    AiIndexSlot* slots;
+    int size;
+    int count;
+};
+
+bool aiMakeKey(const char* callsign, AiKey* key);
+void aiIndexClear(AiIndex* index);
+int aiIndexFind(AiIndex* index, const char* callsign);
+bool aiIndexSet(AiIndex* index, const char* callsign, int slot);
+bool aiIndexRemove(AiIndex* index, const char* callsign);
+int aiCompact(AI_Aircraft* aircraft, int count, AiIndex* index);
@@ -0,0 +1,31 @@
+#pragma once
+#include "Platform.h"
+
+/// Where labels go in a label atlas (see LabelAtlas.h). Labels are packed
+/// in shelves: a label goes on the first shelf of its height with room
+/// left, otherwise a new shelf is started below the last one and when a
+/// page is full a new page is added. Only the page structures are
+/// allocated here, their bitmaps are created by the atlas.
+
+const int AtlasPageSize = 2048;
+const int MaxAtlasPages = 16;
+const int MaxAtlasShelves = 512;
+
+struct AtlasShelf {
+    int y;
+    int height;
+    int used;
+};
+
+struct AtlasPage {
+    ALLEGRO_BITMAP* bmp;
+    int shelfCount;
+    AtlasShelf shelf[MaxAtlasShelves];
+};
+
+struct LabelAtlas {
+    int pageCount;
+    AtlasPage* page[MaxAtlasPages];
+};
+
+bool atlasPlace(LabelAtlas* atlas, int width, int height, int* pageNum, int* x, int* y);
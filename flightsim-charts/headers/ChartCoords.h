@@ -1,5 +1,6 @@
 #pragma once
 #include "flightsim-charts.h"
+#include "SpatialGrid.h"
 
 struct AircraftPosition {
     int x;
@@ -14,14 +15,48 @@ struct Intersect {
     double dist;
 };
 
+/// Calibration constants used by locationToChartPos. Worked out once
+/// whenever the chart or its calibration changes.
+struct ChartTransform {
+    bool projected;     // Lat stretches towards the poles
+    double x0;
+    double xCalibDiff;
+    double lon0;
+    double lonCalibDiff;
+    double y0;
+    double yCalibDiff;
+    double lat0;        // In projected units if projected
+    double latCalibDiff;
+};
+
+/// Scratch space for projecting a whole layer of locations at once.
+/// Locations are gathered into separate lat and lon arrays so they
+/// can be projected two at a time. Storage only grows.
+struct ChartBatch {
+    int count;
+    int allocated;
+    double* lat;
+    double* lon;
+    int* x;             // Chart positions
+    int* y;
+};
+
 void displayToChartPos(int x, int y, Position* pos);
 void chartToDisplayPos(int x, int y, Position* pos);
+void updateChartTransform();
 void locationToChartPos(Locn* loc, Position* pos);
+void batchProject(ChartBatch* batch, const Locn* firstLoc, int stride, const int* index, int count);
+bool batchDrawOther(ChartBatch* batch, int n, Position* displayPos1, Position* displayPos2, Position* pos, bool force = false);
+void batchCleanup(ChartBatch* batch);
 void chartPosToLocation(int x, int y, Locn* loc);
+int chartAreaToLocations(Position* pos1, Position* pos2, LocnArea* areas);
+double displayPixelsPerDegree();
 void locationToString(Locn* loc, char* str);
 double greatCircleDistance(Locn* loc1, Locn* loc2);
+void greatCirclePos(Locn* loc, double headingTrue, double distanceNm);
 void aircraftLocToChartPos(AircraftPosition* pos);
 bool drawOther(Position* displayPos1, Position* displayPos2, Locn* loc, Position* pos, bool force = false);
+double chartCentreDistance(ChartData* chartData, Locn* loc);
 CalibratedData* findClosestChart(CalibratedData* calib, int count, Locn* loc);
 void adjustFollowLocation(LocData* loc, double ownWingSpan);
 void findTrackExtremities(FlightPlanData start, FlightPlanData end, Position* line1Start, Position* line1End, Position* line2Start, Position* line2End);
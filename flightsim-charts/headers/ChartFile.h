@@ -3,6 +3,7 @@
 
 void saveSettings();
 void loadSettings();
+void chartCalibrationFile(const char* chart, char* filename);
 void loadCalibrationData(ChartData* chartData, char* filename = NULL);
 void saveCalibration(int x, int y, Locn* loc);
 char *fileSelectorDialog(HWND displayHwnd, const char* filter, bool save = false);
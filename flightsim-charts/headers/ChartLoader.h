@@ -0,0 +1,28 @@
+#pragma once
+#include "flightsim-charts.h"
+#include "ChartTiles.h"
+
+/// Charts are loaded on a worker thread so the display keeps updating
+/// while a big chart is decoded. Only the latest request matters so a
+/// request made while a chart is loading replaces it. The render thread
+/// collects the loaded chart and its calibration and swaps both in at once.
+///
+/// Charts can also be prefetched when the worker is idle. A few of these
+/// are kept ready so switching to them later costs no load time. Their
+/// decoded tiles together must fit in PrefetchBudgetMB.
+
+const int MaxPrefetchedCharts = 2;
+const int PrefetchBudgetMB = 256;
+
+struct LoadedChart {
+    char filename[256];
+    bool ok;
+    ChartTiles tiles;
+    ChartData chartData;
+};
+
+void chartLoaderInit();
+void chartLoaderCleanup();
+void chartLoadRequest(const char* filename);
+void chartPrefetchRequest(const char* filename);
+bool chartLoadCollect(LoadedChart* loaded);
@@ -0,0 +1,44 @@
+#pragma once
+#include <windows.h>
+#include <allegro5/allegro.h>
+#include "TilePyramid.h"
+
+/// A chart is held as a pyramid of levels, each half the size of the one
+/// before, until it fits in a single tile. Levels are kept in memory
+/// bitmaps and split into fixed size tiles. Only the tiles covering the
+/// view, at the level that matches the zoom, are uploaded to video bitmaps
+/// and a bounded number of these are cached, least recently used first out.
+///
+/// The first time a chart is opened every tile is saved as a PNG to a tile
+/// cache file next to the chart. After that the cache file is mapped and
+/// only the tiles that are drawn get decoded.
+
+const int MaxTileUploads = 2;
+struct TileLevel {
+    ALLEGRO_BITMAP* bmp;    // Memory bitmap, NULL if using the tile cache
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    int* cacheSlot;         // Per tile, -1 if not cached
+    int firstEntry;         // Index of first tile in the tile cache
+};
+
+struct ChartTiles {
+    int width;
+    int height;
+    int levels;
+    TileLevel level[MaxTileLevels];
+    CachedTile cache[MaxCachedTiles];
+    unsigned int frame;
+    HANDLE cacheFile;
+    HANDLE cacheMapping;
+    const unsigned char* cacheData;
+    ULONGLONG cacheSize;
+    const TileCacheEntry* cacheIndex;
+};
+
+bool tilesLoad(ChartTiles* tiles, const char* filename);
+void tilesDraw(ChartTiles* tiles, double viewX, double viewY, double viewWidth, double viewHeight, int displayWidth, int displayHeight);
+ULONGLONG tilesMemory(ChartTiles* tiles);
+void tilesCleanup(ChartTiles* tiles);
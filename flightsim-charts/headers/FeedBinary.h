@@ -0,0 +1,51 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Compact binary alternative to the fr24 text feed. Requested by adding
+/// ",bin" to a fr24 or fr24d request. All values are little-endian.
+///
+/// Header (12 bytes):
+///   u8 magic[3] = FB 32 34, u8 version, u8 flags, u8 pad[3], u32 seq
+///   flags bit 0 = delta response (see fr24d), bit 1 = full resync
+/// Then any number of records, each starting with a u8 record type:
+///   FEED_AIRCRAFT  char callsign[16], char airline[32], char model[16],
+///                  i32 lat * 1e7, i32 lon * 1e7, u16 heading * 100,
+///                  i32 alt (feet), u16 speed (knots)
+///   FEED_REMOVE    char callsign[16]
+///   FEED_TRAIL     u8 trail (0-2), 6 x (u8 len, chars) for callsign,
+///                  airline, modelType, image, fromAirport, toAirport,
+///                  u16 count, count x (i32 lat * 1e7, i32 lon * 1e7)
+/// Strings in fixed size fields are zero padded and need not be terminated.
+/// A lat or lon of FeedNoLoc means it is missing. Records are checked with
+/// the same rules as the text feed (see FeedParser) and a record that fails
+/// them is decoded as FEED_IGNORED.
+
+const unsigned char FeedMagic[3] = { 0xFB, '2', '4' };
+const int FeedVersion = 1;
+const int FeedHeaderSize = 12;
+const int FeedAircraftSize = 1 + 16 + 32 + 16 + 4 + 4 + 2 + 4 + 2;
+const int FeedRemoveSize = 1 + 16;
+const unsigned int FeedNoLoc = 0x80000000;
+const int FeedMaxTrailSize = 1 + 1 + 6 * 256 + 2 + 8 * (sizeof(AI_Trail::loc) / sizeof(Locn));
+
+enum FEED_RECORD {
+    FEED_IGNORED = 0,
+    FEED_AIRCRAFT = 1,
+    FEED_REMOVE = 2,
+    FEED_TRAIL = 3
+};
+
+struct FeedHeader {
+    bool isDelta;
+    bool isFull;
+    unsigned int seq;
+};
+
+bool isFeedBinary(char firstByte);
+int decodeFeedHeader(const char* data, const char* end, FeedHeader* header);
+int decodeFeedRecord(const char* data, const char* end, int* type, AI_Aircraft* ai, AI_Trail* trail, int* trailNum);
+
+int encodeFeedHeader(char* buf, const FeedHeader* header);
+int encodeFeedAircraft(char* buf, const AI_Aircraft* ai);
+int encodeFeedRemove(char* buf, const char* callsign);
+int encodeFeedTrail(char* buf, int trailNum, const AI_Trail* trail);
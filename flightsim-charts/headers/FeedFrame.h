@@ -0,0 +1,45 @@
+#pragma once
+
+/// Splits the responses from the fr24 server out of the received bytes.
+/// Each response is <len>\n<payload>. The header is received in the same
+/// chunks as the data so any bytes past the end of a response are kept
+/// for the next one. Text payloads are processed a line at a time and
+/// binary payloads a record at a time as they arrive. A # message is
+/// processed once all of it has arrived. Anything too big for the buffer
+/// is skipped: a text line up to its newline, a message or binary payload
+/// up to the end of the response.
+
+const int MaxHeaderSize = 32;
+const int RecvSize = 65536;
+
+enum ResponseStatus {
+    RESPONSE_OK,
+    RESPONSE_NONE,
+    RESPONSE_INCOMPLETE
+};
+
+enum FRAME_MODE {
+    FRAME_TEXT,
+    FRAME_MESSAGE,
+    FRAME_BINARY
+};
+
+typedef int (*FrameRecv)(char* buf, int len);
+typedef const char* (*FrameProcess)(const char* data, const char* end);
+typedef void (*FrameMessage)(const char* message);
+typedef void (*FrameProgress)();
+
+struct FeedFrame {
+    char* data;
+    int size;
+    int pending;        // Bytes already received for the next response
+    int mode;           // FRAME_MODE of the last response
+    FrameRecv recvData;
+    FrameProcess processText;
+    FrameProcess processBinary;
+    FrameMessage processMessage;
+    FrameProgress progress;
+};
+
+ResponseStatus frameReceive(FeedFrame* frame);
+void frameReset(FeedFrame* frame);
@@ -0,0 +1,13 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Parses the fr24 text feed in a single pass straight out of the
+/// receive buffer. The buffer is never modified or copied and lines
+/// do not need to be null terminated.
+
+const char* findFeedLineEnd(const char* line, const char* end);
+const char* parseFeedDouble(const char* pos, const char* end, double* val);
+bool parseAircraftLine(const char* line, const char* end, AI_Aircraft* ai);
+int parseTrailLine(const char* line, const char* end, AI_Trail* trail);
+bool checkFeedAircraft(AI_Aircraft* ai, bool fits, bool gotLoc);
+bool checkFeedTrail(const AI_Trail* trail, bool fits);
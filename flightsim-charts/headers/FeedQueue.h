@@ -0,0 +1,35 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Lock-free single producer, single consumer queue of updates parsed
+/// by the listener thread and applied by the server thread. Trails are
+/// too big to queue so they are parsed into a staging trail which is
+/// handed over by index.
+
+const int FeedQueueSize = 4096;     // Must be a power of 2
+const int FeedTrailStaging = 6;
+
+enum FEED_UPDATE {
+    UPDATE_AIRCRAFT,
+    UPDATE_REMOVE,
+    UPDATE_DELTA,
+    UPDATE_TRAIL,
+    UPDATE_END,
+    UPDATE_STALE,
+    UPDATE_CLEAR_AIRCRAFT,
+    UPDATE_CLEAR_FIXED
+};
+
+struct FeedUpdate {
+    int type;
+    int trailNum;       // Trail number or mask of trails received for UPDATE_END
+    int staging;        // Staging trail index
+    bool full;          // Full resync for UPDATE_DELTA and UPDATE_END
+    AI_Aircraft ai;
+};
+
+bool feedQueuePush(const FeedUpdate* update);
+bool feedQueuePop(FeedUpdate* update);
+AI_Trail* feedTrailAcquire(int* staging);
+AI_Trail* feedTrail(int staging);
+void feedTrailRelease(int staging);
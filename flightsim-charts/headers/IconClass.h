@@ -0,0 +1,29 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Works out which icon to draw for an aircraft from its model and
+/// callsign. The answer never changes for a given model/callsign so it is
+/// worked out once when the aircraft record is created or its model
+/// changes and kept in the record. The type codes are looked up in a
+/// table built at compile time from the type strings in flightsim-charts.h.
+
+enum ICON_TYPE {
+    ICON_DEFAULT,       // Other or small other depending on wingspan
+    ICON_LONG_MODEL,    // Model is not a type code so go by wingspan
+    ICON_GLIDER,
+    ICON_HELI,
+    ICON_TURBOPROP,
+    ICON_AIRLINER,
+    ICON_LARGE_AIRLINER,
+    ICON_JET,
+    ICON_MILITARY_HELI,
+    ICON_MILITARY_JET,
+    ICON_MILITARY_SMALL,
+    ICON_MILITARY_OTHER
+};
+
+// Set for GRND models which are drawn as vehicles when below 50 feet
+const int IconGround = 0x100;
+const int IconTypeMask = 0xff;
+
+int classifyIcon(const char* model, const char* callsign);
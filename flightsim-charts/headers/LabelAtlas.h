@@ -0,0 +1,12 @@
+#pragma once
+#include <allegro5/allegro.h>
+#include "AtlasPacker.h"
+
+/// Static labels (flight plan, VRPs, obstacles, elevations) are packed into
+/// a few large pages instead of each having its own bitmap. Each label is a
+/// sub-bitmap of a page, so drawing a whole layer with bitmap drawing held
+/// goes out in one batch per page. Labels are packed in shelves and are
+/// never freed one at a time, the whole atlas is cleared with its layer.
+
+ALLEGRO_BITMAP* labelAtlasAdd(LabelAtlas* atlas, int width, int height);
+void labelAtlasClear(LabelAtlas* atlas);
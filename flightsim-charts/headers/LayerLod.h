@@ -0,0 +1,27 @@
+#pragma once
+#include "flightsim-charts.h"
+#include "SpatialGrid.h"
+
+/// Level of detail for dense point layers (obstacles and VRPs). Each level
+/// divides the world into square cells, starting at LodCellSize degrees and
+/// doubling each level, and keeps only the highest ranked item in each cell.
+/// Levels are built once when the layer is loaded and each one has its own
+/// grid so a zoomed out chart only draws a bounded number of items.
+
+const int LodLevels = 10;
+const double LodCellSize = 0.005;   // Degrees
+
+struct LodLevel {
+    int count;
+    int* item;          // Table index of each item kept, in ascending order
+    Locn* loc;
+    SpatialGrid grid;
+};
+
+struct LayerLod {
+    LodLevel level[LodLevels];
+};
+
+void lodBuild(LayerLod* lod, const Locn* firstLoc, const int* firstRank, int stride, int count);
+int lodChooseLevel(double pixelsPerDegree, int minPixels);
+void lodCleanup(LayerLod* lod);
@@ -2,4 +2,6 @@
 
 void listenerInit();
 void listenerCleanup();
-bool listenerRead(const char* request, int waitMillis, bool immediate);
+void listener();
+void listenerReplay();
+void listenerApply();
@@ -0,0 +1,38 @@
+#pragma once
+
+/// The pure computation modules (coordinates, feed decoding, icon
+/// classification, server scheduling, spatial grids, layer LOD, tile
+/// pyramids and label packing) only need a handful of Windows and Allegro
+/// types. Defining FSC_HEADLESS swaps the real headers for just those
+/// types so they can be compiled and run on their own, e.g. on a build box
+/// with no Windows SDK or display. Modules that draw, use SimConnect or
+/// sockets still need the real headers.
+
+#ifdef FSC_HEADLESS
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef uint32_t DWORD;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef void* HANDLE;
+#define MAXINT INT_MAX
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#define YieldProcessor() sched_yield()
+#define Sleep(millis) usleep((millis) * 1000)
+#define _fseeki64 fseeko
+#define _ftelli64 ftello
+
+// Only ever used as a pointer by the pure modules
+struct ALLEGRO_BITMAP;
+#else
+#include <windows.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include <windows.h>
+
+/// Lightweight timing of the hot paths on the render, server and listener
+/// threads. Each zone is only ever timed on one thread so recording needs
+/// no locks. A zone keeps its recent samples in a ring buffer for the
+/// overlay and a histogram of every sample for the dump on exit.
+
+const int ZoneSamples = 256;    // Must be a power of 2
+const int ZoneBuckets = 24;     // Log2 of microseconds, last bucket takes anything over 4s
+
+enum PROFILE_ZONE {
+    ZONE_FRAME,             // Render thread, time between frames
+    ZONE_UPDATE,            // Render thread
+    ZONE_RENDER,            // Render thread
+    ZONE_OTHER_TAGS,        // Render thread
+    ZONE_DISPATCH,          // Server thread
+    ZONE_FEED_APPLY,        // Server thread
+    ZONE_FEED_REQUEST,      // Listener thread
+    ZONE_FEED_PARSE,        // Listener thread
+    ZONE_COUNT
+};
+
+/// Times from construction to the end of the enclosing scope
+struct ZoneTimer {
+    int zone;
+    LARGE_INTEGER start;
+
+    ZoneTimer(int zone);
+    ~ZoneTimer();
+};
+
+void profilerInit();
+void profileRecord(int zone, LONGLONG ticks);
+void profileFrame();
+const char* zoneName(int zone);
+bool zonePercentiles(int zone, double* p50, double* p99);
+void profilerDump();
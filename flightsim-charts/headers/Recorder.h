@@ -0,0 +1,39 @@
+#pragma once
+#include "Platform.h"
+
+/// Records the raw SimConnect messages passed to MyDispatchProc and the
+/// raw bytes the listener receives from the fr24 server, each with the
+/// time since recording started. A recording can be replayed in place of
+/// MS FS2020 and the fr24 server, either in real time or as fast as
+/// possible, through the same dispatch and feed parsing code. Feed data is
+/// recorded a response at a time, so one record holds everything that was
+/// received for it. Nothing is sent to MS FS2020 during a replay.
+///
+/// File layout (native byte order):
+///   char magic[4] = "FCRC", u32 version
+///   Then records of: u32 stream, u32 size, i64 micros, size bytes of data
+
+const char RecordMagic[4] = { 'F', 'C', 'R', 'C' };
+const int RecordVersion = 1;
+
+enum RECORD_STREAM {
+    STREAM_DISPATCH = 1,
+    STREAM_FEED = 2
+};
+
+struct RecordHeader {
+    unsigned int stream;
+    unsigned int size;
+    LONGLONG micros;
+};
+
+bool recordStart(const char* filename);
+bool replayStart(const char* filename, bool fast);
+void recorderCleanup();
+bool recording();
+bool replaying();
+void recordData(int stream, const void* data, int size);
+void recordFeed(const void* data, int size);
+void recordFeedEnd();
+const char* replayDispatch(int* size, int* waitMillis);
+int replayFeed(char* buf, int len);
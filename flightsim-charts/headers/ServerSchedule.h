@@ -0,0 +1,31 @@
+#pragma once
+#include "Platform.h"
+
+/// Decides what the server loop does next and how long it then waits.
+/// The loop does the work and reports the result, so the timing rules
+/// can be tested with a fake clock and no SimConnect.
+///
+/// While disconnected a connection is attempted every RetryMillis. While
+/// connected all aircraft are requested as soon as the last request has
+/// been answered, but no more often than every AllAircraftMillis, and
+/// the loop waits at most ConnectedMillis for SimConnect.
+
+const int AllAircraftMillis = 50;   // Min time between all aircraft requests
+const int ConnectedMillis = 1000;   // Max wait when connected
+const int RetryMillis = 10000;      // Time between connection attempts
+
+enum SERVER_ACTION {
+    ACTION_NONE,
+    ACTION_CONNECT,         // Try to connect to MS FS2020
+    ACTION_ALL_AIRCRAFT     // Request all aircraft in range
+};
+
+struct ServerSchedule {
+    ULONGLONG nextAllAircraft;
+    ULONGLONG nextConnect;
+};
+
+void scheduleInit(ServerSchedule* schedule);
+int scheduleNext(ServerSchedule* schedule, ULONGLONG now, bool connected, bool noConnect, bool pendingRequest, int* waitMillis);
+int scheduleDone(ServerSchedule* schedule, ULONGLONG now, int action, bool ok);
+void scheduleDisconnected(ServerSchedule* schedule, ULONGLONG now);
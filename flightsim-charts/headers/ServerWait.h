@@ -0,0 +1,20 @@
+#pragma once
+#include "Platform.h"
+
+/// The server thread sleeps until SimConnect has data, the listener has
+/// queued feed updates, another thread wants attention or its timeout
+/// expires. All the waiting goes through these functions so the server
+/// loop doesn't depend on how the wakeups are implemented. Built with
+/// FSC_HEADLESS they are a condition variable so the waiting can be
+/// tested without Windows.
+
+void serverWaitInit();
+void serverWaitCleanup();
+HANDLE serverSimConnectEvent();
+void serverFeedReady();
+void serverNotify();
+bool serverWait(int timeoutMillis);
+
+#ifdef FSC_HEADLESS
+void serverSignal(HANDLE event);
+#endif
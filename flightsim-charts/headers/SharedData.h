@@ -0,0 +1,49 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Data written by the server thread and read by the render thread.
+///
+/// Other aircraft are triple buffered. The server fills its own frame
+/// and publishes it by swapping indexes with the latest frame. The render
+/// thread swaps the latest frame for its own if a newer one has been
+/// published. Frames are never copied and neither side can see a frame
+/// the other is still writing.
+///
+/// AI aircraft from the feed are published the same way by the server
+/// thread once it has applied a batch of feed updates. Only the fields
+/// needed to draw and click on them are copied into the frame.
+///
+/// Own aircraft and wind are small and change every sim frame so they are
+/// published with a sequence lock. The render thread reads them once per
+/// update and retries if the server was part way through writing them.
+
+struct OtherFrame {
+    int count;
+    OtherData aircraft[MAX_AIRCRAFT];
+};
+
+struct AiFrameAircraft {
+    Locn loc;
+    double heading;
+    double alt;
+    double speed;
+    int iconType;
+    char callsign[16];
+    char tagText[68];
+};
+
+struct AiFrame {
+    int count;
+    AiFrameAircraft aircraft[Max_AI_Aircraft];
+};
+
+OtherFrame* otherFrameWrite();
+void otherFramePublish();
+OtherFrame* otherFrameRead();
+
+AiFrame* aiFrameWrite();
+void aiFramePublish();
+AiFrame* aiFrameRead();
+
+void ownStatePublish(const LocData* aircraft, const WindData* wind);
+void ownStateRead(LocData* aircraft, WindData* wind);
@@ -0,0 +1,36 @@
+#pragma once
+#include "flightsim-charts.h"
+
+/// Uniform lat/lon grid used to find the items that may be on the display
+/// without projecting every one of them. The grid covers the bounding box
+/// of the items it was built from. Cells are stored as a start table into
+/// a single list of item indexes. Item storage only grows so rebuilding
+/// a grid of the same size or smaller never allocates.
+
+const int MaxGridSide = 128;
+
+struct LocnArea {
+    double minLat;
+    double maxLat;
+    double minLon;
+    double maxLon;
+};
+
+struct SpatialGrid {
+    double minLat;
+    double minLon;
+    double cellLat;     // Cell size in degrees
+    double cellLon;
+    int rows;
+    int cols;
+    int count;
+    int allocated;
+    int cellStart[MaxGridSide * MaxGridSide + 1];
+    int* item;
+    int* found;         // Results of the last query
+    int* scratch;
+};
+
+void gridBuild(SpatialGrid* grid, const Locn* firstLoc, int stride, int count);
+int gridQuery(SpatialGrid* grid, const LocnArea* areas, int areaCount);
+void gridCleanup(SpatialGrid* grid);
@@ -0,0 +1,19 @@
+#pragma once
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+
+/// Tags that change often (other aircraft, AI and the measuring line) are
+/// queued while a frame is drawn and then drawn together, in runs of tags
+/// that don't overlap. A run's backgrounds go in a single al_draw_prim
+/// call and its text is drawn with bitmap drawing held. Every glyph comes
+/// from the builtin font's one bitmap, so the text of a run goes out in a
+/// single batch and no per-tag bitmaps are needed. Overlapping tags still
+/// cover each other in the order they were queued.
+
+const int TagHeight = 10;
+
+int tagWidth(const char* text);
+void textLayerInit(ALLEGRO_FONT* font);
+void textLayerCleanup();
+void queueTag(const char* text, float x, float y, bool isMeasure = false);
+void drawQueuedTags();
@@ -0,0 +1,61 @@
+#pragma once
+#include "Platform.h"
+
+/// The parts of drawing a chart from tiles that don't need Allegro: the
+/// size of each level of the pyramid, which level and tiles cover the
+/// view, which cached tile to evict, halving one level's pixels to make
+/// the next and checking a tile cache file before it is used. See
+/// ChartTiles.h.
+
+const int TileSize = 512;
+const int MaxTileLevels = 16;
+const int MaxCachedTiles = 96;
+const char TileCacheExt[] = ".tiles";
+const int TileCacheVersion = 1;
+
+/// Tile cache file layout, all values little-endian:
+///   TileCacheHeader
+///   TileCacheLevel for each level
+///   TileCacheEntry for each tile of level 0, then level 1 etc.
+///   PNG data for each tile
+struct TileCacheHeader {
+    char magic[4];
+    int version;
+    ULONGLONG chartSize;
+    ULONGLONG chartTime;
+    int width;
+    int height;
+    int levels;
+    int reserved;
+};
+
+struct TileCacheLevel {
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+};
+
+struct TileCacheEntry {
+    ULONGLONG offset;
+    int size;
+    int reserved;
+};
+
+struct CachedTile {
+    ALLEGRO_BITMAP* bmp;    // Video bitmap
+    int level;
+    int tile;
+    unsigned int lastUsed;
+};
+
+void tileLevelSize(TileCacheLevel* level, int width, int height);
+int tilePyramid(int width, int height, TileCacheLevel* levels);
+int tileChooseLevel(double viewWidth, int displayWidth, int levels);
+void tileRange(int tilesX, int tilesY, int levelNum, double viewX, double viewY, double viewWidth, double viewHeight,
+    int* tx1, int* ty1, int* tx2, int* ty2);
+int tileEvictSlot(const CachedTile* cache);
+void halvePixels(const unsigned char* from, int fromPitch, int srcWidth, int srcHeight, unsigned char* to, int toPitch);
+char* tileCacheFile(const char* filename);
+void tileCacheHeaderInit(TileCacheHeader* header, ULONGLONG chartSize, ULONGLONG chartTime, int width, int height, int levels);
+const TileCacheEntry* tileCacheIndex(const unsigned char* data, ULONGLONG size, ULONGLONG chartSize, ULONGLONG chartTime);
@@ -1,6 +1,5 @@
 #pragma once
-#include <allegro5/allegro.h>
-#include <allegro5/allegro_image.h>
+#include "Platform.h"
 
 // Constants
 const int MAX_AIRCRAFT = 800;
@@ -14,18 +13,18 @@ const char DefaultChart[] = "Airport Charts\\London & Surrounding Area.png";
 const int DefaultFPS = 8;
 const char DegreesSymbol[] = "\xC2\xB0";
 
-const char Airliner[] = "_A20_A21_A30_A31_A32_A33_BCS_B38_B73_B75_B76_E19_E29_E75_";
-const char Large_Airliner[] = "_A34_A35_A38_A3S_B74_B77_B78_";
+constexpr char Airliner[] = "_A20_A21_A30_A31_A32_A33_BCS_B38_B73_B75_B76_E19_E29_E75_";
+constexpr char Large_Airliner[] = "_A34_A35_A38_A3S_B74_B77_B78_";
 
-const char Heli[] = "_A10_A13_A16_A18_AS5_B06_B50_B17_CLO_EC3_EC4_EC5_EC7_EXP_G2C_MM1_R22_R44_R66_S76_WAS_";
-const char Jet[] = "_AST_BE4_C25_C51_C52_C55_C56_C68_C75_CL3_CL6_CRJ_E13_E14_E35_E50_E55_EA5_F2T_F90_FA2_FA7_FA8_G28_GA5_GA6_GAL_GL5_GL7_GLE_GLF_H25_HDJ_LJ3_LJ7_PC2_PRM_";
-const char Turboprop[] = "_AT4_AT7_B35_BE2_D22_D32_DH8_DHC_P18_SC7_SF3_C303_";
+constexpr char Heli[] = "_A10_A13_A16_A18_AS5_B06_B50_B17_CLO_EC3_EC4_EC5_EC7_EXP_G2C_MM1_R22_R44_R66_S76_WAS_";
+constexpr char Jet[] = "_AST_BE4_C25_C51_C52_C55_C56_C68_C75_CL3_CL6_CRJ_E13_E14_E35_E50_E55_EA5_F2T_F90_FA2_FA7_FA8_G28_GA5_GA6_GAL_GL5_GL7_GLE_GLF_H25_HDJ_LJ3_LJ7_PC2_PRM_";
+constexpr char Turboprop[] = "_AT4_AT7_B35_BE2_D22_D32_DH8_DHC_P18_SC7_SF3_C303_";
 
-const char Military_Heli[] = "_H47_H64_LYN_PUM_UGLY1_"; // UGLY = Apache
-const char Military_Jet[] = "_SB3_F15_HAW_HUN_REDAR_";  // REDAR = Red Arrow
-const char Military_Small[] = "_SPI_GTCHI_P51_FUR_";    // GTCHI = Spitfire
-const char Military_Other[] = "_A40_B52_C13_C30_E39_E3C_K35_LAN_";
-const char Military_Other2[] = "_C17_";                 // Matches full model only (to stop it matching, e.g. C172)
+constexpr char Military_Heli[] = "_H47_H64_LYN_PUM_UGLY1_"; // UGLY = Apache
+constexpr char Military_Jet[] = "_SB3_F15_HAW_HUN_REDAR_";  // REDAR = Red Arrow
+constexpr char Military_Small[] = "_SPI_GTCHI_P51_FUR_";    // GTCHI = Spitfire
+constexpr char Military_Other[] = "_A40_B52_C13_C30_E39_E3C_K35_LAN_";
+constexpr char Military_Other2[] = "_C17_";                 // Matches full model only (to stop it matching, e.g. C172)
 
 struct Position {
     int x;
@@ -116,11 +115,18 @@ struct OtherData {
     char model[32];
 };
 
+/// Drawn by the text layer so only the text is kept
 struct TagData {
     char tagText[68];
-    DrawData tag;
     char moreTagText[68];
-    DrawData moreTag;
+};
+
+/// Icon type of another aircraft, only classified again when the
+/// aircraft in its slot has a different callsign or model
+struct OtherIcon {
+    char callsign[32];
+    char model[32];
+    int iconType;
 };
 
 struct ChartData {
@@ -147,6 +153,7 @@ struct Settings {
     bool showInstrumentHud = true;
     bool showAlwaysOnTop = false;
     bool showMiniMenu = false;
+    bool autoFollowChart = false;
 };
 
 struct CalibratedData {
@@ -215,6 +222,8 @@ struct AI_Aircraft {
     time_t lastUpdated;
     DWORD objectId;
     TagData tagData;
+    int iconType;       // From classifyIcon
+    unsigned int resync;    // Last full resync it was sent in
 };
 
 struct AI_Fixed {
@@ -267,6 +276,7 @@ struct VrpData {
 struct ObstacleData {
     char name[32];
     char elevation[16];
+    int elevationFt;
     Locn loc;
     DrawData tag;
     DrawData moreTag;
@@ -279,6 +289,6 @@ const int Max_AI_ModelMatch = 25000;
 // Prototypes
 int showMessage(const char* message, bool isError, const char* title = NULL, bool canCancel = false);
 void createTagText(char* callsign, char* model, char* tagText);
-void createTagBitmap(char *tagText, DrawData* tag, bool isMeasure = false, bool isElevation = false);
+void createTagBitmap(struct LabelAtlas* atlas, char *tagText, DrawData* tag, bool isMeasure = false, bool isElevation = false);
 void cleanupBitmap(ALLEGRO_BITMAP* bmp);
 void cleanupTagBitmap(DrawData* tag);
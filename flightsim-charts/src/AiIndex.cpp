@@ -0,0 +1,156 @@
+#include <string.h>
+#include "AiIndex.h"
+
+/// Lookups happen once per line of every fr24 payload (thousands of
+/// lines every few seconds) and once per aircraft in every SimConnect
+/// REQ_ALL response so they need to be cheap.
+
+/// <summary>
+/// Convert a callsign into a fixed width key.
+/// Returns false if the callsign is empty or too long to be a key.
+/// </summary>
+bool aiMakeKey(const char* callsign, AiKey* key)
+{
+    size_t len = strlen(callsign);
+    if (len == 0 || len >= AiKeySize) {
+        return false;
+    }
+
+    memset(key->text, 0, AiKeySize);
+    memcpy(key->text, callsign, len);
+    return true;
+}
+
+unsigned int aiKeyHash(const AiKey* key)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < AiKeySize && key->text[i] != '\0'; i++) {
+        hash ^= (unsigned char)key->text[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// <summary>
+/// Returns the position in the slot table of the key or of the empty
+/// slot where it should be inserted.
+/// </summary>
+int aiIndexProbe(AiIndex* index, const AiKey* key)
+{
+    int mask = index->size - 1;
+    int pos = aiKeyHash(key) & mask;
+
+    while (index->slots[pos].key.text[0] != '\0') {
+        if (memcmp(index->slots[pos].key.text, key->text, AiKeySize) == 0) {
+            break;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return pos;
+}
+
+void aiIndexClear(AiIndex* index)
+{
+    memset(index->slots, 0, sizeof(AiIndexSlot) * index->size);
+    index->count = 0;
+}
+
+/// <summary>
+/// Returns the table slot for the callsign or -1 if not found.
+/// </summary>
+int aiIndexFind(AiIndex* index, const char* callsign)
+{
+    AiKey key;
+    if (index->count == 0 || !aiMakeKey(callsign, &key)) {
+        return -1;
+    }
+
+    int pos = aiIndexProbe(index, &key);
+    if (index->slots[pos].key.text[0] == '\0') {
+        return -1;
+    }
+
+    return index->slots[pos].slot;
+}
+
+/// <summary>
+/// Add the callsign or change the table slot it points to.
+/// </summary>
+bool aiIndexSet(AiIndex* index, const char* callsign, int slot)
+{
+    AiKey key;
+    if (!aiMakeKey(callsign, &key)) {
+        return false;
+    }
+
+    int pos = aiIndexProbe(index, &key);
+    if (index->slots[pos].key.text[0] == '\0') {
+        // Always keep at least one empty slot so probes terminate
+        if (index->count >= index->size - 1) {
+            return false;
+        }
+        index->slots[pos].key = key;
+        index->count++;
+    }
+
+    index->slots[pos].slot = slot;
+    return true;
+}
+
+bool aiIndexRemove(AiIndex* index, const char* callsign)
+{
+    AiKey key;
+    if (index->count == 0 || !aiMakeKey(callsign, &key)) {
+        return false;
+    }
+
+    int mask = index->size - 1;
+    int pos = aiIndexProbe(index, &key);
+    if (index->slots[pos].key.text[0] == '\0') {
+        return false;
+    }
+
+    // Shift back any following entries that would no longer be
+    // reachable from their home position (no tombstones needed).
+    int next = (pos + 1) & mask;
+    while (index->slots[next].key.text[0] != '\0') {
+        int home = aiKeyHash(&index->slots[next].key) & mask;
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            index->slots[pos] = index->slots[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    index->slots[pos].key.text[0] = '\0';
+    index->count--;
+    return true;
+}
+
+/// <summary>
+/// Remove the aircraft marked for removal (lastUpdated is 0) in a single
+/// pass. Survivors are moved down over the removed aircraft so each one
+/// is copied at most once and they stay in the same order. The index is
+/// kept pointing at the new slots. Returns the new count.
+/// </summary>
+int aiCompact(AI_Aircraft* aircraft, int count, AiIndex* index)
+{
+    int keep = 0;
+    for (int i = 0; i < count; i++) {
+        if (aircraft[i].lastUpdated == 0) {
+            aiIndexRemove(index, aircraft[i].callsign);
+        }
+        else {
+            if (keep < i) {
+                memcpy(&aircraft[keep], &aircraft[i], sizeof(AI_Aircraft));
+                aiIndexSet(index, aircraft[keep].callsign, keep);
+            }
+            keep++;
+        }
+    }
+
+    return keep;
+}
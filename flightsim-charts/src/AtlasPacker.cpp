@@ -0,0 +1,79 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "AtlasPacker.h"
+
+
+/// <summary>
+/// Find room on a page. Uses the first shelf of the right height with
+/// space left, otherwise starts a new shelf. Returns false if it's full.
+/// </summary>
+bool findSpace(AtlasPage* page, int width, int height, int* x, int* y)
+{
+    for (int i = 0; i < page->shelfCount; i++) {
+        AtlasShelf* shelf = &page->shelf[i];
+        if (shelf->height == height && shelf->used + width <= AtlasPageSize) {
+            *x = shelf->used;
+            *y = shelf->y;
+            shelf->used += width;
+            return true;
+        }
+    }
+
+    int nextY = 0;
+    if (page->shelfCount > 0) {
+        AtlasShelf* last = &page->shelf[page->shelfCount - 1];
+        nextY = last->y + last->height;
+    }
+
+    if (page->shelfCount == MaxAtlasShelves || nextY + height > AtlasPageSize) {
+        return false;
+    }
+
+    AtlasShelf* shelf = &page->shelf[page->shelfCount];
+    shelf->y = nextY;
+    shelf->height = height;
+    shelf->used = width;
+    page->shelfCount++;
+
+    *x = 0;
+    *y = nextY;
+    return true;
+}
+
+/// <summary>
+/// Find room for a label, adding a page if none of the existing ones have
+/// space. A new page has no bitmap yet. Returns false if the label is
+/// too big or the atlas is full.
+/// </summary>
+bool atlasPlace(LabelAtlas* atlas, int width, int height, int* pageNum, int* x, int* y)
+{
+    if (width > AtlasPageSize || height > AtlasPageSize) {
+        return false;
+    }
+
+    for (int i = 0; i < atlas->pageCount; i++) {
+        if (findSpace(atlas->page[i], width, height, x, y)) {
+            *pageNum = i;
+            return true;
+        }
+    }
+
+    if (atlas->pageCount == MaxAtlasPages) {
+        return false;
+    }
+
+    AtlasPage* page = (AtlasPage*)malloc(sizeof(AtlasPage));
+    if (page == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    page->bmp = NULL;
+    page->shelfCount = 0;
+    *pageNum = atlas->pageCount;
+    atlas->page[atlas->pageCount] = page;
+    atlas->pageCount++;
+
+    return findSpace(page, width, height, x, y);
+}
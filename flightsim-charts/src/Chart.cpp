@@ -10,6 +10,16 @@
 #include "ChartCoords.h"
 #include "ChartFlightPlan.h"
 #include "ChartServer.h"
+#include "ServerWait.h"
+#include "SharedData.h"
+#include "SpatialGrid.h"
+#include "LayerLod.h"
+#include "ChartTiles.h"
+#include "ChartLoader.h"
+#include "TextLayer.h"
+#include "LabelAtlas.h"
+#include "IconClass.h"
+#include "Profiler.h"
 
 // Constants
 const char ProgramName[] = "FlightSim Charts";
@@ -37,16 +47,13 @@ const char ArrowFile[] = "images/arrow.png";
 const int MinScale = 5;
 const int InitScale = 40;
 const int MaxScale = 200;
+const int ChartFollowAheadMins = 5;
+const double ChartSwitchMargin = 0.9;
 
 // Externals
 extern bool _quit;
-extern LocData _aircraftData;
-extern WindData _windData;
-extern OtherData _otherAircraftData[MAX_AIRCRAFT];
 extern char* _chartServer;
 extern ChartServerData _chartServerData;
-extern int _otherAircraftCount;
-extern int _otherDataSize;
 extern TeleportData _teleport;
 extern SnapshotData _snapshot;
 extern FollowData _follow;
@@ -57,8 +64,6 @@ extern bool _noConnect;
 extern int _aiFixedCount;
 extern AI_Fixed _aiFixed[Max_AI_Fixed];
 extern bool _connected;
-extern int _aiAircraftCount;
-extern AI_Aircraft _aiAircraft[Max_AI_Aircraft];
 extern AI_Trail _aiTrail[3];
 extern char _watchCallsign[16];
 extern bool _watchInProgress;
@@ -77,6 +82,7 @@ int _displayHeight;
 HWND _displayWindow;
 int _winCheckDelay = 0;
 DrawData _chart;
+ChartTiles _chartTiles;
 DrawData _view;
 AircraftDrawData _aircraft;
 DrawData _aircraftLabel;
@@ -98,17 +104,20 @@ ChartData _chartData;
 HANDLE _bmpMutex = NULL;
 Settings _settings;
 ALLEGRO_MOUSE_STATE _mouse;
-OtherData _snapshotOtherData[MAX_AIRCRAFT];
-int _snapshotOtherCount;
+LocData _aircraftData;
+WindData _windData;
+OtherFrame* _otherSnapshot;
+AiFrame* _aiSnapshot;
+int _aiVisible[Max_AI_Aircraft];
+SpatialGrid _otherGrid;
+SpatialGrid _aiGrid;
 TagData _otherTag[MAX_AIRCRAFT];
-TagData _oldTag[MAX_AIRCRAFT];
-int _tagCount = 0;
-int _tagDataSize = sizeof(TagData);
-int _drawDataSize = sizeof(DrawData);
+OtherIcon _otherIcon[MAX_AIRCRAFT];
 int _mouseStartZ = 0;
 int _titleState;
 int _titleDelay;
 bool _showCalibration = false;
+bool _showTimings = false;
 Locn _clickedLoc;
 Position _clickedPos;
 Position _clipboardPos;
@@ -128,15 +137,32 @@ TagData _measureTag;
 bool _ignoreNextRelease;
 char _aiHome[256];
 char _previousChart[512];
+bool _chartLoading = false;
+bool _loadingSetsPrevious = false;
+char _loadingPrevious[512];
+CalibratedData* _chartCatalogue = NULL;
+int _chartCatalogueCount = 0;
+int _chartFollowDelay = 0;
+char _prefetchedChart[256];
 FlightPlanData _flightPlan[MAX_FLIGHT_PLAN];
 int _flightPlanCount = 0;
 VrpData* _vrps;
 int _vrpCount = 0;
+SpatialGrid _vrpGrid;
+LayerLod _vrpLod;
 ObstacleData* _obstacles;
 int _obstacleCount = 0;
+SpatialGrid _obstacleGrid;
+LayerLod _obstacleLod;
 bool _showObstacleNames = false;
 ElevationData* _elevations;
 int _elevationCount = 0;
+SpatialGrid _elevationGrid;
+ChartBatch _drawBatch;
+LabelAtlas _flightPlanLabels;
+LabelAtlas _elevationLabels;
+LabelAtlas _obstacleLabels;
+LabelAtlas _vrpLabels;
 int _hudUpdate = -1;
 bool hudShowBrake = false;
 
@@ -147,6 +173,7 @@ enum MENU_ITEMS {
     MENU_LOAD_CLOSEST_TO_AIRCRAFT,
     MENU_LOAD_CLOSEST_TO_HERE,
     MENU_LOAD_CLOSEST_TO_CLIPBOARD,
+    MENU_LOAD_AUTO_FOLLOW,
     MENU_LOCATE_AIRCRAFT,
     MENU_FIX_CRASH,
     MENU_INCREASE_ALTITUDE,
@@ -180,6 +207,7 @@ enum MENU_ITEMS {
     MENU_CLEAR_AI_TRAILS,
     MENU_SHOW_CALIBRATION,
     MENU_SHOW_INSTRUMENT_HUD,
+    MENU_SHOW_TIMINGS,
     MENU_SHOW_MINI_MENU,
     MENU_SHOW_ALWAYS_ON_TOP,
     MENU_LOAD_FLIGHT_PLAN,
@@ -194,7 +222,9 @@ enum MENU_ITEMS {
 void newChart();
 void closestChart(Locn* loc);
 void clearCustomPoints();
-bool initChart();
+void loadChart(const char* filename, const char* previousChart);
+void calibratedChartFile(CalibratedData* calib, char* chart);
+void refreshChartCatalogue();
 
 
 int showMessage(const char *message, bool isError, const char *title, bool canCancel)
@@ -275,6 +305,8 @@ void cancelCalibration()
         // Chart still needs calibrating
         _chartData.state = -1;
     }
+
+    updateChartTransform();
 }
 
 void updateWindowTitle()
@@ -362,6 +394,8 @@ void updateWindowTitle()
 /// </summary>
 void initVars()
 {
+    _otherSnapshot = otherFrameRead();
+    _aiSnapshot = aiFrameRead();
     _chart.bmp = NULL;
     _view.bmp = NULL;
     _aircraft.bmp = NULL;
@@ -419,8 +453,10 @@ void initVars()
     *_closestAircraft = '\0';
     _measureStartPos.x = MAXINT;
     _altHomeLoc.lat = MAXINT;
-    _measureTag.tag.bmp = NULL;
+    *_measureTag.moreTagText = '\0';
     *_previousChart = '\0';
+    *_prefetchedChart = '\0';
+    _aircraftData.loc.lat = MAXINT;
     _windData.direction = -1;
 }
 
@@ -432,20 +468,20 @@ void findClosestAircraft(Locn* loc)
     *_closestAircraft = '\0';
 
     double closest = MAXINT;
-    for (int i = 0; i < _otherAircraftCount; i++) {
+    for (int i = 0; i < _otherSnapshot->count; i++) {
         // Exclude self
         if (strcmp(_tagText, _otherTag[i].tagText) == 0) {
             continue;
         }
 
         // Exclude static aircraft
-        if (strcmp(_otherAircraftData[i].callsign, "ASXGSA") == 0 || strcmp(_otherAircraftData[i].callsign, "AS-MTP2") == 0) {
+        if (strcmp(_otherSnapshot->aircraft[i].callsign, "ASXGSA") == 0 || strcmp(_otherSnapshot->aircraft[i].callsign, "AS-MTP2") == 0) {
             continue;
         }
 
-        double distance = greatCircleDistance(loc, &_otherAircraftData[i].loc);
+        double distance = greatCircleDistance(loc, &_otherSnapshot->aircraft[i].loc);
         if (closest > distance) {
-            strcpy(_closestAircraft, _otherAircraftData[i].callsign);
+            strcpy(_closestAircraft, _otherSnapshot->aircraft[i].callsign);
             closest = distance;
         }
     }
@@ -459,6 +495,7 @@ HMENU createMenu()
     AppendMenu(loadMenu, MF_STRING, MENU_LOAD_CLOSEST_TO_AIRCRAFT, "Closest to aircraft");
     AppendMenu(loadMenu, MF_STRING, MENU_LOAD_CLOSEST_TO_HERE, "Closest to here");
     AppendMenu(loadMenu, MF_STRING, MENU_LOAD_CLOSEST_TO_CLIPBOARD, "Closest to clipboard location");
+    AppendMenu(loadMenu, MF_STRING, MENU_LOAD_AUTO_FOLLOW, "Auto follow aircraft");
 
     HMENU rotateMenu = CreatePopupMenu();
     AppendMenu(rotateMenu, MF_STRING, MENU_ROTATE_180, "180");
@@ -499,6 +536,7 @@ HMENU createMenu()
     }
     AppendMenu(showMenu, MF_STRING, MENU_SHOW_CALIBRATION, "Show calibration");
     AppendMenu(showMenu, MF_STRING, MENU_SHOW_INSTRUMENT_HUD, "Show instrument HUD");
+    AppendMenu(showMenu, MF_STRING, MENU_SHOW_TIMINGS, "Show timings");
     AppendMenu(showMenu, MF_STRING, MENU_SHOW_MINI_MENU, "Show mini menu");
     AppendMenu(showMenu, MF_STRING, MENU_SHOW_ALWAYS_ON_TOP, "Always on top");
 
@@ -592,6 +630,7 @@ void updateMenu(HMENU menu)
     EnableMenuItem(menu, MENU_LOAD_CLOSEST_TO_AIRCRAFT, enabledState(active));
     EnableMenuItem(menu, MENU_LOAD_CLOSEST_TO_HERE, enabledState(calibrated));
     EnableMenuItem(menu, MENU_LOAD_CLOSEST_TO_CLIPBOARD, enabledState(calibrated));
+    CheckMenuItem(menu, MENU_LOAD_AUTO_FOLLOW, checkedState(_settings.autoFollowChart));
     EnableMenuItem(menu, MENU_LOCATE_AIRCRAFT, enabledState(active && calibrated));
     EnableMenuItem(menu, MENU_FIX_CRASH, enabledState(active && calibrated && !_teleport.inProgress));
     EnableMenuItem(menu, MENU_ROTATE_AGAIN, enabledState(active && !_teleport.inProgress && _lastRotate != MAXINT));
@@ -637,6 +676,7 @@ void updateMenu(HMENU menu)
     CheckMenuItem(menu, MENU_SHOW_TAGS, checkedState(_settings.showTags));
     CheckMenuItem(menu, MENU_SHOW_CALIBRATION, checkedState(_showCalibration));
     CheckMenuItem(menu, MENU_SHOW_INSTRUMENT_HUD, checkedState(_settings.showInstrumentHud));
+    CheckMenuItem(menu, MENU_SHOW_TIMINGS, checkedState(_showTimings));
 
     EnableMenuItem(menu, MENU_SHOW_MINI_MENU, MF_ENABLED);
     EnableMenuItem(menu, MENU_SHOW_ALWAYS_ON_TOP, MF_ENABLED);
@@ -719,15 +759,7 @@ void actionMenuItem()
     }
     case MENU_LOAD_PREVIOUS:
     {
-        char currentChart[512];
-        strcpy(currentChart, _settings.chart);
-        strcpy(_settings.chart, _previousChart);
-        strcpy(_previousChart, currentChart);
-
-        if (initChart()) {
-            // Save the last loaded chart name
-            saveSettings();
-        }
+        loadChart(_previousChart, _settings.chart);
         _showCalibration = false;
         break;
     }
@@ -757,6 +789,17 @@ void actionMenuItem()
         }
         break;
     }
+    case MENU_LOAD_AUTO_FOLLOW:
+    {
+        _settings.autoFollowChart = !_settings.autoFollowChart;
+        saveSettings();
+
+        // Pick up any charts calibrated since last time
+        if (_settings.autoFollowChart) {
+            refreshChartCatalogue();
+        }
+        break;
+    }
     case MENU_LOCATE_AIRCRAFT:
     {
         // Centre chart on current aircraft location
@@ -1047,6 +1090,11 @@ void actionMenuItem()
         saveSettings();
         break;
     }
+    case MENU_SHOW_TIMINGS:
+    {
+        _showTimings = !_showTimings;
+        break;
+    }
     case MENU_SHOW_MINI_MENU:
     {
         _settings.showMiniMenu = !_settings.showMiniMenu;
@@ -1108,6 +1156,7 @@ void actionMenuItem()
     case MENU_RECALIBRATE:
     {
         _chartData.state = 0;
+        updateChartTransform();
         _showCalibration = false;
         break;
     }
@@ -1159,6 +1208,8 @@ bool init()
         return false;
     }
 
+    textLayerInit(_font);
+
     al_set_new_window_title("FlightSim Charts");
 
     // Use existing desktop resolution/refresh rate
@@ -1265,7 +1316,11 @@ void cleanupTagBitmap(DrawData *tag)
 /// </summary>
 void cleanup()
 {
-    cleanupBitmap(_chart.bmp);
+    chartLoaderCleanup();
+    if (_chartCatalogue) {
+        free(_chartCatalogue);
+    }
+    tilesCleanup(&_chartTiles);
     cleanupBitmap(_view.bmp);
     cleanupBitmap(_aircraft.bmp);
     cleanupBitmap(_aircraft.smallBmp);
@@ -1296,22 +1351,10 @@ void cleanup()
     cleanupBitmap(_instrumentHudCopyRight.bmp);
     cleanupBitmap(_instrumentHudBrake.bmp);
     cleanupBitmap(_instrumentHudBrakeCopy.bmp);
-    cleanupTagBitmap(&_measureTag.tag);
+    textLayerCleanup();
+    batchCleanup(&_drawBatch);
 
     // Cleanup tags
-    for (int i = 0; i < _tagCount; i++) {
-        cleanupTagBitmap(&_otherTag[i].tag);
-    }
-
-    for (int i = 0; i < _aiAircraftCount; i++) {
-        cleanupTagBitmap(&_aiAircraft[i].tagData.tag);
-        cleanupTagBitmap(&_aiAircraft[i].tagData.moreTag);
-    }
-
-    for (int i = 0; i < _aiFixedCount; i++) {
-        cleanupTagBitmap(&_aiFixed[i].tagData.tag);
-        cleanupTagBitmap(&_aiFixed[i].tagData.moreTag);
-    }
 
     for (int i = 0; i < _flightPlanCount; i++) {
         cleanupTagBitmap(&_flightPlan[i].tag);
@@ -1320,6 +1363,7 @@ void cleanup()
     clearFlightPlan();
     clearElevations();
     clearObstacles();
+    clearVrps();
 
     if (_bmpMutex) {
         CloseHandle(_bmpMutex);
@@ -1386,35 +1430,82 @@ void resetMap()
     _view.scale = 0;
 }
 
-bool initChart()
+/// <summary>
+/// Start loading a chart in the background. The current chart stays on
+/// display until the new one is ready. If previousChart is supplied it
+/// becomes the previous chart once the new one has loaded.
+/// </summary>
+void loadChart(const char* filename, const char* previousChart)
 {
-    if (*_settings.chart == '\0') {
-        return false;
+    if (*filename == '\0') {
+        return;
     }
 
-    cleanupBitmap(_chart.bmp);
-    _chart.bmp = NULL;
+    _loadingSetsPrevious = previousChart != NULL;
+    if (previousChart) {
+        strcpy(_loadingPrevious, previousChart);
+    }
 
-    _chart.bmp = al_load_bitmap(_settings.chart);
-    if (!_chart.bmp) {
-        char msg[256];
-        sprintf(msg, "Failed to load chart %s\n", _settings.chart);
+    chartLoadRequest(filename);
+    _chartLoading = true;
+
+    const char* name = strrchr(filename, '\\');
+    if (name) {
+        name++;
+    }
+    else {
+        name = filename;
+    }
+
+    char msg[512];
+    sprintf(msg, "%s - Loading %s", ProgramName, name);
+    showTitleMessage(msg);
+}
+
+/// <summary>
+/// Swap in a chart that has finished loading along with its calibration.
+/// </summary>
+void checkChartLoaded()
+{
+    static LoadedChart loaded;
+
+    if (!_chartLoading || !chartLoadCollect(&loaded)) {
+        return;
+    }
+
+    _chartLoading = false;
+
+    if (!loaded.ok) {
+        char msg[512];
+        sprintf(msg, "Failed to load chart %s\n", loaded.filename);
         showMessage(msg, true);
-        *_settings.chart = '\0';
-        return false;
+
+        if (_chartTiles.levels == 0) {
+            // Nothing to show so ask for another chart
+            *_settings.chart = '\0';
+        }
+        _titleState = -2;
+        return;
     }
 
-    _chart.width = al_get_bitmap_width(_chart.bmp);
-    _chart.height = al_get_bitmap_height(_chart.bmp);
+    tilesCleanup(&_chartTiles);
+    _chartTiles = loaded.tiles;
+    _chartData = loaded.chartData;
+    updateChartTransform();
+    strcpy(_settings.chart, loaded.filename);
+
+    _chart.width = _chartTiles.width;
+    _chart.height = _chartTiles.height;
 
     // Centre map and zoom fully out
     resetMap();
-
     _titleState = -2;
-    _chartData.state = -1;
-    loadCalibrationData(&_chartData);
 
-    return true;
+    // Save the last loaded chart name
+    saveSettings();
+    if (_loadingSetsPrevious) {
+        strcpy(_previousChart, _loadingPrevious);
+    }
 }
 
 bool initAircraft()
@@ -1733,47 +1824,40 @@ void drawOwnAircraft()
     }
 }
 
-void getIconData(char *model, char *callsign, int altitude, IconData* iconData, int wingSpan)
+/// <summary>
+/// Icon type is worked out once per aircraft by classifyIcon. Only
+/// altitude and wingspan can change which icon gets drawn after that.
+/// </summary>
+void getIconData(int iconType, int altitude, IconData* iconData, int wingSpan)
 {
     iconData->halfWidth = _aircraft.smallHalfWidth;
     iconData->halfHeight = _aircraft.smallHalfHeight;
     iconData->isMilitary = false;
 
-    if (strlen(model) > 5) {
+    if ((iconType & IconGround) && altitude < 50) {
+        iconData->bmp = _aircraft.vehicleBmp;
+        return;
+    }
+
+    switch (iconType & IconTypeMask) {
+    case ICON_LONG_MODEL:
         if (wingSpan <= WINGSPAN_SMALL) {
             iconData->bmp = _aircraft.smallOtherBmp;
-            return;
         }
-
-        iconData->halfWidth = _aircraft.smallHalfWidth;
-        iconData->halfHeight = _aircraft.smallHalfHeight;
-        iconData->bmp = _aircraft.otherBmp;
+        else {
+            iconData->bmp = _aircraft.otherBmp;
+        }
         return;
-    }
 
-    if (strcmp(model, "GLID") == 0 || strcmp(model, "DISC") == 0) {
+    case ICON_GLIDER:
         iconData->bmp = _aircraft.gliderOtherBmp;
         return;
-    }
-
-    if (strcmp(model, "GRND") == 0 && altitude < 50) {
-        iconData->bmp = _aircraft.vehicleBmp;
-        return;
-    }
 
-    char prefixShort[8];
-    char prefixModel[8];
-    char prefixCallsign[8];
-    sprintf(prefixShort, "_%.3s_", model);
-    sprintf(prefixModel, "_%.4s_", model);
-    sprintf(prefixCallsign, "_%.5s_", callsign);
-
-    if (strstr(Heli, prefixShort) != NULL) {
+    case ICON_HELI:
         iconData->bmp = _aircraft.helicopterOtherBmp;
         return;
-    }
 
-    if (strstr(Turboprop, prefixShort) != NULL || strstr(Turboprop, prefixModel) != NULL) {
+    case ICON_TURBOPROP:
         iconData->bmp = _aircraft.turbopropOtherBmp;
         return;
     }
@@ -1781,40 +1865,35 @@ void getIconData(char *model, char *callsign, int altitude, IconData* iconData,
     iconData->halfWidth = _aircraft.halfWidth;
     iconData->halfHeight = _aircraft.halfHeight;
 
-    if (strstr(Airliner, prefixShort) != NULL) {
+    switch (iconType & IconTypeMask) {
+    case ICON_AIRLINER:
         iconData->bmp = _aircraft.otherBmp;
         return;
-    }
 
-    if (strstr(Large_Airliner, prefixShort) != NULL) {
+    case ICON_LARGE_AIRLINER:
         iconData->bmp = _aircraft.largeOtherBmp;
         return;
-    }
 
-    if (strstr(Jet, prefixShort) != NULL) {
+    case ICON_JET:
         iconData->bmp = _aircraft.jetOtherBmp;
         return;
-    }
 
-    if (strstr(Military_Heli, prefixShort) != NULL || strstr(Military_Heli, prefixCallsign) != NULL) {
+    case ICON_MILITARY_HELI:
         iconData->bmp = _aircraft.militaryHeliBmp;
         iconData->isMilitary = true;
         return;
-    }
 
-    if (strstr(Military_Jet, prefixShort) != NULL || strstr(Military_Jet, prefixCallsign) != NULL) {
+    case ICON_MILITARY_JET:
         iconData->bmp = _aircraft.militaryJetBmp;
         iconData->isMilitary = true;
         return;
-    }
 
-    if (strstr(Military_Small, prefixShort) != NULL || strstr(Military_Small, prefixCallsign) != NULL) {
+    case ICON_MILITARY_SMALL:
         iconData->bmp = _aircraft.militarySmallBmp;
         iconData->isMilitary = true;
         return;
-    }
 
-    if (strstr(Military_Other, prefixShort) != NULL || strstr(Military_Other2, prefixModel) != NULL) {
+    case ICON_MILITARY_OTHER:
         iconData->bmp = _aircraft.militaryOtherBmp;
         iconData->isMilitary = true;
         return;
@@ -1831,9 +1910,28 @@ void getIconData(char *model, char *callsign, int altitude, IconData* iconData,
     iconData->halfHeight = _aircraft.smallHalfHeight;
 }
 
+/// <summary>
+/// Find the items in the grid that may be between the display positions
+/// so only those need projecting. Returns -1 if they all need checking.
+/// </summary>
+int findVisible(SpatialGrid* grid, Position* displayPos1, Position* displayPos2)
+{
+    if (_chartData.state != 2) {
+        return -1;
+    }
+
+    LocnArea areas[2];
+    int areaCount = chartAreaToLocations(displayPos1, displayPos2, areas);
+    if (areaCount == -1) {
+        return -1;
+    }
+
+    return gridQuery(grid, areas, areaCount);
+}
+
 void drawOtherAircraft()
 {
-    if (_otherAircraftCount == 0) {
+    if (_otherSnapshot->count == 0) {
         return;
     }
 
@@ -1857,15 +1955,23 @@ void drawOtherAircraft()
         _aircraft.scale = 0.14;
     }
 
+    // Only check aircraft in grid cells that overlap the display
+    int visibleCount = findVisible(&_otherGrid, &displayPos1, &displayPos2);
+    int checkCount = visibleCount == -1 ? _otherSnapshot->count : visibleCount;
+
+    batchProject(&_drawBatch, &_otherSnapshot->aircraft[0].loc, sizeof(OtherData), visibleCount == -1 ? NULL : _otherGrid.found, checkCount);
+
     Position pos;
-    for (int i = 0; i < _otherAircraftCount; i++) {
+    for (int n = 0; n < checkCount; n++) {
+        int i = visibleCount == -1 ? n : _otherGrid.found[n];
+
         // Exclude self
         if (strcmp(_tagText, _otherTag[i].tagText) == 0) {
             continue;
         }
 
         // Exclude static aircraft
-        if (strcmp(_otherAircraftData[i].callsign, "ASXGSA") == 0 || strcmp(_otherAircraftData[i].callsign, "AS-MTP2") == 0) {
+        if (strcmp(_otherSnapshot->aircraft[i].callsign, "ASXGSA") == 0 || strcmp(_otherSnapshot->aircraft[i].callsign, "AS-MTP2") == 0) {
             continue;
         }
 
@@ -1874,28 +1980,23 @@ void drawOtherAircraft()
         }
 
         // Don't draw other aircraft if outside the display
-        if (drawOther(&displayPos1, &displayPos2, &_otherAircraftData[i].loc, &pos)) {
+        if (batchDrawOther(&_drawBatch, n, &displayPos1, &displayPos2, &pos)) {
             IconData iconData;
-            getIconData(_otherAircraftData[i].model, _otherAircraftData[i].callsign, _otherAircraftData[i].alt, &iconData, _otherAircraftData[i].wingSpan);
+            getIconData(_otherIcon[i].iconType, _otherSnapshot->aircraft[i].alt, &iconData, _otherSnapshot->aircraft[i].wingSpan);
 
             if (_settings.showAiMilitaryOnly && !iconData.isMilitary) {
                 continue;
             }
 
-            al_draw_scaled_rotated_bitmap(iconData.bmp, iconData.halfWidth, iconData.halfHeight, pos.x, pos.y, _aircraft.scale, _aircraft.scale, _otherAircraftData[i].heading * DegreesToRadians, 0);
+            al_draw_scaled_rotated_bitmap(iconData.bmp, iconData.halfWidth, iconData.halfHeight, pos.x, pos.y, _aircraft.scale, _aircraft.scale, _otherSnapshot->aircraft[i].heading * DegreesToRadians, 0);
 
             if (_settings.showTags) {
-                if (_otherTag[i].tag.bmp != NULL) {
-                    // Draw tag to right of aircraft
-                    al_draw_bitmap(_otherTag[i].tag.bmp, pos.x + 1 + iconData.halfHeight * 1.5 * _aircraft.scale, pos.y - _otherTag[i].tag.height / 2.0, 0);
-
-                    if (_settings.showAiInfoTags) {
-                        // Draw second tag with alt and speed
-                        if (_otherTag[i].moreTag.bmp == NULL) {
-                            createTagBitmap(_otherTag[i].moreTagText, &_otherTag[i].moreTag);
-                        }
-                        al_draw_bitmap(_otherTag[i].moreTag.bmp, pos.x + 1 + iconData.halfHeight * 1.5 * _aircraft.scale, pos.y + _otherTag[i].tag.height / 2.0, 0);
-                    }
+                // Draw tag to right of aircraft
+                queueTag(_otherTag[i].tagText, pos.x + 1 + iconData.halfHeight * 1.5 * _aircraft.scale, pos.y - TagHeight / 2.0);
+
+                if (_settings.showAiInfoTags) {
+                    // Draw second tag with alt and speed
+                    queueTag(_otherTag[i].moreTagText, pos.x + 1 + iconData.halfHeight * 1.5 * _aircraft.scale, pos.y + TagHeight / 2.0);
                 }
             }
         }
@@ -1937,16 +2038,16 @@ void drawAiObjects()
     for (int i = 0; i < 3; i++) {
         if (_aiTrail[i].count > 0) {
             last = i;
+            batchProject(&_drawBatch, &_aiTrail[i].loc[0], sizeof(Locn), NULL, _aiTrail[i].count);
+
+            Position fromPos;
+            batchDrawOther(&_drawBatch, 0, &displayPos1, &displayPos2, &fromPos, true);
 
             for (int j = 1; j < _aiTrail[i].count; j++) {
-                Position fromPos;
                 Position toPos;
-
-                if (drawOther(&displayPos1, &displayPos2, &_aiTrail[i].loc[j - 1], &fromPos, true) &&
-                    drawOther(&displayPos1, &displayPos2, &_aiTrail[i].loc[j], &toPos, true))
-                {
-                    al_draw_line(fromPos.x, fromPos.y, toPos.x, toPos.y, colour, 2);
-                }
+                batchDrawOther(&_drawBatch, j, &displayPos1, &displayPos2, &toPos, true);
+                al_draw_line(fromPos.x, fromPos.y, toPos.x, toPos.y, colour, 2);
+                fromPos = toPos;
             }
         }
     }
@@ -1975,43 +2076,43 @@ void drawAiObjects()
 
     // If we aren't currently connected draw the AI aircraft as they won't be injected
     if (!_connected) {
-        char moreTagText[68];
+        int visibleCount = findVisible(&_aiGrid, &displayPos1, &displayPos2);
+        int checkCount = visibleCount == -1 ? _aiSnapshot->count : visibleCount;
+
+        // Only use indexes that are inside the snapshot being drawn
+        int drawCount = 0;
+        for (int n = 0; n < checkCount; n++) {
+            int i = visibleCount == -1 ? n : _aiGrid.found[n];
+            if (i < _aiSnapshot->count) {
+                _aiVisible[drawCount++] = i;
+            }
+        }
+        batchProject(&_drawBatch, &_aiSnapshot->aircraft[0].loc, sizeof(AiFrameAircraft), _aiVisible, drawCount);
+
+        for (int n = 0; n < drawCount; n++) {
+            AiFrameAircraft* ai = &_aiSnapshot->aircraft[_aiVisible[n]];
 
-        for (int i = 0; i < _aiAircraftCount; i++) {
             // Don't draw aircraft if outside the display
-            if (drawOther(&displayPos1, &displayPos2, &_aiAircraft[i].loc, &pos)) {
+            if (batchDrawOther(&_drawBatch, n, &displayPos1, &displayPos2, &pos)) {
                 IconData iconData;
-                getIconData(_aiAircraft[i].model, _aiAircraft[i].callsign, _aiAircraft[i].alt, &iconData, 0);
+                getIconData(ai->iconType, ai->alt, &iconData, 0);
 
                 if (_settings.showAiMilitaryOnly && !iconData.isMilitary) {
                     continue;
                 }
 
                 try {
-                    al_draw_scaled_rotated_bitmap(iconData.bmp, iconData.halfWidth, iconData.halfHeight, pos.x, pos.y, _aircraft.scale, _aircraft.scale, _aiAircraft[i].heading * DegreesToRadians, 0);
+                    al_draw_scaled_rotated_bitmap(iconData.bmp, iconData.halfWidth, iconData.halfHeight, pos.x, pos.y, _aircraft.scale, _aircraft.scale, ai->heading * DegreesToRadians, 0);
 
                     if (_settings.showTags) {
-                        if (_aiAircraft[i].tagData.tag.bmp == NULL) {
-                            createTagBitmap(_aiAircraft[i].tagData.tagText, &_aiAircraft[i].tagData.tag);
-                        }
-
                         // Draw tag to right of aircraft
-                        al_draw_bitmap(_aiAircraft[i].tagData.tag.bmp, pos.x + 1 + iconData.halfHeight * _aircraft.scale, pos.y - _aiAircraft[i].tagData.tag.height / 2.0, 0);
+                        queueTag(ai->tagText, pos.x + 1 + iconData.halfHeight * _aircraft.scale, pos.y - TagHeight / 2.0);
 
                         if (_settings.showAiInfoTags) {
                             // Add a second tag with alt and speed
-                            sprintf(moreTagText, "%.0lf %.0lf", _aiAircraft[i].alt, _aiAircraft[i].speed);
-                            if (strcmp(_aiAircraft[i].tagData.moreTagText, moreTagText) != 0) {
-                                strcpy(_aiAircraft[i].tagData.moreTagText, moreTagText);
-                                cleanupTagBitmap(&_aiAircraft[i].tagData.moreTag);
-                                _aiAircraft[i].tagData.moreTag.bmp = NULL;
-                            }
-
-                            if (_aiAircraft[i].tagData.moreTag.bmp == NULL) {
-                                createTagBitmap(_aiAircraft[i].tagData.moreTagText, &_aiAircraft[i].tagData.moreTag);
-                            }
-
-                            al_draw_bitmap(_aiAircraft[i].tagData.moreTag.bmp, pos.x + 1 + iconData.halfHeight * _aircraft.scale, pos.y + _aiAircraft[i].tagData.tag.height / 2.0, 0);
+                            char moreTagText[68];
+                            sprintf(moreTagText, "%.0lf %.0lf", ai->alt, ai->speed);
+                            queueTag(moreTagText, pos.x + 1 + iconData.halfHeight * _aircraft.scale, pos.y + TagHeight / 2.0);
                         }
                     }
                 }
@@ -2023,9 +2124,11 @@ void drawAiObjects()
     }
 
     // Draw fixed objects, e.g. airports and waypoints
+    batchProject(&_drawBatch, &_aiFixed[0].loc, sizeof(AI_Fixed), NULL, _aiFixedCount);
+
     for (int i = 0; i < _aiFixedCount; i++) {
         // Don't draw if outside the display
-        if (_aiFixed[i].loc.lat < 99 && drawOther(&displayPos1, &displayPos2, &_aiFixed[i].loc, &pos)) {
+        if (_aiFixed[i].loc.lat < 99 && batchDrawOther(&_drawBatch, i, &displayPos1, &displayPos2, &pos)) {
             ALLEGRO_BITMAP* bmp;
             int halfWidth = _aircraft.smallHalfWidth / 2;
             int halfHeight = _aircraft.smallHalfHeight / 2;
@@ -2057,21 +2160,13 @@ void drawAiObjects()
                 al_draw_scaled_rotated_bitmap(bmp, halfWidth, halfHeight, pos.x, pos.y, _aircraft.scale, _aircraft.scale, _aiFixed[i].heading * DegreesToRadians, 0);
 
                 if (_settings.showTags) {
-                    if (_aiFixed[i].tagData.tag.bmp == NULL) {
-                        createTagBitmap(_aiFixed[i].tagData.tagText, &_aiFixed[i].tagData.tag);
-                    }
-
                     // Draw tag to right
-                    al_draw_bitmap(_aiFixed[i].tagData.tag.bmp, pos.x + tagShift * _aircraft.scale, pos.y - _aiFixed[i].tagData.tag.height / 4, 0);
+                    queueTag(_aiFixed[i].tagData.tagText, pos.x + tagShift * _aircraft.scale, pos.y - TagHeight / 4);
                 }
 
                 if (_settings.showFixedTags && *_aiFixed[i].tagData.moreTagText != '\0') {
-                    if (_aiFixed[i].tagData.moreTag.bmp == NULL) {
-                        createTagBitmap(_aiFixed[i].tagData.moreTagText, &_aiFixed[i].tagData.moreTag);
-                    }
-
                     // Draw tag to right
-                    al_draw_bitmap(_aiFixed[i].tagData.moreTag.bmp, pos.x + tagShift * _aircraft.scale, pos.y + _aiFixed[i].tagData.tag.height * 3 / 4, 0);
+                    queueTag(_aiFixed[i].tagData.moreTagText, pos.x + tagShift * _aircraft.scale, pos.y + TagHeight * 3 / 4);
                 }
             }
             catch (...) {
@@ -2115,58 +2210,144 @@ void drawFlightPlan()
     }
 
     // Add waypoint labels
+    al_hold_bitmap_drawing(true);
     for (int num = 0; num < _flightPlanCount; num++) {
         al_draw_bitmap(_flightPlan[num].tag.bmp, _flightPlan[num].pos.x - 20, _flightPlan[num].pos.y - 5, 0);
     }
+    al_hold_bitmap_drawing(false);
+}
+
+/// <summary>
+/// Get the chart area covered by the display plus a border so labels
+/// drawn to the side of a location aren't lost at the edges.
+/// </summary>
+void getDisplayArea(int border, Position* displayPos1, Position* displayPos2)
+{
+    displayToChartPos(0, 0, displayPos1);
+    displayToChartPos(_displayWidth - 1, _displayHeight - 1, displayPos2);
+
+    double chartBorder = border / _view.scale;
+    displayPos1->x -= chartBorder;
+    displayPos1->y -= chartBorder;
+    displayPos2->x += chartBorder;
+    displayPos2->y += chartBorder;
+}
+
+/// <summary>
+/// Like findVisible but uses a level of detail to suit the zoom so a
+/// zoomed out chart doesn't draw thousands of overlapping labels.
+/// Visible is set to the table indexes found.
+/// </summary>
+int findVisibleLayer(SpatialGrid* grid, LayerLod* lod, int minPixels, Position* displayPos1, Position* displayPos2, int** visible)
+{
+    int level = -1;
+    if (_chartData.state == 2) {
+        level = lodChooseLevel(displayPixelsPerDegree(), minPixels);
+    }
+
+    if (level == -1) {
+        *visible = grid->found;
+        return findVisible(grid, displayPos1, displayPos2);
+    }
+
+    LodLevel* lodLevel = &lod->level[level];
+    int visibleCount = findVisible(&lodLevel->grid, displayPos1, displayPos2);
+
+    // Level items are in table order so this keeps the drawing order
+    for (int n = 0; n < visibleCount; n++) {
+        lodLevel->grid.found[n] = lodLevel->item[lodLevel->grid.found[n]];
+    }
+
+    *visible = lodLevel->grid.found;
+    return visibleCount;
 }
 
 void drawElevations()
 {
-    Position chartPos;
+    Position displayPos1;
+    Position displayPos2;
+    getDisplayArea(50, &displayPos1, &displayPos2);
+
+    int visibleCount = findVisible(&_elevationGrid, &displayPos1, &displayPos2);
+    int drawCount = visibleCount == -1 ? _elevationCount : visibleCount;
+    batchProject(&_drawBatch, &_elevations[0].loc, sizeof(ElevationData), visibleCount == -1 ? NULL : _elevationGrid.found, drawCount);
     Position pos;
 
-    for (int num = 0; num < _elevationCount; num++) {
-        // Draw next elevation
-        locationToChartPos(&_elevations[num].loc, &chartPos);
-        chartToDisplayPos(chartPos.x, chartPos.y, &pos);
+    al_hold_bitmap_drawing(true);
+    for (int n = 0; n < drawCount; n++) {
+        int num = visibleCount == -1 ? n : _elevationGrid.found[n];
 
-        al_draw_bitmap(_elevations[num].tag.bmp, pos.x - 15, pos.y - 5, 0);
+        // Draw next elevation
+        if (batchDrawOther(&_drawBatch, n, &displayPos1, &displayPos2, &pos)) {
+            al_draw_bitmap(_elevations[num].tag.bmp, pos.x - 15, pos.y - 5, 0);
+        }
     }
+    al_hold_bitmap_drawing(false);
 }
 
 void drawVrps()
 {
-    Position chartPos;
+    Position displayPos1;
+    Position displayPos2;
+    getDisplayArea(250, &displayPos1, &displayPos2);
+
+    int* visible;
+    int visibleCount = findVisibleLayer(&_vrpGrid, &_vrpLod, 60, &displayPos1, &displayPos2, &visible);
+    int drawCount = visibleCount == -1 ? _vrpCount : visibleCount;
+    batchProject(&_drawBatch, &_vrps[0].loc, sizeof(VrpData), visibleCount == -1 ? NULL : visible, drawCount);
     Position pos;
 
-    for (int num = 0; num < _vrpCount; num++) {
-        // Draw next VRP
-        locationToChartPos(&_vrps[num].loc, &chartPos);
-        chartToDisplayPos(chartPos.x, chartPos.y, &pos);
+    al_hold_bitmap_drawing(true);
+    for (int n = 0; n < drawCount; n++) {
+        int num = visibleCount == -1 ? n : visible[n];
 
-        al_draw_bitmap(_vrps[num].tag.bmp, pos.x - 30, pos.y - 5, 0);
+        // Draw next VRP
+        if (batchDrawOther(&_drawBatch, n, &displayPos1, &displayPos2, &pos)) {
+            al_draw_bitmap(_vrps[num].tag.bmp, pos.x - 30, pos.y - 5, 0);
+        }
     }
+    al_hold_bitmap_drawing(false);
 }
 
 void drawObstacles()
 {
-    Position chartPos;
+    Position displayPos1;
+    Position displayPos2;
+    getDisplayArea(250, &displayPos1, &displayPos2);
+
+    // Only the tallest obstacle in each area is drawn when zoomed out
+    int* visible;
+    int visibleCount = findVisibleLayer(&_obstacleGrid, &_obstacleLod, 40, &displayPos1, &displayPos2, &visible);
+    int drawCount = visibleCount == -1 ? _obstacleCount : visibleCount;
+    batchProject(&_drawBatch, &_obstacles[0].loc, sizeof(ObstacleData), visibleCount == -1 ? NULL : visible, drawCount);
     Position pos;
 
-    for (int num = 0; num < _obstacleCount; num++) {
-        // Draw next obstacle
-        locationToChartPos(&_obstacles[num].loc, &chartPos);
-        chartToDisplayPos(chartPos.x, chartPos.y, &pos);
+    // Names are created when first needed. Has to be done before
+    // holding drawing as it changes the target bitmap.
+    if (_showObstacleNames) {
+        for (int n = 0; n < drawCount; n++) {
+            int num = visibleCount == -1 ? n : visible[n];
 
-        if (_showObstacleNames) {
             if (_obstacles[num].tag.bmp == NULL) {
-                if (num == 0) {
+                if (n == 0) {
                     al_set_window_title(_display, "Generating Obstacle Names ...");
                     _titleState = -2;
                 }
-                createTagBitmap(_obstacles[num].name, &_obstacles[num].tag, true);
+                createTagBitmap(&_obstacleLabels, _obstacles[num].name, &_obstacles[num].tag, true);
             }
+        }
+    }
+
+    al_hold_bitmap_drawing(true);
+    for (int n = 0; n < drawCount; n++) {
+        int num = visibleCount == -1 ? n : visible[n];
 
+        // Draw next obstacle
+        if (!batchDrawOther(&_drawBatch, n, &displayPos1, &displayPos2, &pos)) {
+            continue;
+        }
+
+        if (_showObstacleNames) {
             al_draw_bitmap(_obstacles[num].tag.bmp, pos.x - 30, pos.y - 10, 0);
             al_draw_bitmap(_obstacles[num].moreTag.bmp, pos.x - 30, pos.y, 0);
         }
@@ -2174,6 +2355,7 @@ void drawObstacles()
             al_draw_bitmap(_obstacles[num].moreTag.bmp, pos.x - 30, pos.y - 5, 0);
         }
     }
+    al_hold_bitmap_drawing(false);
 }
 
 void drawWind()
@@ -2201,14 +2383,51 @@ void drawInstrumentHud()
     }
 }
 
+/// <summary>
+/// Draw recent p50/p99 times of each zone in milliseconds
+/// above the instrument HUD.
+/// </summary>
+void drawTimings()
+{
+    const int LineHeight = 10;
+    const int Width = 26 * 8;
+    int height = (ZONE_COUNT + 1) * LineHeight;
+
+    int x = _displayWidth - Width - 5;
+    int y = _displayHeight - height - 5;
+    if (_settings.showInstrumentHud && !_noConnect) {
+        y -= _instrumentHud.height + 5;
+    }
+
+    al_draw_filled_rectangle(x - 3, y - 3, x + Width + 3, y + height + 1, al_map_rgba(0, 0, 0, 160));
+
+    ALLEGRO_COLOR colour = al_map_rgb(0xff, 0xff, 0xff);
+    al_draw_text(_font, colour, x, y, 0, "Zone           p50    p99");
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++) {
+        y += LineHeight;
+
+        double p50;
+        double p99;
+        if (zonePercentiles(zone, &p50, &p99)) {
+            al_draw_textf(_font, colour, x, y, 0, "%-12s %6.1f %6.1f", zoneName(zone), p50, p99);
+        }
+        else {
+            al_draw_textf(_font, colour, x, y, 0, "%-12s      -      -", zoneName(zone));
+        }
+    }
+}
+
 void render()
 {
-    if (*_settings.chart == '\0') {
+    ZoneTimer timer(ZONE_RENDER);
+
+    if (*_settings.chart == '\0' || _chartTiles.levels == 0) {
         return;
     }
 
     // Draw chart
-    al_draw_scaled_bitmap(_chart.bmp, _view.x, _view.y, _view.width, _view.height, 0, 0, _displayWidth, _displayHeight, 0);
+    tilesDraw(&_chartTiles, _view.x, _view.y, _view.width, _view.height, _displayWidth, _displayHeight);
 
     // Draw other aircraft
     drawOtherAircraft();
@@ -2235,6 +2454,9 @@ void render()
         drawElevations();
     }
 
+    // All the tags go on top in one batch
+    drawQueuedTags();
+
     // Draw aircraft
     drawOwnAircraft();
 
@@ -2294,15 +2516,10 @@ void render()
         double dist = greatCircleDistance(&_measureStartLoc, &measureEndLoc);
         sprintf(_measureTag.moreTagText, "%.1f", dist);
 
-        if (strcmp(_measureTag.tagText, _measureTag.moreTagText) != 0) {
-            strcpy(_measureTag.tagText, _measureTag.moreTagText);
-            cleanupBitmap(_measureTag.tag.bmp);
-            createTagBitmap(_measureTag.tagText, &_measureTag.tag, true);
-        }
-
         ALLEGRO_COLOR colour = al_map_rgb(0x60, 0x40, 0x20);
         al_draw_line(startPos.x, startPos.y, endPos.x, endPos.y, colour, 2);
-        al_draw_bitmap(_measureTag.tag.bmp, midPos.x - 20, midPos.y - 5, 0);
+        queueTag(_measureTag.moreTagText, midPos.x - 20, midPos.y - 5, true);
+        drawQueuedTags();
     }
 
     if (_altHomeLoc.lat != MAXINT) {
@@ -2331,8 +2548,10 @@ void render()
 /// </summary>
 bool doInit()
 {
+    chartLoaderInit();
+
     // Don't fail if no chart loaded yet
-    initChart();
+    loadChart(_settings.chart, NULL);
 
     if (!initAircraft()) {
         return false;
@@ -2370,6 +2589,10 @@ void doRender()
     // Draw chart and aircraft
     render();
 
+    if (_showTimings) {
+        drawTimings();
+    }
+
     // Allegro can detect window resize but not window move so do it here.
     // Only need to check once every second.
     if (_winCheckDelay > 0) {
@@ -2394,9 +2617,6 @@ void doRender()
 /// </summary>
 void newChart()
 {
-    char oldChart[512];
-    strcpy(oldChart, _settings.chart);
-
     al_set_window_title(_display, "Select Chart");
 
     char* newChart = fileSelectorDialog(al_get_win_window_handle(_display), ".png or .jpg\0*.png;*.jpg\0");
@@ -2405,13 +2625,7 @@ void newChart()
         return;
     }
 
-    strcpy(_settings.chart, newChart);
-
-    if (initChart()) {
-        // Save the last loaded chart name
-        saveSettings();
-        strcpy(_previousChart, oldChart);
-    }
+    loadChart(newChart, _settings.chart);
 }
 
 /// <summary>
@@ -2434,28 +2648,97 @@ void closestChart(Locn* loc)
         return;
     }
 
-    char oldChart[512];
-    strcpy(oldChart, _settings.chart);
-
+    char chart[256];
     CalibratedData* closest = findClosestChart(calib, count, loc);
-    strcpy(_settings.chart, closest->filename);
+    calibratedChartFile(closest, chart);
     free(calib);
 
+    loadChart(chart, _settings.chart);
+}
+
+/// <summary>
+/// Sets chart to the chart file that matches a calibration.
+/// </summary>
+void calibratedChartFile(CalibratedData* calib, char* chart)
+{
+    strcpy(chart, calib->filename);
+
     // Chart could be .png or .jpg
-    char* ext = strrchr(_settings.chart, '.');
+    char* ext = strrchr(chart, '.');
     strcpy(ext, ".png");
-    FILE* inf = fopen(_settings.chart, "r");
+    FILE* inf = fopen(chart, "r");
     if (inf) {
         fclose(inf);
     }
     else {
         strcpy(ext, ".jpg");
     }
+}
 
-    if (initChart()) {
-        // Save the chart name
-        saveSettings();
-        strcpy(_previousChart, oldChart);
+void refreshChartCatalogue()
+{
+    if (_chartCatalogue == NULL) {
+        _chartCatalogue = (CalibratedData*)malloc(sizeof(CalibratedData) * MAX_CHARTS);
+        if (_chartCatalogue == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+    }
+
+    findCalibratedCharts(_chartCatalogue, &_chartCatalogueCount);
+}
+
+/// <summary>
+/// When auto follow is on, switch to the closest chart as the aircraft
+/// moves and prefetch the chart it will need next by projecting ahead
+/// along its track. Only checks about once a second.
+/// </summary>
+void autoFollowChart()
+{
+    if (!_settings.autoFollowChart || _aircraftData.loc.lat == MAXINT || _chartLoading) {
+        return;
+    }
+
+    if (_chartFollowDelay > 0) {
+        _chartFollowDelay--;
+        return;
+    }
+    _chartFollowDelay = _settings.framesPerSec;
+
+    if (_chartCatalogue == NULL) {
+        refreshChartCatalogue();
+    }
+
+    if (_chartCatalogueCount == 0) {
+        return;
+    }
+
+    char chart[256];
+    CalibratedData* closest = findClosestChart(_chartCatalogue, _chartCatalogueCount, &_aircraftData.loc);
+    calibratedChartFile(closest, chart);
+
+    if (_stricmp(chart, _settings.chart) != 0) {
+        // New chart must be clearly closer so charts don't keep swapping at the boundary
+        if (_chartData.state != 2 || chartCentreDistance(&closest->data, &_aircraftData.loc)
+            < chartCentreDistance(&_chartData, &_aircraftData.loc) * ChartSwitchMargin) {
+            loadChart(chart, _settings.chart);
+            return;
+        }
+    }
+
+    if (_aircraftData.speed < 1) {
+        return;
+    }
+
+    Locn ahead = _aircraftData.loc;
+    greatCirclePos(&ahead, _aircraftData.heading, _aircraftData.speed * ChartFollowAheadMins / 60.0);
+
+    closest = findClosestChart(_chartCatalogue, _chartCatalogueCount, &ahead);
+    calibratedChartFile(closest, chart);
+
+    if (_stricmp(chart, _settings.chart) != 0 && _stricmp(chart, _prefetchedChart) != 0) {
+        strcpy(_prefetchedChart, chart);
+        chartPrefetchRequest(chart);
     }
 }
 
@@ -2519,12 +2802,16 @@ void updateOwnAircraft()
 /// Create a tag bitmap to show to the right of other aircraft.
 /// It displays their callsign and aircraft model.
 /// </summary>
-void createTagBitmap(char *tagText, DrawData* tag, bool isMeasure, bool isElevation)
+void createTagBitmap(LabelAtlas* atlas, char *tagText, DrawData* tag, bool isMeasure, bool isElevation)
 {
     tag->width = 4 + (int)strlen(tagText) * 8;
     tag->height = 10;
 
-    tag->bmp = al_create_bitmap(tag->width, tag->height);
+    tag->bmp = labelAtlasAdd(atlas, tag->width, tag->height);
+    if (tag->bmp == NULL) {
+        // Atlas is full so give it a bitmap of its own
+        tag->bmp = al_create_bitmap(tag->width, tag->height);
+    }
 
     al_set_target_bitmap(tag->bmp);
 
@@ -2549,59 +2836,24 @@ void createTagBitmap(char *tagText, DrawData* tag, bool isMeasure, bool isElevat
 }
 
 /// <summary>
-/// Move tags if they already exist, create new tags and delete old tags
+/// Update the tag text for other aircraft. The text layer draws
+/// straight from the text so there is nothing else to create.
 /// </summary>
 void updateOtherTags()
 {
-    if (_tagCount > 0) {
-        memcpy(&_oldTag, &_otherTag, _tagDataSize * _tagCount);
-    }
-
-    for (int i = 0; i < _snapshotOtherCount; i++) {
-        createTagText(_snapshotOtherData[i].callsign, _snapshotOtherData[i].model, _otherTag[i].tagText);
+    ZoneTimer timer(ZONE_OTHER_TAGS);
 
-        char moreTagText[68];
-        sprintf(moreTagText, "%.0lf %.0lf", _snapshotOtherData[i].alt, _snapshotOtherData[i].speed);
-
-        bool tagFound = false;
-        for (int j = 0; j < _tagCount; j++) {
-            if (strcmp(_otherTag[i].tagText, _oldTag[j].tagText) == 0 && _oldTag[j].tag.bmp != NULL) {
-                tagFound = true;
-                memcpy(&_otherTag[i].tag, &_oldTag[j].tag, _drawDataSize);
-                _oldTag[j].tag.bmp = NULL;
-                memcpy(&_otherTag[i].moreTag, &_oldTag[j].moreTag, _drawDataSize);
-                _oldTag[j].moreTag.bmp = NULL;
-
-                if (strcmp(_otherTag[i].moreTagText, moreTagText) != 0) {
-                    strcpy(_otherTag[i].moreTagText, moreTagText);
-                    cleanupTagBitmap(&_otherTag[i].moreTag);
-                }
-                break;
-            }
-        }
-
-        if (!tagFound) {
-            createTagBitmap(_otherTag[i].tagText, &_otherTag[i].tag);
-            createTagBitmap(moreTagText, &_otherTag[i].moreTag);
-        }
-    }
+    for (int i = 0; i < _otherSnapshot->count; i++) {
+        createTagText(_otherSnapshot->aircraft[i].callsign, _otherSnapshot->aircraft[i].model, _otherTag[i].tagText);
+        sprintf(_otherTag[i].moreTagText, "%.0lf %.0lf", _otherSnapshot->aircraft[i].alt, _otherSnapshot->aircraft[i].speed);
 
-    // Cleanup old tags
-    for (int i = 0; i < _tagCount; i++) {
-        if (_oldTag[i].tag.bmp != NULL) {
-            al_destroy_bitmap(_oldTag[i].tag.bmp);
-        }
-        if (_oldTag[i].moreTag.bmp != NULL) {
-            try {
-                al_destroy_bitmap(_oldTag[i].moreTag.bmp);
-            }
-            catch (std::exception e) {
-                printf("Failed to delete old moreTag %d of %d\n", i, _tagCount);
-            }
+        OtherData* other = &_otherSnapshot->aircraft[i];
+        if (strcmp(_otherIcon[i].model, other->model) != 0 || strcmp(_otherIcon[i].callsign, other->callsign) != 0) {
+            strcpy(_otherIcon[i].callsign, other->callsign);
+            strcpy(_otherIcon[i].model, other->model);
+            _otherIcon[i].iconType = classifyIcon(other->model, other->callsign);
         }
     }
-
-    _tagCount = _snapshotOtherCount;
 }
 
 void updateWind()
@@ -2749,7 +3001,15 @@ void updateHud()
 /// </summary>
 void doUpdate()
 {
-    if (*_settings.chart == '\0') {
+    ZoneTimer timer(ZONE_UPDATE);
+
+    // Take a consistent copy of own aircraft and wind for this frame
+    ownStateRead(&_aircraftData, &_windData);
+
+    checkChartLoaded();
+    autoFollowChart();
+
+    if (*_settings.chart == '\0' && !_chartLoading) {
         newChart();
     }
 
@@ -2795,15 +3055,23 @@ void doUpdate()
         updateHud();
     }
 
-    // Take a new snapshot of the other aircraft
-    _snapshotOtherCount = _otherAircraftCount;
-    memcpy(&_snapshotOtherData, &_otherAircraftData, _otherDataSize * _snapshotOtherCount);
+    // Pick up the latest other aircraft (no copy needed)
+    _otherSnapshot = otherFrameRead();
+    gridBuild(&_otherGrid, &_otherSnapshot->aircraft[0].loc, sizeof(OtherData), _otherSnapshot->count);
+
+    // Pick up the latest AI aircraft (also used when one is clicked)
+    _aiSnapshot = aiFrameRead();
+
+    if (_showAi && !_connected) {
+        // AI aircraft are only drawn when they aren't injected
+        gridBuild(&_aiGrid, &_aiSnapshot->aircraft[0].loc, sizeof(AiFrameAircraft), _aiSnapshot->count);
+    }
 
     // Create any tags that don't already exist
     updateOtherTags();
 
-    // Update window title if required
-    if (_titleState != _chartData.state) {
+    // Update window title if required (keep the loading message until the chart arrives)
+    if (_titleState != _chartData.state && !_chartLoading) {
         if (_titleState == -9 && _titleDelay > 0) {
             _titleDelay--;
         }
@@ -2869,15 +3137,12 @@ void doMouseButton(ALLEGRO_EVENT* event, bool isPress)
                 displayToChartPos(_mouse.x, _mouse.y, &_measureStartPos);
                 chartPosToLocation(_measureStartPos.x, _measureStartPos.y, &_measureStartLoc);
 
-                strcpy(_measureTag.tagText, "0.0");
-                createTagBitmap(_measureTag.tagText, &_measureTag.tag, true);
+                strcpy(_measureTag.moreTagText, "0.0");
             }
             else if (_measureStartPos.x != MAXINT) {
                 // Stop measuring
                 _ignoreNextRelease = true;
                 _measureStartPos.x = MAXINT;
-                cleanupBitmap(_measureTag.tag.bmp);
-                _measureTag.tag.bmp = NULL;
             }
             else if (_altPressed) {
                 // Add/remove additional home icon
@@ -2908,7 +3173,7 @@ void doMouseButton(ALLEGRO_EVENT* event, bool isPress)
             }
 
             // If mouse wasn't dragged check for click on AI aircraft
-            if (_aiAircraftCount > 0 && abs(_mouse.x - clickedPos.x) < 2 && abs( _mouse.y - clickedPos.y) < 2) {
+            if (_aiSnapshot->count > 0 && abs(_mouse.x - clickedPos.x) < 2 && abs( _mouse.y - clickedPos.y) < 2) {
                 Position posMin, posMax;
                 Locn locMin, locMax;
                 displayToChartPos(_mouse.x - 12, _mouse.y - 12, &posMin);
@@ -2916,20 +3181,21 @@ void doMouseButton(ALLEGRO_EVENT* event, bool isPress)
                 chartPosToLocation(posMin.x, posMax.y, &locMin);
                 chartPosToLocation(posMax.x, posMin.y, &locMax);
 
-                for (int i = 0; i < _aiAircraftCount; i++) {
+                for (int i = 0; i < _aiSnapshot->count; i++) {
+                    AiFrameAircraft* ai = &_aiSnapshot->aircraft[i];
                     IconData iconData;
-                    getIconData(_aiAircraft[i].model, _aiAircraft[i].callsign, _aiAircraft[i].alt, &iconData, 0);
+                    getIconData(ai->iconType, ai->alt, &iconData, 0);
 
                     if (_settings.showAiMilitaryOnly && !iconData.isMilitary) {
                         continue;
                     }
 
-                    if (_aiAircraft[i].loc.lat >= locMin.lat && _aiAircraft[i].loc.lat <= locMax.lat &&
-                        _aiAircraft[i].loc.lon >= locMin.lon && _aiAircraft[i].loc.lon <= locMax.lon)
+                    if (ai->loc.lat >= locMin.lat && ai->loc.lat <= locMax.lat &&
+                        ai->loc.lon >= locMin.lon && ai->loc.lon <= locMax.lon)
                     {
                         // AI aircraft has been clicked
-                        if (!_watchInProgress && strcmp(_aiAircraft[i].callsign, "Unknown") != 0) {
-                            strcpy(_watchCallsign, _aiAircraft[i].callsign);
+                        if (!_watchInProgress && strcmp(ai->callsign, "Unknown") != 0) {
+                            strcpy(_watchCallsign, ai->callsign);
                             _watchInProgress = true;
                             char msg[256];
                             sprintf(msg, "Fetching data for aircraft %s", _watchCallsign);
@@ -3008,6 +3274,7 @@ void showChart()
     setAlwaysOnTop();
 
     // If aircraft is initialised always start on the closest chart
+    ownStateRead(&_aircraftData, &_windData);
     closestChart(&_aircraftData.loc);
 
     doUpdate();
@@ -3015,10 +3282,6 @@ void showChart()
     bool redraw = true;
     ALLEGRO_EVENT event;
 
-    //LARGE_INTEGER perfFreq, prevTime, nowTime, elapsedTime;
-    //QueryPerformanceFrequency(&perfFreq);
-    //QueryPerformanceCounter(&prevTime);
-
     al_start_timer(_timer);
 
     while (!_quit) {
@@ -3052,6 +3315,7 @@ void showChart()
 
         case ALLEGRO_EVENT_DISPLAY_CLOSE:
             _quit = true;
+            serverNotify();
             break;
 
         case ALLEGRO_EVENT_DISPLAY_RESIZE:
@@ -3068,13 +3332,7 @@ void showChart()
             doRender();
             al_flip_display();
             redraw = false;
-
-            //QueryPerformanceCounter(&nowTime);
-            //elapsedTime.QuadPart = (nowTime.QuadPart - prevTime.QuadPart) * 1000000;
-            //elapsedTime.QuadPart /= perfFreq.QuadPart;
-            //LONGLONG elapsedMillis = elapsedTime.QuadPart / 1000;
-            //prevTime.QuadPart = nowTime.QuadPart;
-            //printf("Elapsed: %lld\n", elapsedMillis);
+            profileFrame();
         }
     }
 
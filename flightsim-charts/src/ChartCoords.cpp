@@ -1,9 +1,14 @@
-#include <windows.h>
+#include "Platform.h"
 #include <iostream>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include "ChartCoords.h"
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
 const double RadiusOfEarthNm = 3440.1;
 
 // Externals
@@ -16,6 +21,9 @@ extern LocData _aircraftData;
 extern MouseData _mouseData;
 extern ChartData _chartData;
 
+// Variables
+ChartTransform _chartTransform;
+
 /// <summary>
 /// Get position on zoomed chart of display's top left corner
 /// </summary>
@@ -54,37 +62,162 @@ void chartToDisplayPos(int chartX, int chartY, Position* display)
 }
 
 /// <summary>
-/// Convert location to chart position. Chart must be calibrated.
+/// Lat in the units of a projected chart. Uses rough and ready
+/// formula y = ((lat + 26.4)^2 / 7.9) - 60
 /// </summary>
-void locationToChartPos(Locn* loc, Position* pos)
+double projectedLat(double lat)
 {
-    double lonCalibDiff = _chartData.lon[1] - _chartData.lon[0];
-    double lonDiff = loc->lon - _chartData.lon[0];
-    double xScale = lonDiff / lonCalibDiff;
-    int xCalibDiff = _chartData.x[1] - _chartData.x[0];
-    pos->x = _chartData.x[0] + xCalibDiff * xScale;
+    double val = lat + 26.4;
+    return val * val / 7.9 - 60;
+}
+
+/// <summary>
+/// Must be called whenever _chartData changes
+/// </summary>
+void updateChartTransform()
+{
+    _chartTransform.x0 = _chartData.x[0];
+    _chartTransform.xCalibDiff = _chartData.x[1] - _chartData.x[0];
+    _chartTransform.lon0 = _chartData.lon[0];
+    _chartTransform.lonCalibDiff = _chartData.lon[1] - _chartData.lon[0];
+    _chartTransform.y0 = _chartData.y[0];
+    _chartTransform.yCalibDiff = _chartData.y[1] - _chartData.y[0];
 
     double latCalibDiff = _chartData.lat[1] - _chartData.lat[0];
-    double latDiff;
+    _chartTransform.projected = fabs(latCalibDiff) >= 2;
 
-    if (abs(latCalibDiff) < 2) {
-        // Assume linear lat scale
-        latDiff = loc->lat - _chartData.lat[0];
+    if (_chartTransform.projected) {
+        // Account for map projection (lat stretches towards poles)
+        _chartTransform.lat0 = projectedLat(_chartData.lat[0]);
+        _chartTransform.latCalibDiff = projectedLat(_chartData.lat[1]) - _chartTransform.lat0;
     }
     else {
-        // Account for map projection (lat stretches towards poles).
-        // Use rough and ready formula y = ((lat + 26.4)^2 / 7.9) - 60
-        double lat0 = (pow(_chartData.lat[0] + 26.4, 2) / 7.9) - 60;
-        double lat1 = (pow(_chartData.lat[1] + 26.4, 2) / 7.9) - 60;
-        double yPos = (pow(loc->lat + 26.4, 2) / 7.9) - 60;
+        // Assume linear lat scale
+        _chartTransform.lat0 = _chartData.lat[0];
+        _chartTransform.latCalibDiff = latCalibDiff;
+    }
+}
+
+/// <summary>
+/// Convert location to chart position. Chart must be calibrated.
+/// </summary>
+void locationToChartPos(Locn* loc, Position* pos)
+{
+    const ChartTransform* t = &_chartTransform;
+
+    pos->x = t->x0 + t->xCalibDiff * ((loc->lon - t->lon0) / t->lonCalibDiff);
+
+    double lat = t->projected ? projectedLat(loc->lat) : loc->lat;
+    pos->y = t->y0 + t->yCalibDiff * ((lat - t->lat0) / t->latCalibDiff);
+}
 
-        latCalibDiff = lat1 - lat0;
-        latDiff = yPos - lat0;
+/// <summary>
+/// Same as locationToChartPos for every location in the batch. Does
+/// the same operations in the same order so the results are identical.
+/// </summary>
+void projectBatch(ChartBatch* batch)
+{
+    const ChartTransform* t = &_chartTransform;
+    int i = 0;
+
+#ifdef USE_SSE2
+    __m128d x0 = _mm_set1_pd(t->x0);
+    __m128d xCalibDiff = _mm_set1_pd(t->xCalibDiff);
+    __m128d lon0 = _mm_set1_pd(t->lon0);
+    __m128d lonCalibDiff = _mm_set1_pd(t->lonCalibDiff);
+    __m128d y0 = _mm_set1_pd(t->y0);
+    __m128d yCalibDiff = _mm_set1_pd(t->yCalibDiff);
+    __m128d lat0 = _mm_set1_pd(t->lat0);
+    __m128d latCalibDiff = _mm_set1_pd(t->latCalibDiff);
+    __m128d latOffset = _mm_set1_pd(26.4);
+    __m128d latDivisor = _mm_set1_pd(7.9);
+    __m128d latBase = _mm_set1_pd(60);
+
+    for (; i + 2 <= batch->count; i += 2) {
+        __m128d lon = _mm_loadu_pd(&batch->lon[i]);
+        __m128d x = _mm_add_pd(x0, _mm_mul_pd(xCalibDiff, _mm_div_pd(_mm_sub_pd(lon, lon0), lonCalibDiff)));
+        _mm_storel_epi64((__m128i*)&batch->x[i], _mm_cvttpd_epi32(x));
+
+        __m128d lat = _mm_loadu_pd(&batch->lat[i]);
+        if (t->projected) {
+            __m128d val = _mm_add_pd(lat, latOffset);
+            lat = _mm_sub_pd(_mm_div_pd(_mm_mul_pd(val, val), latDivisor), latBase);
+        }
+        __m128d y = _mm_add_pd(y0, _mm_mul_pd(yCalibDiff, _mm_div_pd(_mm_sub_pd(lat, lat0), latCalibDiff)));
+        _mm_storel_epi64((__m128i*)&batch->y[i], _mm_cvttpd_epi32(y));
     }
+#endif
 
-    double yScale = latDiff / latCalibDiff;
-    int yCalibDiff = _chartData.y[1] - _chartData.y[0];
-    pos->y = _chartData.y[0] + yCalibDiff * yScale;
+    for (; i < batch->count; i++) {
+        batch->x[i] = t->x0 + t->xCalibDiff * ((batch->lon[i] - t->lon0) / t->lonCalibDiff);
+
+        double lat = t->projected ? projectedLat(batch->lat[i]) : batch->lat[i];
+        batch->y[i] = t->y0 + t->yCalibDiff * ((lat - t->lat0) / t->latCalibDiff);
+    }
+}
+
+/// <summary>
+/// Project count locations to chart positions. Locations are stride bytes
+/// apart and are picked by the item numbers in index, or are the first
+/// count if index is NULL. Position n in the batch is for the nth location.
+/// </summary>
+void batchProject(ChartBatch* batch, const Locn* firstLoc, int stride, const int* index, int count)
+{
+    if (count > batch->allocated) {
+        batchCleanup(batch);
+
+        batch->lat = (double*)malloc(count * sizeof(double));
+        batch->lon = (double*)malloc(count * sizeof(double));
+        batch->x = (int*)malloc(count * sizeof(int));
+        batch->y = (int*)malloc(count * sizeof(int));
+        if (batch->lat == NULL || batch->lon == NULL || batch->x == NULL || batch->y == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+        batch->allocated = count;
+    }
+
+    for (int n = 0; n < count; n++) {
+        int i = index ? index[n] : n;
+        const Locn* loc = (const Locn*)((const char*)firstLoc + i * stride);
+        batch->lat[n] = loc->lat;
+        batch->lon[n] = loc->lon;
+    }
+
+    batch->count = count;
+    projectBatch(batch);
+}
+
+/// <summary>
+/// Same as drawOther for position n of a projected batch
+/// </summary>
+bool batchDrawOther(ChartBatch* batch, int n, Position* displayPos1, Position* displayPos2, Position* pos, bool force)
+{
+    int x = batch->x[n];
+    int y = batch->y[n];
+
+    if (!force) {
+        if (x < displayPos1->x || x > displayPos2->x || y < displayPos1->y || y > displayPos2->y) {
+            return false;
+        }
+    }
+
+    chartToDisplayPos(x, y, pos);
+
+    return true;
+}
+
+void batchCleanup(ChartBatch* batch)
+{
+    if (batch->allocated > 0) {
+        free(batch->lat);
+        free(batch->lon);
+        free(batch->x);
+        free(batch->y);
+        batch->allocated = 0;
+    }
+
+    batch->count = 0;
 }
 
 /// <summary>
@@ -107,6 +240,84 @@ void chartPosToLocation(int x, int y, Locn* loc)
     loc->lon = _chartData.lon[0] + lonCalibDiff * lonScale;
 }
 
+/// <summary>
+/// Find the lat/lon areas containing every location that
+/// locationToChartPos would put inside the given chart positions.
+/// Projected charts fold at lat -26.4 so there may be two areas.
+/// Returns the number of areas or -1 if the chart isn't calibrated.
+/// </summary>
+int chartAreaToLocations(Position* pos1, Position* pos2, LocnArea* areas)
+{
+    int xCalibDiff = _chartData.x[1] - _chartData.x[0];
+    int yCalibDiff = _chartData.y[1] - _chartData.y[0];
+    double latCalibDiff = _chartData.lat[1] - _chartData.lat[0];
+    double lonCalibDiff = _chartData.lon[1] - _chartData.lon[0];
+
+    if (xCalibDiff == 0 || yCalibDiff == 0 || latCalibDiff == 0 || lonCalibDiff == 0) {
+        return -1;
+    }
+
+    // Allow a pixel either side for rounding
+    double lon1 = _chartData.lon[0] + lonCalibDiff * (pos1->x - 1 - _chartData.x[0]) / xCalibDiff;
+    double lon2 = _chartData.lon[0] + lonCalibDiff * (pos2->x + 1 - _chartData.x[0]) / xCalibDiff;
+    double yScale1 = (double)(pos1->y - 1 - _chartData.y[0]) / yCalibDiff;
+    double yScale2 = (double)(pos2->y + 1 - _chartData.y[0]) / yCalibDiff;
+
+    for (int i = 0; i < 2; i++) {
+        areas[i].minLon = lon1 < lon2 ? lon1 : lon2;
+        areas[i].maxLon = lon1 < lon2 ? lon2 : lon1;
+    }
+
+    if (abs(latCalibDiff) < 2) {
+        double lat1 = _chartData.lat[0] + latCalibDiff * yScale1;
+        double lat2 = _chartData.lat[0] + latCalibDiff * yScale2;
+        areas[0].minLat = lat1 < lat2 ? lat1 : lat2;
+        areas[0].maxLat = lat1 < lat2 ? lat2 : lat1;
+        return 1;
+    }
+
+    // Invert y = ((lat + 26.4)^2 / 7.9) - 60
+    double lat0 = (pow(_chartData.lat[0] + 26.4, 2) / 7.9) - 60;
+    double lat1 = (pow(_chartData.lat[1] + 26.4, 2) / 7.9) - 60;
+    double yPos1 = lat0 + (lat1 - lat0) * yScale1;
+    double yPos2 = lat0 + (lat1 - lat0) * yScale2;
+
+    double sqMin = ((yPos1 < yPos2 ? yPos1 : yPos2) + 60) * 7.9;
+    double sqMax = ((yPos1 < yPos2 ? yPos2 : yPos1) + 60) * 7.9;
+    if (sqMax < 0) {
+        return 0;
+    }
+
+    double dMin = sqMin > 0 ? sqrt(sqMin) : 0;
+    double dMax = sqrt(sqMax);
+
+    if (dMin == 0) {
+        areas[0].minLat = -26.4 - dMax;
+        areas[0].maxLat = -26.4 + dMax;
+        return 1;
+    }
+
+    areas[0].minLat = -26.4 + dMin;
+    areas[0].maxLat = -26.4 + dMax;
+    areas[1].minLat = -26.4 - dMax;
+    areas[1].maxLat = -26.4 - dMin;
+    return 2;
+}
+
+/// <summary>
+/// Returns roughly how many display pixels there are to a degree of
+/// latitude at the current zoom. Chart must be calibrated.
+/// </summary>
+double displayPixelsPerDegree()
+{
+    double latCalibDiff = fabs(_chartData.lat[1] - _chartData.lat[0]);
+    if (latCalibDiff == 0) {
+        return 0;
+    }
+
+    return abs(_chartData.y[1] - _chartData.y[0]) * _view.scale / latCalibDiff;
+}
+
 /// <summary>
 /// Returns formatted co-ordinate, e.g. 51 28' 29.60"
 /// </summary>
@@ -430,6 +641,18 @@ bool drawOther(Position* displayPos1, Position* displayPos2, Locn* loc, Position
     return true;
 }
 
+/// <summary>
+/// Distance from the centre of the calibration points to the location.
+/// </summary>
+double chartCentreDistance(ChartData* chartData, Locn* loc)
+{
+    Locn centre;
+    centre.lat = (chartData->lat[0] + chartData->lat[1]) / 2.0;
+    centre.lon = (chartData->lon[0] + chartData->lon[1]) / 2.0;
+
+    return greatCircleDistance(&centre, loc);
+}
+
 CalibratedData* findClosestChart(CalibratedData* calib, int count, Locn* loc)
 {
     CalibratedData* closest = calib;
@@ -441,11 +664,7 @@ CalibratedData* findClosestChart(CalibratedData* calib, int count, Locn* loc)
 
         // Ignore any bad calibration data
         if (nextCalib->data.state == 2) {
-            Locn centre;
-            centre.lat = (nextCalib->data.lat[0] + nextCalib->data.lat[1]) / 2.0;
-            centre.lon = (nextCalib->data.lon[0] + nextCalib->data.lon[1]) / 2.0;
-
-            double distance = greatCircleDistance(&centre, loc);
+            double distance = chartCentreDistance(&nextCalib->data, loc);
 
             if (distance < minDistance) {
                 closest = nextCalib;
@@ -39,12 +39,12 @@ char* settingsFile()
 }
 
 /// <summary>
-/// Returns the full pathname of the chart calibration file
+/// Sets filename to the full pathname of the calibration file for
+/// the supplied chart. Safe to call from any thread.
 /// </summary>
-char* calibrationFile()
+void chartCalibrationFile(const char* chart, char* filename)
 {
-    static char filename[256];
-    strcpy(filename, _settings.chart);
+    strcpy(filename, chart);
 
     char* last = strrchr(filename, '\\');
     if (last) {
@@ -54,6 +54,15 @@ char* calibrationFile()
         }
     }
     strcat(filename, CalibrationExt);
+}
+
+/// <summary>
+/// Returns the full pathname of the chart calibration file
+/// </summary>
+char* calibrationFile()
+{
+    static char filename[256];
+    chartCalibrationFile(_settings.chart, filename);
 
     return filename;
 }
@@ -77,7 +86,7 @@ void saveSettings()
     fprintf(outf, "%s\n", _settings.location);
     fprintf(outf, "%d,%d,%d\n", _settings.showTags, _settings.showFixedTags,  _settings.showAiInfoTags);
     fprintf(outf, "%d,%d,%d\n", _settings.showAiPhotos, _settings.showAiMilitaryOnly, _settings.showInstrumentHud);
-    fprintf(outf, "%d,%d,%d\n", _settings.showAlwaysOnTop, _settings.showMiniMenu, 0);
+    fprintf(outf, "%d,%d,%d\n", _settings.showAlwaysOnTop, _settings.showMiniMenu, _settings.autoFollowChart);
 
     fclose(outf);
 }
@@ -167,6 +176,7 @@ void loadSettings()
                 if (items == 3) {
                     _settings.showAlwaysOnTop = toggle1;
                     _settings.showMiniMenu = toggle2;
+                    _settings.autoFollowChart = toggle3;
                 }
                 break;
             }
@@ -243,6 +253,7 @@ void saveCalibration(int x, int y, Locn* loc)
     _chartData.lat[_chartData.state] = loc->lat;
     _chartData.lon[_chartData.state] = loc->lon;
     _chartData.state++;
+    updateChartTransform();
 
     char msg[256];
 
@@ -5,6 +5,9 @@
 #include "flightsim-charts.h"
 #include "ChartFile.h"
 #include "ChartCoords.h"
+#include "SpatialGrid.h"
+#include "LayerLod.h"
+#include "LabelAtlas.h"
 
 // Externals
 extern ALLEGRO_DISPLAY* _display;
@@ -14,11 +17,20 @@ extern FlightPlanData _flightPlan[MAX_FLIGHT_PLAN];
 extern int _flightPlanCount;
 extern VrpData* _vrps;
 extern int _vrpCount;
+extern SpatialGrid _vrpGrid;
+extern LayerLod _vrpLod;
 extern ObstacleData* _obstacles;
 extern int _obstacleCount;
+extern SpatialGrid _obstacleGrid;
+extern LayerLod _obstacleLod;
 extern bool _showObstacleNames;
 extern ElevationData* _elevations;
 extern int _elevationCount;
+extern SpatialGrid _elevationGrid;
+extern LabelAtlas _flightPlanLabels;
+extern LabelAtlas _elevationLabels;
+extern LabelAtlas _obstacleLabels;
+extern LabelAtlas _vrpLabels;
 
 // Constants
 const char* UkElevationData =
@@ -121,7 +133,7 @@ void loadFlightPlan(const char *filename)
     }
 
     for (int i = 0; i < _flightPlanCount; i++) {
-        createTagBitmap(_flightPlan[i].name, &_flightPlan[i].tag, false);
+        createTagBitmap(&_flightPlanLabels, _flightPlan[i].name, &_flightPlan[i].tag, false);
     }
 
     return;
@@ -136,6 +148,7 @@ void clearFlightPlan()
         cleanupTagBitmap(&_flightPlan[i].tag);
     }
 
+    labelAtlasClear(&_flightPlanLabels);
     _flightPlanCount = 0;
 }
 
@@ -168,7 +181,7 @@ void newElevations()
         if (elevation > 0) {
             char nameTag[16];
             sprintf(nameTag, "%d", elevation * 100);
-            createTagBitmap(nameTag, &_elevations[_elevationCount].tag, false, true);
+            createTagBitmap(&_elevationLabels, nameTag, &_elevations[_elevationCount].tag, false, true);
 
             _elevations[_elevationCount].loc.lat = lat;
             _elevations[_elevationCount].loc.lon = lon;
@@ -200,6 +213,9 @@ void newElevations()
             pos = nextPos;
         }
     }
+
+    // Index once so only visible elevations are drawn
+    gridBuild(&_elevationGrid, &_elevations[0].loc, sizeof(ElevationData), _elevationCount);
 }
 
 /// <summary>
@@ -215,7 +231,9 @@ void clearElevations()
         cleanupTagBitmap(&_elevations[i].tag);
     }
 
+    labelAtlasClear(&_elevationLabels);
     free(_elevations);
+    gridCleanup(&_elevationGrid);
     _elevationCount = 0;
 }
 
@@ -434,6 +452,7 @@ void loadObstacles(const char* filename)
         _obstacles[_obstacleCount].loc.lat = lat;
         _obstacles[_obstacleCount].loc.lon = lon;
         sprintf(_obstacles[_obstacleCount].elevation, "%d ft", elevation);
+        _obstacles[_obstacleCount].elevationFt = elevation;
 
         _obstacleCount++;
 
@@ -453,13 +472,18 @@ void loadObstacles(const char* filename)
 
     for (int i = 0; i < _obstacleCount; i++) {
         if (_showObstacleNames) {
-            createTagBitmap(_obstacles[i].name, &_obstacles[i].tag, true);
+            createTagBitmap(&_obstacleLabels, _obstacles[i].name, &_obstacles[i].tag, true);
         }
         else {
             _obstacles[i].tag.bmp = NULL;
         }
-        createTagBitmap(_obstacles[i].elevation, &_obstacles[i].moreTag, true);
+        createTagBitmap(&_obstacleLabels, _obstacles[i].elevation, &_obstacles[i].moreTag, true);
     }
+
+    // Index once so only visible obstacles are drawn and
+    // only the tallest ones when zoomed out
+    gridBuild(&_obstacleGrid, &_obstacles[0].loc, sizeof(ObstacleData), _obstacleCount);
+    lodBuild(&_obstacleLod, &_obstacles[0].loc, &_obstacles[0].elevationFt, sizeof(ObstacleData), _obstacleCount);
 }
 
 /// <summary>
@@ -476,7 +500,10 @@ void clearObstacles()
         cleanupTagBitmap(&_obstacles[i].moreTag);
     }
 
+    labelAtlasClear(&_obstacleLabels);
     free(_obstacles);
+    gridCleanup(&_obstacleGrid);
+    lodCleanup(&_obstacleLod);
     _obstacleCount = 0;
     _showObstacleNames = false;
 }
@@ -608,8 +635,13 @@ void loadVrps(const char* filename)
     fclose(inf);
 
     for (int i = 0; i < _vrpCount; i++) {
-        createTagBitmap(_vrps[i].name, &_vrps[i].tag, true, true);
+        createTagBitmap(&_vrpLabels, _vrps[i].name, &_vrps[i].tag, true, true);
     }
+
+    // Index once so only visible VRPs are drawn and
+    // fewer of them when zoomed out
+    gridBuild(&_vrpGrid, &_vrps[0].loc, sizeof(VrpData), _vrpCount);
+    lodBuild(&_vrpLod, &_vrps[0].loc, NULL, sizeof(VrpData), _vrpCount);
 }
 
 /// <summary>
@@ -625,6 +657,9 @@ void clearVrps()
         cleanupTagBitmap(&_vrps[i].tag);
     }
 
+    labelAtlasClear(&_vrpLabels);
     free(_vrps);
+    gridCleanup(&_vrpGrid);
+    lodCleanup(&_vrpLod);
     _vrpCount = 0;
 }
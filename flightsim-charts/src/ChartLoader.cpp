@@ -0,0 +1,257 @@
+#include <windows.h>
+#include <iostream>
+#include <thread>
+#include "ChartLoader.h"
+#include "ChartFile.h"
+
+/// Everything shared with the worker is guarded by _loaderMutex.
+/// Tiles are only ever loaded into memory bitmaps here, video bitmaps
+/// are created by the render thread when the tiles are drawn.
+
+std::thread _loaderThread;
+HANDLE _loaderEvent = NULL;
+HANDLE _loaderMutex = NULL;
+bool _loaderQuit = false;
+char _loadRequest[256];
+bool _loadRequested = false;
+bool _loadReady = false;
+LoadedChart _loadResult;
+char _prefetchRequest[256];
+bool _prefetchRequested = false;
+
+// Only touched by the worker (or after it has stopped)
+LoadedChart _prefetched[MaxPrefetchedCharts];
+int _prefetchedCount = 0;
+
+
+/// <summary>
+/// Load a chart and its calibration into loaded, which must not hold any tiles.
+/// </summary>
+void loadChartFiles(LoadedChart* loaded)
+{
+    loaded->ok = tilesLoad(&loaded->tiles, loaded->filename);
+    loaded->chartData.state = -1;
+    if (loaded->ok) {
+        char calibFile[256];
+        chartCalibrationFile(loaded->filename, calibFile);
+        loadCalibrationData(&loaded->chartData, calibFile);
+    }
+}
+
+/// <summary>
+/// Returns the index of a prefetched chart or -1 if it hasn't been prefetched.
+/// </summary>
+int findPrefetched(const char* filename)
+{
+    for (int i = 0; i < _prefetchedCount; i++) {
+        if (_stricmp(_prefetched[i].filename, filename) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void removePrefetched(int index)
+{
+    for (int i = index; i < _prefetchedCount - 1; i++) {
+        _prefetched[i] = _prefetched[i + 1];
+    }
+    _prefetchedCount--;
+}
+
+/// <summary>
+/// Load a chart that will probably be wanted soon. Even if it can't be
+/// kept the tile cache will have been written so it will load quickly.
+/// </summary>
+void prefetchChart(const char* filename)
+{
+    if (findPrefetched(filename) != -1) {
+        return;
+    }
+
+    LoadedChart loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    strcpy(loaded.filename, filename);
+    loadChartFiles(&loaded);
+
+    const ULONGLONG budget = PrefetchBudgetMB * 1024ULL * 1024ULL;
+    ULONGLONG memory = loaded.ok ? tilesMemory(&loaded.tiles) : 0;
+    if (!loaded.ok || memory > budget) {
+        tilesCleanup(&loaded.tiles);
+        return;
+    }
+
+    for (int i = 0; i < _prefetchedCount; i++) {
+        memory += tilesMemory(&_prefetched[i].tiles);
+    }
+
+    // Oldest are dropped first until all of them fit the budget
+    while (_prefetchedCount == MaxPrefetchedCharts || memory > budget) {
+        memory -= tilesMemory(&_prefetched[0].tiles);
+        tilesCleanup(&_prefetched[0].tiles);
+        removePrefetched(0);
+    }
+
+    _prefetched[_prefetchedCount] = loaded;
+    _prefetchedCount++;
+}
+
+/// <summary>
+/// Worker thread. Waits for a request then loads the chart and its calibration.
+/// Requested charts always take priority over prefetching.
+/// </summary>
+void chartLoader()
+{
+    LoadedChart loaded;
+    memset(&loaded, 0, sizeof(loaded));
+
+    while (true) {
+        WaitForSingleObject(_loaderEvent, INFINITE);
+
+        while (true) {
+            WaitForSingleObject(_loaderMutex, INFINITE);
+            if (_loaderQuit) {
+                ReleaseMutex(_loaderMutex);
+                return;
+            }
+
+            if (!_loadRequested) {
+                if (!_prefetchRequested) {
+                    ReleaseMutex(_loaderMutex);
+                    break;
+                }
+
+                char filename[256];
+                strcpy(filename, _prefetchRequest);
+                _prefetchRequested = false;
+                ReleaseMutex(_loaderMutex);
+
+                prefetchChart(filename);
+                continue;
+            }
+
+            strcpy(loaded.filename, _loadRequest);
+            _loadRequested = false;
+            ReleaseMutex(_loaderMutex);
+
+            int index = findPrefetched(loaded.filename);
+            if (index != -1) {
+                loaded = _prefetched[index];
+                removePrefetched(index);
+            }
+            else {
+                loadChartFiles(&loaded);
+            }
+
+            WaitForSingleObject(_loaderMutex, INFINITE);
+            if (_loadRequested || _loaderQuit) {
+                // Superseded so nobody wants this chart
+                tilesCleanup(&loaded.tiles);
+            }
+            else {
+                if (_loadReady) {
+                    tilesCleanup(&_loadResult.tiles);
+                }
+                _loadResult = loaded;
+                _loadReady = true;
+            }
+            memset(&loaded.tiles, 0, sizeof(loaded.tiles));
+            ReleaseMutex(_loaderMutex);
+        }
+    }
+}
+
+void chartLoaderInit()
+{
+    _loaderEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    _loaderMutex = CreateMutex(NULL, FALSE, NULL);
+    if (_loaderEvent == NULL || _loaderMutex == NULL) {
+        printf("Failed to create chart loader\n");
+        return;
+    }
+
+    _loaderThread = std::thread(chartLoader);
+}
+
+void chartLoaderCleanup()
+{
+    if (_loaderThread.joinable()) {
+        WaitForSingleObject(_loaderMutex, INFINITE);
+        _loaderQuit = true;
+        ReleaseMutex(_loaderMutex);
+        SetEvent(_loaderEvent);
+        _loaderThread.join();
+    }
+
+    if (_loadReady) {
+        tilesCleanup(&_loadResult.tiles);
+        _loadReady = false;
+    }
+
+    for (int i = 0; i < _prefetchedCount; i++) {
+        tilesCleanup(&_prefetched[i].tiles);
+    }
+    _prefetchedCount = 0;
+
+    if (_loaderEvent) {
+        CloseHandle(_loaderEvent);
+        _loaderEvent = NULL;
+    }
+
+    if (_loaderMutex) {
+        CloseHandle(_loaderMutex);
+        _loaderMutex = NULL;
+    }
+}
+
+/// <summary>
+/// Called by the render thread. Replaces any request that hasn't started yet
+/// and makes any chart still loading get thrown away when it finishes. A
+/// chart that has finished but not been collected is thrown away now,
+/// otherwise it would be collected in place of this one.
+/// </summary>
+void chartLoadRequest(const char* filename)
+{
+    WaitForSingleObject(_loaderMutex, INFINITE);
+    if (_loadReady) {
+        tilesCleanup(&_loadResult.tiles);
+        _loadReady = false;
+    }
+    strcpy(_loadRequest, filename);
+    _loadRequested = true;
+    ReleaseMutex(_loaderMutex);
+
+    SetEvent(_loaderEvent);
+}
+
+/// <summary>
+/// Called by the render thread. Loads a chart in the background, when there
+/// is nothing else to do, ready for a later chartLoadRequest.
+/// </summary>
+void chartPrefetchRequest(const char* filename)
+{
+    WaitForSingleObject(_loaderMutex, INFINITE);
+    strcpy(_prefetchRequest, filename);
+    _prefetchRequested = true;
+    ReleaseMutex(_loaderMutex);
+
+    SetEvent(_loaderEvent);
+}
+
+/// <summary>
+/// Called by the render thread. Returns true if a chart has finished loading,
+/// in which case the caller takes ownership of its tiles.
+/// </summary>
+bool chartLoadCollect(LoadedChart* loaded)
+{
+    WaitForSingleObject(_loaderMutex, INFINITE);
+    bool ready = _loadReady;
+    if (ready) {
+        *loaded = _loadResult;
+        _loadReady = false;
+    }
+    ReleaseMutex(_loaderMutex);
+
+    return ready;
+}
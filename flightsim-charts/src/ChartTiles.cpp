@@ -0,0 +1,539 @@
+#include <windows.h>
+#include <iostream>
+#include <math.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_memfile.h>
+#include "ChartTiles.h"
+
+/// Pixels are handled as 32-bit RGBA whatever the source format is.
+const int TileFormat = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+
+/// A PNG can end up slightly bigger than the raw pixels if they don't compress.
+const int MaxTilePng = TileSize * TileSize * 4 + 65536;
+
+
+/// <summary>
+/// Create the next level by averaging each 2x2 block of pixels.
+/// </summary>
+ALLEGRO_BITMAP* halveBitmap(ALLEGRO_BITMAP* src, int srcWidth, int srcHeight)
+{
+    int width = (srcWidth + 1) / 2;
+    int height = (srcHeight + 1) / 2;
+
+    ALLEGRO_BITMAP* bmp = al_create_bitmap(width, height);
+    if (!bmp) {
+        return NULL;
+    }
+
+    ALLEGRO_LOCKED_REGION* from = al_lock_bitmap(src, TileFormat, ALLEGRO_LOCK_READONLY);
+    ALLEGRO_LOCKED_REGION* to = al_lock_bitmap(bmp, TileFormat, ALLEGRO_LOCK_WRITEONLY);
+    if (!from || !to) {
+        if (from) al_unlock_bitmap(src);
+        if (to) al_unlock_bitmap(bmp);
+        al_destroy_bitmap(bmp);
+        return NULL;
+    }
+
+    halvePixels((const unsigned char*)from->data, from->pitch, srcWidth, srcHeight, (unsigned char*)to->data, to->pitch);
+
+    al_unlock_bitmap(src);
+    al_unlock_bitmap(bmp);
+    return bmp;
+}
+
+/// <summary>
+/// Allocate the tile to cache slot table for a level.
+/// </summary>
+void initTileLevel(TileLevel* level, int width, int height)
+{
+    TileCacheLevel size;
+    tileLevelSize(&size, width, height);
+    level->width = size.width;
+    level->height = size.height;
+    level->tilesX = size.tilesX;
+    level->tilesY = size.tilesY;
+
+    int tileCount = level->tilesX * level->tilesY;
+    level->cacheSlot = (int*)malloc(tileCount * sizeof(int));
+    if (level->cacheSlot == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < tileCount; i++) {
+        level->cacheSlot[i] = -1;
+    }
+}
+
+void closeTileCache(ChartTiles* tiles)
+{
+    if (tiles->cacheData) {
+        UnmapViewOfFile(tiles->cacheData);
+        tiles->cacheData = NULL;
+    }
+
+    if (tiles->cacheMapping) {
+        CloseHandle(tiles->cacheMapping);
+        tiles->cacheMapping = NULL;
+    }
+
+    if (tiles->cacheFile) {
+        CloseHandle(tiles->cacheFile);
+        tiles->cacheFile = NULL;
+    }
+
+    tiles->cacheSize = 0;
+    tiles->cacheIndex = NULL;
+}
+
+/// <summary>
+/// Map the tile cache file and set up the levels from it. Returns false
+/// if there is no cache file or it doesn't match the chart.
+/// </summary>
+bool openTileCache(ChartTiles* tiles, const char* cacheFile, ULONGLONG chartSize, ULONGLONG chartTime)
+{
+    tiles->cacheFile = CreateFile(cacheFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (tiles->cacheFile == INVALID_HANDLE_VALUE) {
+        tiles->cacheFile = NULL;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(tiles->cacheFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(TileCacheHeader)) {
+        closeTileCache(tiles);
+        return false;
+    }
+
+    tiles->cacheMapping = CreateFileMapping(tiles->cacheFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (tiles->cacheMapping) {
+        tiles->cacheData = (const unsigned char*)MapViewOfFile(tiles->cacheMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (!tiles->cacheData) {
+        closeTileCache(tiles);
+        return false;
+    }
+
+    tiles->cacheSize = fileSize.QuadPart;
+    tiles->cacheIndex = tileCacheIndex(tiles->cacheData, tiles->cacheSize, chartSize, chartTime);
+    if (!tiles->cacheIndex) {
+        closeTileCache(tiles);
+        return false;
+    }
+
+    const TileCacheHeader* header = (const TileCacheHeader*)tiles->cacheData;
+    const TileCacheLevel* cacheLevel = (const TileCacheLevel*)(tiles->cacheData + sizeof(TileCacheHeader));
+    tiles->width = header->width;
+    tiles->height = header->height;
+    tiles->levels = header->levels;
+
+    int firstEntry = 0;
+    for (int i = 0; i < tiles->levels; i++) {
+        TileLevel* level = &tiles->level[i];
+        level->bmp = NULL;
+        initTileLevel(level, cacheLevel[i].width, cacheLevel[i].height);
+        level->firstEntry = firstEntry;
+        firstEntry += level->tilesX * level->tilesY;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Save every tile of every level as a PNG. The file is written under a
+/// temporary name first so a partly written cache is never used.
+/// </summary>
+bool writeTileCache(ChartTiles* tiles, const char* cacheFile, ULONGLONG chartSize, ULONGLONG chartTime)
+{
+    char tempFile[256];
+    sprintf(tempFile, "%s.tmp", cacheFile);
+
+    FILE* outf = fopen(tempFile, "wb");
+    if (!outf) {
+        return false;
+    }
+
+    TileCacheHeader header;
+    tileCacheHeaderInit(&header, chartSize, chartTime, tiles->width, tiles->height, tiles->levels);
+    fwrite(&header, sizeof(header), 1, outf);
+
+    int totalTiles = 0;
+    for (int i = 0; i < tiles->levels; i++) {
+        TileCacheLevel cacheLevel;
+        cacheLevel.width = tiles->level[i].width;
+        cacheLevel.height = tiles->level[i].height;
+        cacheLevel.tilesX = tiles->level[i].tilesX;
+        cacheLevel.tilesY = tiles->level[i].tilesY;
+        fwrite(&cacheLevel, sizeof(cacheLevel), 1, outf);
+
+        tiles->level[i].firstEntry = totalTiles;
+        totalTiles += cacheLevel.tilesX * cacheLevel.tilesY;
+    }
+
+    long indexPos = ftell(outf);
+    TileCacheEntry* index = (TileCacheEntry*)calloc(totalTiles, sizeof(TileCacheEntry));
+    unsigned char* png = (unsigned char*)malloc(MaxTilePng);
+    if (index == NULL || png == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    // Leave space for the index and fill it in at the end
+    fwrite(index, sizeof(TileCacheEntry), totalTiles, outf);
+    ULONGLONG offset = indexPos + (ULONGLONG)totalTiles * sizeof(TileCacheEntry);
+
+    bool ok = true;
+    for (int i = 0; i < tiles->levels && ok; i++) {
+        TileLevel* level = &tiles->level[i];
+
+        for (int tile = 0; tile < level->tilesX * level->tilesY; tile++) {
+            int x = (tile % level->tilesX) * TileSize;
+            int y = (tile / level->tilesX) * TileSize;
+            int width = level->width - x < TileSize ? level->width - x : TileSize;
+            int height = level->height - y < TileSize ? level->height - y : TileSize;
+
+            ALLEGRO_BITMAP* sub = al_create_sub_bitmap(level->bmp, x, y, width, height);
+            ALLEGRO_FILE* memFile = al_open_memfile(png, MaxTilePng, "w");
+            ok = sub && memFile && al_save_bitmap_f(memFile, ".png", sub);
+
+            int size = memFile ? (int)al_ftell(memFile) : 0;
+            if (memFile) al_fclose(memFile);
+            if (sub) al_destroy_bitmap(sub);
+
+            if (!ok || fwrite(png, 1, size, outf) != size) {
+                ok = false;
+                break;
+            }
+
+            index[level->firstEntry + tile].offset = offset;
+            index[level->firstEntry + tile].size = size;
+            offset += size;
+        }
+    }
+
+    if (ok) {
+        fseek(outf, indexPos, SEEK_SET);
+        ok = fwrite(index, sizeof(TileCacheEntry), totalTiles, outf) == totalTiles;
+    }
+
+    free(png);
+    free(index);
+
+    if (fclose(outf) != 0) {
+        ok = false;
+    }
+
+    if (!ok || !MoveFileEx(tempFile, cacheFile, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFile(tempFile);
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Decode the chart and build all its levels in memory bitmaps.
+/// Returns false if the chart can't be loaded.
+/// </summary>
+bool decodeChart(ChartTiles* tiles, const char* filename)
+{
+    int oldFlags = al_get_new_bitmap_flags();
+    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+    ALLEGRO_BITMAP* bmp = al_load_bitmap(filename);
+    if (!bmp) {
+        al_set_new_bitmap_flags(oldFlags);
+        return false;
+    }
+
+    tiles->width = al_get_bitmap_width(bmp);
+    tiles->height = al_get_bitmap_height(bmp);
+    TileCacheLevel size[MaxTileLevels];
+    int levels = tilePyramid(tiles->width, tiles->height, size);
+    tiles->levels = 0;
+
+    while (bmp && tiles->levels < levels) {
+        TileLevel* level = &tiles->level[tiles->levels];
+        level->bmp = bmp;
+        initTileLevel(level, size[tiles->levels].width, size[tiles->levels].height);
+
+        tiles->levels++;
+
+        if (tiles->levels < levels) {
+            bmp = halveBitmap(bmp, level->width, level->height);
+        }
+    }
+
+    al_set_new_bitmap_flags(oldFlags);
+    return true;
+}
+
+/// <summary>
+/// Load a chart from its tile cache or, if the cache is missing or out
+/// of date, decode it and write a new tile cache. Returns false if the
+/// chart can't be loaded.
+/// </summary>
+bool tilesLoad(ChartTiles* tiles, const char* filename)
+{
+    tilesCleanup(tiles);
+
+    ULONGLONG startMillis = GetTickCount64();
+
+    WIN32_FILE_ATTRIBUTE_DATA attribs;
+    if (!GetFileAttributesEx(filename, GetFileExInfoStandard, &attribs)) {
+        return false;
+    }
+
+    ULONGLONG chartSize = ((ULONGLONG)attribs.nFileSizeHigh << 32) | attribs.nFileSizeLow;
+    ULONGLONG chartTime = ((ULONGLONG)attribs.ftLastWriteTime.dwHighDateTime << 32) | attribs.ftLastWriteTime.dwLowDateTime;
+    char* cacheFile = tileCacheFile(filename);
+
+    if (openTileCache(tiles, cacheFile, chartSize, chartTime)) {
+        printf("Chart %dx%d opened from tile cache in %d ms\n", tiles->width, tiles->height,
+            (int)(GetTickCount64() - startMillis));
+        return true;
+    }
+
+    if (!decodeChart(tiles, filename)) {
+        return false;
+    }
+
+    int decodeMillis = (int)(GetTickCount64() - startMillis);
+
+    // Once the tile cache is written the decoded levels aren't needed
+    if (writeTileCache(tiles, cacheFile, chartSize, chartTime)) {
+        tilesCleanup(tiles);
+        if (openTileCache(tiles, cacheFile, chartSize, chartTime)) {
+            printf("Chart %dx%d decoded in %d ms, tile cache written in %d ms\n", tiles->width, tiles->height,
+                decodeMillis, (int)(GetTickCount64() - startMillis) - decodeMillis);
+            return true;
+        }
+
+        return decodeChart(tiles, filename);
+    }
+
+    double totalPixels = 0;
+    for (int i = 0; i < tiles->levels; i++) {
+        totalPixels += (double)tiles->level[i].width * tiles->level[i].height;
+    }
+
+    printf("Chart %dx%d decoded in %d ms as %d levels using %.0f MB (no tile cache)\n", tiles->width, tiles->height,
+        decodeMillis, tiles->levels, totalPixels * 4 / (1024 * 1024));
+
+    return true;
+}
+/// <summary>
+/// Create a tile by copying its pixels from a decoded level.
+/// </summary>
+ALLEGRO_BITMAP* copyTile(TileLevel* level, int x, int y, int width, int height)
+{
+    ALLEGRO_BITMAP* bmp = al_create_bitmap(width, height);
+    if (!bmp) {
+        return NULL;
+    }
+
+    ALLEGRO_LOCKED_REGION* from = al_lock_bitmap_region(level->bmp, x, y, width, height, TileFormat, ALLEGRO_LOCK_READONLY);
+    ALLEGRO_LOCKED_REGION* to = al_lock_bitmap(bmp, TileFormat, ALLEGRO_LOCK_WRITEONLY);
+    if (from && to) {
+        for (int row = 0; row < height; row++) {
+            memcpy((char*)to->data + row * to->pitch, (char*)from->data + row * from->pitch, width * 4);
+        }
+    }
+    if (from) al_unlock_bitmap(level->bmp);
+    if (to) al_unlock_bitmap(bmp);
+
+    return bmp;
+}
+
+/// <summary>
+/// Create a tile by decoding its PNG straight out of the mapped tile cache.
+/// </summary>
+ALLEGRO_BITMAP* loadCachedTile(ChartTiles* tiles, const TileCacheEntry* entry)
+{
+    if (entry->size <= 0 || entry->offset + entry->size > tiles->cacheSize) {
+        return NULL;
+    }
+
+    ALLEGRO_FILE* memFile = al_open_memfile((void*)(tiles->cacheData + entry->offset), entry->size, "r");
+    if (!memFile) {
+        return NULL;
+    }
+
+    ALLEGRO_BITMAP* bmp = al_load_bitmap_f(memFile, ".png");
+    al_fclose(memFile);
+
+    return bmp;
+}
+
+/// <summary>
+/// Returns the video bitmap for a tile, uploading it and evicting the
+/// least recently used tile if needed. Returns NULL if the tile isn't
+/// cached and there are no uploads left for this frame.
+/// </summary>
+ALLEGRO_BITMAP* getTile(ChartTiles* tiles, int levelNum, int tx, int ty, int* uploads)
+{
+    TileLevel* level = &tiles->level[levelNum];
+    int tile = ty * level->tilesX + tx;
+
+    int slot = level->cacheSlot[tile];
+    if (slot != -1) {
+        tiles->cache[slot].lastUsed = tiles->frame;
+        return tiles->cache[slot].bmp;
+    }
+
+    if (*uploads <= 0) {
+        return NULL;
+    }
+    (*uploads)--;
+
+    slot = tileEvictSlot(tiles->cache);
+    CachedTile* cached = &tiles->cache[slot];
+    if (cached->bmp != NULL) {
+        tiles->level[cached->level].cacheSlot[cached->tile] = -1;
+        al_destroy_bitmap(cached->bmp);
+        cached->bmp = NULL;
+    }
+
+    int x = tx * TileSize;
+    int y = ty * TileSize;
+    int width = level->width - x < TileSize ? level->width - x : TileSize;
+    int height = level->height - y < TileSize ? level->height - y : TileSize;
+
+    int oldFlags = al_get_new_bitmap_flags();
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP | ALLEGRO_MIN_LINEAR);
+
+    ALLEGRO_BITMAP* bmp;
+    if (level->bmp) {
+        bmp = copyTile(level, x, y, width, height);
+    }
+    else {
+        bmp = loadCachedTile(tiles, &tiles->cacheIndex[level->firstEntry + tile]);
+    }
+
+    al_set_new_bitmap_flags(oldFlags);
+
+    if (!bmp) {
+        return NULL;
+    }
+
+    cached->bmp = bmp;
+    cached->level = levelNum;
+    cached->tile = tile;
+    cached->lastUsed = tiles->frame;
+    level->cacheSlot[tile] = slot;
+
+    return bmp;
+}
+
+/// <summary>
+/// Draw a tile of any level scaled to the display. Both edges are worked
+/// out from the chart position so adjacent tiles always meet exactly.
+/// </summary>
+void drawTile(ALLEGRO_BITMAP* bmp, int levelNum, int tx, int ty, double viewX, double viewY, double scaleX, double scaleY)
+{
+    double levelScale = 1 << levelNum;
+    int width = al_get_bitmap_width(bmp);
+    int height = al_get_bitmap_height(bmp);
+
+    double x1 = (tx * TileSize * levelScale - viewX) * scaleX;
+    double y1 = (ty * TileSize * levelScale - viewY) * scaleY;
+    double x2 = ((tx * TileSize + width) * levelScale - viewX) * scaleX;
+    double y2 = ((ty * TileSize + height) * levelScale - viewY) * scaleY;
+
+    al_draw_scaled_bitmap(bmp, 0, 0, width, height, x1, y1, x2 - x1, y2 - y1, 0);
+}
+
+/// <summary>
+/// Draw the part of the chart in the view (in chart pixels) so it fills
+/// the display. Uses the smallest level that still has at least one
+/// pixel per display pixel.
+///
+/// Only a few tiles are uploaded each frame so a newly loaded chart or a
+/// big jump doesn't stall the display. Until all the tiles are ready the
+/// smallest level, which is a single tile, is drawn underneath as a preview.
+/// </summary>
+void tilesDraw(ChartTiles* tiles, double viewX, double viewY, double viewWidth, double viewHeight, int displayWidth, int displayHeight)
+{
+    if (tiles->levels == 0) {
+        return;
+    }
+
+    tiles->frame++;
+
+    int levelNum = tileChooseLevel(viewWidth, displayWidth, tiles->levels);
+    TileLevel* level = &tiles->level[levelNum];
+    double scaleX = displayWidth / viewWidth;
+    double scaleY = displayHeight / viewHeight;
+
+    int tx1, ty1, tx2, ty2;
+    tileRange(level->tilesX, level->tilesY, levelNum, viewX, viewY, viewWidth, viewHeight, &tx1, &ty1, &tx2, &ty2);
+
+    int uploads = MaxTileUploads;
+    int missing = 0;
+
+    for (int ty = ty1; ty <= ty2; ty++) {
+        for (int tx = tx1; tx <= tx2; tx++) {
+            if (!getTile(tiles, levelNum, tx, ty, &uploads)) {
+                missing++;
+            }
+        }
+    }
+
+    if (missing > 0 && levelNum != tiles->levels - 1) {
+        int previewUploads = 1;
+        ALLEGRO_BITMAP* preview = getTile(tiles, tiles->levels - 1, 0, 0, &previewUploads);
+        if (preview) {
+            drawTile(preview, tiles->levels - 1, 0, 0, viewX, viewY, scaleX, scaleY);
+        }
+    }
+
+    uploads = 0;
+    for (int ty = ty1; ty <= ty2; ty++) {
+        for (int tx = tx1; tx <= tx2; tx++) {
+            ALLEGRO_BITMAP* bmp = getTile(tiles, levelNum, tx, ty, &uploads);
+            if (bmp) {
+                drawTile(bmp, levelNum, tx, ty, viewX, viewY, scaleX, scaleY);
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Returns the memory used by decoded levels. Tiles in the tile cache
+/// are mapped so don't count.
+/// </summary>
+ULONGLONG tilesMemory(ChartTiles* tiles)
+{
+    ULONGLONG bytes = 0;
+    for (int i = 0; i < tiles->levels; i++) {
+        if (tiles->level[i].bmp) {
+            bytes += (ULONGLONG)tiles->level[i].width * tiles->level[i].height * 4;
+        }
+    }
+
+    return bytes;
+}
+
+void tilesCleanup(ChartTiles* tiles)
+{
+    for (int i = 0; i < MaxCachedTiles; i++) {
+        if (tiles->cache[i].bmp != NULL) {
+            al_destroy_bitmap(tiles->cache[i].bmp);
+            tiles->cache[i].bmp = NULL;
+        }
+        tiles->cache[i].lastUsed = 0;
+    }
+
+    for (int i = 0; i < tiles->levels; i++) {
+        if (tiles->level[i].bmp) {
+            al_destroy_bitmap(tiles->level[i].bmp);
+        }
+        free(tiles->level[i].cacheSlot);
+    }
+
+    closeTileCache(tiles);
+
+    tiles->levels = 0;
+    tiles->width = 0;
+    tiles->height = 0;
+}
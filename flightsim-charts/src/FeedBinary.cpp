@@ -0,0 +1,295 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "FeedBinary.h"
+#include "FeedParser.h"
+
+/// Decoding is just fixed offset reads so a record can be applied
+/// as soon as all its bytes have been received.
+
+const double LocScale = 1e7;
+const double HeadingScale = 100;
+
+
+unsigned int readU16(const unsigned char* pos)
+{
+    return pos[0] | (pos[1] << 8);
+}
+
+unsigned int readU32(const unsigned char* pos)
+{
+    return pos[0] | (pos[1] << 8) | (pos[2] << 16) | ((unsigned int)pos[3] << 24);
+}
+
+void writeU16(unsigned char* pos, unsigned int val)
+{
+    pos[0] = val & 0xff;
+    pos[1] = (val >> 8) & 0xff;
+}
+
+void writeU32(unsigned char* pos, unsigned int val)
+{
+    pos[0] = val & 0xff;
+    pos[1] = (val >> 8) & 0xff;
+    pos[2] = (val >> 16) & 0xff;
+    pos[3] = (val >> 24) & 0xff;
+}
+
+double readLoc(const unsigned char* pos)
+{
+    return (int)readU32(pos) / LocScale;
+}
+
+void writeLoc(unsigned char* pos, double val)
+{
+    if (isnan(val)) {
+        writeU32(pos, FeedNoLoc);
+        return;
+    }
+
+    writeU32(pos, (unsigned int)(int)floor(val * LocScale + 0.5));
+}
+
+/// <summary>
+/// Copy a zero padded fixed size field into a null terminated string.
+/// Returns false if the text had to be cut short to fit.
+/// </summary>
+bool readFixedText(const unsigned char* pos, int fieldSize, char* text, int textSize)
+{
+    int len = 0;
+    while (len < fieldSize && pos[len] != '\0') {
+        len++;
+    }
+
+    bool fits = len < textSize;
+    if (!fits) {
+        len = textSize - 1;
+    }
+
+    memcpy(text, pos, len);
+    text[len] = '\0';
+    return fits;
+}
+
+void writeFixedText(unsigned char* pos, int fieldSize, const char* text)
+{
+    int len = (int)strlen(text);
+    if (len > fieldSize) {
+        len = fieldSize;
+    }
+
+    memcpy(pos, text, len);
+    memset(pos + len, 0, fieldSize - len);
+}
+
+bool isFeedBinary(char firstByte)
+{
+    return (unsigned char)firstByte == FeedMagic[0];
+}
+
+/// <summary>
+/// Returns the number of bytes used, 0 if more data is needed
+/// or -1 if the header is bad.
+/// </summary>
+int decodeFeedHeader(const char* data, const char* end, FeedHeader* header)
+{
+    if (end - data < FeedHeaderSize) {
+        return 0;
+    }
+
+    const unsigned char* pos = (const unsigned char*)data;
+    if (memcmp(pos, FeedMagic, sizeof(FeedMagic)) != 0 || pos[3] != FeedVersion) {
+        return -1;
+    }
+
+    header->isDelta = (pos[4] & 1) != 0;
+    header->isFull = (pos[4] & 2) != 0;
+    header->seq = readU32(&pos[8]);
+    return FeedHeaderSize;
+}
+
+/// <summary>
+/// Decode the next record. Aircraft and remove records are decoded into ai
+/// and trail records into trail. Returns the number of bytes used, 0 if
+/// more data is needed or -1 if the record is bad.
+/// </summary>
+int decodeFeedRecord(const char* data, const char* end, int* type, AI_Aircraft* ai, AI_Trail* trail, int* trailNum)
+{
+    if (data >= end) {
+        return 0;
+    }
+
+    const unsigned char* pos = (const unsigned char*)data;
+    int avail = (int)(end - data);
+    *type = pos[0];
+
+    switch (*type) {
+    case FEED_AIRCRAFT:
+    {
+        if (avail < FeedAircraftSize) {
+            return 0;
+        }
+
+        bool fits = readFixedText(&pos[1], 16, ai->callsign, sizeof(ai->callsign));
+        fits = readFixedText(&pos[17], 32, ai->airline, sizeof(ai->airline)) && fits;
+        fits = readFixedText(&pos[49], 16, ai->model, sizeof(ai->model)) && fits;
+        bool gotLoc = readU32(&pos[65]) != FeedNoLoc && readU32(&pos[69]) != FeedNoLoc;
+        ai->loc.lat = readLoc(&pos[65]);
+        ai->loc.lon = readLoc(&pos[69]);
+        ai->heading = readU16(&pos[73]) / HeadingScale;
+        ai->alt = (int)readU32(&pos[75]);
+        ai->speed = readU16(&pos[79]);
+
+        if (!checkFeedAircraft(ai, fits, gotLoc)) {
+            *type = FEED_IGNORED;
+        }
+
+        return FeedAircraftSize;
+    }
+
+    case FEED_REMOVE:
+    {
+        if (avail < FeedRemoveSize) {
+            return 0;
+        }
+
+        // Same as a text remove that is too long
+        if (!readFixedText(&pos[1], 16, ai->callsign, sizeof(ai->callsign))) {
+            *type = FEED_IGNORED;
+        }
+
+        return FeedRemoveSize;
+    }
+
+    case FEED_TRAIL:
+    {
+        // Find the record size before writing anything
+        int len = 2;
+        for (int i = 0; i < 6; i++) {
+            if (avail < len + 1) {
+                return 0;
+            }
+            len += 1 + pos[len];
+        }
+
+        if (avail < len + 2) {
+            return 0;
+        }
+
+        int count = readU16(&pos[len]);
+        const int maxLocs = sizeof(AI_Trail::loc) / sizeof(Locn);
+        if (pos[1] > 2 || count > maxLocs) {
+            return -1;
+        }
+
+        int size = len + 2 + count * 8;
+        if (avail < size) {
+            return 0;
+        }
+
+        *trailNum = pos[1];
+        char* text[6] = { trail->callsign, trail->airline, trail->modelType, trail->image, trail->fromAirport, trail->toAirport };
+        int textSize[6] = { sizeof(trail->callsign), sizeof(trail->airline), sizeof(trail->modelType),
+            sizeof(trail->image), sizeof(trail->fromAirport), sizeof(trail->toAirport) };
+
+        len = 2;
+        bool fits = true;
+        for (int i = 0; i < 6; i++) {
+            fits = readFixedText(&pos[len + 1], pos[len], text[i], textSize[i]) && fits;
+            len += 1 + pos[len];
+        }
+        len += 2;
+
+        for (int i = 0; i < count; i++) {
+            trail->loc[i].lat = readLoc(&pos[len]);
+            trail->loc[i].lon = readLoc(&pos[len + 4]);
+            len += 8;
+        }
+
+        trail->count = count;
+
+        if (!checkFeedTrail(trail, fits)) {
+            *type = FEED_IGNORED;
+        }
+
+        return size;
+    }
+
+    default:
+        return -1;
+    }
+}
+
+int encodeFeedHeader(char* buf, const FeedHeader* header)
+{
+    unsigned char* pos = (unsigned char*)buf;
+
+    memcpy(pos, FeedMagic, sizeof(FeedMagic));
+    pos[3] = FeedVersion;
+    pos[4] = (header->isDelta ? 1 : 0) | (header->isFull ? 2 : 0);
+    pos[5] = 0;
+    pos[6] = 0;
+    pos[7] = 0;
+    writeU32(&pos[8], header->seq);
+    return FeedHeaderSize;
+}
+
+int encodeFeedAircraft(char* buf, const AI_Aircraft* ai)
+{
+    unsigned char* pos = (unsigned char*)buf;
+
+    pos[0] = FEED_AIRCRAFT;
+    writeFixedText(&pos[1], 16, ai->callsign);
+    writeFixedText(&pos[17], 32, ai->airline);
+    writeFixedText(&pos[49], 16, ai->model);
+    writeLoc(&pos[65], ai->loc.lat);
+    writeLoc(&pos[69], ai->loc.lon);
+    writeU16(&pos[73], (unsigned int)floor(ai->heading * HeadingScale + 0.5));
+    writeU32(&pos[75], (unsigned int)(int)floor(ai->alt + 0.5));
+    writeU16(&pos[79], (unsigned int)floor(ai->speed + 0.5));
+    return FeedAircraftSize;
+}
+
+int encodeFeedRemove(char* buf, const char* callsign)
+{
+    unsigned char* pos = (unsigned char*)buf;
+
+    pos[0] = FEED_REMOVE;
+    writeFixedText(&pos[1], 16, callsign);
+    return FeedRemoveSize;
+}
+
+/// <summary>
+/// Buffer must be at least FeedMaxTrailSize bytes.
+/// </summary>
+int encodeFeedTrail(char* buf, int trailNum, const AI_Trail* trail)
+{
+    unsigned char* pos = (unsigned char*)buf;
+    const char* text[6] = { trail->callsign, trail->airline, trail->modelType, trail->image, trail->fromAirport, trail->toAirport };
+
+    pos[0] = FEED_TRAIL;
+    pos[1] = trailNum;
+
+    int len = 2;
+    for (int i = 0; i < 6; i++) {
+        int textLen = (int)strlen(text[i]);
+        if (textLen > 255) {
+            textLen = 255;
+        }
+        pos[len] = textLen;
+        memcpy(&pos[len + 1], text[i], textLen);
+        len += 1 + textLen;
+    }
+
+    writeU16(&pos[len], trail->count);
+    len += 2;
+
+    for (int i = 0; i < trail->count; i++) {
+        writeLoc(&pos[len], trail->loc[i].lat);
+        writeLoc(&pos[len + 4], trail->loc[i].lon);
+        len += 8;
+    }
+
+    return len;
+}
@@ -0,0 +1,169 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FeedFrame.h"
+#include "FeedBinary.h"
+
+/// The buffer must be bigger than MaxHeaderSize + RecvSize. It holds
+/// any bytes for the next response (pending) at the start, and while a
+/// response is being received it holds the part of the payload that has
+/// not been processed yet, followed by any bytes for the next response.
+
+
+int frameMode(char firstByte)
+{
+    if (firstByte == '#') {
+        return FRAME_MESSAGE;
+    }
+
+    return isFeedBinary(firstByte) ? FRAME_BINARY : FRAME_TEXT;
+}
+
+/// <summary>
+/// Drop the processed bytes from the start of the buffer. Keeps the
+/// rest of the payload and any bytes for the next response.
+/// </summary>
+void frameConsume(FeedFrame* frame, const char* tail, int* filled, int extra)
+{
+    *filled -= (int)(tail - frame->data);
+    memmove(frame->data, tail, *filled + extra);
+}
+
+/// <summary>
+/// Receive and process one response. Blocks until it is complete
+/// or recvData fails.
+/// </summary>
+ResponseStatus frameReceive(FeedFrame* frame)
+{
+    char* data = frame->data;
+    int filled = frame->pending;
+    frame->pending = 0;
+
+    // The header may have arrived with the last response
+    char* endHeader;
+    while ((endHeader = (char*)memchr(data, '\n', filled)) == NULL) {
+        if (filled >= MaxHeaderSize) {
+            printf("Listener bad response header\n");
+            return RESPONSE_INCOMPLETE;
+        }
+
+        int bytes = frame->recvData(&data[filled], RecvSize);
+        if (bytes <= 0) {
+            if (filled == 0) {
+                printf("Timeout receiving remote data\n");
+                return RESPONSE_NONE;
+            }
+            printf("Timeout receiving more remote data\n");
+            return RESPONSE_INCOMPLETE;
+        }
+        filled += bytes;
+    }
+
+    *endHeader = '\0';
+    int expected = atoi(data);
+    if (endHeader - data >= MaxHeaderSize || expected < 0) {
+        printf("Listener bad response header\n");
+        return RESPONSE_INCOMPLETE;
+    }
+
+    filled -= (int)(endHeader + 1 - data);
+    memmove(data, endHeader + 1, filled);
+
+    // Anything past the payload belongs to the next response
+    int extra = 0;
+    if (filled > expected) {
+        extra = filled - expected;
+        filled = expected;
+    }
+
+    int received = filled;
+    bool skipLine = false;
+    bool skipRest = false;
+    frame->mode = received > 0 ? frameMode(data[0]) : FRAME_TEXT;
+
+    while (true) {
+        if (skipLine) {
+            char* endLine = (char*)memchr(data, '\n', filled);
+            if (endLine) {
+                frameConsume(frame, endLine + 1, &filled, extra);
+                skipLine = false;
+            }
+            else {
+                filled = 0;
+            }
+        }
+
+        if (skipRest) {
+            filled = 0;
+        }
+        else if (frame->mode == FRAME_TEXT) {
+            frameConsume(frame, frame->processText(data, &data[filled]), &filled, extra);
+        }
+        else if (frame->mode == FRAME_BINARY) {
+            frameConsume(frame, frame->processBinary(data, &data[filled]), &filled, extra);
+        }
+
+        // Let the server apply what we have so far
+        frame->progress();
+
+        if (received == expected) {
+            break;
+        }
+
+        if (filled == frame->size - 1) {
+            // Binary records and messages can't be resynced part way through
+            if (frame->mode == FRAME_TEXT) {
+                printf("Listener line too long ignored\n");
+                skipLine = true;
+            }
+            else {
+                printf("Listener response too long ignored\n");
+                skipRest = true;
+            }
+            filled = 0;
+        }
+
+        int space = frame->size - 1 - filled;
+        if (space > RecvSize) {
+            space = RecvSize;
+        }
+        if (space > expected - received) {
+            space = expected - received;
+        }
+
+        int bytes = frame->recvData(&data[filled], space);
+        if (bytes <= 0) {
+            printf("Timeout receiving more remote data\n");
+            return RESPONSE_INCOMPLETE;
+        }
+
+        if (received == 0) {
+            frame->mode = frameMode(data[0]);
+        }
+        received += bytes;
+        filled += bytes;
+    }
+
+    if (frame->mode == FRAME_MESSAGE && !skipRest) {
+        // Terminate the message without losing the first byte of the next response
+        char saved = data[filled];
+        data[filled] = '\0';
+        frame->processMessage(data);
+        data[filled] = saved;
+    }
+
+    // An unterminated last line or partial record is dropped
+    memmove(data, &data[filled], extra);
+    frame->pending = extra;
+    return RESPONSE_OK;
+}
+
+/// <summary>
+/// Forget any bytes received for the next response, e.g. when the
+/// connection is closed.
+/// </summary>
+void frameReset(FeedFrame* frame)
+{
+    frame->pending = 0;
+}
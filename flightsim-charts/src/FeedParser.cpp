@@ -0,0 +1,304 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <string.h>
+#include "FeedParser.h"
+
+/// Aircraft lines are:
+///   callsign,airline,model,lat,lon,heading,alt,speed
+/// where any of the first three fields may be empty.
+///
+/// Trail lines are:
+///   !n!callsign!airline!modelType!image!fromAirport!toAirport!lat!lon!lat!lon...
+
+const int MaxMantissaDigits = 19;
+
+// Exactly representable powers of 10
+const double Pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MaxPow10 = sizeof(Pow10) / sizeof(double) - 1;
+
+
+/// <summary>
+/// Returns the position of the newline that ends the line
+/// or NULL if the line is incomplete.
+/// </summary>
+const char* findFeedLineEnd(const char* line, const char* end)
+{
+    return (const char*)memchr(line, '\n', end - line);
+}
+
+/// <summary>
+/// Parse a decimal number (like strtod but bounded by end).
+/// Returns the position after the number or NULL if there isn't one.
+/// </summary>
+const char* parseFeedDouble(const char* pos, const char* end, double* val)
+{
+    while (pos < end && *pos == ' ') {
+        pos++;
+    }
+
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+')) {
+        negative = *pos == '-';
+        pos++;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool gotDigit = false;
+
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        if (digits < MaxMantissaDigits) {
+            mantissa = mantissa * 10 + (*pos - '0');
+            if (mantissa != 0) {
+                digits++;
+            }
+        }
+        else {
+            exponent++;
+        }
+        gotDigit = true;
+        pos++;
+    }
+
+    if (pos < end && *pos == '.') {
+        pos++;
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            if (digits < MaxMantissaDigits) {
+                mantissa = mantissa * 10 + (*pos - '0');
+                if (mantissa != 0) {
+                    digits++;
+                }
+                exponent--;
+            }
+            gotDigit = true;
+            pos++;
+        }
+    }
+
+    if (!gotDigit) {
+        return NULL;
+    }
+
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        const char* expPos = pos + 1;
+        bool expNegative = false;
+        if (expPos < end && (*expPos == '-' || *expPos == '+')) {
+            expNegative = *expPos == '-';
+            expPos++;
+        }
+        if (expPos < end && *expPos >= '0' && *expPos <= '9') {
+            int expVal = 0;
+            while (expPos < end && *expPos >= '0' && *expPos <= '9') {
+                if (expVal < 1000) {
+                    expVal = expVal * 10 + (*expPos - '0');
+                }
+                expPos++;
+            }
+            exponent += expNegative ? -expVal : expVal;
+            pos = expPos;
+        }
+    }
+
+    double result = (double)mantissa;
+    while (exponent > MaxPow10) {
+        result *= Pow10[MaxPow10];
+        exponent -= MaxPow10;
+    }
+    while (exponent < -MaxPow10) {
+        result /= Pow10[MaxPow10];
+        exponent += MaxPow10;
+    }
+    if (exponent > 0) {
+        result *= Pow10[exponent];
+    }
+    else if (exponent < 0) {
+        result /= Pow10[-exponent];
+    }
+
+    *val = negative ? -result : result;
+    return pos;
+}
+
+/// <summary>
+/// Copy a text field up to the separator. Returns the position of the
+/// separator (or end). A field that doesn't fit is cut short and fits
+/// is set to false.
+/// </summary>
+const char* parseFeedText(const char* pos, const char* end, char sep, char* text, int maxLen, bool* fits)
+{
+    const char* fieldEnd = (const char*)memchr(pos, sep, end - pos);
+    if (!fieldEnd) {
+        fieldEnd = end;
+    }
+
+    int len = (int)(fieldEnd - pos);
+    if (len > maxLen) {
+        len = maxLen;
+        *fits = false;
+    }
+
+    memcpy(text, pos, len);
+    text[len] = '\0';
+    return fieldEnd;
+}
+
+/// <summary>
+/// Rules for an aircraft shared by the text and binary feeds. Too long
+/// fields or a missing lat/lon make it bad. Otherwise a missing callsign
+/// becomes "-" and a model of N/A becomes GRND. Returns false if bad.
+/// </summary>
+bool checkFeedAircraft(AI_Aircraft* ai, bool fits, bool gotLoc)
+{
+    if (!fits) {
+        printf("Listener bad data ignored: %s (too long)\n", ai->callsign);
+        return false;
+    }
+
+    if (!gotLoc) {
+        printf("Listener bad data ignored: %s (no location)\n", ai->callsign);
+        return false;
+    }
+
+    if (*ai->callsign == '\0') {
+        strcpy(ai->callsign, "-");
+    }
+
+    if (strcmp(ai->model, "N/A") == 0) {
+        strcpy(ai->model, "GRND");
+    }
+
+    ai->bank = 0;
+    ai->pitch = 0;
+    return true;
+}
+
+/// <summary>
+/// Rules for a trail shared by the text and binary feeds. Every text
+/// field must be present and fit. Trails for an Unknown callsign are
+/// quietly ignored. Returns false if the trail should not be used.
+/// </summary>
+bool checkFeedTrail(const AI_Trail* trail, bool fits)
+{
+    const char* text[6] = { trail->callsign, trail->airline, trail->modelType, trail->image, trail->fromAirport, trail->toAirport };
+
+    for (int col = 0; col < 6; col++) {
+        if (!fits || *text[col] == '\0') {
+            printf("Listener bad trail data ignored: %s (%d)\n", trail->callsign, col);
+            return false;
+        }
+    }
+
+    return strcmp(trail->callsign, "Unknown") != 0;
+}
+
+/// <summary>
+/// Parse an aircraft line (excluding newline). Missing airline or model
+/// become empty and heading, alt and speed default to 0. See
+/// checkFeedAircraft for the other rules. Returns false if the line is bad.
+/// </summary>
+bool parseAircraftLine(const char* line, const char* end, AI_Aircraft* ai)
+{
+    const char* pos = line;
+    char* text[3] = { ai->callsign, ai->airline, ai->model };
+    int maxLen[3] = { sizeof(ai->callsign) - 1, sizeof(ai->airline) - 1, sizeof(ai->model) - 1 };
+    bool fits = true;
+
+    for (int col = 0; col < 3; col++) {
+        pos = parseFeedText(pos, end, ',', text[col], maxLen[col], &fits);
+        if (pos == end) {
+            printf("Listener bad data ignored: %.*s (%d)\n", (int)(end - line), line, col);
+            return false;
+        }
+        pos++;
+    }
+
+    double* num[5] = { &ai->loc.lat, &ai->loc.lon, &ai->heading, &ai->alt, &ai->speed };
+    int col = 0;
+    for (; col < 5; col++) {
+        *num[col] = 0;
+    }
+
+    for (col = 0; col < 5; col++) {
+        pos = parseFeedDouble(pos, end, num[col]);
+        if (!pos) {
+            break;
+        }
+        pos = (const char*)memchr(pos, ',', end - pos);
+        if (!pos) {
+            col++;
+            break;
+        }
+        pos++;
+    }
+
+    return checkFeedAircraft(ai, fits, col >= 2);
+}
+
+/// <summary>
+/// Parse a trail line (excluding newline) into the trail.
+/// Returns the trail number or -1 if the line is bad.
+/// </summary>
+int parseTrailLine(const char* line, const char* end, AI_Trail* trail)
+{
+    if (end - line < 3 || line[0] != '!' || line[2] != '!') {
+        return -1;
+    }
+
+    int t = line[1] - '1';
+    if (t < 0 || t > 2) {
+        printf("Cannot read trail %c\n", line[1]);
+        return -1;
+    }
+
+    char* text[6] = { trail->callsign, trail->airline, trail->modelType, trail->image, trail->fromAirport, trail->toAirport };
+    int maxLen[6] = { sizeof(trail->callsign) - 1, sizeof(trail->airline) - 1, sizeof(trail->modelType) - 1,
+        sizeof(trail->image) - 1, sizeof(trail->fromAirport) - 1, sizeof(trail->toAirport) - 1 };
+
+    const char* pos = &line[3];
+    bool fits = true;
+    for (int col = 0; col < 6; col++) {
+        pos = parseFeedText(pos, end, '!', text[col], maxLen[col], &fits);
+        if (pos == end) {
+            printf("Listener bad trail data ignored: %.*s (%d)\n", (int)(end - line), line, col);
+            return -1;
+        }
+        pos++;
+    }
+
+    if (!checkFeedTrail(trail, fits)) {
+        return -1;
+    }
+
+    const int maxLocs = sizeof(trail->loc) / sizeof(Locn);
+    int i = 0;
+    bool isLat = true;
+
+    while (pos <= end && i < maxLocs) {
+        double val;
+        if (!parseFeedDouble(pos, end, &val)) {
+            val = 0;
+        }
+
+        if (isLat) {
+            trail->loc[i].lat = val;
+        }
+        else {
+            trail->loc[i].lon = val;
+            i++;
+        }
+        isLat = !isLat;
+
+        pos = (const char*)memchr(pos, '!', end - pos);
+        if (!pos) {
+            break;
+        }
+        pos++;
+    }
+
+    trail->count = i;
+    return t;
+}
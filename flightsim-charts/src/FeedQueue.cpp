@@ -0,0 +1,75 @@
+#include "Platform.h"
+#include <atomic>
+#include "FeedQueue.h"
+
+/// The producer only writes _tail and the consumer only writes _head so
+/// no locks are needed. Release/acquire ordering makes sure an update is
+/// fully written before the consumer can see it.
+
+FeedUpdate _feedQueue[FeedQueueSize];
+std::atomic<unsigned int> _feedHead(0);
+std::atomic<unsigned int> _feedTail(0);
+
+AI_Trail _feedTrail[FeedTrailStaging];
+std::atomic<bool> _feedTrailBusy[FeedTrailStaging];
+
+
+/// <summary>
+/// Called by the listener thread. Returns false if the queue is full.
+/// </summary>
+bool feedQueuePush(const FeedUpdate* update)
+{
+    unsigned int tail = _feedTail.load(std::memory_order_relaxed);
+    if (tail - _feedHead.load(std::memory_order_acquire) == FeedQueueSize) {
+        return false;
+    }
+
+    _feedQueue[tail & (FeedQueueSize - 1)] = *update;
+    _feedTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/// <summary>
+/// Called by the server thread. Returns false if the queue is empty.
+/// </summary>
+bool feedQueuePop(FeedUpdate* update)
+{
+    unsigned int head = _feedHead.load(std::memory_order_relaxed);
+    if (head == _feedTail.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    *update = _feedQueue[head & (FeedQueueSize - 1)];
+    _feedHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/// <summary>
+/// Called by the listener thread to get a free staging trail.
+/// Returns NULL if they are all waiting to be applied.
+/// </summary>
+AI_Trail* feedTrailAcquire(int* staging)
+{
+    for (int i = 0; i < FeedTrailStaging; i++) {
+        if (!_feedTrailBusy[i].load(std::memory_order_acquire)) {
+            _feedTrailBusy[i].store(true, std::memory_order_relaxed);
+            *staging = i;
+            return &_feedTrail[i];
+        }
+    }
+
+    return NULL;
+}
+
+AI_Trail* feedTrail(int staging)
+{
+    return &_feedTrail[staging];
+}
+
+/// <summary>
+/// Called by whichever thread has finished with the staging trail.
+/// </summary>
+void feedTrailRelease(int staging)
+{
+    _feedTrailBusy[staging].store(false, std::memory_order_release);
+}
@@ -0,0 +1,191 @@
+#include "Platform.h"
+#include <stdint.h>
+#include <string.h>
+#include "IconClass.h"
+
+/// Type codes are packed into a uint64 (up to 8 chars) and stored in an
+/// open addressing table. Each entry has a bit for every list the code
+/// appears in as some codes are in more than one list. Matching a packed
+/// code is the same as the old strstr of "_code_" as no code contains '_'.
+
+const int IconTableSize = 256;  // Must be a power of 2
+const int MaxIconProbe = 8;
+
+enum ICON_LIST {
+    LIST_HELI = 1 << 0,
+    LIST_TURBOPROP = 1 << 1,
+    LIST_AIRLINER = 1 << 2,
+    LIST_LARGE_AIRLINER = 1 << 3,
+    LIST_JET = 1 << 4,
+    LIST_MILITARY_HELI = 1 << 5,
+    LIST_MILITARY_JET = 1 << 6,
+    LIST_MILITARY_SMALL = 1 << 7,
+    LIST_MILITARY_OTHER = 1 << 8,
+    LIST_MILITARY_OTHER2 = 1 << 9
+};
+
+struct IconToken {
+    uint64_t key;       // 0 = empty slot
+    unsigned int lists;
+};
+
+struct IconTable {
+    IconToken slot[IconTableSize];
+    int maxProbe;
+};
+
+
+constexpr uint64_t packToken(const char* text, int len)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < len; i++) {
+        key |= (uint64_t)(unsigned char)text[i] << (i * 8);
+    }
+    return key;
+}
+
+constexpr int tokenSlot(uint64_t key)
+{
+    return (int)((key * 0x9E3779B97F4A7C15ull) >> 56) & (IconTableSize - 1);
+}
+
+constexpr void addToken(IconTable& table, uint64_t key, unsigned int list)
+{
+    int slot = tokenSlot(key);
+    int probe = 1;
+    while (table.slot[slot].key != 0 && table.slot[slot].key != key) {
+        slot = (slot + 1) & (IconTableSize - 1);
+        probe++;
+    }
+
+    table.slot[slot].key = key;
+    table.slot[slot].lists |= list;
+    if (probe > table.maxProbe) {
+        table.maxProbe = probe;
+    }
+}
+
+/// <summary>
+/// Add every code in an "_AAA_BBB_" style list.
+/// </summary>
+constexpr void addList(IconTable& table, const char* list, unsigned int listBit)
+{
+    int start = 1;
+    for (int i = 1; list[i] != '\0'; i++) {
+        if (list[i] == '_') {
+            addToken(table, packToken(&list[start], i - start), listBit);
+            start = i + 1;
+        }
+    }
+}
+
+constexpr IconTable buildIconTable()
+{
+    IconTable table = {};
+    addList(table, Heli, LIST_HELI);
+    addList(table, Turboprop, LIST_TURBOPROP);
+    addList(table, Airliner, LIST_AIRLINER);
+    addList(table, Large_Airliner, LIST_LARGE_AIRLINER);
+    addList(table, Jet, LIST_JET);
+    addList(table, Military_Heli, LIST_MILITARY_HELI);
+    addList(table, Military_Jet, LIST_MILITARY_JET);
+    addList(table, Military_Small, LIST_MILITARY_SMALL);
+    addList(table, Military_Other, LIST_MILITARY_OTHER);
+    addList(table, Military_Other2, LIST_MILITARY_OTHER2);
+    return table;
+}
+
+constexpr IconTable _iconTable = buildIconTable();
+static_assert(_iconTable.maxProbe <= MaxIconProbe, "Icon type table has too many collisions, increase IconTableSize");
+
+
+/// <summary>
+/// Returns the lists the first maxLen chars of text appear in as a
+/// whole code, the same as strstr(list, "_%.<maxLen>s_").
+/// </summary>
+unsigned int tokenLists(const char* text, int maxLen)
+{
+    int len = 0;
+    while (len < maxLen && text[len] != '\0') {
+        len++;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    uint64_t key = packToken(text, len);
+    int slot = tokenSlot(key);
+    for (int probe = 0; probe < _iconTable.maxProbe; probe++) {
+        if (_iconTable.slot[slot].key == key) {
+            return _iconTable.slot[slot].lists;
+        }
+        if (_iconTable.slot[slot].key == 0) {
+            return 0;
+        }
+        slot = (slot + 1) & (IconTableSize - 1);
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Returns an ICON_TYPE, plus IconGround for ground vehicles.
+/// Lists are checked in priority order so the first one that
+/// matches wins.
+/// </summary>
+int classifyIcon(const char* model, const char* callsign)
+{
+    if (strlen(model) > 5) {
+        return ICON_LONG_MODEL;
+    }
+
+    if (strcmp(model, "GLID") == 0 || strcmp(model, "DISC") == 0) {
+        return ICON_GLIDER;
+    }
+
+    // A ground vehicle that is airborne is classified like anything else
+    int ground = strcmp(model, "GRND") == 0 ? IconGround : 0;
+
+    unsigned int shortLists = tokenLists(model, 3);
+    unsigned int modelLists = tokenLists(model, 4);
+    unsigned int callsignLists = tokenLists(callsign, 5);
+
+    if (shortLists & LIST_HELI) {
+        return ground | ICON_HELI;
+    }
+
+    if ((shortLists | modelLists) & LIST_TURBOPROP) {
+        return ground | ICON_TURBOPROP;
+    }
+
+    if (shortLists & LIST_AIRLINER) {
+        return ground | ICON_AIRLINER;
+    }
+
+    if (shortLists & LIST_LARGE_AIRLINER) {
+        return ground | ICON_LARGE_AIRLINER;
+    }
+
+    if (shortLists & LIST_JET) {
+        return ground | ICON_JET;
+    }
+
+    if ((shortLists | callsignLists) & LIST_MILITARY_HELI) {
+        return ground | ICON_MILITARY_HELI;
+    }
+
+    if ((shortLists | callsignLists) & LIST_MILITARY_JET) {
+        return ground | ICON_MILITARY_JET;
+    }
+
+    if ((shortLists | callsignLists) & LIST_MILITARY_SMALL) {
+        return ground | ICON_MILITARY_SMALL;
+    }
+
+    if ((shortLists & LIST_MILITARY_OTHER) || (modelLists & LIST_MILITARY_OTHER2)) {
+        return ground | ICON_MILITARY_OTHER;
+    }
+
+    return ground | ICON_DEFAULT;
+}
@@ -0,0 +1,45 @@
+#include <windows.h>
+#include <iostream>
+#include <allegro5/allegro.h>
+#include "LabelAtlas.h"
+
+
+/// <summary>
+/// Returns a sub-bitmap for a new label or NULL if the atlas is full.
+/// The caller draws the label into it and destroys the sub-bitmap when done.
+/// </summary>
+ALLEGRO_BITMAP* labelAtlasAdd(LabelAtlas* atlas, int width, int height)
+{
+    int pageNum;
+    int x;
+    int y;
+    if (!atlasPlace(atlas, width, height, &pageNum, &x, &y)) {
+        return NULL;
+    }
+
+    AtlasPage* page = atlas->page[pageNum];
+    if (page->bmp == NULL) {
+        page->bmp = al_create_bitmap(AtlasPageSize, AtlasPageSize);
+        if (page->bmp == NULL) {
+            // Only a page that was just added has no bitmap
+            free(page);
+            atlas->pageCount--;
+            return NULL;
+        }
+    }
+
+    return al_create_sub_bitmap(page->bmp, x, y, width, height);
+}
+
+/// <summary>
+/// Free all pages. Any sub-bitmaps must have been destroyed first.
+/// </summary>
+void labelAtlasClear(LabelAtlas* atlas)
+{
+    for (int i = 0; i < atlas->pageCount; i++) {
+        al_destroy_bitmap(atlas->page[i]->bmp);
+        free(atlas->page[i]);
+    }
+
+    atlas->pageCount = 0;
+}
@@ -0,0 +1,132 @@
+#include "Platform.h"
+#include <iostream>
+#include <math.h>
+#include <algorithm>
+#include "LayerLod.h"
+
+struct LodCandidate {
+    long long cell;
+    int rank;
+    int item;
+};
+
+
+bool lodCandidateBefore(const LodCandidate& a, const LodCandidate& b)
+{
+    if (a.cell != b.cell) {
+        return a.cell < b.cell;
+    }
+    if (a.rank != b.rank) {
+        return a.rank > b.rank;
+    }
+
+    return a.item < b.item;
+}
+
+/// <summary>
+/// Build all the levels for a table. Locations and ranks are stride bytes
+/// apart so they can be read straight from the table. The item with the
+/// highest rank is kept in each cell or the first item if firstRank is NULL.
+/// </summary>
+void lodBuild(LayerLod* lod, const Locn* firstLoc, const int* firstRank, int stride, int count)
+{
+    lodCleanup(lod);
+
+    if (count == 0) {
+        return;
+    }
+
+    // Each level only needs to consider the items kept by the level
+    // below it because a cell is made up of four cells from that level.
+    LodCandidate* candidate = (LodCandidate*)malloc(count * sizeof(LodCandidate));
+    int* kept = (int*)malloc(count * sizeof(int));
+    if (candidate == NULL || kept == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    int keptCount = count;
+    for (int i = 0; i < count; i++) {
+        kept[i] = i;
+    }
+
+    double cellSize = LodCellSize;
+
+    for (int l = 0; l < LodLevels; l++) {
+        for (int i = 0; i < keptCount; i++) {
+            int item = kept[i];
+            const Locn* loc = (const Locn*)((const char*)firstLoc + item * stride);
+            long long row = (long long)floor(loc->lat / cellSize);
+            long long col = (long long)floor(loc->lon / cellSize);
+
+            candidate[i].cell = row * 0x100000000LL + col;
+            candidate[i].rank = firstRank ? *(const int*)((const char*)firstRank + item * stride) : 0;
+            candidate[i].item = item;
+        }
+
+        std::sort(candidate, candidate + keptCount, lodCandidateBefore);
+
+        int newCount = 0;
+        for (int i = 0; i < keptCount; i++) {
+            if (i == 0 || candidate[i].cell != candidate[i - 1].cell) {
+                kept[newCount++] = candidate[i].item;
+            }
+        }
+        keptCount = newCount;
+        std::sort(kept, kept + keptCount);
+
+        LodLevel* level = &lod->level[l];
+        level->count = keptCount;
+        level->item = (int*)malloc(keptCount * sizeof(int));
+        level->loc = (Locn*)malloc(keptCount * sizeof(Locn));
+        if (level->item == NULL || level->loc == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+
+        for (int i = 0; i < keptCount; i++) {
+            level->item[i] = kept[i];
+            level->loc[i] = *(const Locn*)((const char*)firstLoc + kept[i] * stride);
+        }
+
+        gridBuild(&level->grid, level->loc, sizeof(Locn), keptCount);
+        cellSize *= 2;
+    }
+
+    free(candidate);
+    free(kept);
+}
+
+/// <summary>
+/// Returns the most detailed level whose cells are at least minPixels
+/// across on the display or -1 if zoomed in far enough to show everything.
+/// </summary>
+int lodChooseLevel(double pixelsPerDegree, int minPixels)
+{
+    double cellPixels = LodCellSize * pixelsPerDegree;
+    if (cellPixels >= minPixels * 2) {
+        return -1;
+    }
+
+    for (int l = 0; l < LodLevels; l++) {
+        if (cellPixels >= minPixels) {
+            return l;
+        }
+        cellPixels *= 2;
+    }
+
+    return LodLevels - 1;
+}
+
+void lodCleanup(LayerLod* lod)
+{
+    for (int l = 0; l < LodLevels; l++) {
+        LodLevel* level = &lod->level[l];
+        if (level->count > 0) {
+            free(level->item);
+            free(level->loc);
+        }
+        level->count = 0;
+        gridCleanup(&level->grid);
+    }
+}
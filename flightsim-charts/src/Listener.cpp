@@ -3,6 +3,16 @@
 #include <iostream>
 #include "Server.h"
 #include "flightsim-charts.h"
+#include "AiIndex.h"
+#include "FeedParser.h"
+#include "FeedBinary.h"
+#include "FeedFrame.h"
+#include "FeedQueue.h"
+#include "IconClass.h"
+#include "Profiler.h"
+#include "Recorder.h"
+#include "ServerWait.h"
+#include "SharedData.h"
 #include "simconnect.h"
 
 /// Read aircraft data from an external source passed to our port
@@ -10,18 +20,26 @@
 /// you want to display additional aircraft on the chart.
 
 const int Port = 52025;
-const int MaxDataSize = 512000;
+const int MaxDataSize = 320000;  // Must hold the longest line (trails can be long)
 const int IntervalSecs = 3;
 const int StaleSecs = 15;
+const int ConnectTimeoutSecs = 3;
+const int MaxBackoffSecs = 30;
 
 const char* IFR_Default = "Airbus A320 Neo Asobo";
 const char* VFR_Default = "DA40-NG Asobo";
 
+extern bool _quit;
 extern HANDLE hSimConnect;
 extern bool _connected;
 extern bool _listening;
 extern char _remoteIp[32];
 extern SOCKET _sockfd;
+extern bool _listenerConnected;
+extern bool _listenerKeepAlive;
+extern bool _listenerDelta;
+extern unsigned int _listenerSeq;
+extern bool _listenerBinary;
 extern sockaddr_in _sendAddr;
 extern char* _listenerData;
 extern char* _listenerHome;
@@ -31,11 +49,30 @@ extern int _aiAircraftCount;
 extern AI_Aircraft _aiAircraft[Max_AI_Aircraft];
 extern int _aiFixedCount;
 extern AI_Fixed _aiFixed[Max_AI_Fixed];
+extern AiIndex _aiAircraftIndex;
+extern AiIndex _aiFixedIndex;
 extern int _aiModelMatchCount;
 extern AI_ModelMatch _aiModelMatch[Max_AI_ModelMatch];
 extern AI_Trail _aiTrail[3];
 extern Settings _settings;
 extern bool _clearAll;
+extern char _watchCallsign[16];
+extern bool _watchInProgress;
+
+bool _gotTrail[3];
+bool _deltaResponse;
+bool _fullResync;
+unsigned int _aiResync = 0;     // Only used by the server thread
+bool _gotFeedHeader;
+bool _badFeed;
+FeedFrame _listenerFrame;
+bool _recvTimedOut;
+
+// Prototypes
+const char* processLines(const char* data, const char* end);
+const char* processRecords(const char* data, const char* end);
+void processMessage(const char* data);
+int listenerRecv(char* buf, int len);
 
 
 void getModelMatch(const char* modelMatchFile)
@@ -134,25 +171,15 @@ void getModelMatch(const char* modelMatchFile)
     fclose(inf);
 }
 
-void listenerInit()
+/// <summary>
+/// Find the IPv4 address of the fr24server
+/// </summary>
+bool findServer()
 {
-    _aiTrail[0].count = 0;
-    _aiTrail[1].count = 0;
-    _aiTrail[2].count = 0;
-
-    srand(time(NULL));
-
-    WSADATA wsaData;
-    int err = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (err != 0) {
-        printf("Listener failed to initialise Windows Sockets: %d\n", err);
-        return;
-    }
-
     char *server = getenv("fr24server");
     if (!server) {
         printf("No fr24server\n");
-        return;
+        return false;
     }
 
     // If it's a hostname need to lookup the IPv4 address
@@ -169,7 +196,7 @@ void listenerInit()
 
         if ((status = getaddrinfo(server, NULL, &hints, &resp)) != 0) {
             printf("Failed to get address of fr24server %s: %s\n", server, gai_strerror(status));
-            return;
+            return false;
         }
 
         struct sockaddr_in* ipv4 = (struct sockaddr_in*)resp->ai_addr;
@@ -178,12 +205,52 @@ void listenerInit()
     }
 
     printf("fr24server: %s (%s)\n", _remoteIp, server);
+    return true;
+}
+
+void listenerInit()
+{
+    _aiTrail[0].count = 0;
+    _aiTrail[1].count = 0;
+    _aiTrail[2].count = 0;
+
+    srand(time(NULL));
+
+    WSADATA wsaData;
+    int err = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (err != 0) {
+        printf("Listener failed to initialise Windows Sockets: %d\n", err);
+        return;
+    }
+
+    // A replay doesn't need a server as responses come from the recording
+    if (!replaying() && !findServer()) {
+        return;
+    }
 
     _listenerHome = getenv("fr24home");
     if (_listenerHome) {
         printf("fr24home: %s\n", _listenerHome);
     }
 
+    // Server must accept multiple newline terminated requests per connection
+    if (getenv("fr24keepalive")) {
+        printf("fr24keepalive: on\n");
+        _listenerKeepAlive = true;
+    }
+
+    // Server must support the fr24d request
+    if (getenv("fr24delta")) {
+        printf("fr24delta: on\n");
+        _listenerDelta = true;
+    }
+
+    // Server may still reply in text if it doesn't support binary
+    if (getenv("fr24binary")) {
+        printf("fr24binary: on\n");
+        _listenerBinary = true;
+    }
+
     char* modelMatchFile = getenv("fr24modelmatch");
     if (modelMatchFile) {
         printf("fr24modelmatch: %s\n", modelMatchFile);
@@ -200,6 +267,15 @@ void listenerInit()
         return;
     }
 
+    _listenerFrame.data = _listenerData;
+    _listenerFrame.size = MaxDataSize;
+    _listenerFrame.pending = 0;
+    _listenerFrame.recvData = listenerRecv;
+    _listenerFrame.processText = processLines;
+    _listenerFrame.processBinary = processRecords;
+    _listenerFrame.processMessage = processMessage;
+    _listenerFrame.progress = serverFeedReady;
+
     _listening = true;
     _listenerInitFetch = true;
 }
@@ -218,7 +294,9 @@ void listenerCleanup()
         }
     }
 
-    closesocket(_sockfd);
+    if (_listenerConnected) {
+        closesocket(_sockfd);
+    }
     printf("Listener stopped\n");
 }
 
@@ -318,14 +396,10 @@ void removeStale(bool force = false)
     time_t now;
     time(&now);
 
-    int i = 0;
-    while (i < _aiAircraftCount) {
+    for (int i = 0; i < _aiAircraftCount; i++) {
         if (force || now - _aiAircraft[i].lastUpdated > StaleSecs) {
-            // Remove aircraft
-            _aiAircraftCount--;
-            cleanupTagBitmap(&_aiAircraft[i].tagData.tag);
-
-            if (_aiAircraft[i].objectId != -1) {
+            // Remove aircraft (a replay has nothing to remove it from)
+            if (_aiAircraft[i].objectId != -1 && !replaying()) {
                 if (SimConnect_AIRemoveObject(hSimConnect, _aiAircraft[i].objectId, REQ_AI_AIRCRAFT) != 0) {
                     printf("Failed to remove AI aircraft: %s\n", _aiAircraft[i].callsign);
                 }
@@ -341,242 +415,669 @@ void removeStale(bool force = false)
                 _aiTrail[2].count = 0;
             }
 
-            if (i < _aiAircraftCount) {
-                memcpy(&_aiAircraft[i], &_aiAircraft[i + 1], sizeof(AI_Aircraft) * (_aiAircraftCount - i));
-            }
-        }
-        else {
-            i++;
+            // Mark for removal
+            _aiAircraft[i].lastUpdated = 0;
         }
     }
+
+    _aiAircraftCount = aiCompact(_aiAircraft, _aiAircraftCount, &_aiAircraftIndex);
 }
 
 void removeFixed()
 {
-    int i = _aiFixedCount - 1;
-    while (i >= 0) {
-        _aiFixedCount--;
-        cleanupTagBitmap(&_aiFixed[i].tagData.tag);
-        cleanupTagBitmap(&_aiFixed[i].tagData.moreTag);
-        i--;
-    }
+    _aiFixedCount = 0;
+
+    aiIndexClear(&_aiFixedIndex);
 }
 
-int getTrail(char *line)
+/// <summary>
+/// Add or update an AI aircraft or fixed object from the feed.
+/// </summary>
+void applyAircraft(AI_Aircraft* ai)
 {
-    const int headerCols = 6;
+    if (strcmp(ai->model, "AIRP") == 0 || strcmp(ai->model, "WAYP") == 0 || strcmp(ai->model, "SRCH") == 0) {
+        int i = aiIndexFind(&_aiFixedIndex, ai->callsign);
+        if (i != -1) {
+            // Update waypoint
+            memcpy(&_aiFixed[i], ai, _snapshotDataSize);
+            strcpy(_aiFixed[i].model, ai->model);
+        }
+        else if (_aiFixedCount < Max_AI_Fixed) {
+            // Create waypoint
+            i = _aiFixedCount;
+            memcpy(&_aiFixed[i], ai, _snapshotDataSize);
+            strcpy(_aiFixed[i].tagData.tagText, ai->callsign);
+            strcpy(_aiFixed[i].model, ai->model);
+            if (*ai->airline == 'x') {
+                *_aiFixed[i].tagData.moreTagText = '\0';
+            }
+            else {
+                strcpy(_aiFixed[i].tagData.moreTagText, ai->airline);
+            }
+            aiIndexSet(&_aiFixedIndex, ai->callsign, i);
+            _aiFixedCount++;
+        }
+    }
+    else {
+        int i = aiIndexFind(&_aiAircraftIndex, ai->callsign);
+        if (i != -1) {
+            // Update aircraft
+            memcpy(&_aiAircraft[i], ai, _snapshotDataSize);
+            strcpy(_aiAircraft[i].airline, ai->airline);
+            time(&_aiAircraft[i].lastUpdated);
+            _aiAircraft[i].resync = _aiResync;
+
+            if (strcmp(_aiAircraft[i].model, ai->model) != 0) {
+                strcpy(_aiAircraft[i].model, ai->model);
+                _aiAircraft[i].iconType = classifyIcon(ai->model, ai->callsign);
+            }
 
-    if (line[0] != '!' || line[2] != '!') {
-        return -1;
+            if (_connected && _aiAircraft[i].objectId != -1) {
+                if (SimConnect_SetDataOnSimObject(hSimConnect, DEF_SNAPSHOT, _aiAircraft[i].objectId, 0, 0, _snapshotDataSize, &_aiAircraft[i]) != 0) {
+                    if (SimConnect_AICreateNonATCAircraft(hSimConnect, getModelName(*ai),
+                        ai->callsign, getAircraftPos(*ai), REQ_AI_AIRCRAFT) != 0) {
+                        printf("Failed to create/update AI aircraft: %s\n", ai->callsign);
+                    }
+                }
+            }
+        }
+        else if (_aiAircraftCount < Max_AI_Aircraft) {
+            // Add aircraft
+            i = _aiAircraftCount;
+            memcpy(&_aiAircraft[i], ai, _snapshotDataSize);
+            strcpy(_aiAircraft[i].callsign, ai->callsign);
+            strcpy(_aiAircraft[i].airline, ai->airline);
+            strcpy(_aiAircraft[i].model, ai->model);
+            time(&_aiAircraft[i].lastUpdated);
+            _aiAircraft[i].resync = _aiResync;
+            _aiAircraft[i].objectId = -1;
+            _aiAircraft[i].iconType = classifyIcon(ai->model, ai->callsign);
+
+            // Create a tag so we can still draw the AI aircraft if FS2020 is disconnected
+            createTagText(ai->callsign, ai->model, _aiAircraft[i].tagData.tagText);
+            *_aiAircraft[i].tagData.moreTagText = '\0';
+
+            aiIndexSet(&_aiAircraftIndex, ai->callsign, i);
+            _aiAircraftCount++;
+
+            if (_connected) {
+                if (SimConnect_AICreateNonATCAircraft(hSimConnect, getModelName(*ai),
+                    ai->callsign, getAircraftPos(*ai), REQ_AI_AIRCRAFT) != 0) {
+                    printf("Failed to create AI aircraft: %s\n", ai->callsign);
+                }
+            }
+        }
     }
+}
 
-    int t = line[1] - '1';
-    if (t < 0 || t > 2) {
-        printf("Cannot read trail %c\n", line[1]);
-        return -1;
+/// <summary>
+/// Unchanged aircraft are not resent in a delta so they are still current.
+/// A full resync starts a new generation. Aircraft are only removed for
+/// not being resent once the whole resync has arrived, see applyEnd.
+/// </summary>
+void applyDelta(bool full)
+{
+    if (full) {
+        _aiResync++;
+        return;
     }
 
-    int cols = sscanf(&line[2], "!%15[^!]!%63[^!]!%63[^!]!%255[^!]!%127[^!]!%127[^!]!",
-        _aiTrail[t].callsign, _aiTrail[t].airline, _aiTrail[t].modelType, _aiTrail[t].image, _aiTrail[t].fromAirport, _aiTrail[t].toAirport);
+    time_t now;
+    time(&now);
 
-    if (cols != headerCols) {
-        printf("Listener bad trail data ignored: %s (%d)\n", line, cols);
-        return false;
+    for (int i = 0; i < _aiAircraftCount; i++) {
+        _aiAircraft[i].lastUpdated = now;
     }
+}
 
-    if (strcmp(_aiTrail[t].callsign, "Unknown") == 0) {
-        return -1;
+/// <summary>
+/// Aircraft has gone. It will be removed with the stale aircraft.
+/// </summary>
+void applyRemove(const char* callsign)
+{
+    int i = aiIndexFind(&_aiAircraftIndex, callsign);
+    if (i != -1) {
+        _aiAircraft[i].lastUpdated = 0;
     }
+}
 
-    int pos = 3;
-    int col = 0;
-    int i = 0;
-    bool isLat = true;
+void applyTrail(int t, AI_Trail* trail)
+{
+    strcpy(_aiTrail[t].callsign, trail->callsign);
+    strcpy(_aiTrail[t].airline, trail->airline);
+    strcpy(_aiTrail[t].modelType, trail->modelType);
+    strcpy(_aiTrail[t].image, trail->image);
+    strcpy(_aiTrail[t].fromAirport, trail->fromAirport);
+    strcpy(_aiTrail[t].toAirport, trail->toAirport);
+    memcpy(_aiTrail[t].loc, trail->loc, sizeof(Locn) * trail->count);
+    _aiTrail[t].count = trail->count;
+}
 
-    while (line[pos] != '\0') {
-        if (line[pos] == '!') {
-            pos++;
-            col++;
+/// <summary>
+/// Clear any trails that were not in the response. At the end of a
+/// full resync any aircraft that wasn't resent has gone.
+/// </summary>
+void applyEnd(int gotTrailMask, bool full)
+{
+    for (int t = 0; t < 3; t++) {
+        if ((gotTrailMask & (1 << t)) == 0) {
+            _aiTrail[t].count = 0;
+            *_aiTrail[t].image = '\0';
+        }
+    }
 
-            if (col >= headerCols) {
-                if (isLat) {
-                    _aiTrail[t].loc[i].lat = atof(&line[pos]);
-                }
-                else {
-                    _aiTrail[t].loc[i].lon = atof(&line[pos]);
-                    i++;
-                }
-                isLat = !isLat;
+    if (full) {
+        for (int i = 0; i < _aiAircraftCount; i++) {
+            if (_aiAircraft[i].resync != _aiResync) {
+                _aiAircraft[i].lastUpdated = 0;
             }
         }
-        else {
-            pos++;
+    }
+}
+
+/// <summary>
+/// Copy what the render thread needs to draw the AI aircraft
+/// into a new frame and publish it.
+/// </summary>
+void publishAiFrame()
+{
+    AiFrame* frame = aiFrameWrite();
+
+    for (int i = 0; i < _aiAircraftCount; i++) {
+        AiFrameAircraft* ai = &frame->aircraft[i];
+        ai->loc = _aiAircraft[i].loc;
+        ai->heading = _aiAircraft[i].heading;
+        ai->alt = _aiAircraft[i].alt;
+        ai->speed = _aiAircraft[i].speed;
+        ai->iconType = _aiAircraft[i].iconType;
+        strcpy(ai->callsign, _aiAircraft[i].callsign);
+        strcpy(ai->tagText, _aiAircraft[i].tagData.tagText);
+    }
+
+    frame->count = _aiAircraftCount;
+    aiFramePublish();
+}
+
+/// <summary>
+/// Called by the server thread to apply all the updates queued
+/// by the listener thread. Updates to the AI tables and to
+/// SimConnect only ever happen on the server thread.
+/// </summary>
+void listenerApply()
+{
+    ZoneTimer timer(ZONE_FEED_APPLY);
+    FeedUpdate update;
+    bool applied = false;
+
+    while (feedQueuePop(&update)) {
+        applied = true;
+        switch (update.type) {
+        case UPDATE_AIRCRAFT:
+            applyAircraft(&update.ai);
+            break;
+        case UPDATE_REMOVE:
+            applyRemove(update.ai.callsign);
+            break;
+        case UPDATE_DELTA:
+            applyDelta(update.full);
+            break;
+        case UPDATE_TRAIL:
+            applyTrail(update.trailNum, feedTrail(update.staging));
+            feedTrailRelease(update.staging);
+            break;
+        case UPDATE_END:
+            applyEnd(update.trailNum, update.full);
+            break;
+        case UPDATE_STALE:
+            removeStale();
+            break;
+        case UPDATE_CLEAR_AIRCRAFT:
+            removeStale(true);
+            break;
+        case UPDATE_CLEAR_FIXED:
+            removeFixed();
+            break;
+        }
+    }
+
+    if (applied) {
+        publishAiFrame();
+    }
+}
+
+/// <summary>
+/// Queue an update for the server thread. Waits if the queue is full.
+/// </summary>
+void postUpdate(FeedUpdate* update)
+{
+    while (!feedQueuePush(update)) {
+        if (_quit) {
+            return;
+        }
+        serverFeedReady();
+        Sleep(1);
+    }
+}
+
+void postUpdate(int type)
+{
+    FeedUpdate update;
+    update.type = type;
+    postUpdate(&update);
+}
+
+void postClearAircraft()
+{
+    postUpdate(UPDATE_CLEAR_AIRCRAFT);
+
+    // Need a full resync if using deltas
+    _listenerSeq = 0;
+}
+
+/// <summary>
+/// Get a staging trail to parse into. Waits if they are
+/// all still waiting to be applied.
+/// </summary>
+AI_Trail* waitForTrail(int* staging)
+{
+    AI_Trail* trail;
+    while ((trail = feedTrailAcquire(staging)) == NULL) {
+        if (_quit) {
+            return NULL;
         }
+        serverFeedReady();
+        Sleep(1);
     }
 
-    _aiTrail[t].count = i;
+    return trail;
+}
 
-    return t;
+void postTrail(int t, int staging)
+{
+    FeedUpdate update;
+    update.type = UPDATE_TRAIL;
+    update.trailNum = t;
+    update.staging = staging;
+    postUpdate(&update);
+
+    _gotTrail[t] = true;
+}
+
+void processBegin()
+{
+    _gotTrail[0] = false;
+    _gotTrail[1] = false;
+    _gotTrail[2] = false;
+    _deltaResponse = false;
+    _fullResync = false;
+    _gotFeedHeader = false;
+    _badFeed = false;
 }
 
-void processData(char *data)
+void processDelta(unsigned int seq, bool full)
 {
-    bool gotTrail[3];
-    gotTrail[0] = false;
-    gotTrail[1] = false;
-    gotTrail[2] = false;
+    _listenerSeq = seq;
+    _deltaResponse = true;
+    _fullResync = full;
+
+    FeedUpdate update;
+    update.type = UPDATE_DELTA;
+    update.full = full;
+    postUpdate(&update);
+}
 
-    while (*data != '\0') {
-        char* line = data;
-        char* endLine = strchr(line, '\n');
+/// <summary>
+/// A response to fr24d starts with @seq for changes since the sequence
+/// number we sent or @seq,full for a full resync. Trails are always sent
+/// in full.
+/// </summary>
+void processDeltaHeader(const char* line)
+{
+    if (!isdigit(line[1])) {
+        printf("Listener bad delta header ignored\n");
+        return;
+    }
+
+    char* pos;
+    unsigned int seq = strtoul(&line[1], &pos, 10);
+    processDelta(seq, strncmp(pos, ",full", 5) == 0);
+}
+
+/// <summary>
+/// A delta line of -callsign means the aircraft has gone.
+/// </summary>
+void processDeltaRemove(const char* line, const char* end)
+{
+    FeedUpdate update;
+    int len = (int)(end - line) - 1;
+    if (len <= 0 || len >= (int)sizeof(update.ai.callsign)) {
+        return;
+    }
+
+    update.type = UPDATE_REMOVE;
+    memcpy(update.ai.callsign, &line[1], len);
+    update.ai.callsign[len] = '\0';
+    postUpdate(&update);
+}
+
+/// <summary>
+/// Process all the complete lines in the data. Returns the start
+/// of any partial line that still needs more data.
+/// </summary>
+const char* processLines(const char* data, const char* end)
+{
+    ZoneTimer timer(ZONE_FEED_PARSE);
+
+    while (data < end) {
+        const char* line = data;
+        const char* endLine = findFeedLineEnd(line, end);
         if (!endLine) {
-            return;
+            break;
         }
-        *endLine = '\0';
-        data += strlen(line) + 1;
+        data = endLine + 1;
 
         if (line[0] == '!') {
-            int t = getTrail(line);
-            if (t != -1) {
-                gotTrail[t] = true;
+            int staging;
+            AI_Trail* trail = waitForTrail(&staging);
+            if (trail) {
+                int t = parseTrailLine(line, endLine, trail);
+                if (t != -1) {
+                    postTrail(t, staging);
+                }
+                else {
+                    feedTrailRelease(staging);
+                }
             }
             continue;
         }
 
-        AI_Aircraft ai;
+        if (line[0] == '@') {
+            processDeltaHeader(line);
+            continue;
+        }
 
-        int cols = sscanf(line, "%15[^,],%31[^,],%15[^,],%lf,%lf,%lf,%lf,%lf",
-            ai.callsign, ai.airline, ai.model, &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
+        if (line[0] == '-' && _deltaResponse) {
+            processDeltaRemove(line, endLine);
+            continue;
+        }
 
-        if (cols == 0) {
-            // Missing callsign
-            strcpy(ai.callsign, "-");
-            cols = sscanf(line, ",%31[^,],%15[^,],%lf,%lf,%lf,%lf,%lf",
-                ai.airline, ai.model, &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
+        FeedUpdate update;
+        if (parseAircraftLine(line, endLine, &update.ai)) {
+            update.type = UPDATE_AIRCRAFT;
+            postUpdate(&update);
+        }
+    }
 
-            if (cols == 0) {
-                // Missing callsign and airline
-                *ai.airline = '\0';
-                cols = sscanf(line, ",,%15[^,],%lf,%lf,%lf,%lf,%lf",
-                    ai.model, &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
-            }
+    return data;
+}
 
-            if (cols == 0) {
-                // Missing callsign and airline and model
-                *ai.model = '\0';
-                cols = sscanf(line, ",,,%lf,%lf,%lf,%lf,%lf",
-                    &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
-            }
+/// <summary>
+/// Process all the complete records in binary data. Returns the start
+/// of any partial record that still needs more data.
+/// </summary>
+const char* processRecords(const char* data, const char* end)
+{
+    ZoneTimer timer(ZONE_FEED_PARSE);
+
+    if (_badFeed) {
+        return end;
+    }
+
+    if (!_gotFeedHeader) {
+        FeedHeader header;
+        int len = decodeFeedHeader(data, end, &header);
+        if (len == 0) {
+            return data;
+        }
+        if (len < 0) {
+            printf("Listener bad binary header ignored\n");
+            _badFeed = true;
+            return end;
+        }
+        if (header.isDelta) {
+            processDelta(header.seq, header.isFull);
         }
-        else if (cols == 1) {
-            // Missing airline
-            *ai.airline = '\0';
-            cols = sscanf(line, "%15[^,],,%15[^,],%lf,%lf,%lf,%lf,%lf",
-                ai.callsign, ai.model, &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
-
-            if (cols == 1) {
-                // Missing airline and model
-                *ai.model = '\0';
-                cols = sscanf(line, "%15[^,],,,%lf,%lf,%lf,%lf,%lf",
-                    ai.callsign, &ai.loc.lat, &ai.loc.lon, &ai.heading, &ai.alt, &ai.speed);
+        _gotFeedHeader = true;
+        data += len;
+    }
+
+    while (data < end) {
+        int type;
+        int t;
+        int staging = -1;
+        AI_Trail* trail = NULL;
+        FeedUpdate update;
+
+        if ((unsigned char)*data == FEED_TRAIL) {
+            trail = waitForTrail(&staging);
+            if (!trail) {
+                return end;
             }
         }
 
-        if (cols < 5) {
-            printf("Listener bad data ignored: %s (%d)\n", line, cols);
+        int len = decodeFeedRecord(data, end, &type, &update.ai, trail, &t);
+        if (len <= 0 && trail) {
+            feedTrailRelease(staging);
         }
-        else {
-            if (strcmp(ai.model, "N/A") == 0) {
-                strcpy(ai.model, "GRND");
+        if (len == 0) {
+            break;
+        }
+        if (len < 0) {
+            printf("Listener bad binary record type %d ignored\n", type);
+            _badFeed = true;
+            return end;
+        }
+        data += len;
+
+        switch (type) {
+        case FEED_AIRCRAFT:
+            update.type = UPDATE_AIRCRAFT;
+            postUpdate(&update);
+            break;
+        case FEED_REMOVE:
+            update.type = UPDATE_REMOVE;
+            postUpdate(&update);
+            break;
+        case FEED_TRAIL:
+            postTrail(t, staging);
+            break;
+        case FEED_IGNORED:
+            if (trail) {
+                feedTrailRelease(staging);
             }
+            break;
+        }
+    }
 
-            ai.bank = 0;
-            ai.pitch = 0;
-
-            if (strcmp(ai.model, "AIRP") == 0 || strcmp(ai.model, "WAYP") == 0 || strcmp(ai.model, "SRCH") == 0) {
-                int i = 0;
-                for (; i < _aiFixedCount; i++) {
-                    if (strcmp(ai.callsign, _aiFixed[i].tagData.tagText) == 0) {
-                        // Update waypoint
-                        memcpy(&_aiFixed[i], &ai, _snapshotDataSize);
-                        strcpy(_aiFixed[i].model, ai.model);
-                        break;
-                    }
-                }
+    return data;
+}
 
-                if (i == _aiFixedCount && _aiFixedCount < Max_AI_Fixed) {
-                    // Create waypoint
-                    memcpy(&_aiFixed[i], &ai, _snapshotDataSize);
-                    strcpy(_aiFixed[i].tagData.tagText, ai.callsign);
-                    strcpy(_aiFixed[i].model, ai.model);
-                    if (*ai.airline == 'x') {
-                        *_aiFixed[i].tagData.moreTagText = '\0';
-                    }
-                    else {
-                        strcpy(_aiFixed[i].tagData.moreTagText, ai.airline);
-                    }
-                    // Tag will be created later by single-threaded drawing thread
-                    _aiFixed[i].tagData.tag.bmp = NULL;
-                    _aiFixed[i].tagData.moreTag.bmp = NULL;
-                    _aiFixedCount++;
-                }
-            }
-            else {
-                int i = 0;
-                for (; i < _aiAircraftCount; i++) {
-                    if (strcmp(ai.callsign, _aiAircraft[i].callsign) == 0) {
-                        // Update aircraft
-                        memcpy(&_aiAircraft[i], &ai, _snapshotDataSize);
-                        strcpy(_aiAircraft[i].airline, ai.airline);
-                        strcpy(_aiAircraft[i].model, ai.model);
-                        time(&_aiAircraft[i].lastUpdated);
-
-                        if (_connected && _aiAircraft[i].objectId != -1) {
-                            if (SimConnect_SetDataOnSimObject(hSimConnect, DEF_SNAPSHOT, _aiAircraft[i].objectId, 0, 0, _snapshotDataSize, &_aiAircraft[i]) != 0) {
-                                if (SimConnect_AICreateNonATCAircraft(hSimConnect, getModelName(ai),
-                                    ai.callsign, getAircraftPos(ai), REQ_AI_AIRCRAFT) != 0) {
-                                    printf("Failed to create/update AI aircraft: %s\n", ai.callsign);
-                                }
-                            }
-                        }
-                        break;
-                    }
-                }
+void processEnd()
+{
+    FeedUpdate update;
+    update.type = UPDATE_END;
+    update.trailNum = (_gotTrail[0] ? 1 : 0) | (_gotTrail[1] ? 2 : 0) | (_gotTrail[2] ? 4 : 0);
+    update.full = _fullResync;
+    postUpdate(&update);
+}
 
-                if (i == _aiAircraftCount && _aiAircraftCount < Max_AI_Aircraft) {
-                    // Add aircraft
-                    memcpy(&_aiAircraft[i], &ai, _snapshotDataSize);
-                    strcpy(_aiAircraft[i].callsign, ai.callsign);
-                    strcpy(_aiAircraft[i].airline, ai.airline);
-                    strcpy(_aiAircraft[i].model, ai.model);
-                    time(&_aiAircraft[i].lastUpdated);
-                    _aiAircraft[i].objectId = -1;
-
-                    // Create a tag so we can still draw the AI aircraft if FS2020 is disconnected
-                    createTagText(ai.callsign, ai.model, _aiAircraft[i].tagData.tagText);
-                    // Tag will be created later by single-threaded drawing thread
-                    _aiAircraft[i].tagData.tag.bmp = NULL;
-                    _aiAircraft[i].tagData.moreTag.bmp = NULL;
-
-                    _aiAircraftCount++;
-
-                    if (_connected) {
-                        if (SimConnect_AICreateNonATCAircraft(hSimConnect, getModelName(ai),
-                            ai.callsign, getAircraftPos(ai), REQ_AI_AIRCRAFT) != 0) {
-                            printf("Failed to create AI aircraft: %s\n", ai.callsign);
-                        }
-                    }
-                }
-            }
+void processMessage(const char* data)
+{
+    if (strlen(data) > 1) {
+        printf("%s\n", data);
+    }
+
+    if (strncmp(data, "# Clear,", 8) == 0) {
+        if (strncmp(&data[8], "all", 3) == 0 || strncmp(&data[8], "home", 4) == 0) {
+            postClearAircraft();
+        }
+        postUpdate(UPDATE_CLEAR_FIXED);
+
+        if (strncmp(&data[8], "all", 3) == 0 || strncmp(&data[8], "wayp", 4) == 0) {
+            _listenerInitFetch = true;
         }
     }
 
-    for (int t = 0; t < 3; t++) {
-        if (!gotTrail[t]) {
-            _aiTrail[t].count = 0;
-            *_aiTrail[t].image = '\0';
+    const char* imgPos = strstr(data, "Image: ");
+    if (imgPos != NULL) {
+        char img[256];
+        strncpy(img, imgPos + 7, 254);
+        img[255] = '\0';
+        char* eol = strchr(img, '\n');
+        if (eol != NULL) {
+            *eol = '\0';
         }
+
+        if (_settings.showAiPhotos) {
+            // Launch a browser to view the aircraft image
+            ShellExecute(0, 0, img, 0, 0, SW_SHOW);
+        }
+    }
+}
+
+bool connectWithTimeout()
+{
+    // Connect in non-blocking mode so an unreachable server
+    // can't stall the server loop for the full TCP timeout.
+    unsigned long nonBlocking = 1;
+    ioctlsocket(_sockfd, FIONBIO, &nonBlocking);
+
+    bool connected = connect(_sockfd, (sockaddr*)&_sendAddr, sizeof(_sendAddr)) == 0;
+    if (!connected && WSAGetLastError() == WSAEWOULDBLOCK) {
+        fd_set writeSet;
+        fd_set errorSet;
+        FD_ZERO(&writeSet);
+        FD_ZERO(&errorSet);
+        FD_SET(_sockfd, &writeSet);
+        FD_SET(_sockfd, &errorSet);
+
+        timeval timeout;
+        timeout.tv_sec = ConnectTimeoutSecs;
+        timeout.tv_usec = 0;
+
+        connected = select(0, NULL, &writeSet, &errorSet, &timeout) > 0 && FD_ISSET(_sockfd, &writeSet);
+    }
+
+    nonBlocking = 0;
+    ioctlsocket(_sockfd, FIONBIO, &nonBlocking);
+    return connected;
+}
+
+/// <summary>
+/// Connect to the remote server. After a failure further attempts are
+/// skipped for an increasing time so requests fail fast rather than
+/// waiting on connects that are unlikely to succeed.
+/// </summary>
+bool listenerConnect()
+{
+    static time_t nextAttempt = 0;
+    static int backoffSecs = 0;
+
+    time_t now;
+    time(&now);
+
+    if (now < nextAttempt) {
+        return false;
+    }
+
+    if ((_sockfd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) {
+        printf("Listener failed to create TCP socket\n");
+        return false;
+    }
+
+    if (!connectWithTimeout()) {
+        printf("Failed to connect to %s port %d\n", _remoteIp, Port);
+        closesocket(_sockfd);
+
+        backoffSecs = backoffSecs == 0 ? 1 : backoffSecs * 2;
+        if (backoffSecs > MaxBackoffSecs) {
+            backoffSecs = MaxBackoffSecs;
+        }
+        nextAttempt = now + backoffSecs;
+        return false;
+    }
+
+    backoffSecs = 0;
+    nextAttempt = 0;
+
+    // Wait for data
+    int timeout = 15000;
+    setsockopt(_sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(int));
+
+    if (_listenerKeepAlive) {
+        int enable = 1;
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&enable, sizeof(int));
+        setsockopt(_sockfd, SOL_SOCKET, SO_KEEPALIVE, (char*)&enable, sizeof(int));
+    }
+
+    _listenerConnected = true;
+    return true;
+}
+
+void listenerDisconnect()
+{
+    if (_listenerConnected) {
+        closesocket(_sockfd);
+        _listenerConnected = false;
     }
+
+    // Anything left over came from the old connection
+    frameReset(&_listenerFrame);
+}
+
+/// <summary>
+/// Receive from the fr24 server, or from the recording when replaying.
+/// </summary>
+int listenerRecv(char* buf, int len)
+{
+    if (replaying()) {
+        return replayFeed(buf, len);
+    }
+
+    int bytes = recv(_sockfd, buf, len, 0);
+    if (bytes > 0 && recording()) {
+        recordFeed(buf, bytes);
+    }
+    _recvTimedOut = bytes < 0 && WSAGetLastError() == WSAETIMEDOUT;
+
+    return bytes;
+}
+
+/// <summary>
+/// Receive the response to a request. Data lines are processed as soon as
+/// they arrive so there is no limit on the size of the response, only on
+/// the length of a single line.
+/// </summary>
+ResponseStatus receiveResponse()
+{
+    processBegin();
+
+    ResponseStatus status = frameReceive(&_listenerFrame);
+    if (status == RESPONSE_OK && _listenerFrame.mode != FRAME_MESSAGE) {
+        processEnd();
+    }
+
+    if (recording()) {
+        recordFeedEnd();
+    }
+
+    return status;
+}
+
+ResponseStatus sendRequest(const char* request)
+{
+    //printf("Request: %s\n", request);
+    int bytes = send(_sockfd, request, strlen(request), 0);
+    if (bytes > 0 && _listenerKeepAlive) {
+        bytes = send(_sockfd, "\n", 1, 0);
+    }
+
+    if (bytes <= 0) {
+        printf("Failed to request remote data\n");
+        return RESPONSE_NONE;
+    }
+
+    return receiveResponse();
 }
 
 /// <summary>
@@ -597,8 +1098,9 @@ bool listenerRead(const char* request, int waitMillis, bool immediate)
 
     if (_clearAll) {
         _clearAll = false;
-        removeStale(true);
-        removeFixed();
+        postClearAircraft();
+        postUpdate(UPDATE_CLEAR_FIXED);
+        serverFeedReady();
         _listenerInitFetch = true;
         Sleep(waitMillis);
         return false;
@@ -611,106 +1113,115 @@ bool listenerRead(const char* request, int waitMillis, bool immediate)
 
     time(&lastRequest);
 
-    // Request data from remote server using a TCP socket
-    if ((_sockfd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) {
-        printf("Listener failed to create TCP socket\n");
-        return false;
+    // Request data from remote server using a TCP socket. A kept alive
+    // connection may have been closed by the server since the last
+    // request so allow one retry on a new connection. A server that
+    // didn't answer in time isn't tried again, that would be another
+    // full timeout.
+    int attempts = _listenerConnected ? 2 : 1;
+    ResponseStatus status = RESPONSE_NONE;
+    _recvTimedOut = false;
+
+    for (int attempt = 0; attempt < attempts && status == RESPONSE_NONE && !_recvTimedOut; attempt++) {
+        if (!_listenerConnected && !listenerConnect()) {
+            postClearAircraft();
+            serverFeedReady();
+            Sleep(waitMillis);
+            return false;
+        }
+
+        {
+            ZoneTimer timer(ZONE_FEED_REQUEST);
+            status = sendRequest(request);
+        }
+
+        if (status != RESPONSE_OK || !_listenerKeepAlive) {
+            listenerDisconnect();
+        }
     }
-    
-    if (connect(_sockfd, (sockaddr*)&_sendAddr, sizeof(_sendAddr)) != 0) {
-        printf("Failed to connect to %s port %d\n", _remoteIp, Port);
-        closesocket(_sockfd);
-        removeStale(true);
-        Sleep(waitMillis);
-        return false;
+
+    if (status == RESPONSE_INCOMPLETE) {
+        // Need a full resync if using deltas
+        _listenerSeq = 0;
     }
 
-    //printf("Request: %s\n", request);
-    int bytes = send(_sockfd, request, strlen(request), 0);
-    if (bytes <= 0) {
-        printf("Failed to request remote data\n");
-        closesocket(_sockfd);
-        removeStale(true);
-        Sleep(waitMillis);
-        return false;
+    bool success = status == RESPONSE_OK;
+    if (success && strncmp(request, "fr24", 4) != 0) {
+        // Don't wait before sending next request
+        lastRequest = 0;
     }
 
-    // Wait for data
-    int timeout = 15000;
-    setsockopt(_sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(int));
+    // Only a complete response says which aircraft are still there
+    if (success) {
+        postUpdate(UPDATE_STALE);
+    }
+    serverFeedReady();
+    return success;
+}
 
-    bool success = false;
-    bytes = recv(_sockfd, _listenerData, MaxDataSize - 1, 0);
-    //printf("Received: %d bytes\n", bytes);
-    if (bytes > 0) {
-        int expected = atoi(_listenerData);
-        char *data = strchr(_listenerData, '\n') + 1;
-        int header = data - _listenerData;
-
-        while (bytes - header < expected && bytes < MaxDataSize) {
-            // Wait for more data
-            int moreBytes = recv(_sockfd, &_listenerData[bytes], MaxDataSize - bytes, 0);
-            if (moreBytes > 0) {
-                bytes += moreBytes;
+/// <summary>
+/// Listener thread. Requests data from the remote server and queues
+/// the parsed updates so a slow or unresponsive server never holds
+/// up the server thread.
+/// </summary>
+void listener()
+{
+    int loopMillis = 50;
+
+    while (!_quit) {
+        char request[256];
+        bool immediate = false;
+
+        if (_watchInProgress) {
+            sprintf(request, "watch,%s", _watchCallsign);
+            immediate = true;
+        }
+        else if (_listenerInitFetch) {
+            if (_listenerHome) {
+                sprintf(request, "home,%s", _listenerHome);
             }
             else {
-                printf("Timeout receiving more remote data\n");
-                return false;
+                strcpy(request, "wayp");
             }
+            immediate = true;
+        }
+        else if (_listenerDelta) {
+            sprintf(request, "fr24d,%u", _listenerSeq);
+        }
+        else {
+            strcpy(request, "fr24");
         }
 
-        // printf("Received %ld bytes from %s\n", bytes, _remoteIp);
-        _listenerData[bytes] = '\0';
-
-        if (data[0] == '#') {
-            if (strlen(data) > 1) {
-                printf("%s\n", data);
-            }
-
-            if (strncmp(data, "# Clear,", 8) == 0) {
-                if (strncmp(&data[8], "all", 3) == 0 || strncmp(&data[8], "home", 4) == 0) {
-                    removeStale(true);
-                }
-                removeFixed();
+        if (_listenerBinary && strncmp(request, "fr24", 4) == 0) {
+            strcat(request, ",bin");
+        }
 
-                if (strncmp(&data[8], "all", 3) == 0 || strncmp(&data[8], "wayp", 4) == 0) {
-                    _listenerInitFetch = true;
-                }
+        if (listenerRead(request, loopMillis, immediate) && _listenerInitFetch) {
+            if (_listenerHome) {
+                _listenerHome = NULL;
             }
-
-            char* imgPos = strstr(data, "Image: ");
-            if (imgPos != NULL) {
-                char img[256];
-                strncpy(img, imgPos + 7, 254);
-                img[255] = '\0';
-                char* eol = strchr(img, '\n');
-                if (eol != NULL) {
-                    *eol = '\0';
-                }
-
-                if (_settings.showAiPhotos) {
-                    // Launch a browser to view the aircraft image
-                    ShellExecute(0, 0, img, 0, 0, SW_SHOW);
-                }
+            else if (strcmp(request, "wayp") == 0) {
+                _listenerInitFetch = false;
             }
         }
-        else {
-            processData(data);
-        }
 
-        if (strncmp(request, "fr24", 4) != 0) {
-            // Don't wait before sending next request
-            lastRequest = 0;
+        // Don't retry a watch. User must click again.
+        if (strncmp(request, "watch", 5) == 0) {
+            _watchInProgress = false;
         }
-
-        success = true;
     }
-    else {
-        printf("Timeout receiving remote data\n");
-        removeStale();
+}
+
+/// <summary>
+/// Listener thread when replaying a recording. The recorded responses
+/// go through the same receive and parsing code as a live server.
+/// </summary>
+void listenerReplay()
+{
+    while (!_quit && receiveResponse() == RESPONSE_OK) {
+        postUpdate(UPDATE_STALE);
+        serverFeedReady();
     }
 
-    closesocket(_sockfd);
-    removeStale();
-    return success;
+    printf("Finished replaying fr24 feed\n");
 }
@@ -0,0 +1,208 @@
+#include <windows.h>
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include "Profiler.h"
+
+// Constants
+const char TimingsExt[] = ".timings.csv";
+
+struct ZoneData {
+    float sample[ZoneSamples];          // Microseconds
+    std::atomic<unsigned int> count;
+    unsigned int bucket[ZoneBuckets];
+    double totalMicros;
+    double maxMicros;
+};
+
+ZoneData _zone[ZONE_COUNT];
+double _ticksPerMicro = 0;
+LARGE_INTEGER _lastFrame;
+
+const char* _zoneName[ZONE_COUNT] = {
+    "Frame",
+    "Update",
+    "Render",
+    "Other tags",
+    "Dispatch",
+    "Feed apply",
+    "Feed request",
+    "Feed parse"
+};
+
+
+ZoneTimer::ZoneTimer(int zone)
+{
+    this->zone = zone;
+    QueryPerformanceCounter(&start);
+}
+
+ZoneTimer::~ZoneTimer()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    profileRecord(zone, now.QuadPart - start.QuadPart);
+}
+
+/// <summary>
+/// Must be called before any other threads are started
+/// </summary>
+void profilerInit()
+{
+    LARGE_INTEGER perfFreq;
+    QueryPerformanceFrequency(&perfFreq);
+    _ticksPerMicro = perfFreq.QuadPart / 1000000.0;
+    _lastFrame.QuadPart = 0;
+
+    for (int i = 0; i < ZONE_COUNT; i++) {
+        _zone[i].count = 0;
+        memset(_zone[i].bucket, 0, sizeof(_zone[i].bucket));
+        _zone[i].totalMicros = 0;
+        _zone[i].maxMicros = 0;
+    }
+}
+
+/// <summary>
+/// Must only be called from the thread that owns the zone
+/// </summary>
+void profileRecord(int zone, LONGLONG ticks)
+{
+    ZoneData* data = &_zone[zone];
+    double micros = ticks / _ticksPerMicro;
+
+    unsigned int count = data->count.load(std::memory_order_relaxed);
+    data->sample[count & (ZoneSamples - 1)] = (float)micros;
+    data->count.store(count + 1, std::memory_order_release);
+
+    int bucket = 0;
+    for (unsigned int val = (unsigned int)micros; val > 0 && bucket < ZoneBuckets - 1; val >>= 1) {
+        bucket++;
+    }
+    data->bucket[bucket]++;
+
+    data->totalMicros += micros;
+    if (micros > data->maxMicros) {
+        data->maxMicros = micros;
+    }
+}
+
+/// <summary>
+/// Call once per frame to record the time since the last one
+/// </summary>
+void profileFrame()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    if (_lastFrame.QuadPart != 0) {
+        profileRecord(ZONE_FRAME, now.QuadPart - _lastFrame.QuadPart);
+    }
+
+    _lastFrame = now;
+}
+
+const char* zoneName(int zone)
+{
+    return _zoneName[zone];
+}
+
+/// <summary>
+/// Percentiles of the recent samples in milliseconds. Can be called from
+/// any thread. Returns false if the zone has no samples yet.
+/// </summary>
+bool zonePercentiles(int zone, double* p50, double* p99)
+{
+    ZoneData* data = &_zone[zone];
+    unsigned int count = data->count.load(std::memory_order_acquire);
+    if (count == 0) {
+        return false;
+    }
+
+    if (count > ZoneSamples) {
+        count = ZoneSamples;
+    }
+
+    // Owner may overwrite a sample while copying which only
+    // makes that one sample a little newer.
+    float sorted[ZoneSamples];
+    memcpy(sorted, data->sample, count * sizeof(float));
+    std::sort(sorted, sorted + count);
+
+    *p50 = sorted[(count - 1) / 2] / 1000.0;
+    *p99 = sorted[(count - 1) * 99 / 100] / 1000.0;
+    return true;
+}
+
+/// <summary>
+/// Returns the upper bound in microseconds of the histogram bucket
+/// that holds the requested percentile of all samples.
+/// </summary>
+double bucketPercentile(ZoneData* data, unsigned int total, int percent)
+{
+    unsigned int target = (unsigned int)(((unsigned long long)total * percent + 99) / 100);
+    unsigned int sum = 0;
+
+    for (int i = 0; i < ZoneBuckets; i++) {
+        sum += data->bucket[i];
+        if (sum >= target) {
+            return (double)(1 << i);
+        }
+    }
+
+    return data->maxMicros;
+}
+
+/// <summary>
+/// Write a summary of every zone next to the executable. Call
+/// after all the other threads have finished.
+/// </summary>
+void profilerDump()
+{
+    char filename[256];
+    GetModuleFileName(NULL, filename, 256);
+
+    char* last = strrchr(filename, '\\');
+    if (last) {
+        char* ext = strrchr(last, '.');
+        if (ext) {
+            *ext = '\0';
+        }
+    }
+    strcat(filename, TimingsExt);
+
+    FILE* outf = fopen(filename, "w");
+    if (outf == NULL) {
+        printf("Failed to save timings to %s\n", filename);
+        return;
+    }
+
+    fprintf(outf, "zone,samples,mean_ms,p50_ms,p99_ms,max_ms,recent_p50_ms,recent_p99_ms");
+    for (int i = 0; i < ZoneBuckets; i++) {
+        fprintf(outf, ",lt_%dus", 1 << i);
+    }
+    fprintf(outf, "\n");
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++) {
+        ZoneData* data = &_zone[zone];
+        unsigned int total = data->count.load(std::memory_order_acquire);
+        if (total == 0) {
+            continue;
+        }
+
+        double recentP50;
+        double recentP99;
+        zonePercentiles(zone, &recentP50, &recentP99);
+
+        fprintf(outf, "%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f", _zoneName[zone], total, data->totalMicros / total / 1000.0,
+            bucketPercentile(data, total, 50) / 1000.0, bucketPercentile(data, total, 99) / 1000.0,
+            data->maxMicros / 1000.0, recentP50, recentP99);
+
+        for (int i = 0; i < ZoneBuckets; i++) {
+            fprintf(outf, ",%u", data->bucket[i]);
+        }
+        fprintf(outf, "\n");
+    }
+
+    fclose(outf);
+    printf("Saved timings to %s\n", filename);
+}
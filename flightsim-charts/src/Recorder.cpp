@@ -0,0 +1,343 @@
+#include "Platform.h"
+#include <iostream>
+#include <mutex>
+#ifdef FSC_HEADLESS
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#endif
+#include "Recorder.h"
+
+// Externals
+extern bool _quit;
+
+// Variables
+FILE* _recordFile = NULL;
+std::mutex _recordMutex;
+char* _replayData = NULL;
+LONGLONG _replaySize = 0;
+bool _replayFast = false;
+LONGLONG _dispatchPos = 0;
+LONGLONG _feedPos = 0;
+int _feedUsed = 0;      // Bytes of the current feed record already returned
+char* _feedData = NULL; // Response being recorded
+int _feedSize = 0;
+int _feedAllocated = 0;
+LONGLONG _feedMicros;
+
+#ifdef FSC_HEADLESS
+
+std::chrono::steady_clock::time_point _recordStartTime;
+
+
+LONGLONG elapsedMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _recordStartTime).count();
+}
+
+void startClock()
+{
+    _recordStartTime = std::chrono::steady_clock::now();
+}
+
+#else
+
+double _recordTicksPerMicro = 0;
+LARGE_INTEGER _recordStartTime;
+
+
+LONGLONG elapsedMicros()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (LONGLONG)((now.QuadPart - _recordStartTime.QuadPart) / _recordTicksPerMicro);
+}
+
+void startClock()
+{
+    LARGE_INTEGER perfFreq;
+    QueryPerformanceFrequency(&perfFreq);
+    _recordTicksPerMicro = perfFreq.QuadPart / 1000000.0;
+    QueryPerformanceCounter(&_recordStartTime);
+}
+
+#endif
+
+/// <summary>
+/// Start recording everything received to the file. Must be
+/// called before the server thread is started.
+/// </summary>
+bool recordStart(const char* filename)
+{
+    _recordFile = fopen(filename, "wb");
+    if (_recordFile == NULL) {
+        printf("Failed to create recording %s\n", filename);
+        return false;
+    }
+
+    unsigned int version = RecordVersion;
+    fwrite(RecordMagic, sizeof(RecordMagic), 1, _recordFile);
+    fwrite(&version, sizeof(version), 1, _recordFile);
+
+    startClock();
+    printf("Recording to %s\n", filename);
+    return true;
+}
+
+/// <summary>
+/// Load a recording to replay. Must be called before the server
+/// thread is started. Fast replays everything as soon as it can be
+/// processed rather than at the speed it was recorded.
+/// </summary>
+bool replayStart(const char* filename, bool fast)
+{
+    FILE* inf = fopen(filename, "rb");
+    if (inf == NULL) {
+        printf("Failed to open recording %s\n", filename);
+        return false;
+    }
+
+    _fseeki64(inf, 0, SEEK_END);
+    LONGLONG fileSize = _ftelli64(inf);
+    _fseeki64(inf, 0, SEEK_SET);
+
+    _replayData = (char*)malloc(fileSize > 0 ? fileSize : 1);
+    if (_replayData == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    LONGLONG bytes = fread(_replayData, 1, fileSize, inf);
+    fclose(inf);
+
+    unsigned int version;
+    if (bytes < (LONGLONG)(sizeof(RecordMagic) + sizeof(version)) || memcmp(_replayData, RecordMagic, sizeof(RecordMagic)) != 0) {
+        printf("Not a recording: %s\n", filename);
+        free(_replayData);
+        _replayData = NULL;
+        return false;
+    }
+
+    memcpy(&version, _replayData + sizeof(RecordMagic), sizeof(version));
+    if (version != RecordVersion) {
+        printf("Recording %s is version %u, expected %d\n", filename, version, RecordVersion);
+        free(_replayData);
+        _replayData = NULL;
+        return false;
+    }
+
+    // Drop anything after the last complete record, e.g. if
+    // the recording wasn't closed properly.
+    LONGLONG pos = sizeof(RecordMagic) + sizeof(version);
+    while (pos + (LONGLONG)sizeof(RecordHeader) <= bytes) {
+        const RecordHeader* header = (const RecordHeader*)(_replayData + pos);
+        if (pos + (LONGLONG)sizeof(RecordHeader) + header->size > bytes) {
+            break;
+        }
+        pos += sizeof(RecordHeader) + header->size;
+    }
+
+    _replaySize = pos;
+    _replayFast = fast;
+    _dispatchPos = sizeof(RecordMagic) + sizeof(version);
+    _feedPos = _dispatchPos;
+    _feedUsed = 0;
+
+    startClock();
+    printf("Replaying %s%s\n", filename, fast ? " (fast)" : "");
+    return true;
+}
+
+/// <summary>
+/// Call after all the other threads have finished
+/// </summary>
+void recorderCleanup()
+{
+    if (_recordFile != NULL) {
+        recordFeedEnd();
+        fclose(_recordFile);
+        _recordFile = NULL;
+    }
+
+    if (_feedData != NULL) {
+        free(_feedData);
+        _feedData = NULL;
+        _feedAllocated = 0;
+    }
+
+    if (_replayData != NULL) {
+        free(_replayData);
+        _replayData = NULL;
+    }
+}
+
+bool recording()
+{
+    return _recordFile != NULL;
+}
+
+bool replaying()
+{
+    return _replayData != NULL;
+}
+
+void writeRecord(int stream, const void* data, int size, LONGLONG micros)
+{
+    RecordHeader header;
+    header.stream = stream;
+    header.size = size;
+    header.micros = micros;
+
+    std::lock_guard<std::mutex> lock(_recordMutex);
+    fwrite(&header, sizeof(header), 1, _recordFile);
+    fwrite(data, size, 1, _recordFile);
+}
+
+/// <summary>
+/// Called by the server thread for SimConnect data.
+/// </summary>
+void recordData(int stream, const void* data, int size)
+{
+    writeRecord(stream, data, size, elapsedMicros());
+}
+
+/// <summary>
+/// Called by the listener thread for everything it receives. It is
+/// kept until recordFeedEnd so a response becomes a single record.
+/// </summary>
+void recordFeed(const void* data, int size)
+{
+    if (_feedSize == 0) {
+        _feedMicros = elapsedMicros();
+    }
+
+    if (_feedSize + size > _feedAllocated) {
+        _feedAllocated = (_feedSize + size) * 2;
+        _feedData = (char*)realloc(_feedData, _feedAllocated);
+        if (_feedData == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+    }
+
+    memcpy(_feedData + _feedSize, data, size);
+    _feedSize += size;
+}
+
+/// <summary>
+/// Called by the listener thread at the end of each response.
+/// </summary>
+void recordFeedEnd()
+{
+    if (_feedSize == 0) {
+        return;
+    }
+
+    writeRecord(STREAM_FEED, _feedData, _feedSize, _feedMicros);
+    _feedSize = 0;
+}
+
+/// <summary>
+/// Returns the position of the next record for the stream at or
+/// after pos or -1 if there are no more.
+/// </summary>
+LONGLONG nextRecord(int stream, LONGLONG pos)
+{
+    while (pos < _replaySize) {
+        const RecordHeader* header = (const RecordHeader*)(_replayData + pos);
+        if ((int)header->stream == stream) {
+            return pos;
+        }
+        pos += sizeof(RecordHeader) + header->size;
+    }
+
+    return -1;
+}
+
+/// <summary>
+/// Returns millis until the record is due, 0 if it is due now.
+/// </summary>
+int millisUntilDue(LONGLONG pos)
+{
+    if (_replayFast) {
+        return 0;
+    }
+
+    const RecordHeader* header = (const RecordHeader*)(_replayData + pos);
+    LONGLONG wait = header->micros - elapsedMicros();
+    if (wait <= 0) {
+        return 0;
+    }
+
+    return (int)((wait + 999) / 1000);
+}
+
+/// <summary>
+/// Called by the server thread. Returns the next SimConnect message if it
+/// is due. Otherwise returns NULL and sets waitMillis to the time until it
+/// is due or to -1 if there are no more.
+/// </summary>
+const char* replayDispatch(int* size, int* waitMillis)
+{
+    if (_dispatchPos == -1) {
+        *waitMillis = -1;
+        return NULL;
+    }
+
+    _dispatchPos = nextRecord(STREAM_DISPATCH, _dispatchPos);
+    if (_dispatchPos == -1) {
+        printf("Finished replaying SimConnect data\n");
+        *waitMillis = -1;
+        return NULL;
+    }
+
+    *waitMillis = millisUntilDue(_dispatchPos);
+    if (*waitMillis > 0) {
+        return NULL;
+    }
+
+    const RecordHeader* header = (const RecordHeader*)(_replayData + _dispatchPos);
+    *size = header->size;
+    _dispatchPos += sizeof(RecordHeader) + header->size;
+    return (const char*)(header + 1);
+}
+
+/// <summary>
+/// Called by the listener thread in place of recv. Waits until the
+/// next feed data is due. Returns 0 when there is no more.
+/// </summary>
+int replayFeed(char* buf, int len)
+{
+    if (_feedPos == -1) {
+        return 0;
+    }
+
+    _feedPos = nextRecord(STREAM_FEED, _feedPos);
+    if (_feedPos == -1) {
+        return 0;
+    }
+
+    int waitMillis;
+    while ((waitMillis = millisUntilDue(_feedPos)) > 0) {
+        if (_quit) {
+            return 0;
+        }
+        Sleep(waitMillis < 100 ? waitMillis : 100);
+    }
+
+    const RecordHeader* header = (const RecordHeader*)(_replayData + _feedPos);
+    int bytes = header->size - _feedUsed;
+    if (bytes > len) {
+        bytes = len;
+    }
+
+    memcpy(buf, (const char*)(header + 1) + _feedUsed, bytes);
+    _feedUsed += bytes;
+
+    if (_feedUsed == (int)header->size) {
+        _feedPos += sizeof(RecordHeader) + header->size;
+        _feedUsed = 0;
+    }
+
+    return bytes;
+}
@@ -7,6 +7,12 @@
 #include "Server.h"
 #include "Listener.h"
 #include "ChartServer.h"
+#include "AiIndex.h"
+#include "Profiler.h"
+#include "Recorder.h"
+#include "ServerWait.h"
+#include "ServerSchedule.h"
+#include "SharedData.h"
 #include "simconnect.h"
 
 // Externals
@@ -16,14 +22,11 @@ extern bool _noConnect;
 
 // Variables
 LocData _locData;
-WindData _windData;
-LocData _aircraftData;
+WindData _selfWind;
+LocData _selfData;
 OtherData _otherData;
-OtherData _otherAircraftData[MAX_AIRCRAFT];
-OtherData _newOtherAircraftData[MAX_AIRCRAFT];
 char* _chartServer;
 ChartServerData _chartServerData;
-int _otherAircraftCount = 0;
 int _locDataSize = sizeof(LocData);
 int _windDataSize = sizeof(WindData);
 int _otherDataSize = sizeof(OtherData);
@@ -40,6 +43,11 @@ FollowData _follow;
 bool _listening = false;
 char _remoteIp[32];
 SOCKET _sockfd;
+bool _listenerConnected = false;
+bool _listenerKeepAlive = false;
+bool _listenerDelta = false;
+unsigned int _listenerSeq = 0;
+bool _listenerBinary = false;
 sockaddr_in _sendAddr;
 char* _listenerData;
 char* _listenerHome;
@@ -48,6 +56,10 @@ int _aiAircraftCount = 0;
 AI_Aircraft _aiAircraft[Max_AI_Aircraft];
 int _aiFixedCount = 0;
 AI_Fixed _aiFixed[Max_AI_Fixed];
+AiIndexSlot _aiAircraftSlots[Ai_Aircraft_Index_Size];
+AiIndex _aiAircraftIndex = { _aiAircraftSlots, Ai_Aircraft_Index_Size, 0 };
+AiIndexSlot _aiFixedSlots[Ai_Fixed_Index_Size];
+AiIndex _aiFixedIndex = { _aiFixedSlots, Ai_Fixed_Index_Size, 0 };
 int _aiModelMatchCount = 0;
 AI_ModelMatch _aiModelMatch[Max_AI_ModelMatch];
 AI_Trail _aiTrail[3];
@@ -62,20 +74,35 @@ void stopFollowing(bool force = false)
         return;
     }
 
-    if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SELF, DEF_SELF, _follow.aircraftId, SIMCONNECT_PERIOD_NEVER, 0, 0, 0, 0) != 0) {
-        printf("Failed to stop requesting followed aircraft data\n");
-    }
+    // A replay has no SimConnect connection
+    if (!replaying()) {
+        if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SELF, DEF_SELF, _follow.aircraftId, SIMCONNECT_PERIOD_NEVER, 0, 0, 0, 0) != 0) {
+            printf("Failed to stop requesting followed aircraft data\n");
+        }
 
-    if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SELF, DEF_SELF, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_VISUAL_FRAME, 0, 0, 0, 0) != 0) {
-        printf("Failed to start requesting own aircraft data\n");
+        if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SELF, DEF_SELF, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_VISUAL_FRAME, 0, 0, 0, 0) != 0) {
+            printf("Failed to start requesting own aircraft data\n");
+        }
     }
 
     *_follow.callsign = '\0';
     _follow.inProgress = false;
 }
 
+void clearOtherAircraft()
+{
+    otherFrameWrite()->count = 0;
+    otherFramePublish();
+}
+
 void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContext)
 {
+    ZoneTimer timer(ZONE_DISPATCH);
+
+    if (recording()) {
+        recordData(STREAM_DISPATCH, pData, cbData);
+    }
+
     switch (pData->dwID)
     {
     case SIMCONNECT_RECV_ID_SIMOBJECT_DATA:
@@ -93,15 +120,15 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
             }
 
             memcpy(&_locData, &pObjData->dwData, _locDataSize);
-            memcpy(&_windData, (char*)&pObjData->dwData + _locDataSize, _windDataSize);
+            memcpy(&_selfWind, (char*)&pObjData->dwData + _locDataSize, _windDataSize);
 
             // Check for fake data that FS2020 sends before you have selected an airport
             if (_locData.loc.lat > -0.02 && _locData.loc.lat < 0.02 && _locData.loc.lon > -0.02 && _locData.loc.lon < 0.02 && (_locData.heading > 359.9 || _locData.heading < 0.1)) {
-                _aircraftData.loc.lat = MAXINT;
+                _selfData.loc.lat = MAXINT;
                 chartServerCleanup();
             }
             else {
-                memcpy(&_aircraftData, &_locData, _locDataSize);
+                memcpy(&_selfData, &_locData, _locDataSize);
                 updateInstrumentHud(&_locData);
 
                 int command = chartServerSend();
@@ -110,6 +137,18 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
                 }
             }
 
+            ownStatePublish(&_selfData, &_selfWind);
+
+            // Teleports, snapshots, pausing and following all need to send to
+            // MS FS2020 and a replay has no SimConnect connection to send on.
+            if (replaying()) {
+                _teleport.inProgress = false;
+                _snapshot.save = false;
+                _snapshot.restore = false;
+                _snapshot.pause = false;
+                break;
+            }
+
             if (_teleport.inProgress) {
                 if (_teleport.settleDelay > 0) {
                     _teleport.settleDelay--;
@@ -238,12 +277,10 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
             int i = pObjData->dwentrynumber - 1;
 
             // Use the AI model (not matched model) if it's an AI aircraft
-            for (int j = 0; j < _aiAircraftCount; j++) {
-                if (strcmp(_otherData.callsign, _aiAircraft[j].callsign) == 0) {
-                    strcpy(_otherData.model, _aiAircraft[j].model);
-                    _aiAircraft[j].objectId = pObjData->dwObjectID;
-                    break;
-                }
+            int j = aiIndexFind(&_aiAircraftIndex, _otherData.callsign);
+            if (j != -1) {
+                strcpy(_otherData.model, _aiAircraft[j].model);
+                _aiAircraft[j].objectId = pObjData->dwObjectID;
             }
 
             // Make sure followed aircraft still exists
@@ -251,7 +288,7 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
                 _follow.aircraftId = pObjData->dwObjectID;
             }
 
-            if (_follow.inProgress && *_follow.callsign != '\0' && strcmp(_otherData.callsign, _follow.callsign) == 0) {
+            if (_follow.inProgress && *_follow.callsign != '\0' && strcmp(_otherData.callsign, _follow.callsign) == 0 && !replaying()) {
                 // Start following
                 if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SELF, DEF_SELF, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_NEVER, 0, 0, 0, 0) != 0) {
                     printf("Failed to stop requesting own aircraft data\n");
@@ -264,7 +301,7 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
 
             if (i < MAX_AIRCRAFT) {
                 //printf("%d: %s - lat: %f  lon: %f  heading:%f  wingSpan: %f\n", i, _locData.callsign, _locData.lat, _locData.lon, _locData.heading, _locData.wingSpan);
-                memcpy(&_newOtherAircraftData[i], &_otherData, _otherDataSize);
+                memcpy(&otherFrameWrite()->aircraft[i], &_otherData, _otherDataSize);
             }
             else if (!_shownMaxExceeded) {
                 _shownMaxExceeded = true;
@@ -284,9 +321,9 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
                     stopFollowing();
                 }
 
-                // Overwrite old locations with new locations
-                memcpy(&_otherAircraftData, &_newOtherAircraftData, _otherDataSize * count);
-                _otherAircraftCount = count;
+                // Hand the new locations to the render thread
+                otherFrameWrite()->count = count;
+                otherFramePublish();
                 _pendingRequest = false;
             }
 
@@ -314,7 +351,7 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
 }
 
 void getAllAircract() {
-    if (_pendingRequest || _aircraftData.loc.lat == MAXINT) {
+    if (_pendingRequest || _selfData.loc.lat == MAXINT) {
         return;
     }
 
@@ -446,8 +483,10 @@ void server()
 
     printf(WaitMsg);
     _connected = false;
-    _aircraftData.loc.lat = MAXINT;
-    _otherAircraftCount = 0;
+    _selfData.loc.lat = MAXINT;
+    _selfWind.direction = -1;
+    ownStatePublish(&_selfData, &_selfWind);
+    clearOtherAircraft();
     _teleport.inProgress = false;
     _snapshot.loc.lat = MAXINT;
     _snapshot.save = false;
@@ -459,88 +498,79 @@ void server()
     _range = _maxRange ? MAX_RANGE : AIRCRAFT_RANGE;
 
     HRESULT result;
+    serverWaitInit();
 
+    // Listener runs on its own thread so it can't hold up SimConnect
+    std::thread listenerThread;
     if (_showAi) {
         listenerInit();
+        if (_listening) {
+            listenerThread = std::thread(replaying() ? listenerReplay : listener);
+        }
     }
 
-    int loopMillis = 50;
-    int retryDelay = 0;
+    // Wait for events rather than polling so SimConnect data and feed
+    // updates are processed as soon as they arrive.
+    ServerSchedule schedule;
+    scheduleInit(&schedule);
+
     while (!_quit)
     {
-        if (_connected) {
-            result = SimConnect_CallDispatch(hSimConnect, MyDispatchProc, NULL);
-            if (result == 0) {
-                getAllAircract();
+        ULONGLONG now = GetTickCount64();
+        int waitMillis;
+
+        if (replaying()) {
+            // Recorded SimConnect data stands in for MS FS2020
+            int size;
+            const char* data = replayDispatch(&size, &waitMillis);
+            if (data != NULL) {
+                MyDispatchProc((SIMCONNECT_RECV*)data, size, NULL);
+                waitMillis = 0;
             }
-            else {
+        }
+        else {
+            if (_connected && SimConnect_CallDispatch(hSimConnect, MyDispatchProc, NULL) != 0) {
                 printf("Disconnected from MS FS2020\n");
                 _connected = false;
                 _pendingRequest = false;
                 *_follow.callsign = '\0';
-                _aircraftData.loc.lat = MAXINT;
-                _otherAircraftCount = 0;
+                _selfData.loc.lat = MAXINT;
+                ownStatePublish(&_selfData, &_selfWind);
+                clearOtherAircraft();
                 printf(WaitMsg);
                 chartServerCleanup();
+                scheduleDisconnected(&schedule, now);
             }
-        }
-        else if (retryDelay > 0) {
-            retryDelay--;
-        }
-        else if (_noConnect) {
-            retryDelay = 1000;
-        }
-        else {
-            result = SimConnect_Open(&hSimConnect, "FlightSim Charts", NULL, 0, 0, 0);
-            if (result == 0) {
-                printf("Connected to MS FS2020\n");
-                init();
-                _connected = true;
-            }
-            else {
-                retryDelay = 200;
-            }
-        }
 
-        if (_showAi) {
-            char request[256];
-            bool immediate = false;
-
-            if (_watchInProgress) {
-                sprintf(request, "watch,%s", _watchCallsign);
-                immediate = true;
-            }
-            else if (_listenerInitFetch) {
-                if (_listenerHome) {
-                    sprintf(request, "home,%s", _listenerHome);
+            int action = scheduleNext(&schedule, now, _connected, _noConnect, _pendingRequest, &waitMillis);
+            if (action == ACTION_CONNECT) {
+                result = SimConnect_Open(&hSimConnect, "FlightSim Charts", NULL, 0, serverSimConnectEvent(), 0);
+                if (result == 0) {
+                    printf("Connected to MS FS2020\n");
+                    init();
+                    _connected = true;
                 }
-                else {
-                    strcpy(request, "wayp");
-                }
-                immediate = true;
-            }
-            else {
-                strcpy(request, "fr24");
+                waitMillis = scheduleDone(&schedule, now, action, result == 0);
             }
-
-            if (listenerRead(request, loopMillis, immediate) && _listenerInitFetch) {
-                if (_listenerHome) {
-                    _listenerHome = NULL;
-                }
-                else if (strcmp(request, "wayp") == 0) {
-                    _listenerInitFetch = false;
-                }
+            else if (action == ACTION_ALL_AIRCRAFT) {
+                getAllAircract();
+                waitMillis = scheduleDone(&schedule, now, action, _pendingRequest);
             }
+        }
 
-            // Don't retry a watch. User must click again.
-            if (strncmp(request, "watch", 5) == 0) {
-                _watchInProgress = false;
-            }
+        if (_showAi) {
+            listenerApply();
         }
-        else {
-            Sleep(loopMillis);
+
+        if (!_quit) {
+            serverWait(waitMillis);
         }
     }
 
+    if (listenerThread.joinable()) {
+        listenerThread.join();
+    }
+
     cleanUp();
+    serverWaitCleanup();
 }
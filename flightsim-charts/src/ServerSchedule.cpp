@@ -0,0 +1,76 @@
+#include "Platform.h"
+#include "ServerSchedule.h"
+
+
+void scheduleInit(ServerSchedule* schedule)
+{
+    schedule->nextAllAircraft = 0;
+    schedule->nextConnect = 0;
+}
+
+/// <summary>
+/// Returns the action to take now and sets waitMillis to how long to
+/// wait afterwards. A negative wait means until something is signalled.
+/// </summary>
+int scheduleNext(ServerSchedule* schedule, ULONGLONG now, bool connected, bool noConnect, bool pendingRequest, int* waitMillis)
+{
+    if (connected) {
+        *waitMillis = ConnectedMillis;
+        if (pendingRequest) {
+            return ACTION_NONE;
+        }
+
+        if (now >= schedule->nextAllAircraft) {
+            return ACTION_ALL_AIRCRAFT;
+        }
+
+        *waitMillis = (int)(schedule->nextAllAircraft - now);
+        return ACTION_NONE;
+    }
+
+    if (noConnect) {
+        // Only feed updates or quitting can wake us
+        *waitMillis = -1;
+        return ACTION_NONE;
+    }
+
+    if (now < schedule->nextConnect) {
+        *waitMillis = (int)(schedule->nextConnect - now);
+        return ACTION_NONE;
+    }
+
+    *waitMillis = 0;
+    return ACTION_CONNECT;
+}
+
+/// <summary>
+/// Called after an action has been taken. For ACTION_ALL_AIRCRAFT ok means
+/// a request is now pending. Returns how long to wait.
+/// </summary>
+int scheduleDone(ServerSchedule* schedule, ULONGLONG now, int action, bool ok)
+{
+    switch (action) {
+    case ACTION_CONNECT:
+        if (ok) {
+            return 0;
+        }
+        schedule->nextConnect = now + RetryMillis;
+        return RetryMillis;
+
+    case ACTION_ALL_AIRCRAFT:
+        if (ok) {
+            schedule->nextAllAircraft = now + AllAircraftMillis;
+        }
+        return ConnectedMillis;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Called when the connection to MS FS2020 is lost
+/// </summary>
+void scheduleDisconnected(ServerSchedule* schedule, ULONGLONG now)
+{
+    schedule->nextConnect = now + RetryMillis;
+}
@@ -0,0 +1,156 @@
+#include "Platform.h"
+#include <stdio.h>
+#include "ServerWait.h"
+#ifdef FSC_HEADLESS
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#endif
+
+enum WAKE_EVENT {
+    WAKE_SIMCONNECT,
+    WAKE_FEED,
+    WAKE_NOTIFY,
+    WAKE_EVENTS
+};
+
+#ifdef FSC_HEADLESS
+
+/// Each event is a bit in _wakeSignalled. A handle points at the event's
+/// bit. Waking clears the lowest signalled bit the same as
+/// WaitForMultipleObjects resets the first signalled auto-reset event.
+
+const int _wakeBit[WAKE_EVENTS] = { 1, 2, 4 };
+std::mutex _wakeMutex;
+std::condition_variable _wakeCondition;
+int _wakeSignalled = 0;
+
+
+void serverWaitInit()
+{
+    std::lock_guard<std::mutex> lock(_wakeMutex);
+    _wakeSignalled = 0;
+}
+
+void serverWaitCleanup()
+{
+}
+
+HANDLE serverSimConnectEvent()
+{
+    return (HANDLE)&_wakeBit[WAKE_SIMCONNECT];
+}
+
+/// <summary>
+/// Signals an event the way SetEvent does. Lets tests stand in for
+/// SimConnect signalling its event.
+/// </summary>
+void serverSignal(HANDLE event)
+{
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _wakeSignalled |= *(const int*)event;
+    }
+    _wakeCondition.notify_one();
+}
+
+void signalWake(int event)
+{
+    serverSignal((HANDLE)&_wakeBit[event]);
+}
+
+bool serverWait(int timeoutMillis)
+{
+    std::unique_lock<std::mutex> lock(_wakeMutex);
+
+    if (timeoutMillis < 0) {
+        _wakeCondition.wait(lock, [] { return _wakeSignalled != 0; });
+    }
+    else if (!_wakeCondition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [] { return _wakeSignalled != 0; })) {
+        return false;
+    }
+
+    _wakeSignalled &= _wakeSignalled - 1;
+    return true;
+}
+
+#else
+
+HANDLE _wakeEvent[WAKE_EVENTS];
+
+
+void serverWaitInit()
+{
+    for (int i = 0; i < WAKE_EVENTS; i++) {
+        // Auto-reset so each wakeup is consumed by a single wait
+        _wakeEvent[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (_wakeEvent[i] == NULL) {
+            printf("Failed to create server wake event\n");
+        }
+    }
+}
+
+void serverWaitCleanup()
+{
+    for (int i = 0; i < WAKE_EVENTS; i++) {
+        if (_wakeEvent[i] != NULL) {
+            CloseHandle(_wakeEvent[i]);
+            _wakeEvent[i] = NULL;
+        }
+    }
+}
+
+/// <summary>
+/// Passed to SimConnect_Open. SimConnect signals it whenever
+/// there is something to dispatch.
+/// </summary>
+HANDLE serverSimConnectEvent()
+{
+    return _wakeEvent[WAKE_SIMCONNECT];
+}
+
+void signalWake(int event)
+{
+    if (_wakeEvent[event] != NULL) {
+        SetEvent(_wakeEvent[event]);
+    }
+}
+
+/// <summary>
+/// Sleep until any wake event is signalled or the timeout expires.
+/// A negative timeout waits forever. The caller checks everything
+/// after waking so it doesn't matter which event was signalled.
+/// Returns true if an event was signalled.
+/// </summary>
+bool serverWait(int timeoutMillis)
+{
+    DWORD millis = timeoutMillis < 0 ? INFINITE : timeoutMillis;
+
+    DWORD result = WaitForMultipleObjects(WAKE_EVENTS, _wakeEvent, FALSE, millis);
+    if (result == WAIT_FAILED) {
+        // Events not available so fall back to polling
+        Sleep(millis < 50 ? millis : 50);
+        return false;
+    }
+
+    return result < WAIT_OBJECT_0 + WAKE_EVENTS;
+}
+
+#endif
+
+/// <summary>
+/// Called by the listener thread when it has queued updates.
+/// </summary>
+void serverFeedReady()
+{
+    signalWake(WAKE_FEED);
+}
+
+/// <summary>
+/// Called by any other thread that needs the server to act now,
+/// e.g. when quitting.
+/// </summary>
+void serverNotify()
+{
+    signalWake(WAKE_NOTIFY);
+}
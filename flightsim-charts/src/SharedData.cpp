@@ -0,0 +1,137 @@
+#include "Platform.h"
+#include <atomic>
+#include <string.h>
+#include "SharedData.h"
+
+const int FrameIndexMask = 3;
+const int FrameFresh = 4;
+
+struct FrameSwap {
+    std::atomic<int> latest;
+    int writing;                // Only used by the server thread
+    int reading;                // Only used by the render thread
+};
+
+OtherFrame _otherFrame[3];
+FrameSwap _otherSwap = { { 1 }, 0, 2 };
+
+AiFrame _aiFrame[3];
+FrameSwap _aiSwap = { { 1 }, 0, 2 };
+
+LocData _ownAircraft;
+WindData _ownWind;
+std::atomic<unsigned int> _ownSeq(0);  // Odd while being written
+
+
+/// <summary>
+/// Make the frame just written the latest one. A different frame
+/// must be written next.
+/// </summary>
+void framePublish(FrameSwap* swap)
+{
+    int latest = swap->latest.exchange(swap->writing | FrameFresh, std::memory_order_acq_rel);
+    swap->writing = latest & FrameIndexMask;
+}
+
+/// <summary>
+/// Swap the frame being read for the latest one if a newer one has
+/// been published. Returns the index of the frame to read.
+/// </summary>
+int frameRead(FrameSwap* swap)
+{
+    if (swap->latest.load(std::memory_order_relaxed) & FrameFresh) {
+        int latest = swap->latest.exchange(swap->reading, std::memory_order_acq_rel);
+        swap->reading = latest & FrameIndexMask;
+    }
+
+    return swap->reading;
+}
+
+/// <summary>
+/// Called by the server thread. Returns the frame to fill in.
+/// </summary>
+OtherFrame* otherFrameWrite()
+{
+    return &_otherFrame[_otherSwap.writing];
+}
+
+/// <summary>
+/// Called by the server thread once the frame is complete. The frame
+/// becomes the latest one and a different frame must be filled next.
+/// </summary>
+void otherFramePublish()
+{
+    framePublish(&_otherSwap);
+}
+
+/// <summary>
+/// Called by the render thread. Returns the most recently published
+/// frame. It stays valid and unchanged until the next call.
+/// </summary>
+OtherFrame* otherFrameRead()
+{
+    return &_otherFrame[frameRead(&_otherSwap)];
+}
+
+/// <summary>
+/// Called by the server thread. Returns the frame to fill in.
+/// </summary>
+AiFrame* aiFrameWrite()
+{
+    return &_aiFrame[_aiSwap.writing];
+}
+
+/// <summary>
+/// Called by the server thread once the frame is complete.
+/// </summary>
+void aiFramePublish()
+{
+    framePublish(&_aiSwap);
+}
+
+/// <summary>
+/// Called by the render thread. Returns the most recently published
+/// frame. It stays valid and unchanged until the next call.
+/// </summary>
+AiFrame* aiFrameRead()
+{
+    return &_aiFrame[frameRead(&_aiSwap)];
+}
+
+/// <summary>
+/// Called by the server thread whenever own aircraft or wind changes.
+/// </summary>
+void ownStatePublish(const LocData* aircraft, const WindData* wind)
+{
+    unsigned int seq = _ownSeq.load(std::memory_order_relaxed);
+
+    _ownSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&_ownAircraft, aircraft, sizeof(LocData));
+    memcpy(&_ownWind, wind, sizeof(WindData));
+
+    _ownSeq.store(seq + 2, std::memory_order_release);
+}
+
+/// <summary>
+/// Called by the render thread. Always returns a consistent copy.
+/// </summary>
+void ownStateRead(LocData* aircraft, WindData* wind)
+{
+    while (true) {
+        unsigned int seq = _ownSeq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            YieldProcessor();
+            continue;
+        }
+
+        memcpy(aircraft, &_ownAircraft, sizeof(LocData));
+        memcpy(wind, &_ownWind, sizeof(WindData));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_ownSeq.load(std::memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,251 @@
+#include "Platform.h"
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "SpatialGrid.h"
+
+/// Aim for a couple of items per cell. Queries only have to test the
+/// items in the cells that overlap the display so the cost of drawing
+/// depends on what is visible rather than on the size of the table.
+
+const double ItemsPerCell = 2;
+
+int _gridFill[MaxGridSide * MaxGridSide];
+
+
+const Locn* gridLoc(const Locn* firstLoc, int stride, int i)
+{
+    return (const Locn*)((const char*)firstLoc + i * stride);
+}
+
+/// <summary>
+/// Returns the cell row or column for a lat or lon. Anything outside
+/// the grid goes in the nearest edge cell.
+/// </summary>
+int gridCell(double val, double min, double cellScale, int cells)
+{
+    double cell = (val - min) * cellScale;
+    if (!(cell >= 0)) {
+        return 0;
+    }
+    if (cell >= cells) {
+        return cells - 1;
+    }
+
+    return (int)cell;
+}
+
+/// <summary>
+/// Make sure the grid can hold count items.
+/// </summary>
+void gridAllocate(SpatialGrid* grid, int count)
+{
+    if (count <= grid->allocated) {
+        return;
+    }
+
+    gridCleanup(grid);
+
+    grid->item = (int*)malloc(count * sizeof(int));
+    grid->found = (int*)malloc(count * sizeof(int));
+    grid->scratch = (int*)malloc(count * sizeof(int));
+    if (grid->item == NULL || grid->found == NULL || grid->scratch == NULL) {
+        printf("Ran out of memory\n");
+        exit(1);
+    }
+
+    grid->allocated = count;
+}
+
+/// <summary>
+/// Rebuild the grid from count locations. Locations are stride bytes
+/// apart so the grid can be built straight from any table that
+/// contains a Locn.
+/// </summary>
+void gridBuild(SpatialGrid* grid, const Locn* firstLoc, int stride, int count)
+{
+    grid->count = count;
+    grid->cellStart[0] = 0;
+
+    if (count == 0) {
+        grid->rows = 0;
+        grid->cols = 0;
+        return;
+    }
+
+    gridAllocate(grid, count);
+
+    double minLat = firstLoc->lat;
+    double maxLat = firstLoc->lat;
+    double minLon = firstLoc->lon;
+    double maxLon = firstLoc->lon;
+
+    for (int i = 1; i < count; i++) {
+        const Locn* loc = gridLoc(firstLoc, stride, i);
+        if (loc->lat < minLat) minLat = loc->lat;
+        if (loc->lat > maxLat) maxLat = loc->lat;
+        if (loc->lon < minLon) minLon = loc->lon;
+        if (loc->lon > maxLon) maxLon = loc->lon;
+    }
+
+    int side = (int)sqrt(count / ItemsPerCell);
+    if (side < 1) {
+        side = 1;
+    }
+    else if (side > MaxGridSide) {
+        side = MaxGridSide;
+    }
+
+    grid->minLat = minLat;
+    grid->minLon = minLon;
+    grid->rows = maxLat > minLat ? side : 1;
+    grid->cols = maxLon > minLon ? side : 1;
+    grid->cellLat = maxLat > minLat ? (maxLat - minLat) / grid->rows : 1;
+    grid->cellLon = maxLon > minLon ? (maxLon - minLon) / grid->cols : 1;
+
+    int cells = grid->rows * grid->cols;
+    for (int c = 0; c < cells; c++) {
+        _gridFill[c] = 0;
+    }
+
+    // Count items per cell, then fill in index order so each
+    // cell's items are in ascending order.
+    double latScale = 1 / grid->cellLat;
+    double lonScale = 1 / grid->cellLon;
+
+    for (int i = 0; i < count; i++) {
+        const Locn* loc = gridLoc(firstLoc, stride, i);
+        int row = gridCell(loc->lat, grid->minLat, latScale, grid->rows);
+        int col = gridCell(loc->lon, grid->minLon, lonScale, grid->cols);
+        grid->scratch[i] = row * grid->cols + col;
+        _gridFill[grid->scratch[i]]++;
+    }
+
+    for (int c = 0; c < cells; c++) {
+        grid->cellStart[c + 1] = grid->cellStart[c] + _gridFill[c];
+        _gridFill[c] = grid->cellStart[c];
+    }
+
+    for (int i = 0; i < count; i++) {
+        grid->item[_gridFill[grid->scratch[i]]++] = i;
+    }
+}
+
+/// <summary>
+/// Find all items in cells that overlap any of the areas. Items in the
+/// same cell but outside an area are included so the caller must still
+/// check each one. Results are in grid->found in ascending order so
+/// drawing order doesn't change. Returns the number found.
+/// </summary>
+int gridQuery(SpatialGrid* grid, const LocnArea* areas, int areaCount)
+{
+    if (grid->count == 0 || areaCount == 0) {
+        return 0;
+    }
+
+    // All areas share the same lon range (only lat can fold)
+    // so a cell is wanted if its row overlaps any of them.
+    if (areas[0].maxLon < grid->minLon || areas[0].minLon > grid->minLon + grid->cellLon * grid->cols) {
+        return 0;
+    }
+
+    int col1 = gridCell(areas[0].minLon, grid->minLon, 1 / grid->cellLon, grid->cols);
+    int col2 = gridCell(areas[0].maxLon, grid->minLon, 1 / grid->cellLon, grid->cols);
+
+    int* found = grid->found;
+    int foundCount = 0;
+    bool sorted = true;
+    bool allRows = true;
+    bool wantedRow[MaxGridSide];
+
+    for (int row = 0; row < grid->rows; row++) {
+        double rowMin = grid->minLat + row * grid->cellLat;
+        double rowMax = rowMin + grid->cellLat;
+        wantedRow[row] = false;
+
+        for (int a = 0; a < areaCount; a++) {
+            if (areas[a].maxLat >= rowMin && areas[a].minLat <= rowMax) {
+                wantedRow[row] = true;
+                break;
+            }
+        }
+
+        allRows = allRows && wantedRow[row];
+    }
+
+    // Zoomed out so every cell is wanted
+    if (allRows && col1 == 0 && col2 == grid->cols - 1) {
+        for (int i = 0; i < grid->count; i++) {
+            found[i] = i;
+        }
+        return grid->count;
+    }
+
+    for (int row = 0; row < grid->rows; row++) {
+        if (!wantedRow[row]) {
+            continue;
+        }
+
+        // The row's cells are next to each other and each cell's items
+        // are in ascending order so only the first of each can be out
+        // of order
+        int cell1 = row * grid->cols + col1;
+        int cell2 = row * grid->cols + col2;
+        int previous = foundCount > 0 ? found[foundCount - 1] : -1;
+        for (int cell = cell1; sorted && cell <= cell2; cell++) {
+            int first = grid->cellStart[cell];
+            int last = grid->cellStart[cell + 1] - 1;
+            if (first <= last) {
+                if (grid->item[first] < previous) {
+                    sorted = false;
+                }
+                previous = grid->item[last];
+            }
+        }
+
+        int start = grid->cellStart[cell1];
+        int end = grid->cellStart[cell2 + 1];
+        memcpy(&found[foundCount], &grid->item[start], (end - start) * sizeof(int));
+        foundCount += end - start;
+    }
+
+    if (sorted) {
+        return foundCount;
+    }
+
+    if (foundCount < grid->count / 8) {
+        std::sort(found, found + foundCount);
+        return foundCount;
+    }
+
+    // Cheaper to flag them and pick them out in order
+    memset(grid->scratch, 0, grid->count * sizeof(int));
+    for (int i = 0; i < foundCount; i++) {
+        grid->scratch[found[i]] = 1;
+    }
+
+    foundCount = 0;
+    for (int i = 0; i < grid->count; i++) {
+        if (grid->scratch[i]) {
+            found[foundCount++] = i;
+        }
+    }
+
+    return foundCount;
+}
+
+void gridCleanup(SpatialGrid* grid)
+{
+    if (grid->allocated == 0) {
+        return;
+    }
+
+    free(grid->item);
+    free(grid->found);
+    free(grid->scratch);
+    grid->allocated = 0;
+    grid->count = 0;
+    grid->rows = 0;
+    grid->cols = 0;
+}
@@ -0,0 +1,152 @@
+#include <windows.h>
+#include <iostream>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_primitives.h>
+#include "TextLayer.h"
+
+struct QueuedTag {
+    float x;
+    float y;
+    int width;
+    bool isMeasure;
+    char text[68];
+};
+
+ALLEGRO_FONT* _tagFont = NULL;
+QueuedTag* _queuedTags = NULL;
+ALLEGRO_VERTEX* _tagVertices = NULL;
+int _queuedCount = 0;
+int _queuedAllocated = 0;
+
+
+/// <summary>
+/// Same size as the tag bitmaps used to be. The builtin font is 8 pixels wide.
+/// </summary>
+int tagWidth(const char* text)
+{
+    return 4 + (int)strlen(text) * 8;
+}
+
+void textLayerInit(ALLEGRO_FONT* font)
+{
+    _tagFont = font;
+}
+
+void textLayerCleanup()
+{
+    if (_queuedTags) {
+        free(_queuedTags);
+        _queuedTags = NULL;
+    }
+
+    if (_tagVertices) {
+        free(_tagVertices);
+        _tagVertices = NULL;
+    }
+
+    _queuedCount = 0;
+    _queuedAllocated = 0;
+}
+
+/// <summary>
+/// Add a tag to be drawn by the next drawQueuedTags.
+/// </summary>
+void queueTag(const char* text, float x, float y, bool isMeasure)
+{
+    if (_queuedCount == _queuedAllocated) {
+        _queuedAllocated += 256;
+
+        _queuedTags = (QueuedTag*)realloc(_queuedTags, _queuedAllocated * sizeof(QueuedTag));
+        _tagVertices = (ALLEGRO_VERTEX*)realloc(_tagVertices, _queuedAllocated * 6 * sizeof(ALLEGRO_VERTEX));
+        if (_queuedTags == NULL || _tagVertices == NULL) {
+            printf("Ran out of memory\n");
+            exit(1);
+        }
+    }
+
+    QueuedTag* tag = &_queuedTags[_queuedCount];
+
+    // Whole pixels keep the text sharp
+    tag->x = (float)floor(x);
+    tag->y = (float)floor(y);
+    tag->isMeasure = isMeasure;
+    strncpy(tag->text, text, sizeof(tag->text) - 1);
+    tag->text[sizeof(tag->text) - 1] = '\0';
+    tag->width = tagWidth(tag->text);
+
+    _queuedCount++;
+}
+
+bool tagsOverlap(const QueuedTag* tag1, const QueuedTag* tag2)
+{
+    return tag1->x < tag2->x + tag2->width && tag2->x < tag1->x + tag1->width
+        && tag1->y < tag2->y + TagHeight && tag2->y < tag1->y + TagHeight;
+}
+
+/// <summary>
+/// Draw a run of tags that don't overlap, backgrounds first then text.
+/// </summary>
+void drawTagRun(const QueuedTag* tags, int count)
+{
+    ALLEGRO_COLOR normalColour = al_map_rgb(0xe0, 0xe0, 0xe0);
+    ALLEGRO_COLOR measureColour = al_map_rgb(0xe0, 0xe0, 0x50);
+    ALLEGRO_COLOR textColour = al_map_rgb(0x40, 0x40, 0x40);
+
+    ALLEGRO_VERTEX* vertex = _tagVertices;
+    for (int i = 0; i < count; i++) {
+        const QueuedTag* tag = &tags[i];
+        ALLEGRO_COLOR colour = tag->isMeasure ? measureColour : normalColour;
+
+        float x1 = tag->x;
+        float y1 = tag->y;
+        float x2 = x1 + tag->width;
+        float y2 = y1 + TagHeight;
+
+        // Two triangles per tag
+        float corners[6][2] = { { x1, y1 }, { x2, y1 }, { x2, y2 }, { x1, y1 }, { x2, y2 }, { x1, y2 } };
+        for (int j = 0; j < 6; j++) {
+            vertex->x = corners[j][0];
+            vertex->y = corners[j][1];
+            vertex->z = 0;
+            vertex->u = 0;
+            vertex->v = 0;
+            vertex->color = colour;
+            vertex++;
+        }
+    }
+
+    al_draw_prim(_tagVertices, NULL, NULL, 0, count * 6, ALLEGRO_PRIM_TRIANGLE_LIST);
+
+    al_hold_bitmap_drawing(true);
+    for (int i = 0; i < count; i++) {
+        al_draw_text(_tagFont, textColour, tags[i].x + 2, tags[i].y + 2, 0, tags[i].text);
+    }
+    al_hold_bitmap_drawing(false);
+}
+
+/// <summary>
+/// Draw all queued tags in the order they were queued, so a tag covers
+/// any tag queued before it that it overlaps. Tags are batched in runs
+/// that don't overlap each other and a run ends at the first tag that
+/// overlaps one already in it.
+/// </summary>
+void drawQueuedTags()
+{
+    int runStart = 0;
+    for (int i = 1; i < _queuedCount; i++) {
+        for (int j = runStart; j < i; j++) {
+            if (tagsOverlap(&_queuedTags[i], &_queuedTags[j])) {
+                drawTagRun(&_queuedTags[runStart], i - runStart);
+                runStart = i;
+                break;
+            }
+        }
+    }
+
+    if (runStart < _queuedCount) {
+        drawTagRun(&_queuedTags[runStart], _queuedCount - runStart);
+    }
+
+    _queuedCount = 0;
+}
@@ -0,0 +1,198 @@
+#include "Platform.h"
+#include <stdio.h>
+#include <math.h>
+#include "TilePyramid.h"
+
+const char TileCacheMagic[4] = { 'F', 'C', 'T', 'C' };
+
+
+void tileLevelSize(TileCacheLevel* level, int width, int height)
+{
+    level->width = width;
+    level->height = height;
+    level->tilesX = (width + TileSize - 1) / TileSize;
+    level->tilesY = (height + TileSize - 1) / TileSize;
+}
+
+/// <summary>
+/// Work out the size of each level, each half the one before rounded up,
+/// until one fits in a single tile. Returns the number of levels.
+/// </summary>
+int tilePyramid(int width, int height, TileCacheLevel* levels)
+{
+    int count = 0;
+
+    while (count < MaxTileLevels) {
+        tileLevelSize(&levels[count], width, height);
+        count++;
+
+        if (width <= TileSize && height <= TileSize) {
+            break;
+        }
+
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+
+    return count;
+}
+
+/// <summary>
+/// Returns the smallest level that still has at least one pixel per
+/// display pixel.
+/// </summary>
+int tileChooseLevel(double viewWidth, int displayWidth, int levels)
+{
+    int levelNum = 0;
+    double chartPixelsPerDisplay = viewWidth / displayWidth;
+    if (chartPixelsPerDisplay > 1) {
+        levelNum = (int)(log(chartPixelsPerDisplay) / log(2.0));
+        if (levelNum >= levels) {
+            levelNum = levels - 1;
+        }
+    }
+
+    return levelNum;
+}
+
+/// <summary>
+/// Returns the tiles of a level that cover the view (in level 0 chart
+/// pixels). The range is empty (tx1 > tx2 or ty1 > ty2) if the view is
+/// off the chart.
+/// </summary>
+void tileRange(int tilesX, int tilesY, int levelNum, double viewX, double viewY, double viewWidth, double viewHeight,
+    int* tx1, int* ty1, int* tx2, int* ty2)
+{
+    double levelScale = 1 << levelNum;
+
+    *tx1 = (int)floor(viewX / levelScale / TileSize);
+    *ty1 = (int)floor(viewY / levelScale / TileSize);
+    *tx2 = (int)floor((viewX + viewWidth) / levelScale / TileSize);
+    *ty2 = (int)floor((viewY + viewHeight) / levelScale / TileSize);
+
+    if (*tx1 < 0) *tx1 = 0;
+    if (*ty1 < 0) *ty1 = 0;
+    if (*tx2 >= tilesX) *tx2 = tilesX - 1;
+    if (*ty2 >= tilesY) *ty2 = tilesY - 1;
+}
+
+/// <summary>
+/// Returns the first free cache slot or, if they are all in use, the
+/// least recently used one.
+/// </summary>
+int tileEvictSlot(const CachedTile* cache)
+{
+    int slot = 0;
+    for (int i = 0; i < MaxCachedTiles; i++) {
+        if (cache[i].bmp == NULL) {
+            return i;
+        }
+        if (cache[i].lastUsed < cache[slot].lastUsed) {
+            slot = i;
+        }
+    }
+
+    return slot;
+}
+
+/// <summary>
+/// Make the next level by averaging each 2x2 block of 32-bit pixels. An
+/// odd last row or column is averaged with itself.
+/// </summary>
+void halvePixels(const unsigned char* from, int fromPitch, int srcWidth, int srcHeight, unsigned char* to, int toPitch)
+{
+    int width = (srcWidth + 1) / 2;
+    int height = (srcHeight + 1) / 2;
+
+    for (int y = 0; y < height; y++) {
+        int y1 = y * 2;
+        int y2 = y1 + 1 < srcHeight ? y1 + 1 : y1;
+        const unsigned char* row1 = from + y1 * fromPitch;
+        const unsigned char* row2 = from + y2 * fromPitch;
+        unsigned char* out = to + y * toPitch;
+
+        for (int x = 0; x < width; x++) {
+            int x1 = x * 8;
+            int x2 = x * 2 + 1 < srcWidth ? x1 + 4 : x1;
+
+            for (int c = 0; c < 4; c++) {
+                *out++ = (row1[x1 + c] + row1[x2 + c] + row2[x1 + c] + row2[x2 + c] + 2) / 4;
+            }
+        }
+    }
+}
+
+/// <summary>
+/// Returns the tile cache file for a chart, the chart with its extension
+/// replaced.
+/// </summary>
+char* tileCacheFile(const char* filename)
+{
+    static char cacheFile[256];
+    strcpy(cacheFile, filename);
+
+    char* last = strrchr(cacheFile, '\\');
+    if (last) {
+        char* ext = strrchr(last, '.');
+        if (ext) {
+            *ext = '\0';
+        }
+    }
+    strcat(cacheFile, TileCacheExt);
+
+    return cacheFile;
+}
+
+void tileCacheHeaderInit(TileCacheHeader* header, ULONGLONG chartSize, ULONGLONG chartTime, int width, int height, int levels)
+{
+    memset(header, 0, sizeof(TileCacheHeader));
+    memcpy(header->magic, TileCacheMagic, sizeof(TileCacheMagic));
+    header->version = TileCacheVersion;
+    header->chartSize = chartSize;
+    header->chartTime = chartTime;
+    header->width = width;
+    header->height = height;
+    header->levels = levels;
+}
+
+/// <summary>
+/// Check a mapped tile cache file is for this chart and its header, level
+/// table and index fit in it. Returns the index or NULL if the file can't
+/// be used. Tile entries are checked as each tile is loaded.
+/// </summary>
+const TileCacheEntry* tileCacheIndex(const unsigned char* data, ULONGLONG size, ULONGLONG chartSize, ULONGLONG chartTime)
+{
+    if (size < sizeof(TileCacheHeader)) {
+        return NULL;
+    }
+
+    const TileCacheHeader* header = (const TileCacheHeader*)data;
+    if (memcmp(header->magic, TileCacheMagic, sizeof(TileCacheMagic)) != 0 || header->version != TileCacheVersion
+        || header->chartSize != chartSize || header->chartTime != chartTime
+        || header->levels < 1 || header->levels > MaxTileLevels) {
+        return NULL;
+    }
+
+    const TileCacheLevel* cacheLevel = (const TileCacheLevel*)(data + sizeof(TileCacheHeader));
+    ULONGLONG indexPos = sizeof(TileCacheHeader) + header->levels * sizeof(TileCacheLevel);
+    if (indexPos > size || cacheLevel[0].width != header->width || cacheLevel[0].height != header->height) {
+        return NULL;
+    }
+
+    // Check the index fits before trusting any of it
+    ULONGLONG totalTiles = 0;
+    for (int i = 0; i < header->levels; i++) {
+        if (cacheLevel[i].width < 1 || cacheLevel[i].height < 1
+            || cacheLevel[i].tilesX != (cacheLevel[i].width + TileSize - 1) / TileSize
+            || cacheLevel[i].tilesY != (cacheLevel[i].height + TileSize - 1) / TileSize) {
+            return NULL;
+        }
+        totalTiles += (ULONGLONG)cacheLevel[i].tilesX * cacheLevel[i].tilesY;
+    }
+
+    if (indexPos + totalTiles * sizeof(TileCacheEntry) > size) {
+        return NULL;
+    }
+
+    return (const TileCacheEntry*)(data + indexPos);
+}
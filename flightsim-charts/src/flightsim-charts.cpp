@@ -1,6 +1,8 @@
 #include <windows.h>
 #include <iostream>
 #include <thread>
+#include "Profiler.h"
+#include "Recorder.h"
 
 const char* versionString = "v2.4.3";
 bool _quit = false;
@@ -8,6 +10,7 @@ bool _showAi = false;
 bool _noConnect = false;
 
 void server();
+void serverNotify();
 void showChart();
 
 int main(int argc, char **argv)
@@ -27,8 +30,28 @@ int main(int argc, char **argv)
             _noConnect = true;
             _showAi = false;
         }
+        if (_stricmp(argv[i], "record") == 0 && i + 1 < argc) {
+            // Record SimConnect and fr24 data to a file
+            if (!recordStart(argv[++i])) {
+                return 1;
+            }
+        }
+        else if (_stricmp(argv[i], "replay") == 0 && i + 1 < argc) {
+            // Replay a recording instead of connecting, optionally as fast as possible
+            const char* filename = argv[++i];
+            bool fast = i + 1 < argc && _stricmp(argv[i + 1], "fast") == 0;
+            if (fast) {
+                i++;
+            }
+            if (!replayStart(filename, fast)) {
+                return 1;
+            }
+            _showAi = true;
+        }
     }
 
+    profilerInit();
+
     // Start a thread to connect to FS2020 via SimConnect
     std::thread serverThread(server);
 
@@ -38,7 +61,11 @@ int main(int argc, char **argv)
     showChart();
 
     // Wait for server to exit
+    serverNotify();
     serverThread.join();
 
+    profilerDump();
+    recorderCleanup();
+
     return 0;
 }